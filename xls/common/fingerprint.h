@@ -0,0 +1,55 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_COMMON_FINGERPRINT_H_
+#define XLS_COMMON_FINGERPRINT_H_
+
+#include "absl/strings/string_view.h"
+#include "xls/common/integral_types.h"
+
+namespace xls {
+
+// Non-cryptographic 64-bit hashing for fingerprinting data structures. Unlike
+// absl::Hash, the values are the same in every process, so fingerprints may be
+// persisted and compared across runs.
+
+// Scrambles the bits of the value (the SplitMix64 finalizer).
+inline uint64 FingerprintMix(uint64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// Returns the fingerprint of the sequence 'a, b' where 'a' is the fingerprint
+// of a prefix of the sequence. The combination is not commutative.
+inline uint64 FingerprintCombine(uint64 a, uint64 b) {
+  return FingerprintMix(a * 0x9e3779b97f4a7c15ULL + FingerprintMix(b));
+}
+
+// Returns the fingerprint of the bytes of the string (FNV-1a, mixed).
+inline uint64 FingerprintString(absl::string_view s) {
+  uint64 hash = 0xcbf29ce484222325ULL;
+  for (char c : s) {
+    hash ^= static_cast<uint8>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return FingerprintMix(hash);
+}
+
+}  // namespace xls
+
+#endif  // XLS_COMMON_FINGERPRINT_H_
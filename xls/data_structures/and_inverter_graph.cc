@@ -0,0 +1,778 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/data_structures/and_inverter_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "xls/common/logging/logging.h"
+
+namespace xls {
+namespace {
+
+// The initial number of slots in the unique table.
+constexpr int64 kInitialUniqueTableSize = 1 << 10;
+
+// The maximum number of leaves of the cuts used by Rewrite and Refactor, and
+// the maximum number of cuts kept for each node by Rewrite.
+constexpr int64 kRewriteCutSize = 4;
+constexpr int64 kRefactorCutSize = 6;
+constexpr int64 kMaxCutsPerNode = 8;
+
+uint64 Mix(uint64 a, uint64 b) {
+  uint64 h = a * 0x9e3779b97f4a7c15ULL;
+  h ^= b * 0xc2b2ae3d27d4eb4fULL;
+  return h ^ (h >> 31);
+}
+
+AigLiteral NodeLiteral(int32 node) { return AigLiteral(node << 1); }
+
+// Returns the literal with the complement of 'a' applied to 'b'.
+AigLiteral ApplyComplement(AigLiteral a, AigLiteral b) {
+  return AigLiteral(b.value() ^ (a.value() & 1));
+}
+
+// Truth tables of functions of up to six variables, one bit per minterm.
+// Functions of fewer variables do not depend on the remaining variables.
+using TruthTable = uint64;
+
+constexpr TruthTable kVariableTruthTables[kRefactorCutSize] = {
+    0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+    0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL};
+
+// Returns the function with the given variable set to false or true.
+TruthTable Cofactor(TruthTable f, int64 var, bool value) {
+  TruthTable mask = kVariableTruthTables[var];
+  int64 shift = int64{1} << var;
+  if (value) {
+    return (f & mask) | ((f & mask) >> shift);
+  }
+  return (f & ~mask) | ((f & ~mask) << shift);
+}
+
+// Returns the truth table of a function of the variables 'from' as a function
+// of the variables 'to', a superset of 'from'.
+TruthTable Stretch(TruthTable f, absl::Span<const int32> from,
+                   absl::Span<const int32> to) {
+  absl::InlinedVector<int64, kRefactorCutSize> positions;
+  for (int32 leaf : from) {
+    positions.push_back(std::find(to.begin(), to.end(), leaf) - to.begin());
+  }
+  TruthTable result = 0;
+  for (int64 minterm = 0; minterm < 64; ++minterm) {
+    int64 source = 0;
+    for (int64 i = 0; i < positions.size(); ++i) {
+      source |= ((minterm >> positions[i]) & 1) << i;
+    }
+    result |= ((f >> source) & 1) << minterm;
+  }
+  return result;
+}
+
+// Finds cheap implementations of truth tables by Shannon decomposition,
+// choosing the variable which gives the fewest AND nodes. The cost ignores
+// sharing between the cofactors.
+class Synthesizer {
+ public:
+  int32 Cost(TruthTable f) {
+    if (IsTrivial(f)) {
+      return 0;
+    }
+    auto it = cache_.find(f);
+    if (it != cache_.end()) {
+      return it->second.first;
+    }
+    int32 best_cost = std::numeric_limits<int32>::max();
+    int32 best_var = -1;
+    for (int32 var = 0; var < kRefactorCutSize; ++var) {
+      TruthTable f0 = Cofactor(f, var, false);
+      TruthTable f1 = Cofactor(f, var, true);
+      if (f0 == f1) {
+        continue;
+      }
+      int32 cost;
+      if (IsConstant(f0)) {
+        cost = 1 + Cost(f1);
+      } else if (IsConstant(f1)) {
+        cost = 1 + Cost(f0);
+      } else if (f0 == ~f1) {
+        cost = 3 + Cost(f0);
+      } else {
+        cost = 3 + Cost(f0) + Cost(f1);
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_var = var;
+      }
+    }
+    cache_[f] = {best_cost, best_var};
+    return best_cost;
+  }
+
+  // Builds the function of the given leaves with 'and_fn', which returns the
+  // AND of two literals.
+  AigLiteral Build(TruthTable f, absl::Span<const AigLiteral> leaves,
+                   const std::function<AigLiteral(AigLiteral, AigLiteral)>&
+                       and_fn) {
+    if (f == 0) {
+      return AigLiteral(0);
+    }
+    if (f == ~TruthTable{0}) {
+      return AigLiteral(1);
+    }
+    for (int64 var = 0; var < leaves.size(); ++var) {
+      if (f == kVariableTruthTables[var]) {
+        return leaves[var];
+      }
+      if (f == ~kVariableTruthTables[var]) {
+        return AndInverterGraph::Not(leaves[var]);
+      }
+    }
+    Cost(f);
+    int32 var = cache_.at(f).second;
+    AigLiteral v = leaves[var];
+    TruthTable f0 = Cofactor(f, var, false);
+    TruthTable f1 = Cofactor(f, var, true);
+    auto not_fn = AndInverterGraph::Not;
+    auto or_fn = [&](AigLiteral a, AigLiteral b) {
+      return not_fn(and_fn(not_fn(a), not_fn(b)));
+    };
+    if (f0 == 0) {
+      return and_fn(v, Build(f1, leaves, and_fn));
+    }
+    if (f0 == ~TruthTable{0}) {
+      return or_fn(not_fn(v), Build(f1, leaves, and_fn));
+    }
+    if (f1 == 0) {
+      return and_fn(not_fn(v), Build(f0, leaves, and_fn));
+    }
+    if (f1 == ~TruthTable{0}) {
+      return or_fn(v, Build(f0, leaves, and_fn));
+    }
+    AigLiteral g0 = Build(f0, leaves, and_fn);
+    AigLiteral g1 = f0 == ~f1 ? not_fn(g0) : Build(f1, leaves, and_fn);
+    return or_fn(and_fn(v, g1), and_fn(not_fn(v), g0));
+  }
+
+ private:
+  static bool IsConstant(TruthTable f) { return f == 0 || f == ~TruthTable{0}; }
+
+  static bool IsTrivial(TruthTable f) {
+    if (IsConstant(f)) {
+      return true;
+    }
+    for (TruthTable v : kVariableTruthTables) {
+      if (f == v || f == ~v) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The cost of each truth table and the variable to decompose it by.
+  absl::flat_hash_map<TruthTable, std::pair<int32, int32>> cache_;
+};
+
+// The state of building a new graph from the nodes of an old one which are
+// reachable from the roots.
+struct Rebuild {
+  explicit Rebuild(const AndInverterGraph& old_graph,
+                   absl::Span<const AigLiteral> roots)
+      : old_graph(old_graph),
+        map(old_graph.node_count(), kAigNoFanin),
+        reachable(old_graph.node_count(), false),
+        fanout_counts(old_graph.node_count(), 0) {
+    // Inputs are kept, even if unreachable, to preserve their order.
+    map[0] = graph.zero();
+    for (AigLiteral input : old_graph.inputs()) {
+      map[AndInverterGraph::NodeIndex(input)] = graph.NewInput();
+    }
+    for (AigLiteral root : roots) {
+      reachable[AndInverterGraph::NodeIndex(root)] = true;
+      ++fanout_counts[AndInverterGraph::NodeIndex(root)];
+    }
+    for (int32 node = old_graph.node_count() - 1; node > 0; --node) {
+      const AigNode& n = old_graph.GetNode(NodeLiteral(node));
+      if (!reachable[node] || n.fanin0 == kAigNoFanin) {
+        continue;
+      }
+      for (AigLiteral fanin : {n.fanin0, n.fanin1}) {
+        reachable[AndInverterGraph::NodeIndex(fanin)] = true;
+        ++fanout_counts[AndInverterGraph::NodeIndex(fanin)];
+      }
+    }
+  }
+
+  // Returns the literal in the new graph of a literal of the old graph whose
+  // node has been built.
+  AigLiteral Map(AigLiteral a) const {
+    AigLiteral mapped = map[AndInverterGraph::NodeIndex(a)];
+    XLS_CHECK(mapped != kAigNoFanin);
+    return ApplyComplement(a, mapped);
+  }
+
+  bool IsAndNode(int32 node) const {
+    return old_graph.IsAnd(NodeLiteral(node));
+  }
+
+  // Builds the node as the AND of its mapped fanins.
+  void BuildCopy(int32 node) {
+    const AigNode& n = old_graph.GetNode(NodeLiteral(node));
+    map[node] = graph.And(Map(n.fanin0), Map(n.fanin1));
+  }
+
+  // Dereferences the maximum fanout-free cone of the node with respect to the
+  // given leaves: the nodes of its cone whose fanouts are all in the cone,
+  // which would no longer be used if the node were implemented directly from
+  // the leaves. Returns the number of nodes in the cone, and appends the
+  // dereferenced fanins to 'dereferenced' so they can be restored.
+  int64 DereferenceMffc(int32 root, absl::Span<const int32> leaves,
+                        std::vector<int32>* dereferenced) {
+    int64 size = 0;
+    std::vector<int32> stack = {root};
+    while (!stack.empty()) {
+      int32 node = stack.back();
+      stack.pop_back();
+      ++size;
+      const AigNode& n = old_graph.GetNode(NodeLiteral(node));
+      for (AigLiteral fanin : {n.fanin0, n.fanin1}) {
+        int32 fanin_node = AndInverterGraph::NodeIndex(fanin);
+        if (!IsAndNode(fanin_node) ||
+            std::find(leaves.begin(), leaves.end(), fanin_node) !=
+                leaves.end()) {
+          continue;
+        }
+        dereferenced->push_back(fanin_node);
+        if (--fanout_counts[fanin_node] == 0) {
+          stack.push_back(fanin_node);
+        }
+      }
+    }
+    return size;
+  }
+
+  // Returns the number of nodes Synthesizer::Build would add to the new graph
+  // to implement the function of the given leaves.
+  int64 CountNewNodes(Synthesizer* synthesizer, TruthTable f,
+                      absl::Span<const AigLiteral> leaves) const {
+    // Nodes which are not in the graph get indices past its end.
+    absl::flat_hash_map<std::pair<AigLiteral, AigLiteral>, AigLiteral>
+        new_nodes;
+    int32 next_node = graph.node_count();
+    synthesizer->Build(f, leaves, [&](AigLiteral a, AigLiteral b) {
+      if (AndInverterGraph::NodeIndex(a) < graph.node_count() &&
+          AndInverterGraph::NodeIndex(b) < graph.node_count()) {
+        absl::optional<AigLiteral> existing = graph.FindAnd(a, b);
+        if (existing.has_value()) {
+          return *existing;
+        }
+      }
+      if (a > b) {
+        std::swap(a, b);
+      }
+      auto it = new_nodes.find({a, b});
+      if (it != new_nodes.end()) {
+        return it->second;
+      }
+      AigLiteral result = NodeLiteral(next_node++);
+      new_nodes[{a, b}] = result;
+      return result;
+    });
+    return new_nodes.size();
+  }
+
+  // Implements the node with the function of the given leaves if this saves
+  // nodes. Returns whether it did. The fanout counts of the nodes which are
+  // no longer used are left decremented so that later nodes see them as
+  // free.
+  bool TryResynthesize(int32 node, absl::Span<const int32> leaves,
+                       TruthTable f, Synthesizer* synthesizer) {
+    std::vector<int32> dereferenced;
+    int64 mffc_size = DereferenceMffc(node, leaves, &dereferenced);
+    absl::InlinedVector<AigLiteral, kRefactorCutSize> mapped_leaves;
+    for (int32 leaf : leaves) {
+      mapped_leaves.push_back(Map(NodeLiteral(leaf)));
+    }
+    if (CountNewNodes(synthesizer, f, mapped_leaves) >= mffc_size) {
+      for (int32 fanin : dereferenced) {
+        ++fanout_counts[fanin];
+      }
+      return false;
+    }
+    map[node] = synthesizer->Build(
+        f, mapped_leaves,
+        [&](AigLiteral a, AigLiteral b) { return graph.And(a, b); });
+    return true;
+  }
+
+  // Returns the new graph, compacted, with the roots mapped to it.
+  AndInverterGraph Finish(std::vector<AigLiteral>* roots) {
+    for (AigLiteral& root : *roots) {
+      root = Map(root);
+    }
+    graph.Compact(roots);
+    return std::move(graph);
+  }
+
+  const AndInverterGraph& old_graph;
+  AndInverterGraph graph;
+  std::vector<AigLiteral> map;
+  std::vector<bool> reachable;
+  std::vector<int32> fanout_counts;
+};
+
+// Replaces 'graph' by the graph built by 'rebuild' from it unless that has
+// more AND nodes. The cost estimates of the resynthesis are not exact, so a
+// rewrite pass can occasionally make the graph larger.
+void KeepIfSmaller(Rebuild* rebuild, AndInverterGraph* graph,
+                   std::vector<AigLiteral>* roots) {
+  std::vector<AigLiteral> new_roots = *roots;
+  AndInverterGraph result = rebuild->Finish(&new_roots);
+  if (result.and_count() <= graph->and_count()) {
+    *graph = std::move(result);
+    *roots = std::move(new_roots);
+  }
+}
+
+// A cut of a node: a set of nodes, sorted by index, such that every path from
+// the inputs to the node passes through one of them, and the function of the
+// node in terms of the leaves.
+struct Cut {
+  absl::InlinedVector<int32, kRewriteCutSize> leaves;
+  TruthTable function;
+};
+
+// Returns the cuts of the node with at most kRewriteCutSize leaves given the
+// cuts of its fanins. The trivial cut holding only the node itself is last.
+std::vector<Cut> ComputeCuts(int32 node, const AigNode& n,
+                             const std::vector<std::vector<Cut>>& cuts) {
+  std::vector<Cut> result;
+  for (const Cut& cut0 : cuts[AndInverterGraph::NodeIndex(n.fanin0)]) {
+    for (const Cut& cut1 : cuts[AndInverterGraph::NodeIndex(n.fanin1)]) {
+      Cut cut;
+      std::set_union(cut0.leaves.begin(), cut0.leaves.end(),
+                     cut1.leaves.begin(), cut1.leaves.end(),
+                     std::back_inserter(cut.leaves));
+      if (cut.leaves.size() > kRewriteCutSize ||
+          std::any_of(result.begin(), result.end(), [&](const Cut& c) {
+            return c.leaves == cut.leaves;
+          })) {
+        continue;
+      }
+      TruthTable f0 = Stretch(cut0.function, cut0.leaves, cut.leaves);
+      TruthTable f1 = Stretch(cut1.function, cut1.leaves, cut.leaves);
+      cut.function = (AndInverterGraph::IsComplemented(n.fanin0) ? ~f0 : f0) &
+                     (AndInverterGraph::IsComplemented(n.fanin1) ? ~f1 : f1);
+      result.push_back(std::move(cut));
+    }
+  }
+  std::stable_sort(result.begin(), result.end(),
+                   [](const Cut& a, const Cut& b) {
+                     return a.leaves.size() < b.leaves.size();
+                   });
+  if (result.size() > kMaxCutsPerNode) {
+    result.resize(kMaxCutsPerNode);
+  }
+  result.push_back(Cut{{node}, kVariableTruthTables[0]});
+  return result;
+}
+
+// Returns the input nodes each node depends on structurally, sorted, or
+// kRefactorCutSize + 1 of them if it depends on more.
+std::vector<absl::InlinedVector<int32, kRefactorCutSize + 1>> ComputeSupports(
+    const AndInverterGraph& graph) {
+  std::vector<absl::InlinedVector<int32, kRefactorCutSize + 1>> supports(
+      graph.node_count());
+  for (AigLiteral input : graph.inputs()) {
+    supports[AndInverterGraph::NodeIndex(input)].push_back(
+        AndInverterGraph::NodeIndex(input));
+  }
+  for (int32 node = 1; node < graph.node_count(); ++node) {
+    const AigNode& n = graph.GetNode(NodeLiteral(node));
+    if (n.fanin0 == kAigNoFanin) {
+      continue;
+    }
+    const auto& support0 = supports[AndInverterGraph::NodeIndex(n.fanin0)];
+    const auto& support1 = supports[AndInverterGraph::NodeIndex(n.fanin1)];
+    std::set_union(support0.begin(), support0.end(), support1.begin(),
+                   support1.end(), std::back_inserter(supports[node]));
+    if (supports[node].size() > kRefactorCutSize + 1) {
+      supports[node].resize(kRefactorCutSize + 1);
+    }
+  }
+  return supports;
+}
+
+// Returns the leaves of a cut of the node with at most kRefactorCutSize
+// leaves, grown from its fanins by repeatedly replacing the leaf whose fanins
+// add the fewest new leaves, which favors reconvergent paths.
+std::vector<int32> ComputeReconvergentCut(const AndInverterGraph& graph,
+                                          int32 node) {
+  std::vector<int32> leaves;
+  std::vector<int32> cone = {node};
+  auto contains = [](const std::vector<int32>& set, int32 node) {
+    return std::find(set.begin(), set.end(), node) != set.end();
+  };
+  auto add_leaf = [&](AigLiteral fanin) {
+    int32 fanin_node = AndInverterGraph::NodeIndex(fanin);
+    if (!contains(leaves, fanin_node) && !contains(cone, fanin_node)) {
+      leaves.push_back(fanin_node);
+    }
+  };
+  const AigNode& n = graph.GetNode(NodeLiteral(node));
+  add_leaf(n.fanin0);
+  add_leaf(n.fanin1);
+  while (true) {
+    int64 best_leaf = -1;
+    int64 best_cost = std::numeric_limits<int64>::max();
+    for (int64 i = 0; i < leaves.size(); ++i) {
+      if (!graph.IsAnd(NodeLiteral(leaves[i]))) {
+        continue;
+      }
+      const AigNode& leaf = graph.GetNode(NodeLiteral(leaves[i]));
+      int64 cost = -1;
+      for (AigLiteral fanin : {leaf.fanin0, leaf.fanin1}) {
+        int32 fanin_node = AndInverterGraph::NodeIndex(fanin);
+        if (!contains(leaves, fanin_node) && !contains(cone, fanin_node)) {
+          ++cost;
+        }
+      }
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_leaf = i;
+      }
+    }
+    if (best_leaf < 0 || leaves.size() + best_cost > kRefactorCutSize) {
+      break;
+    }
+    int32 expanded = leaves[best_leaf];
+    leaves.erase(leaves.begin() + best_leaf);
+    cone.push_back(expanded);
+    const AigNode& e = graph.GetNode(NodeLiteral(expanded));
+    add_leaf(e.fanin0);
+    add_leaf(e.fanin1);
+  }
+  std::sort(leaves.begin(), leaves.end());
+  return leaves;
+}
+
+// Returns the nodes between the leaves of a cut and the node, in topological
+// order.
+std::vector<int32> ComputeCone(const AndInverterGraph& graph, int32 node,
+                               absl::Span<const int32> leaves) {
+  std::vector<int32> cone;
+  std::vector<int32> stack = {node};
+  while (!stack.empty()) {
+    int32 n = stack.back();
+    stack.pop_back();
+    if (std::find(cone.begin(), cone.end(), n) != cone.end()) {
+      continue;
+    }
+    cone.push_back(n);
+    for (AigLiteral fanin : {graph.GetNode(NodeLiteral(n)).fanin0,
+                             graph.GetNode(NodeLiteral(n)).fanin1}) {
+      int32 fanin_node = AndInverterGraph::NodeIndex(fanin);
+      if (std::find(leaves.begin(), leaves.end(), fanin_node) ==
+          leaves.end()) {
+        stack.push_back(fanin_node);
+      }
+    }
+  }
+  std::sort(cone.begin(), cone.end());
+  return cone;
+}
+
+// Returns the function of the node in terms of the leaves of a cut, given the
+// nodes of its cone in topological order.
+TruthTable ComputeConeFunction(const AndInverterGraph& graph,
+                               absl::Span<const int32> leaves,
+                               absl::Span<const int32> cone) {
+  absl::flat_hash_map<int32, TruthTable> values;
+  values[0] = 0;
+  for (int64 i = 0; i < leaves.size(); ++i) {
+    values[leaves[i]] = kVariableTruthTables[i];
+  }
+  auto value = [&](AigLiteral a) {
+    TruthTable v = values.at(AndInverterGraph::NodeIndex(a));
+    return AndInverterGraph::IsComplemented(a) ? ~v : v;
+  };
+  for (int32 node : cone) {
+    const AigNode& n = graph.GetNode(NodeLiteral(node));
+    values[node] = value(n.fanin0) & value(n.fanin1);
+  }
+  return values.at(cone.back());
+}
+
+}  // namespace
+
+AndInverterGraph::AndInverterGraph()
+    : unique_table_(kInitialUniqueTableSize, 0) {
+  nodes_.push_back(AigNode{kAigNoFanin, kAigNoFanin});
+  levels_.push_back(0);
+}
+
+AigLiteral AndInverterGraph::NewInput() {
+  XLS_CHECK_LT(nodes_.size(), std::numeric_limits<int32>::max() >> 1)
+      << "Too many AIG nodes";
+  AigLiteral input = NodeLiteral(nodes_.size());
+  nodes_.push_back(AigNode{kAigNoFanin, kAigNoFanin});
+  levels_.push_back(0);
+  inputs_.push_back(input);
+  return input;
+}
+
+int32 AndInverterGraph::FindAndNode(AigLiteral a, AigLiteral b) const {
+  uint64 mask = unique_table_.size() - 1;
+  for (uint64 slot = Mix(a.value(), b.value()) & mask;
+       unique_table_[slot] != 0; slot = (slot + 1) & mask) {
+    const AigNode& node = nodes_[unique_table_[slot]];
+    if (node.fanin0 == a && node.fanin1 == b) {
+      return unique_table_[slot];
+    }
+  }
+  return 0;
+}
+
+void AndInverterGraph::InsertIntoUniqueTable(int32 node) {
+  const AigNode& n = nodes_[node];
+  uint64 mask = unique_table_.size() - 1;
+  for (uint64 slot = Mix(n.fanin0.value(), n.fanin1.value()) & mask;;
+       slot = (slot + 1) & mask) {
+    if (unique_table_[slot] == 0) {
+      unique_table_[slot] = node;
+      return;
+    }
+  }
+}
+
+absl::optional<AigLiteral> AndInverterGraph::FindAnd(AigLiteral a,
+                                                     AigLiteral b) const {
+  if (a > b) {
+    std::swap(a, b);
+  }
+  if (a == zero() || a == Not(b)) {
+    return zero();
+  }
+  if (a == one() || a == b) {
+    return b;
+  }
+  int32 node = FindAndNode(a, b);
+  if (node == 0) {
+    return absl::nullopt;
+  }
+  return NodeLiteral(node);
+}
+
+AigLiteral AndInverterGraph::And(AigLiteral a, AigLiteral b) {
+  absl::optional<AigLiteral> existing = FindAnd(a, b);
+  if (existing.has_value()) {
+    return *existing;
+  }
+  if (a > b) {
+    std::swap(a, b);
+  }
+  XLS_CHECK_LT(nodes_.size(), std::numeric_limits<int32>::max() >> 1)
+      << "Too many AIG nodes";
+  // Keep the load factor of the table at most one half.
+  if (2 * (and_count() + 1) > unique_table_.size()) {
+    unique_table_.assign(2 * unique_table_.size(), 0);
+    for (int32 node = 1; node < nodes_.size(); ++node) {
+      if (nodes_[node].fanin0 != kAigNoFanin) {
+        InsertIntoUniqueTable(node);
+      }
+    }
+  }
+  int32 node = nodes_.size();
+  nodes_.push_back(AigNode{a, b});
+  levels_.push_back(1 + std::max(GetLevel(a), GetLevel(b)));
+  InsertIntoUniqueTable(node);
+  return NodeLiteral(node);
+}
+
+AigLiteral AndInverterGraph::Xor(AigLiteral a, AigLiteral b) {
+  return Or(And(a, Not(b)), And(Not(a), b));
+}
+
+AigLiteral AndInverterGraph::Mux(AigLiteral selector, AigLiteral if_true,
+                                 AigLiteral if_false) {
+  return Or(And(selector, if_true), And(Not(selector), if_false));
+}
+
+int32 AndInverterGraph::GetDepth(absl::Span<const AigLiteral> roots) const {
+  int32 depth = 0;
+  for (AigLiteral root : roots) {
+    depth = std::max(depth, GetLevel(root));
+  }
+  return depth;
+}
+
+std::vector<uint64> AndInverterGraph::Simulate(
+    absl::Span<const uint64> input_values) const {
+  XLS_CHECK_EQ(input_values.size(), inputs_.size());
+  std::vector<uint64> values(nodes_.size(), 0);
+  for (int64 i = 0; i < inputs_.size(); ++i) {
+    values[NodeIndex(inputs_[i])] = input_values[i];
+  }
+  for (int32 node = 1; node < nodes_.size(); ++node) {
+    const AigNode& n = nodes_[node];
+    if (n.fanin0 != kAigNoFanin) {
+      values[node] = GetValue(values, n.fanin0) & GetValue(values, n.fanin1);
+    }
+  }
+  return values;
+}
+
+void AndInverterGraph::Compact(std::vector<AigLiteral>* roots) {
+  Rebuild rebuild(*this, *roots);
+  for (int32 node = 1; node < node_count(); ++node) {
+    if (rebuild.reachable[node] && rebuild.IsAndNode(node)) {
+      rebuild.BuildCopy(node);
+    }
+  }
+  for (AigLiteral& root : *roots) {
+    root = rebuild.Map(root);
+  }
+  *this = std::move(rebuild.graph);
+}
+
+void AndInverterGraph::Balance(std::vector<AigLiteral>* roots) {
+  Rebuild rebuild(*this, *roots);
+  // The leaves of the tree of ANDs rooted at each node which is built: the
+  // tree extends through uncomplemented fanins used only by the tree.
+  std::vector<std::vector<AigLiteral>> supergate_leaves(node_count());
+  std::vector<bool> needed(node_count(), false);
+  for (AigLiteral root : *roots) {
+    needed[NodeIndex(root)] = true;
+  }
+  for (int32 node = node_count() - 1; node > 0; --node) {
+    if (!needed[node] || !rebuild.IsAndNode(node)) {
+      continue;
+    }
+    const AigNode& n = nodes_[node];
+    std::vector<AigLiteral> stack = {n.fanin1, n.fanin0};
+    while (!stack.empty()) {
+      AigLiteral a = stack.back();
+      stack.pop_back();
+      if (!IsComplemented(a) && IsAnd(a) &&
+          rebuild.fanout_counts[NodeIndex(a)] == 1) {
+        stack.push_back(GetNode(a).fanin1);
+        stack.push_back(GetNode(a).fanin0);
+      } else {
+        supergate_leaves[node].push_back(a);
+        needed[NodeIndex(a)] = true;
+      }
+    }
+  }
+  for (int32 node = 1; node < node_count(); ++node) {
+    if (!needed[node] || !rebuild.IsAndNode(node)) {
+      continue;
+    }
+    // Combine the two shallowest operands until one is left.
+    using Operand = std::pair<int32, AigLiteral>;
+    std::priority_queue<Operand, std::vector<Operand>, std::greater<Operand>>
+        operands;
+    for (AigLiteral leaf : supergate_leaves[node]) {
+      AigLiteral mapped = rebuild.Map(leaf);
+      operands.push({rebuild.graph.GetLevel(mapped), mapped});
+    }
+    while (operands.size() > 1) {
+      AigLiteral a = operands.top().second;
+      operands.pop();
+      AigLiteral b = operands.top().second;
+      operands.pop();
+      AigLiteral result = rebuild.graph.And(a, b);
+      operands.push({rebuild.graph.GetLevel(result), result});
+    }
+    rebuild.map[node] = operands.top().second;
+  }
+  *this = rebuild.Finish(roots);
+}
+
+void AndInverterGraph::Rewrite(std::vector<AigLiteral>* roots) {
+  Compact(roots);
+  Rebuild rebuild(*this, *roots);
+  Synthesizer synthesizer;
+  std::vector<std::vector<Cut>> cuts(node_count());
+  cuts[0].push_back(Cut{{}, 0});
+  for (AigLiteral input : inputs_) {
+    cuts[NodeIndex(input)].push_back(
+        Cut{{NodeIndex(input)}, kVariableTruthTables[0]});
+  }
+  for (int32 node = 1; node < node_count(); ++node) {
+    if (!rebuild.IsAndNode(node)) {
+      continue;
+    }
+    cuts[node] = ComputeCuts(node, nodes_[node], cuts);
+    // Try the cuts with the cheapest implementations first.
+    std::vector<const Cut*> candidates;
+    for (const Cut& cut : cuts[node]) {
+      if (cut.leaves.size() != 1 || cut.leaves[0] != node) {
+        candidates.push_back(&cut);
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&](const Cut* a, const Cut* b) {
+                       return synthesizer.Cost(a->function) <
+                              synthesizer.Cost(b->function);
+                     });
+    bool resynthesized = false;
+    for (const Cut* cut : candidates) {
+      if (rebuild.TryResynthesize(node, cut->leaves, cut->function,
+                                  &synthesizer)) {
+        resynthesized = true;
+        break;
+      }
+    }
+    if (!resynthesized) {
+      rebuild.BuildCopy(node);
+    }
+  }
+  KeepIfSmaller(&rebuild, this, roots);
+}
+
+void AndInverterGraph::Refactor(std::vector<AigLiteral>* roots) {
+  Compact(roots);
+  Rebuild rebuild(*this, *roots);
+  Synthesizer synthesizer;
+  auto supports = ComputeSupports(*this);
+  for (int32 node = 1; node < node_count(); ++node) {
+    if (!rebuild.IsAndNode(node)) {
+      continue;
+    }
+    // Narrow logic is best resynthesized from the inputs, which a
+    // reconvergent cut may not reach.
+    std::vector<int32> leaves;
+    if (supports[node].size() <= kRefactorCutSize) {
+      leaves.assign(supports[node].begin(), supports[node].end());
+    } else {
+      leaves = ComputeReconvergentCut(*this, node);
+    }
+    std::vector<int32> cone = ComputeCone(*this, node, leaves);
+    if (cone.size() < 2 ||
+        !rebuild.TryResynthesize(node, leaves,
+                                 ComputeConeFunction(*this, leaves, cone),
+                                 &synthesizer)) {
+      rebuild.BuildCopy(node);
+    }
+  }
+  KeepIfSmaller(&rebuild, this, roots);
+}
+
+}  // namespace xls
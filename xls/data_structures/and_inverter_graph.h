@@ -0,0 +1,154 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_DATA_STRUCTURES_AND_INVERTER_GRAPH_H_
+#define XLS_DATA_STRUCTURES_AND_INVERTER_GRAPH_H_
+
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/strong_int.h"
+
+namespace xls {
+
+// A literal of an and-inverter graph refers to a node, possibly inverted: it
+// is the index of the node shifted left by one with the least significant bit
+// set if the literal is complemented.
+DEFINE_STRONG_INT_TYPE(AigLiteral, int32);
+
+// The fanin of the constant node and of inputs.
+constexpr AigLiteral kAigNoFanin(-1);
+
+// A node of an and-inverter graph: the AND of its two fanins, or an input or
+// the constant node if both fanins are kAigNoFanin. The fanins of an AND node
+// always refer to nodes with smaller indices, and fanin0 < fanin1.
+struct AigNode {
+  AigLiteral fanin0;
+  AigLiteral fanin1;
+};
+
+// An and-inverter graph (AIG): a bit-level representation of combinational
+// logic in which every node is a two-input AND and edges may be inverted. The
+// nodes are held in one contiguous array in topological order, node zero is
+// the constant false, and the AND nodes are structurally hashed so no two
+// have the same fanins. Trivial ANDs (with a constant, with the same literal
+// or with its inverse) are simplified as they are created.
+//
+// The graph is optimized with rewriting passes which, like ABC, build a new
+// graph from the expressions the caller still needs (the roots) and update the
+// roots in place:
+//
+//   Balance:  rebuilds each tree of ANDs with a minimal depth.
+//   Rewrite:  replaces the logic of each node by a cheaper implementation of
+//             the function of one of its small cuts (up to four leaves).
+//   Refactor: like Rewrite, but with one large cut per node (up to six
+//             leaves): its inputs if there are few enough, or otherwise a
+//             cut grown along reconvergent paths.
+//
+// Inputs keep their order across the passes, but their literals may change,
+// so they should be referred to by their position in inputs().
+//
+// Based on:
+//   A. Mishchenko, S. Chatterjee, and R. Brayton,
+//   "DAG-aware AIG rewriting: a fresh look at combinational logic synthesis"
+//   https://dl.acm.org/doi/10.1145/1146909.1147048
+class AndInverterGraph {
+ public:
+  AndInverterGraph();
+
+  // Adds a new input to the graph and returns its literal.
+  AigLiteral NewInput();
+
+  // Returns the inverse of the given literal.
+  static AigLiteral Not(AigLiteral a) { return AigLiteral(a.value() ^ 1); }
+
+  // Returns the AND/OR/XOR of the given literals, and the literal equal to
+  // 'if_true' when 'selector' is true and 'if_false' otherwise.
+  AigLiteral And(AigLiteral a, AigLiteral b);
+  AigLiteral Or(AigLiteral a, AigLiteral b) {
+    return Not(And(Not(a), Not(b)));
+  }
+  AigLiteral Xor(AigLiteral a, AigLiteral b);
+  AigLiteral Mux(AigLiteral selector, AigLiteral if_true, AigLiteral if_false);
+
+  // The literals of the constant node.
+  AigLiteral zero() const { return AigLiteral(0); }
+  AigLiteral one() const { return AigLiteral(1); }
+
+  static int32 NodeIndex(AigLiteral a) { return a.value() >> 1; }
+  static bool IsComplemented(AigLiteral a) { return a.value() & 1; }
+
+  const AigNode& GetNode(AigLiteral a) const { return nodes_[NodeIndex(a)]; }
+  bool IsAnd(AigLiteral a) const { return GetNode(a).fanin0 != kAigNoFanin; }
+
+  // Returns the number of AND nodes between the literal and the inputs on the
+  // longest path.
+  int32 GetLevel(AigLiteral a) const { return levels_[NodeIndex(a)]; }
+
+  // Returns the literals of the inputs in the order they were created.
+  const std::vector<AigLiteral>& inputs() const { return inputs_; }
+
+  // Returns the number of nodes, including the constant and the inputs, and
+  // the number of AND nodes.
+  int64 node_count() const { return nodes_.size(); }
+  int64 and_count() const { return nodes_.size() - inputs_.size() - 1; }
+
+  // Returns the literal equal to the AND of the given literals if the graph
+  // already has it, without adding a node. Trivial ANDs are simplified.
+  absl::optional<AigLiteral> FindAnd(AigLiteral a, AigLiteral b) const;
+
+  // Returns the maximum level of the given literals.
+  int32 GetDepth(absl::Span<const AigLiteral> roots) const;
+
+  // Simulates the graph with one 64-bit word of patterns per input, in the
+  // order of inputs(). Returns a word per node; see GetValue.
+  std::vector<uint64> Simulate(absl::Span<const uint64> input_values) const;
+
+  // Returns the simulated value of the given literal.
+  static uint64 GetValue(absl::Span<const uint64> node_values, AigLiteral a) {
+    uint64 value = node_values[NodeIndex(a)];
+    return IsComplemented(a) ? ~value : value;
+  }
+
+  // Removes the nodes which are not reachable from the roots.
+  void Compact(std::vector<AigLiteral>* roots);
+
+  // The optimization passes described above. The result is compacted.
+  void Balance(std::vector<AigLiteral>* roots);
+  void Rewrite(std::vector<AigLiteral>* roots);
+  void Refactor(std::vector<AigLiteral>* roots);
+
+ private:
+  // Returns the index of the AND node with the given fanins, which must be
+  // ordered, or zero if there is none.
+  int32 FindAndNode(AigLiteral a, AigLiteral b) const;
+
+  // Inserts the node with the given index into the unique table, which must
+  // have room for it.
+  void InsertIntoUniqueTable(int32 node);
+
+  std::vector<AigNode> nodes_;
+  std::vector<int32> levels_;
+  std::vector<AigLiteral> inputs_;
+
+  // An open-addressed hash table from the fanins of an AND node to its index,
+  // using linear probing. Empty slots hold zero, the index of the constant.
+  std::vector<int32> unique_table_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_DATA_STRUCTURES_AND_INVERTER_GRAPH_H_
@@ -0,0 +1,213 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/data_structures/and_inverter_graph.h"
+
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/numeric/bits.h"
+#include "absl/random/random.h"
+#include "xls/common/integral_types.h"
+
+namespace xls {
+namespace {
+
+// Returns the values of the roots for several rounds of random patterns.
+std::vector<uint64> SimulateRoots(const AndInverterGraph& aig,
+                                  absl::Span<const AigLiteral> roots) {
+  std::mt19937_64 engine(0);
+  std::vector<uint64> result;
+  for (int64 round = 0; round < 16; ++round) {
+    std::vector<uint64> input_values;
+    for (int64 i = 0; i < aig.inputs().size(); ++i) {
+      input_values.push_back(engine());
+    }
+    std::vector<uint64> values = aig.Simulate(input_values);
+    for (AigLiteral root : roots) {
+      result.push_back(AndInverterGraph::GetValue(values, root));
+    }
+  }
+  return result;
+}
+
+TEST(AndInverterGraphTest, StructuralHashingAndSimplification) {
+  AndInverterGraph aig;
+  AigLiteral a = aig.NewInput();
+  AigLiteral b = aig.NewInput();
+  EXPECT_EQ(aig.node_count(), 3);
+  EXPECT_EQ(aig.and_count(), 0);
+
+  AigLiteral a_and_b = aig.And(a, b);
+  EXPECT_EQ(aig.And(b, a), a_and_b);
+  EXPECT_EQ(aig.and_count(), 1);
+  EXPECT_EQ(aig.FindAnd(b, a), a_and_b);
+  EXPECT_FALSE(aig.FindAnd(a, AndInverterGraph::Not(b)).has_value());
+  EXPECT_EQ(aig.GetLevel(a_and_b), 1);
+  EXPECT_TRUE(aig.IsAnd(a_and_b));
+  EXPECT_FALSE(aig.IsAnd(a));
+
+  EXPECT_EQ(aig.And(a, aig.zero()), aig.zero());
+  EXPECT_EQ(aig.And(a, aig.one()), a);
+  EXPECT_EQ(aig.And(a, a), a);
+  EXPECT_EQ(aig.And(a, AndInverterGraph::Not(a)), aig.zero());
+  EXPECT_EQ(aig.Or(a, AndInverterGraph::Not(a)), aig.one());
+  EXPECT_EQ(aig.and_count(), 1);
+
+  AigLiteral x = aig.Xor(a, b);
+  EXPECT_EQ(aig.and_count(), 4);
+  EXPECT_EQ(aig.Xor(b, a), x);
+  EXPECT_EQ(aig.and_count(), 4);
+
+  std::vector<uint64> values = aig.Simulate({0b0101, 0b0011});
+  EXPECT_EQ(AndInverterGraph::GetValue(values, a_and_b), 0b0001);
+  EXPECT_EQ(AndInverterGraph::GetValue(values, x), 0b0110);
+  EXPECT_EQ(AndInverterGraph::GetValue(values, AndInverterGraph::Not(x)),
+            ~uint64{0b0110});
+}
+
+TEST(AndInverterGraphTest, CompactRemovesUnreachableNodes) {
+  AndInverterGraph aig;
+  AigLiteral a = aig.NewInput();
+  AigLiteral b = aig.NewInput();
+  AigLiteral c = aig.NewInput();
+  aig.And(a, b);
+  std::vector<AigLiteral> roots = {
+      AndInverterGraph::Not(aig.And(aig.And(b, c), a))};
+  std::vector<uint64> expected = SimulateRoots(aig, roots);
+  EXPECT_EQ(aig.and_count(), 3);
+
+  aig.Compact(&roots);
+  EXPECT_EQ(aig.and_count(), 2);
+  EXPECT_EQ(aig.inputs().size(), 3);
+  EXPECT_TRUE(AndInverterGraph::IsComplemented(roots[0]));
+  EXPECT_EQ(SimulateRoots(aig, roots), expected);
+}
+
+TEST(AndInverterGraphTest, BalanceReducesDepth) {
+  AndInverterGraph aig;
+  AigLiteral chain = aig.NewInput();
+  for (int64 i = 0; i < 7; ++i) {
+    chain = aig.And(chain, aig.NewInput());
+  }
+  std::vector<AigLiteral> roots = {chain};
+  std::vector<uint64> expected = SimulateRoots(aig, roots);
+  EXPECT_EQ(aig.GetDepth(roots), 7);
+
+  aig.Balance(&roots);
+  EXPECT_EQ(aig.GetDepth(roots), 3);
+  EXPECT_EQ(aig.and_count(), 7);
+  EXPECT_EQ(SimulateRoots(aig, roots), expected);
+}
+
+TEST(AndInverterGraphTest, RewriteRemovesRedundantLogic) {
+  AndInverterGraph aig;
+  AigLiteral a = aig.NewInput();
+  AigLiteral b = aig.NewInput();
+  AigLiteral c = aig.NewInput();
+  // (a & b) | (a & ~b) is a; (a & b) | (a & c) is a & (b | c).
+  std::vector<AigLiteral> roots = {
+      aig.Or(aig.And(a, b), aig.And(a, AndInverterGraph::Not(b))),
+      aig.Or(aig.And(a, b), aig.And(a, c))};
+  std::vector<uint64> expected = SimulateRoots(aig, roots);
+  EXPECT_EQ(aig.and_count(), 5);
+
+  aig.Rewrite(&roots);
+  EXPECT_EQ(roots[0], aig.inputs()[0]);
+  EXPECT_EQ(aig.and_count(), 2);
+  EXPECT_EQ(SimulateRoots(aig, roots), expected);
+}
+
+TEST(AndInverterGraphTest, RefactorSumOfProducts) {
+  AndInverterGraph aig;
+  std::vector<AigLiteral> inputs;
+  for (int64 i = 0; i < 4; ++i) {
+    inputs.push_back(aig.NewInput());
+  }
+  // The parity of the inputs as the OR of its eight minterms.
+  AigLiteral parity = aig.zero();
+  for (int64 minterm = 0; minterm < 16; ++minterm) {
+    if (absl::popcount(static_cast<uint64>(minterm)) % 2 == 0) {
+      continue;
+    }
+    AigLiteral product = aig.one();
+    for (int64 i = 0; i < 4; ++i) {
+      product = aig.And(product, (minterm >> i) & 1
+                                     ? inputs[i]
+                                     : AndInverterGraph::Not(inputs[i]));
+    }
+    parity = aig.Or(parity, product);
+  }
+  std::vector<AigLiteral> roots = {parity};
+  std::vector<uint64> expected = SimulateRoots(aig, roots);
+  int64 original_count = aig.and_count();
+
+  aig.Refactor(&roots);
+  // Three XORs of three ANDs each.
+  EXPECT_EQ(aig.and_count(), 9);
+  EXPECT_LT(aig.and_count(), original_count);
+  EXPECT_EQ(SimulateRoots(aig, roots), expected);
+}
+
+// Every pass preserves the functions of the roots of random graphs, and
+// Rewrite and Refactor never make them larger.
+TEST(AndInverterGraphTest, PassesPreserveFunctions) {
+  std::minstd_rand engine(0);
+  for (int64 trial = 0; trial < 20; ++trial) {
+    AndInverterGraph aig;
+    std::vector<AigLiteral> literals;
+    for (int64 i = 0; i < 8; ++i) {
+      literals.push_back(aig.NewInput());
+    }
+    auto random_literal = [&]() {
+      AigLiteral a = literals[absl::Uniform<int64>(engine, 0, literals.size())];
+      return absl::Bernoulli(engine, 0.5) ? AndInverterGraph::Not(a) : a;
+    };
+    for (int64 i = 0; i < 100; ++i) {
+      switch (absl::Uniform<int>(engine, 0, 3)) {
+        case 0:
+          literals.push_back(aig.And(random_literal(), random_literal()));
+          break;
+        case 1:
+          literals.push_back(aig.Xor(random_literal(), random_literal()));
+          break;
+        default:
+          literals.push_back(aig.Mux(random_literal(), random_literal(),
+                                     random_literal()));
+          break;
+      }
+    }
+    std::vector<AigLiteral> roots(literals.end() - 8, literals.end());
+    std::vector<uint64> expected = SimulateRoots(aig, roots);
+
+    aig.Balance(&roots);
+    EXPECT_EQ(SimulateRoots(aig, roots), expected);
+    int64 count = aig.and_count();
+    aig.Rewrite(&roots);
+    EXPECT_EQ(SimulateRoots(aig, roots), expected);
+    EXPECT_LE(aig.and_count(), count);
+    count = aig.and_count();
+    aig.Refactor(&roots);
+    EXPECT_EQ(SimulateRoots(aig, roots), expected);
+    EXPECT_LE(aig.and_count(), count);
+    aig.Balance(&roots);
+    EXPECT_EQ(SimulateRoots(aig, roots), expected);
+    EXPECT_EQ(aig.inputs().size(), 8);
+  }
+}
+
+}  // namespace
+}  // namespace xls
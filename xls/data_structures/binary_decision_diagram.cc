@@ -14,6 +14,8 @@
 
 #include "xls/data_structures/binary_decision_diagram.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
 
 #include "absl/status/status.h"
@@ -25,49 +27,139 @@
 #include "xls/common/logging/vlog_is_on.h"
 
 namespace xls {
+namespace {
 
-BinaryDecisionDiagram::BinaryDecisionDiagram() {
-  // Leaf node 0.
-  nodes_.push_back(BddNode(BddVariable(-1), BddNodeIndex(-1), BddNodeIndex(-1),
+// The variable of the leaf node and of freed nodes.
+constexpr BddVariable kNoVariable(-1);
+
+// The initial number of slots in the unique table and in the if-then-else
+// cache, and the maximum number of if-then-else cache entries.
+constexpr int64 kInitialUniqueTableSize = 1 << 10;
+constexpr int64 kInitialIteCacheSize = 1 << 12;
+constexpr int64 kMaxIteCacheSize = 1 << 20;
+
+bool IsLeaf(BddNodeIndex expr) { return expr.value() < 2; }
+
+uint64 Mix(uint64 a, uint64 b, uint64 c) {
+  uint64 h = a * 0x9e3779b97f4a7c15ULL;
+  h ^= b * 0xc2b2ae3d27d4eb4fULL;
+  h ^= c * 0x165667b19e3779f9ULL;
+  return h ^ (h >> 31);
+}
+
+int32 SaturatingAdd(int64 a, int64 b) {
+  return std::min(a + b, static_cast<int64>(std::numeric_limits<int32>::max()));
+}
+
+// Sifting stops moving a variable in one direction when the BDD grows past
+// this factor of its smallest size, and stops when either of the limits on the
+// number of variables sifted and the number of level swaps is reached.
+constexpr double kMaxSiftGrowth = 1.2;
+constexpr int64 kMaxSiftVariables = 1000;
+constexpr int64 kMaxSiftSwaps = 2000000;
+
+}  // namespace
+
+BinaryDecisionDiagram::BinaryDecisionDiagram()
+    : unique_table_(kInitialUniqueTableSize, 0),
+      ite_cache_(kInitialIteCacheSize) {
+  // The leaf node. The uncomplemented edge to it is zero and the complemented
+  // edge is one.
+  nodes_.push_back(BddNode(kNoVariable, BddNodeIndex(-1), BddNodeIndex(-1),
                            /*m=*/0));
-  // Leaf node 1.
-  nodes_.push_back(BddNode(BddVariable(-1), BddNodeIndex(-1), BddNodeIndex(-1),
-                           /*m=*/1));
+  complement_minterm_counts_.push_back(1);
+}
+
+void BinaryDecisionDiagram::InsertIntoUniqueTable(int32 node) {
+  const BddNode& n = nodes_[node];
+  uint64 mask = unique_table_.size() - 1;
+  for (uint64 slot = Mix(n.variable.value(), n.high.value(), n.low.value()) &
+                     mask;
+       ; slot = (slot + 1) & mask) {
+    if (unique_table_[slot] == 0) {
+      unique_table_[slot] = node;
+      return;
+    }
+  }
+}
+
+void BinaryDecisionDiagram::RebuildUniqueTable(int64 slot_count) {
+  unique_table_.assign(slot_count, 0);
+  for (int32 node = 1; node < nodes_.size(); ++node) {
+    if (nodes_[node].variable != kNoVariable) {
+      InsertIntoUniqueTable(node);
+    }
+  }
 }
 
 BddNodeIndex BinaryDecisionDiagram::GetOrCreateNode(BddVariable var,
                                                     BddNodeIndex high,
                                                     BddNodeIndex low) {
-  NodeKey key = std::make_tuple(var, high, low);
-  auto it = node_map_.find(key);
-  if (it != node_map_.end()) {
-    return it->second;
-  }
   if (low == high) {
     return low;
   }
-  // Compute the number of minterms that the new node will have. Use int64s to
-  // avoid overflowing and saturate at INT32_MAX.
-  int32 minterms =
-      std::min(static_cast<int64>(GetNode(low).minterm_count) +
-                   GetNode(high).minterm_count,
-               static_cast<int64>(std::numeric_limits<int32>::max()));
-  nodes_.emplace_back(var, high, low, minterms);
-  BddNodeIndex node_index = BddNodeIndex(nodes_.size() - 1);
-  node_map_[key] = node_index;
-  return node_index;
+  // Only the high edge may be complemented.
+  if (IsComplemented(low)) {
+    return Not(GetOrCreateNode(var, Not(high), Not(low)));
+  }
+
+  uint64 mask = unique_table_.size() - 1;
+  for (uint64 slot = Mix(var.value(), high.value(), low.value()) & mask;
+       unique_table_[slot] != 0; slot = (slot + 1) & mask) {
+    const BddNode& node = nodes_[unique_table_[slot]];
+    if (node.variable == var && node.high == high && node.low == low) {
+      return BddNodeIndex(unique_table_[slot] << 1);
+    }
+  }
+
+  // Keep the load factor of the table at most one half.
+  if (2 * (size() + 1) > unique_table_.size()) {
+    RebuildUniqueTable(2 * unique_table_.size());
+  }
+  // Grow the if-then-else cache with the BDD. The old entries are kept where
+  // they do not collide.
+  if (size() > ite_cache_.size() && ite_cache_.size() < kMaxIteCacheSize) {
+    std::vector<IteCacheEntry> old_cache(2 * ite_cache_.size());
+    std::swap(old_cache, ite_cache_);
+    for (const IteCacheEntry& entry : old_cache) {
+      ite_cache_[Mix(entry.cond.value(), entry.if_true.value(),
+                     entry.if_false.value()) &
+                 (ite_cache_.size() - 1)] = entry;
+    }
+  }
+
+  // Compute the number of minterms that the new node and its complement will
+  // have, saturating at INT32_MAX.
+  int32 minterms = SaturatingAdd(minterm_count(high), minterm_count(low));
+  int32 complement_minterms =
+      SaturatingAdd(minterm_count(Not(high)), minterm_count(Not(low)));
+  int32 node;
+  if (free_nodes_.empty()) {
+    XLS_CHECK_LT(nodes_.size(), std::numeric_limits<int32>::max() >> 1)
+        << "Too many BDD nodes";
+    node = nodes_.size();
+    nodes_.emplace_back(var, high, low, minterms);
+    complement_minterm_counts_.push_back(complement_minterms);
+  } else {
+    node = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[node] = BddNode(var, high, low, minterms);
+    complement_minterm_counts_[node] = complement_minterms;
+  }
+  InsertIntoUniqueTable(node);
+  return BddNodeIndex(node << 1);
 }
 
 BddNodeIndex BinaryDecisionDiagram::Restrict(BddNodeIndex expr, BddVariable var,
-                                             bool value) {
-  if (expr == zero() || expr == one()) {
+                                             bool value) const {
+  if (IsLeaf(expr)) {
     return expr;
   }
 
   const BddNode& node = GetNode(expr);
-  XLS_CHECK_LE(var, node.variable);
+  XLS_CHECK_LE(var_to_level_[var.value()], GetLevel(expr));
   if (node.variable == var) {
-    return value ? node.high : node.low;
+    return value ? High(expr) : Low(expr);
   }
   return expr;
 }
@@ -81,32 +173,56 @@ BddNodeIndex BinaryDecisionDiagram::IfThenElse(BddNodeIndex cond,
   if (cond == zero()) {
     return if_false;
   }
-  if (if_true == one() && if_false == zero()) {
-    return cond;
+  // Replace the branches which equal the condition or its inverse by
+  // constants.
+  if (if_true == cond) {
+    if_true = one();
+  } else if (if_true == Not(cond)) {
+    if_true = zero();
+  }
+  if (if_false == cond) {
+    if_false = zero();
+  } else if (if_false == Not(cond)) {
+    if_false = one();
   }
   if (if_true == if_false) {
     return if_true;
   }
-  auto key = std::make_tuple(cond, if_true, if_false);
-  auto it = ite_map_.find(key);
-  if (it != ite_map_.end()) {
-    return it->second;
+  if (if_true == one() && if_false == zero()) {
+    return cond;
+  }
+  if (if_true == zero() && if_false == one()) {
+    return Not(cond);
+  }
+
+  // Normalize the expression so that equivalent expressions share cache
+  // entries: the condition and the if-true branch are not complemented.
+  if (IsComplemented(cond)) {
+    cond = Not(cond);
+    std::swap(if_true, if_false);
+  }
+  bool complement_result = IsComplemented(if_true);
+  if (complement_result) {
+    if_true = Not(if_true);
+    if_false = Not(if_false);
+  }
+
+  IteCacheEntry& entry =
+      ite_cache_[Mix(cond.value(), if_true.value(), if_false.value()) &
+                 (ite_cache_.size() - 1)];
+  if (entry.cond == cond && entry.if_true == if_true &&
+      entry.if_false == if_false) {
+    return complement_result ? Not(entry.result) : entry.result;
   }
 
   // The expression is non-trivial and has not been computed before. Recursively
   // decompose the expression by peeling away the first variable and performing
   // a Shannon decomposition.
 
-  // First, find the lowest-index variable amongst all expressions. In all paths
-  // through the BDD the variable indices are strictly increasing.
-  BddVariable min_var = GetNode(cond).variable;
-  // Only non-leaf nodes (not zero or one) have associated variables.
-  if (if_true != zero() && if_true != one()) {
-    min_var = std::min(min_var, GetNode(if_true).variable);
-  }
-  if (if_false != zero() && if_false != one()) {
-    min_var = std::min(min_var, GetNode(if_false).variable);
-  }
+  // First, find the lowest-level variable amongst all expressions. In all
+  // paths through the BDD the variable levels are strictly increasing.
+  BddVariable min_var = level_to_var_[std::min(
+      {GetLevel(cond), GetLevel(if_true), GetLevel(if_false)})];
 
   // Perform a Shannon expansion about the variable where Shannon expansion is
   // the identity:
@@ -119,32 +235,360 @@ BddNodeIndex BinaryDecisionDiagram::IfThenElse(BddNodeIndex cond,
   BddNodeIndex false_cofactor = IfThenElse(Restrict(cond, min_var, false),
                                            Restrict(if_true, min_var, false),
                                            Restrict(if_false, min_var, false));
-
-  if (true_cofactor == false_cofactor) {
-    ite_map_[key] = true_cofactor;
-    return true_cofactor;
-  }
   BddNodeIndex expr = GetOrCreateNode(min_var, true_cofactor, false_cofactor);
-  ite_map_[key] = expr;
-  return expr;
+
+  // The recursive calls may have overwritten or moved the cache entry.
+  ite_cache_[Mix(cond.value(), if_true.value(), if_false.value()) &
+             (ite_cache_.size() - 1)] = {cond, if_true, if_false, expr};
+  return complement_result ? Not(expr) : expr;
 }
 
 BddNodeIndex BinaryDecisionDiagram::NewVariable() {
   BddVariable var = next_var_;
   ++next_var_;
-  return GetOrCreateNode(var, one(), zero());
+  var_to_level_.push_back(level_to_var_.size());
+  level_to_var_.push_back(var);
+  BddNodeIndex base_node = GetOrCreateNode(var, one(), zero());
+  variable_base_nodes_.push_back(base_node);
+  return base_node;
+}
+
+int32 BinaryDecisionDiagram::GetLevel(BddNodeIndex expr) const {
+  if (IsLeaf(expr)) {
+    return std::numeric_limits<int32>::max();
+  }
+  return var_to_level_[GetNode(expr).variable.value()];
 }
 
-BddNodeIndex BinaryDecisionDiagram::Not(BddNodeIndex expr) {
-  return IfThenElse(expr, zero(), one());
+BddNodeIndex BinaryDecisionDiagram::And(BddNodeIndex a, BddNodeIndex b) {
+  // AND is commutative, so order the operands to share cache entries.
+  if (a > b) {
+    std::swap(a, b);
+  }
+  return IfThenElse(a, b, zero());
 }
 
 BddNodeIndex BinaryDecisionDiagram::Or(BddNodeIndex a, BddNodeIndex b) {
-  return IfThenElse(a, one(), b);
+  return Not(And(Not(a), Not(b)));
 }
 
-BddNodeIndex BinaryDecisionDiagram::And(BddNodeIndex a, BddNodeIndex b) {
-  return IfThenElse(a, b, zero());
+int64 BinaryDecisionDiagram::GarbageCollect(
+    absl::Span<const BddNodeIndex> roots) {
+  // Mark the nodes reachable from the roots and the variables.
+  std::vector<bool> live(nodes_.size(), false);
+  live[0] = true;
+  std::vector<int32> stack;
+  auto mark = [&](BddNodeIndex expr) {
+    int32 node = expr.value() >> 1;
+    if (!live[node]) {
+      live[node] = true;
+      stack.push_back(node);
+    }
+  };
+  for (BddNodeIndex root : roots) {
+    mark(root);
+  }
+  for (BddNodeIndex base_node : variable_base_nodes_) {
+    mark(base_node);
+  }
+  while (!stack.empty()) {
+    const BddNode& node = nodes_[stack.back()];
+    stack.pop_back();
+    mark(node.high);
+    mark(node.low);
+  }
+
+  // Sweep the others.
+  int64 freed_count = 0;
+  for (int32 node = 1; node < nodes_.size(); ++node) {
+    if (!live[node] && nodes_[node].variable != kNoVariable) {
+      nodes_[node].variable = kNoVariable;
+      free_nodes_.push_back(node);
+      ++freed_count;
+    }
+  }
+  // Reuse the lowest indices first.
+  std::sort(free_nodes_.begin(), free_nodes_.end(), std::greater<int32>());
+
+  int64 slot_count = kInitialUniqueTableSize;
+  while (slot_count < 2 * size()) {
+    slot_count *= 2;
+  }
+  RebuildUniqueTable(slot_count);
+  std::fill(ite_cache_.begin(), ite_cache_.end(), IteCacheEntry());
+  XLS_VLOG(3) << absl::StreamFormat("BDD garbage collection freed %d nodes",
+                                    freed_count);
+  return freed_count;
+}
+
+BinaryDecisionDiagram::ReorderState BinaryDecisionDiagram::BeginReordering(
+    absl::Span<const BddNodeIndex> roots) {
+  GarbageCollect(roots);
+  ReorderState state;
+  state.ref_counts.resize(nodes_.size(), 0);
+  state.variable_nodes.resize(variable_count());
+  state.subtables.resize(variable_count());
+  for (int32 node = 1; node < nodes_.size(); ++node) {
+    const BddNode& n = nodes_[node];
+    if (n.variable == kNoVariable) {
+      continue;
+    }
+    Ref(n.high, &state);
+    Ref(n.low, &state);
+    state.variable_nodes[n.variable.value()].push_back(node);
+    state.subtables[n.variable.value()][{n.high.value(), n.low.value()}] = node;
+  }
+  for (BddNodeIndex root : roots) {
+    Ref(root, &state);
+  }
+  for (BddNodeIndex base_node : variable_base_nodes_) {
+    Ref(base_node, &state);
+  }
+  return state;
+}
+
+void BinaryDecisionDiagram::EndReordering(ReorderState* state) {
+  RecomputeMintermCounts();
+  std::sort(free_nodes_.begin(), free_nodes_.end(), std::greater<int32>());
+  int64 slot_count = kInitialUniqueTableSize;
+  while (slot_count < 2 * size()) {
+    slot_count *= 2;
+  }
+  RebuildUniqueTable(slot_count);
+  std::fill(ite_cache_.begin(), ite_cache_.end(), IteCacheEntry());
+  if (reorder_threshold_ > 0) {
+    reorder_threshold_ = std::max(reorder_threshold_, 2 * size());
+  }
+  XLS_VLOG(3) << absl::StreamFormat(
+      "BDD reordering did %d swaps, size is now %d nodes", state->swap_count,
+      size());
+}
+
+void BinaryDecisionDiagram::Ref(BddNodeIndex expr, ReorderState* state) {
+  int32 node = expr.value() >> 1;
+  if (node != 0) {
+    ++state->ref_counts[node];
+  }
+}
+
+void BinaryDecisionDiagram::Deref(BddNodeIndex expr, ReorderState* state) {
+  std::vector<int32> stack = {expr.value() >> 1};
+  while (!stack.empty()) {
+    int32 node = stack.back();
+    stack.pop_back();
+    if (node == 0 || --state->ref_counts[node] > 0) {
+      continue;
+    }
+    // Free the node. Freed nodes are not reused while reordering, so the
+    // stale entries in ReorderState::variable_nodes can be recognized.
+    BddNode& n = nodes_[node];
+    state->subtables[n.variable.value()].erase(
+        {n.high.value(), n.low.value()});
+    n.variable = kNoVariable;
+    free_nodes_.push_back(node);
+    stack.push_back(n.high.value() >> 1);
+    stack.push_back(n.low.value() >> 1);
+  }
+}
+
+BddNodeIndex BinaryDecisionDiagram::GetOrCreateReorderNode(
+    BddVariable var, BddNodeIndex high, BddNodeIndex low, ReorderState* state) {
+  if (low == high) {
+    return low;
+  }
+  if (IsComplemented(low)) {
+    return Not(GetOrCreateReorderNode(var, Not(high), Not(low), state));
+  }
+  auto [it, inserted] =
+      state->subtables[var.value()].insert({{high.value(), low.value()}, 0});
+  if (!inserted) {
+    return BddNodeIndex(it->second << 1);
+  }
+  XLS_CHECK_LT(nodes_.size(), std::numeric_limits<int32>::max() >> 1)
+      << "Too many BDD nodes";
+  int32 node = nodes_.size();
+  it->second = node;
+  // The minterm counts are computed when reordering finishes.
+  nodes_.emplace_back(var, high, low, /*m=*/0);
+  complement_minterm_counts_.push_back(0);
+  state->ref_counts.push_back(0);
+  state->variable_nodes[var.value()].push_back(node);
+  Ref(high, state);
+  Ref(low, state);
+  return BddNodeIndex(node << 1);
+}
+
+void BinaryDecisionDiagram::SwapLevels(int64 level, ReorderState* state) {
+  BddVariable x = level_to_var_[level];
+  BddVariable y = level_to_var_[level + 1];
+  std::vector<int32> x_nodes;
+  std::swap(x_nodes, state->variable_nodes[x.value()]);
+  for (int32 node : x_nodes) {
+    if (nodes_[node].variable != x) {
+      continue;
+    }
+    BddNodeIndex high = nodes_[node].high;
+    BddNodeIndex low = nodes_[node].low;
+    bool high_has_y = !IsLeaf(high) && GetNode(high).variable == y;
+    bool low_has_y = !IsLeaf(low) && GetNode(low).variable == y;
+    if (!high_has_y && !low_has_y) {
+      // The node does not depend on 'y' and just moves down a level.
+      state->variable_nodes[x.value()].push_back(node);
+      continue;
+    }
+
+    // Rewrite the node as a function of 'y' whose children are functions of
+    // 'x':
+    //
+    //   x ? (y ? f11 : f10) : (y ? f01 : f00)
+    //     = y ? (x ? f11 : f01) : (x ? f10 : f00)
+    //
+    // The new low child is not complemented because the low edges of the node
+    // and of its low child are not.
+    BddNodeIndex f11 = high_has_y ? High(high) : high;
+    BddNodeIndex f10 = high_has_y ? Low(high) : high;
+    BddNodeIndex f01 = low_has_y ? High(low) : low;
+    BddNodeIndex f00 = low_has_y ? Low(low) : low;
+    BddNodeIndex new_high = GetOrCreateReorderNode(x, f11, f01, state);
+    BddNodeIndex new_low = GetOrCreateReorderNode(x, f10, f00, state);
+    XLS_DCHECK(!IsComplemented(new_low));
+    Ref(new_high, state);
+    Ref(new_low, state);
+    state->subtables[x.value()].erase({high.value(), low.value()});
+    Deref(high, state);
+    Deref(low, state);
+    BddNode& n = nodes_[node];
+    n.variable = y;
+    n.high = new_high;
+    n.low = new_low;
+    state->subtables[y.value()][{new_high.value(), new_low.value()}] = node;
+    state->variable_nodes[y.value()].push_back(node);
+  }
+  std::swap(level_to_var_[level], level_to_var_[level + 1]);
+  var_to_level_[x.value()] = level + 1;
+  var_to_level_[y.value()] = level;
+  ++state->swap_count;
+}
+
+void BinaryDecisionDiagram::SiftVariable(BddVariable var,
+                                         ReorderState* state) {
+  int64 level = var_to_level_[var.value()];
+  int64 best_level = level;
+  int64 best_size = size();
+  int64 last_level = variable_count() - 1;
+  auto moved = [&]() {
+    if (size() < best_size) {
+      best_size = size();
+      best_level = level;
+    }
+    return size() <= kMaxSiftGrowth * best_size &&
+           state->swap_count < kMaxSiftSwaps;
+  };
+  auto move_down = [&]() {
+    while (level < last_level) {
+      SwapLevels(level, state);
+      ++level;
+      if (!moved()) {
+        break;
+      }
+    }
+  };
+  auto move_up = [&]() {
+    while (level > 0) {
+      SwapLevels(level - 1, state);
+      --level;
+      if (!moved()) {
+        break;
+      }
+    }
+  };
+  // Move towards the closer end first.
+  if (level > last_level - level) {
+    move_down();
+    move_up();
+  } else {
+    move_up();
+    move_down();
+  }
+  while (level < best_level) {
+    SwapLevels(level, state);
+    ++level;
+  }
+  while (level > best_level) {
+    SwapLevels(level - 1, state);
+    --level;
+  }
+}
+
+void BinaryDecisionDiagram::Sift(absl::Span<const BddNodeIndex> roots) {
+  ReorderState state = BeginReordering(roots);
+  int64 initial_size = size();
+
+  // Sift the variables with the most nodes first.
+  std::vector<std::pair<int64, BddVariable>> variables;
+  for (int64 i = 0; i < variable_count(); ++i) {
+    variables.push_back(
+        {-static_cast<int64>(state.variable_nodes[i].size()), BddVariable(i)});
+  }
+  std::sort(variables.begin(), variables.end());
+  for (int64 i = 0; i < variables.size() && i < kMaxSiftVariables &&
+                    state.swap_count < kMaxSiftSwaps;
+       ++i) {
+    SiftVariable(variables[i].second, &state);
+  }
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Sifting reduced the BDD from %d to %d nodes", initial_size, size());
+  EndReordering(&state);
+}
+
+void BinaryDecisionDiagram::PermuteWindows(
+    absl::Span<const BddNodeIndex> roots) {
+  ReorderState state = BeginReordering(roots);
+  for (int64 level = 0; level + 2 < variable_count(); ++level) {
+    // Visit all six permutations of the window with swaps of adjacent levels.
+    const int64 kSwaps[] = {level, level + 1, level, level + 1, level};
+    int64 best_size = size();
+    int64 best_step = 0;
+    for (int64 step = 0; step < 5; ++step) {
+      SwapLevels(kSwaps[step], &state);
+      if (size() < best_size) {
+        best_size = size();
+        best_step = step + 1;
+      }
+    }
+    // Undo the swaps done after the best permutation was reached.
+    for (int64 step = 4; step >= best_step; --step) {
+      SwapLevels(kSwaps[step], &state);
+    }
+  }
+  if (variable_count() == 2) {
+    int64 size_before = size();
+    SwapLevels(0, &state);
+    if (size() >= size_before) {
+      SwapLevels(0, &state);
+    }
+  }
+  EndReordering(&state);
+}
+
+void BinaryDecisionDiagram::RecomputeMintermCounts() {
+  // Compute the counts from the bottom level up, so the children of each node
+  // are done before it.
+  std::vector<std::pair<int32, int32>> nodes_by_level;
+  for (int32 node = 1; node < nodes_.size(); ++node) {
+    if (nodes_[node].variable != kNoVariable) {
+      nodes_by_level.push_back(
+          {-var_to_level_[nodes_[node].variable.value()], node});
+    }
+  }
+  std::sort(nodes_by_level.begin(), nodes_by_level.end());
+  for (const auto& [level, node] : nodes_by_level) {
+    BddNode& n = nodes_[node];
+    n.minterm_count =
+        SaturatingAdd(minterm_count(n.high), minterm_count(n.low));
+    complement_minterm_counts_[node] =
+        SaturatingAdd(minterm_count(Not(n.high)), minterm_count(Not(n.low)));
+  }
 }
 
 xabsl::StatusOr<bool> BinaryDecisionDiagram::Evaluate(
@@ -165,15 +609,15 @@ xabsl::StatusOr<bool> BinaryDecisionDiagram::Evaluate(
                   << variable_values.at(node);
     }
   }
-  while (result != zero() && result != one()) {
+  while (!IsLeaf(result)) {
     BddNodeIndex var_node = GetVariableBaseNode(GetNode(result).variable);
-    if (!variable_values.contains(var_node)) {
+    auto it = variable_values.find(var_node);
+    if (it == variable_values.end()) {
       return absl::InvalidArgumentError(
           absl::StrFormat("Missing value for BDD variable %d (node index %d)",
                           GetNode(result).variable.value(), var_node.value()));
     }
-    result = variable_values.at(var_node) ? GetNode(result).high
-                                          : GetNode(result).low;
+    result = it->second ? High(result) : Low(result);
   }
   XLS_VLOG(2) << "  result = " << (result == one() ? true : false);
   return result == one();
@@ -204,11 +648,11 @@ void BinaryDecisionDiagram::ToStringDnfHelper(BddNodeIndex expr,
     return;
   }
 
-  const BddNode& node = GetNode(expr);
-  terms->push_back(absl::StrCat("x", node.variable.value()));
-  ToStringDnfHelper(node.high, minterms_to_emit, terms, str);
-  terms->back() = absl::StrCat("!x", node.variable.value());
-  ToStringDnfHelper(node.low, minterms_to_emit, terms, str);
+  BddVariable variable = GetNode(expr).variable;
+  terms->push_back(absl::StrCat("x", variable.value()));
+  ToStringDnfHelper(High(expr), minterms_to_emit, terms, str);
+  terms->back() = absl::StrCat("!x", variable.value());
+  ToStringDnfHelper(Low(expr), minterms_to_emit, terms, str);
   terms->pop_back();
 }
 
@@ -15,7 +15,11 @@
 #ifndef XLS_DATA_STRUCTURES_BINARY_DECISION_DIAGRAM_H_
 #define XLS_DATA_STRUCTURES_BINARY_DECISION_DIAGRAM_H_
 
+#include <utility>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "xls/common/integral_types.h"
 #include "xls/common/status/statusor.h"
 #include "xls/common/strong_int.h"
@@ -26,19 +30,33 @@ namespace xls {
 // implementation allows an arbitrary number of expressions over a set of
 // variables to be represented in a single BDD.
 //
+// Expressions are referred to by edges to nodes which may be complemented, so
+// an expression and its inverse share all of their nodes and Not is a constant
+// time operation. The unique table is an open-addressed hash table of node
+// indices and the if-then-else operations are memoized in a fixed-size lossy
+// cache. Nodes which are no longer needed can be reclaimed with
+// GarbageCollect.
+//
+// Variables are ordered by their level, which is initially the order in which
+// they were created. The size of a BDD depends heavily on this order, so the
+// variables can be reordered in place by sifting or window permutation.
+//
 // Based on:
 //   K.S. Brace, R.L. Rudell, and R.E. Bryant,
 //   "Efficient Implementation of a BDD package"
 //   https://ieeexplore.ieee.org/document/114826
 
 // For efficiency variables and nodes are referred to by indices into vector
-// data members in the BDD.
+// data members in the BDD. A BddNodeIndex is an edge: the index of the node
+// shifted left by one with the least significant bit set if the edge is
+// complemented.
 DEFINE_STRONG_INT_TYPE(BddVariable, int32);
 DEFINE_STRONG_INT_TYPE(BddNodeIndex, int32);
 
 // A node in the BDD. The node is associated with a single variable and has
 // children corresponding to when the variable is true (high) and when it is
-// false (low).
+// false (low). The low edge is never complemented, which makes the
+// representation canonical.
 struct BddNode {
   BddNode() : variable(0), high(0), low(0), minterm_count(0) {}
   BddNode(BddVariable v, BddNodeIndex h, BddNodeIndex l, int32 m)
@@ -48,9 +66,9 @@ struct BddNode {
   BddNodeIndex high;
   BddNodeIndex low;
 
-  // Number of minterms in the expression. A minterm is a term in a
-  // sum-of-products form of the boolean function, or equivalently a path to the
-  // leaf node '1' from the BDD node. Saturates at INT32_MAX.
+  // Number of minterms in the (uncomplemented) expression. A minterm is a term
+  // in a sum-of-products form of the boolean function, or equivalently a path
+  // to the leaf node '1' from the BDD node. Saturates at INT32_MAX.
   int32 minterm_count;
 };
 
@@ -65,13 +83,16 @@ class BinaryDecisionDiagram {
   BddNodeIndex NewVariable();
 
   // Returns the inverse of the given expression.
-  BddNodeIndex Not(BddNodeIndex expr);
+  BddNodeIndex Not(BddNodeIndex expr) const {
+    return BddNodeIndex(expr.value() ^ 1);
+  }
 
   // Returns the OR/AND of the given expressions.
   BddNodeIndex And(BddNodeIndex a, BddNodeIndex b);
   BddNodeIndex Or(BddNodeIndex a, BddNodeIndex b);
 
-  // Returns the leaf node corresponding to zero or one.
+  // Returns the leaf node corresponding to zero or one. These are the two
+  // edges to the single leaf node.
   BddNodeIndex zero() const { return BddNodeIndex(0); }
   BddNodeIndex one() const { return BddNodeIndex(1); }
 
@@ -83,20 +104,33 @@ class BinaryDecisionDiagram {
       BddNodeIndex expr,
       const absl::flat_hash_map<BddNodeIndex, bool>& variable_values) const;
 
-  // Returns the BDD node with the given index.
+  // Returns the BDD node the given expression refers to, ignoring whether the
+  // edge is complemented.
   const BddNode& GetNode(BddNodeIndex node_index) const {
-    return nodes_.at(node_index.value());
+    return nodes_[node_index.value() >> 1];
   }
 
   // Returns the number of nodes in the graph.
-  int64 size() const { return nodes_.size(); }
+  int64 size() const { return nodes_.size() - free_nodes_.size(); }
 
   // Returns the number of variables in the graph.
   int64 variable_count() const { return next_var_.value(); }
 
+  // Returns the number of bytes allocated by the BDD.
+  int64 memory_usage() const {
+    return nodes_.capacity() * sizeof(BddNode) +
+           complement_minterm_counts_.capacity() * sizeof(int32) +
+           free_nodes_.capacity() * sizeof(int32) +
+           variable_base_nodes_.capacity() * sizeof(BddNodeIndex) +
+           unique_table_.capacity() * sizeof(int32) +
+           ite_cache_.capacity() * sizeof(IteCacheEntry);
+  }
+
   // Returns the number of minterms in the given expression.
   int64 minterm_count(BddNodeIndex expr) const {
-    return GetNode(expr).minterm_count;
+    return IsComplemented(expr)
+               ? complement_minterm_counts_[expr.value() >> 1]
+               : GetNode(expr).minterm_count;
   }
 
   // Returns the given expression in disjunctive normal form (sum of products).
@@ -108,10 +142,86 @@ class BinaryDecisionDiagram {
   // variable. The expression of a base node is exactly equal to the value of
   // the variable.
   bool IsVariableBaseNode(BddNodeIndex expr) const {
-    return GetNode(expr).high == one() && GetNode(expr).low == zero();
+    return !IsComplemented(expr) && expr != zero() &&
+           GetNode(expr).high == one() && GetNode(expr).low == zero();
+  }
+
+  // Frees the nodes which are not reachable from the given expressions or
+  // from the variables. The indices of the remaining nodes are unchanged and
+  // freed nodes are reused by later operations, so the caller must not use
+  // any expression other than these afterwards. Returns the number of nodes
+  // freed.
+  int64 GarbageCollect(absl::Span<const BddNodeIndex> roots);
+
+  // Returns the variables ordered by level, from the root of the BDD down.
+  const std::vector<BddVariable>& variable_order() const {
+    return level_to_var_;
+  }
+
+  // Reorders the variables to reduce the number of nodes using Rudell's
+  // sifting: each variable in turn is moved through all levels and left where
+  // the BDD was smallest. Like GarbageCollect, the nodes which are not
+  // reachable from the given expressions are freed. The given expressions are
+  // unchanged, but their minterm counts may change as these depend on the
+  // order.
+  void Sift(absl::Span<const BddNodeIndex> roots);
+
+  // Reorders the variables by trying all permutations of each window of three
+  // adjacent levels. This is cheaper than sifting but only finds local
+  // improvements. The roots are handled as in Sift.
+  void PermuteWindows(absl::Span<const BddNodeIndex> roots);
+
+  // Sets the number of nodes at which ReorderingDue returns true. After each
+  // reordering the threshold is raised to twice the size of the BDD. Zero
+  // disables reordering, which is the default.
+  void set_reorder_threshold(int64 node_count) {
+    reorder_threshold_ = node_count;
+  }
+
+  // Returns whether the BDD has grown past the reorder threshold. The BDD does
+  // not know which expressions are in use, so it is up to the caller to then
+  // call Sift with them.
+  bool ReorderingDue() const {
+    return reorder_threshold_ > 0 && size() >= reorder_threshold_;
   }
 
  private:
+  // The state kept while reordering variables.
+  struct ReorderState {
+    // The number of references to each node from other nodes and roots.
+    std::vector<int32> ref_counts;
+
+    // The nodes of each variable. Freed nodes are skipped lazily.
+    std::vector<std::vector<int32>> variable_nodes;
+
+    // A unique table for the nodes of each variable, keyed by the values of
+    // the high and low edges.
+    std::vector<absl::flat_hash_map<std::pair<int32, int32>, int32>>
+        subtables;
+
+    // The number of level swaps done.
+    int64 swap_count = 0;
+  };
+
+  // An entry in the if-then-else cache.
+  struct IteCacheEntry {
+    BddNodeIndex cond;
+    BddNodeIndex if_true;
+    BddNodeIndex if_false;
+    BddNodeIndex result;
+  };
+
+  static bool IsComplemented(BddNodeIndex expr) { return expr.value() & 1; }
+
+  // Returns the children of the given expression with the complement of the
+  // edge applied to them.
+  BddNodeIndex High(BddNodeIndex expr) const {
+    return BddNodeIndex(GetNode(expr).high.value() ^ (expr.value() & 1));
+  }
+  BddNodeIndex Low(BddNodeIndex expr) const {
+    return BddNodeIndex(GetNode(expr).low.value() ^ (expr.value() & 1));
+  }
+
   // Helper for constructing a DNF string respresentation.
   void ToStringDnfHelper(BddNodeIndex expr, int64* minterms_to_emit,
                          std::vector<std::string>* terms,
@@ -122,9 +232,16 @@ class BinaryDecisionDiagram {
   BddNodeIndex GetOrCreateNode(BddVariable var, BddNodeIndex high,
                                BddNodeIndex low);
 
-  // Returns the node equal to given expression with the given variable
-  // set to the given value.
-  BddNodeIndex Restrict(BddNodeIndex expr, BddVariable var, bool value);
+  // Inserts the node with the given index into the unique table, which must
+  // have room for it.
+  void InsertIntoUniqueTable(int32 node);
+
+  // Rebuilds the unique table with the given number of slots.
+  void RebuildUniqueTable(int64 slot_count);
+
+  // Returns the cofactor of the given expression with the given variable set
+  // to the given value. 'var' must not be below the expression's variable.
+  BddNodeIndex Restrict(BddNodeIndex expr, BddVariable var, bool value) const;
 
   // Returns the node corresponding to the given if-then-else expression.
   BddNodeIndex IfThenElse(BddNodeIndex cond, BddNodeIndex if_true,
@@ -132,27 +249,72 @@ class BinaryDecisionDiagram {
 
   // Returns the node corresponding to the value of the given variable.
   BddNodeIndex GetVariableBaseNode(BddVariable variable) const {
-    return node_map_.at({variable, one(), zero()});
+    return variable_base_nodes_[variable.value()];
   }
 
+  // Returns the level of the variable of the given expression. The leaf is
+  // below all variables.
+  int32 GetLevel(BddNodeIndex expr) const;
+
+  // Starts and finishes reordering the variables. Between the two, nodes must
+  // only be created with GetOrCreateReorderNode.
+  ReorderState BeginReordering(absl::Span<const BddNodeIndex> roots);
+  void EndReordering(ReorderState* state);
+
+  // Swaps the variables at the given level and the level below in place.
+  // Every expression keeps its node index.
+  void SwapLevels(int64 level, ReorderState* state);
+
+  // Moves the given variable through all levels and back to the level where
+  // the BDD was smallest.
+  void SiftVariable(BddVariable var, ReorderState* state);
+
+  // Equivalent of GetOrCreateNode while reordering.
+  BddNodeIndex GetOrCreateReorderNode(BddVariable var, BddNodeIndex high,
+                                      BddNodeIndex low, ReorderState* state);
+
+  // Adds or removes a reference to the node of the given expression while
+  // reordering. Nodes without references are freed.
+  void Ref(BddNodeIndex expr, ReorderState* state);
+  void Deref(BddNodeIndex expr, ReorderState* state);
+
+  // Recomputes the minterm counts of all nodes, which depend on the order of
+  // the variables.
+  void RecomputeMintermCounts();
+
   // The numeric id to use for the next created variable. Increments with each
   // call to NewVariable which
   BddVariable next_var_ = BddVariable(0);
 
-  // The vector of all the nodes in the BDD.
+  // The vector of all the nodes in the BDD, including freed nodes.
   std::vector<BddNode> nodes_;
 
-  // A map from BDD node content (variable id, high child, low child) to the
-  // index of the respective node. This map is used to ensure that no duplicate
-  // nodes are created.
-  using NodeKey = std::tuple<BddVariable, BddNodeIndex, BddNodeIndex>;
-  absl::flat_hash_map<NodeKey, BddNodeIndex> node_map_;
-
-  // A map from if-then-else expression to the node corresponding to that
-  // expression. The key elements are (condition, if-true, if-false). This map
-  // enables fast lookup for expressions.
-  using IteKey = std::tuple<BddNodeIndex, BddNodeIndex, BddNodeIndex>;
-  absl::flat_hash_map<IteKey, BddNodeIndex> ite_map_;
+  // The number of minterms in the complement of each node's expression.
+  std::vector<int32> complement_minterm_counts_;
+
+  // The indices of the freed nodes in 'nodes_' which can be reused.
+  std::vector<int32> free_nodes_;
+
+  // The base node of each variable.
+  std::vector<BddNodeIndex> variable_base_nodes_;
+
+  // The level of each variable and the variable at each level.
+  std::vector<int32> var_to_level_;
+  std::vector<BddVariable> level_to_var_;
+
+  // The size at which ReorderingDue returns true, or zero.
+  int64 reorder_threshold_ = 0;
+
+  // An open-addressed hash table from BDD node content (variable id, high
+  // child, low child) to the index of the respective node, using linear
+  // probing. Empty slots hold zero, the index of the leaf node. This table is
+  // used to ensure that no duplicate nodes are created.
+  std::vector<int32> unique_table_;
+
+  // A direct-mapped cache from if-then-else expression to the node
+  // corresponding to that expression. Colliding entries replace each other, so
+  // the cache enables fast lookup for expressions with bounded memory.
+  std::vector<IteCacheEntry> ite_cache_;
 };
 
 }  // namespace xls
@@ -14,9 +14,12 @@
 
 #include "xls/data_structures/binary_decision_diagram.h"
 
+#include <random>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/random/random.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/matchers.h"
 #include "xls/ir/bits.h"
@@ -85,6 +88,149 @@ TEST(BinaryDecisionDiagramTest, BddSize) {
   }
 }
 
+TEST(BinaryDecisionDiagramTest, ComplementEdges) {
+  BinaryDecisionDiagram bdd;
+  BddNodeIndex var1 = bdd.NewVariable();
+  BddNodeIndex var2 = bdd.NewVariable();
+  BddNodeIndex var1_and_var2 = bdd.And(var1, var2);
+
+  // An expression and its inverse share their nodes.
+  int64 before_size = bdd.size();
+  BddNodeIndex nand = bdd.Not(var1_and_var2);
+  EXPECT_EQ(bdd.size(), before_size);
+  EXPECT_EQ(bdd.Not(nand), var1_and_var2);
+  EXPECT_EQ(bdd.Or(bdd.Not(var1), bdd.Not(var2)), nand);
+  EXPECT_EQ(bdd.size(), before_size);
+
+  EXPECT_EQ(bdd.minterm_count(nand), 2);
+  EXPECT_EQ(bdd.ToStringDnf(nand), "x0.!x1 + !x0");
+  EXPECT_FALSE(bdd.IsVariableBaseNode(bdd.Not(var1)));
+  EXPECT_THAT(bdd.Evaluate(nand, {{var1, true}, {var2, true}}),
+              IsOkAndHolds(false));
+  EXPECT_THAT(bdd.Evaluate(nand, {{var1, true}, {var2, false}}),
+              IsOkAndHolds(true));
+}
+
+TEST(BinaryDecisionDiagramTest, GarbageCollect) {
+  BinaryDecisionDiagram bdd;
+  std::vector<BddNodeIndex> variables;
+  for (int64 i = 0; i < 8; ++i) {
+    variables.push_back(bdd.NewVariable());
+  }
+  auto parity = [&]() {
+    BddNodeIndex result = bdd.zero();
+    for (BddNodeIndex variable : variables) {
+      result = bdd.Or(bdd.And(result, bdd.Not(variable)),
+                      bdd.And(bdd.Not(result), variable));
+    }
+    return result;
+  };
+  BddNodeIndex kept = bdd.And(variables[0], variables[7]);
+  parity();
+  int64 size_with_parity = bdd.size();
+
+  // Only the kept expression and the variables survive.
+  EXPECT_GT(bdd.GarbageCollect({kept}), 0);
+  EXPECT_LT(bdd.size(), size_with_parity);
+  EXPECT_EQ(bdd.And(variables[7], variables[0]), kept);
+  EXPECT_THAT(bdd.Evaluate(kept, {{variables[0], true}, {variables[7], true}}),
+              IsOkAndHolds(true));
+
+  // The freed nodes are reused and the rebuilt expression is correct.
+  BddNodeIndex result = parity();
+  EXPECT_EQ(bdd.size(), size_with_parity);
+  EXPECT_EQ(bdd.minterm_count(result), 128);
+  absl::flat_hash_map<BddNodeIndex, bool> values;
+  for (int64 i = 0; i < 8; ++i) {
+    values[variables[i]] = (0b10110101 >> i) & 1;
+  }
+  EXPECT_THAT(bdd.Evaluate(result, values), IsOkAndHolds(true));
+  EXPECT_EQ(bdd.GarbageCollect({}), bdd.size() - 9);
+}
+
+// Returns the expression x == y for vectors of variables x and y.
+BddNodeIndex VectorsEqual(BinaryDecisionDiagram* bdd,
+                          absl::Span<const BddNodeIndex> x,
+                          absl::Span<const BddNodeIndex> y) {
+  BddNodeIndex result = bdd->one();
+  for (int64 i = 0; i < x.size(); ++i) {
+    BddNodeIndex bit_equal = bdd->Or(bdd->And(x[i], y[i]),
+                                     bdd->And(bdd->Not(x[i]), bdd->Not(y[i])));
+    result = bdd->And(result, bit_equal);
+  }
+  return result;
+}
+
+TEST(BinaryDecisionDiagramTest, Reordering) {
+  constexpr int64 kWidth = 8;
+  for (bool sift : {false, true}) {
+    BinaryDecisionDiagram bdd;
+    // The worst order for comparing vectors: all of 'x' before all of 'y'.
+    std::vector<BddNodeIndex> x;
+    std::vector<BddNodeIndex> y;
+    for (int64 i = 0; i < kWidth; ++i) {
+      x.push_back(bdd.NewVariable());
+    }
+    for (int64 i = 0; i < kWidth; ++i) {
+      y.push_back(bdd.NewVariable());
+    }
+    BddNodeIndex equal = VectorsEqual(&bdd, x, y);
+    BddNodeIndex x_zero = bdd.Not(bdd.Or(x[0], x[1]));
+    bdd.GarbageCollect({equal, x_zero});
+    int64 size_before = bdd.size();
+
+    if (sift) {
+      bdd.Sift({equal, x_zero});
+    } else {
+      bdd.PermuteWindows({equal, x_zero});
+    }
+    EXPECT_LT(bdd.size(), size_before);
+    if (sift) {
+      // Interleaving the variables makes the BDD linear in the width: three
+      // nodes per bit of the comparison, the variables, the leaf and 'x_zero'.
+      EXPECT_LE(bdd.size(), 3 * kWidth + 2 * kWidth + 1 + 2);
+    }
+
+    // The expressions are unchanged.
+    std::minstd_rand engine;
+    for (int64 sample = 0; sample < 64; ++sample) {
+      absl::flat_hash_map<BddNodeIndex, bool> values;
+      uint64 x_value = absl::Uniform<uint64>(engine, 0, 1 << kWidth);
+      uint64 y_value =
+          sample % 2 == 0 ? x_value : absl::Uniform<uint64>(engine, 0, 256);
+      for (int64 i = 0; i < kWidth; ++i) {
+        values[x[i]] = (x_value >> i) & 1;
+        values[y[i]] = (y_value >> i) & 1;
+      }
+      EXPECT_THAT(bdd.Evaluate(equal, values), IsOkAndHolds(x_value == y_value));
+      EXPECT_THAT(bdd.Evaluate(x_zero, values),
+                  IsOkAndHolds((x_value & 3) == 0));
+    }
+    EXPECT_EQ(bdd.minterm_count(x_zero), 1);
+    EXPECT_EQ(VectorsEqual(&bdd, x, y), equal);
+    EXPECT_EQ(bdd.Not(bdd.Or(x[1], x[0])), x_zero);
+  }
+}
+
+TEST(BinaryDecisionDiagramTest, ReorderingDue) {
+  BinaryDecisionDiagram bdd;
+  EXPECT_FALSE(bdd.ReorderingDue());
+  bdd.set_reorder_threshold(16);
+  std::vector<BddNodeIndex> x;
+  for (int64 i = 0; i < 8; ++i) {
+    x.push_back(bdd.NewVariable());
+  }
+  EXPECT_FALSE(bdd.ReorderingDue());
+  BddNodeIndex all = bdd.one();
+  for (int64 i = 0; i < 8; ++i) {
+    all = bdd.And(all, x[i]);
+  }
+  EXPECT_TRUE(bdd.ReorderingDue());
+  bdd.Sift({all});
+  EXPECT_FALSE(bdd.ReorderingDue());
+  EXPECT_EQ(bdd.variable_order().size(), 8);
+}
+
 TEST(BinaryDecisionDiagramTest, ToString) {
   BinaryDecisionDiagram bdd;
   BddNodeIndex x0 = bdd.NewVariable();
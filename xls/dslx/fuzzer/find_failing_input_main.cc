@@ -71,10 +71,15 @@ absl::Status RealMain(absl::string_view ir_path,
   }
 
   XLS_ASSIGN_OR_RETURN(std::unique_ptr<LlvmIrJit> jit, LlvmIrJit::Create(f));
-  for (const std::vector<Value>& args : inputs) {
+  std::vector<Value> jit_results;
+  if (absl::GetFlag(FLAGS_test_only_inject_jit_result).empty()) {
+    XLS_ASSIGN_OR_RETURN(jit_results, jit->RunBatched(inputs));
+  }
+  for (int64 i = 0; i < inputs.size(); ++i) {
+    const std::vector<Value>& args = inputs[i];
     Value jit_result;
     if (absl::GetFlag(FLAGS_test_only_inject_jit_result).empty()) {
-      XLS_ASSIGN_OR_RETURN(jit_result, jit->Run(args));
+      jit_result = jit_results[i];
     } else {
       XLS_ASSIGN_OR_RETURN(jit_result, Parser::ParseTypedValue(absl::GetFlag(
                                            FLAGS_test_only_inject_jit_result)));
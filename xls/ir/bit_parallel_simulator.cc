@@ -0,0 +1,562 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/bit_parallel_simulator.h"
+
+#include <algorithm>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/lsb_or_msb.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/value_helpers.h"
+
+namespace xls {
+namespace {
+
+using Word = BitParallelSimulator::Word;
+using Words = std::vector<Word>;
+
+constexpr Word kAllOnes = ~Word{0};
+
+// Returns a word with every bit equal to 'value'.
+Word Broadcast(bool value) { return value ? kAllOnes : 0; }
+
+// Returns the words of a value which is the same in every pattern.
+Words Broadcast(const Bits& bits) {
+  Words result(bits.bit_count());
+  for (int64 i = 0; i < bits.bit_count(); ++i) {
+    result[i] = Broadcast(bits.Get(i));
+  }
+  return result;
+}
+
+// Returns 'a' in the patterns where 'selector' is set and 'b' in the others.
+Word Mux(Word selector, Word a, Word b) {
+  return (selector & a) | (~selector & b);
+}
+
+Bits GetPattern(absl::Span<const Word> words, int64 pattern) {
+  absl::InlinedVector<bool, 64> bits(words.size());
+  for (int64 i = 0; i < words.size(); ++i) {
+    bits[i] = (words[i] >> pattern) & 1;
+  }
+  return Bits(bits);
+}
+
+void SetPattern(const Bits& bits, int64 pattern, Words* words) {
+  Word mask = Word{1} << pattern;
+  for (int64 i = 0; i < bits.bit_count(); ++i) {
+    (*words)[i] = bits.Get(i) ? (*words)[i] | mask : (*words)[i] & ~mask;
+  }
+}
+
+// Sets the bits of the patterns at and above 'batch_size' to the value of the
+// last pattern of the batch.
+void PadPatterns(int64 batch_size, Words* words) {
+  if (batch_size == BitParallelSimulator::kBatchSize) {
+    return;
+  }
+  Word padding = kAllOnes << batch_size;
+  for (Word& word : *words) {
+    bool last = (word >> (batch_size - 1)) & 1;
+    word = last ? word | padding : word & ~padding;
+  }
+}
+
+Words Extend(absl::Span<const Word> input, int64 width, bool is_signed) {
+  Words result(width, 0);
+  for (int64 i = 0; i < width; ++i) {
+    if (i < input.size()) {
+      result[i] = input[i];
+    } else if (is_signed && !input.empty()) {
+      result[i] = input.back();
+    }
+  }
+  return result;
+}
+
+// Ripple-carry adder.
+Words Add(absl::Span<const Word> a, absl::Span<const Word> b,
+          Word carry = 0) {
+  Words result(a.size());
+  for (int64 i = 0; i < a.size(); ++i) {
+    Word half_sum = a[i] ^ b[i];
+    result[i] = half_sum ^ carry;
+    carry = (a[i] & b[i]) | (half_sum & carry);
+  }
+  return result;
+}
+
+Words Not(absl::Span<const Word> input) {
+  Words result(input.size());
+  for (int64 i = 0; i < input.size(); ++i) {
+    result[i] = ~input[i];
+  }
+  return result;
+}
+
+Words Subtract(absl::Span<const Word> a, absl::Span<const Word> b) {
+  return Add(a, Not(b), /*carry=*/kAllOnes);
+}
+
+// Multiplies by adding the shifted partial products, modulo 2^width. The
+// product of the operands extended to 'width' is the product of the
+// operands truncated to 'width'.
+Words Multiply(absl::Span<const Word> a, absl::Span<const Word> b,
+               int64 width, bool is_signed) {
+  Words a_ext = Extend(a, width, is_signed);
+  Words b_ext = Extend(b, width, is_signed);
+  Words result(width, 0);
+  for (int64 shift = 0; shift < width; ++shift) {
+    if (b_ext[shift] == 0) {
+      continue;
+    }
+    Words partial_product(width, 0);
+    for (int64 i = shift; i < width; ++i) {
+      partial_product[i] = a_ext[i - shift] & b_ext[shift];
+    }
+    result = Add(result, partial_product);
+  }
+  return result;
+}
+
+Word Equals(absl::Span<const Word> a, absl::Span<const Word> b) {
+  Word different = 0;
+  for (int64 i = 0; i < a.size(); ++i) {
+    different |= a[i] ^ b[i];
+  }
+  return ~different;
+}
+
+// Comparator scanning from the least significant bit: 'a' is less than 'b' if
+// it is less in the current bit, or equal in it and less in the lower bits.
+Word ULessThan(absl::Span<const Word> a, absl::Span<const Word> b) {
+  Word less = 0;
+  for (int64 i = 0; i < a.size(); ++i) {
+    less = (~a[i] & b[i]) | (~(a[i] ^ b[i]) & less);
+  }
+  return less;
+}
+
+// Signed comparison is unsigned comparison with the sign bits flipped.
+Word SLessThan(absl::Span<const Word> a, absl::Span<const Word> b) {
+  if (a.empty()) {
+    return 0;
+  }
+  Words a_flipped(a.begin(), a.end());
+  Words b_flipped(b.begin(), b.end());
+  a_flipped.back() = ~a_flipped.back();
+  b_flipped.back() = ~b_flipped.back();
+  return ULessThan(a_flipped, b_flipped);
+}
+
+// Barrel shifter: stage k shifts by 2^k in the patterns where bit k of the
+// amount is set. Bits shifted in are zero, or the sign bit if 'arithmetic'.
+Words Shift(absl::Span<const Word> input, absl::Span<const Word> amount,
+            bool right, bool arithmetic) {
+  int64 width = input.size();
+  Word fill = arithmetic && width > 0 ? input.back() : 0;
+  Words result(input.begin(), input.end());
+  for (int64 k = 0; k < amount.size(); ++k) {
+    Word selector = amount[k];
+    if (selector == 0) {
+      continue;
+    }
+    // Shifting by at least the width leaves only the fill.
+    int64 distance = k < 63 ? int64{1} << k : width;
+    Words shifted(width);
+    for (int64 i = 0; i < width; ++i) {
+      int64 source = right ? i + distance : i - distance;
+      Word shifted_in =
+          source >= 0 && source < width ? result[source] : (right ? fill : 0);
+      shifted[i] = Mux(selector, shifted_in, result[i]);
+    }
+    result = std::move(shifted);
+  }
+  return result;
+}
+
+// Returns the value of a bits-typed node whose operands are all bits-typed, or
+// nullopt if the operation has no bit-sliced implementation.
+absl::optional<Words> EvaluateBitSliced(
+    Node* node, absl::Span<const absl::Span<const Word>> operands) {
+  int64 width = node->BitCountOrDie();
+  auto nary = [&](auto op, bool invert) {
+    Words result(operands[0].begin(), operands[0].end());
+    for (int64 i = 1; i < operands.size(); ++i) {
+      for (int64 j = 0; j < width; ++j) {
+        result[j] = op(result[j], operands[i][j]);
+      }
+    }
+    return invert ? Not(result) : result;
+  };
+  auto single = [](Word w) { return Words({w}); };
+  switch (node->op()) {
+    case Op::kLiteral:
+      return Broadcast(node->As<Literal>()->value().bits());
+    case Op::kIdentity:
+      return Words(operands[0].begin(), operands[0].end());
+    case Op::kNot:
+      return Not(operands[0]);
+    case Op::kAnd:
+      return nary([](Word a, Word b) { return a & b; }, /*invert=*/false);
+    case Op::kNand:
+      return nary([](Word a, Word b) { return a & b; }, /*invert=*/true);
+    case Op::kOr:
+      return nary([](Word a, Word b) { return a | b; }, /*invert=*/false);
+    case Op::kNor:
+      return nary([](Word a, Word b) { return a | b; }, /*invert=*/true);
+    case Op::kXor:
+      return nary([](Word a, Word b) { return a ^ b; }, /*invert=*/false);
+    case Op::kAndReduce: {
+      Word result = kAllOnes;
+      for (Word w : operands[0]) {
+        result &= w;
+      }
+      return single(result);
+    }
+    case Op::kOrReduce: {
+      Word result = 0;
+      for (Word w : operands[0]) {
+        result |= w;
+      }
+      return single(result);
+    }
+    case Op::kXorReduce: {
+      Word result = 0;
+      for (Word w : operands[0]) {
+        result ^= w;
+      }
+      return single(result);
+    }
+    case Op::kEq:
+      return single(Equals(operands[0], operands[1]));
+    case Op::kNe:
+      return single(~Equals(operands[0], operands[1]));
+    case Op::kULt:
+      return single(ULessThan(operands[0], operands[1]));
+    case Op::kUGt:
+      return single(ULessThan(operands[1], operands[0]));
+    case Op::kULe:
+      return single(~ULessThan(operands[1], operands[0]));
+    case Op::kUGe:
+      return single(~ULessThan(operands[0], operands[1]));
+    case Op::kSLt:
+      return single(SLessThan(operands[0], operands[1]));
+    case Op::kSGt:
+      return single(SLessThan(operands[1], operands[0]));
+    case Op::kSLe:
+      return single(~SLessThan(operands[1], operands[0]));
+    case Op::kSGe:
+      return single(~SLessThan(operands[0], operands[1]));
+    case Op::kAdd:
+      return Add(operands[0], operands[1]);
+    case Op::kSub:
+      return Subtract(operands[0], operands[1]);
+    case Op::kNeg:
+      return Subtract(Words(width, 0), operands[0]);
+    case Op::kUMul:
+      return Multiply(operands[0], operands[1], width, /*is_signed=*/false);
+    case Op::kSMul:
+      return Multiply(operands[0], operands[1], width, /*is_signed=*/true);
+    case Op::kShll:
+      return Shift(operands[0], operands[1], /*right=*/false,
+                   /*arithmetic=*/false);
+    case Op::kShrl:
+      return Shift(operands[0], operands[1], /*right=*/true,
+                   /*arithmetic=*/false);
+    case Op::kShra:
+      return Shift(operands[0], operands[1], /*right=*/true,
+                   /*arithmetic=*/true);
+    case Op::kZeroExt:
+      return Extend(operands[0], width, /*is_signed=*/false);
+    case Op::kSignExt:
+      return Extend(operands[0], width, /*is_signed=*/true);
+    case Op::kConcat: {
+      // The first operand holds the most significant bits.
+      Words result;
+      for (int64 i = operands.size() - 1; i >= 0; --i) {
+        result.insert(result.end(), operands[i].begin(), operands[i].end());
+      }
+      return result;
+    }
+    case Op::kBitSlice: {
+      int64 start = node->As<BitSlice>()->start();
+      return Words(operands[0].begin() + start,
+                   operands[0].begin() + start + width);
+    }
+    case Op::kDynamicBitSlice: {
+      // Bits beyond the end of the operand are zero.
+      Words extended =
+          Extend(operands[0], operands[0].size() + width, /*is_signed=*/false);
+      Words shifted = Shift(extended, operands[1], /*right=*/true,
+                            /*arithmetic=*/false);
+      shifted.resize(width);
+      return shifted;
+    }
+    case Op::kReverse:
+      return Words(operands[0].rbegin(), operands[0].rend());
+    case Op::kSel: {
+      Select* select = node->As<Select>();
+      absl::Span<const Word> selector = operands[0];
+      Words result(width, 0);
+      Word selected = 0;
+      for (int64 i = 0; i < select->cases().size(); ++i) {
+        Word match =
+            Equals(selector, Broadcast(UBits(i, selector.size())));
+        selected |= match;
+        for (int64 j = 0; j < width; ++j) {
+          result[j] |= match & operands[i + 1][j];
+        }
+      }
+      if (select->default_value().has_value()) {
+        for (int64 j = 0; j < width; ++j) {
+          result[j] |= ~selected & operands.back()[j];
+        }
+      }
+      return result;
+    }
+    case Op::kOneHotSel: {
+      absl::Span<const Word> selector = operands[0];
+      Words result(width, 0);
+      for (int64 i = 0; i < selector.size(); ++i) {
+        for (int64 j = 0; j < width; ++j) {
+          result[j] |= selector[i] & operands[i + 1][j];
+        }
+      }
+      return result;
+    }
+    case Op::kOneHot: {
+      absl::Span<const Word> input = operands[0];
+      int64 input_width = input.size();
+      bool lsb_priority = node->As<OneHot>()->priority() == LsbOrMsb::kLsb;
+      Words result(width, 0);
+      Word seen = 0;
+      for (int64 i = 0; i < input_width; ++i) {
+        int64 index = lsb_priority ? i : input_width - i - 1;
+        result[index] = input[index] & ~seen;
+        seen |= input[index];
+      }
+      result[input_width] = ~seen;
+      return result;
+    }
+    case Op::kEncode: {
+      Words result(width, 0);
+      for (int64 i = 0; i < operands[0].size(); ++i) {
+        for (int64 j = 0; j < width; ++j) {
+          if ((i >> j) & 1) {
+            result[j] |= operands[0][i];
+          }
+        }
+      }
+      return result;
+    }
+    case Op::kDecode: {
+      absl::Span<const Word> input = operands[0];
+      Words result(width, 0);
+      for (int64 i = 0; i < width; ++i) {
+        if (Bits::MinBitCountUnsigned(i) > input.size()) {
+          break;
+        }
+        result[i] = Equals(input, Broadcast(UBits(i, input.size())));
+      }
+      return result;
+    }
+    default:
+      return absl::nullopt;
+  }
+}
+
+}  // namespace
+
+BitParallelSimulator::BitParallelSimulator(Function* f) : f_(f) {
+  for (Node* node : TopoSort(f)) {
+    topo_order_.push_back(node);
+    states_[node];
+  }
+}
+
+absl::Status BitParallelSimulator::Run(
+    absl::Span<const std::vector<Value>> args) {
+  if (args.size() != f_->params().size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Function %s expects %d arguments, got %d",
+                        f_->name(), f_->params().size(), args.size()));
+  }
+  int64 batch_size = args.empty() ? 1 : args.front().size();
+  if (batch_size < 1 || batch_size > kBatchSize) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Batch size must be between 1 and %d, got %d", kBatchSize,
+        batch_size));
+  }
+  for (int64 i = 0; i < args.size(); ++i) {
+    Param* param = f_->params()[i];
+    if (args[i].size() != batch_size) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Expected %d values for parameter %s, got %d", batch_size,
+          param->GetName(), args[i].size()));
+    }
+    for (const Value& value : args[i]) {
+      if (!ValueConformsToType(value, param->GetType())) {
+        return absl::InvalidArgumentError(absl::StrFormat(
+            "Value %s does not match the type %s of parameter %s",
+            value.ToString(), param->GetType()->ToString(),
+            param->GetName()));
+      }
+    }
+  }
+
+  StartBatch(batch_size);
+  for (int64 i = 0; i < args.size(); ++i) {
+    Param* param = f_->params()[i];
+    if (param->GetType()->IsBits()) {
+      Words words(param->BitCountOrDie(), 0);
+      for (int64 pattern = 0; pattern < batch_size; ++pattern) {
+        SetPattern(args[i][pattern].bits(), pattern, &words);
+      }
+      PadPatterns(batch_size, &words);
+      SetWords(param, std::move(words));
+    } else {
+      states_.at(param).values = args[i];
+    }
+  }
+  return RunBatch();
+}
+
+absl::Status BitParallelSimulator::RunRandom() {
+  std::uniform_int_distribution<Word> distribution;
+  StartBatch(kBatchSize);
+  for (Param* param : f_->params()) {
+    if (param->GetType()->IsBits()) {
+      Words words(param->BitCountOrDie());
+      for (Word& word : words) {
+        word = distribution(random_);
+      }
+      SetWords(param, std::move(words));
+    } else {
+      std::vector<Value>& values = states_.at(param).values;
+      values.clear();
+      for (int64 pattern = 0; pattern < kBatchSize; ++pattern) {
+        values.push_back(RandomValue(param->GetType(), &random_));
+      }
+    }
+  }
+  return RunBatch();
+}
+
+void BitParallelSimulator::StartBatch(int64 batch_size) {
+  previous_batch_size_ = batch_size_;
+  batch_size_ = batch_size;
+}
+
+absl::Status BitParallelSimulator::RunBatch() {
+  for (Node* node : topo_order_) {
+    if (node->Is<Param>()) {
+      continue;
+    }
+    bool bit_sliced =
+        node->GetType()->IsBits() &&
+        std::all_of(node->operands().begin(), node->operands().end(),
+                    [](Node* o) { return o->GetType()->IsBits(); });
+    if (bit_sliced) {
+      absl::InlinedVector<absl::Span<const Word>, 3> operands;
+      for (Node* operand : node->operands()) {
+        operands.push_back(states_.at(operand).words);
+      }
+      absl::optional<Words> words = EvaluateBitSliced(node, operands);
+      if (words.has_value()) {
+        SetWords(node, std::move(*words));
+        continue;
+      }
+    }
+    XLS_RETURN_IF_ERROR(EvaluateWithInterpreter(node, &states_.at(node)));
+  }
+  pattern_count_ += batch_size_;
+  return absl::OkStatus();
+}
+
+absl::Status BitParallelSimulator::EvaluateWithInterpreter(Node* node,
+                                                           NodeState* state) {
+  Words words(node->GetType()->IsBits() ? node->BitCountOrDie() : 0, 0);
+  std::vector<Value> values;
+  for (int64 pattern = 0; pattern < batch_size_; ++pattern) {
+    std::vector<Value> operand_values;
+    operand_values.reserve(node->operand_count());
+    for (Node* operand : node->operands()) {
+      operand_values.push_back(GetValue(operand, pattern));
+    }
+    std::vector<const Value*> operand_pointers;
+    for (const Value& value : operand_values) {
+      operand_pointers.push_back(&value);
+    }
+    XLS_ASSIGN_OR_RETURN(Value result,
+                         ir_interpreter::EvaluateNode(node, operand_pointers));
+    if (node->GetType()->IsBits()) {
+      SetPattern(result.bits(), pattern, &words);
+    } else {
+      values.push_back(std::move(result));
+    }
+  }
+  if (node->GetType()->IsBits()) {
+    PadPatterns(batch_size_, &words);
+    SetWords(node, std::move(words));
+  } else {
+    state->values = std::move(values);
+  }
+  return absl::OkStatus();
+}
+
+void BitParallelSimulator::SetWords(Node* node, std::vector<Word> words) {
+  NodeState& state = states_.at(node);
+  // Count the transitions between consecutive patterns of the batch, and from
+  // the last pattern of the previous batch to the first of this one.
+  Word within_batch = (kAllOnes >> (kBatchSize - batch_size_)) & ~Word{1};
+  for (int64 i = 0; i < words.size(); ++i) {
+    Word word = words[i];
+    state.toggle_count += absl::popcount((word ^ (word << 1)) & within_batch);
+    if (pattern_count_ > 0) {
+      Word previous = state.words[i] >> (previous_batch_size_ - 1);
+      state.toggle_count += (previous ^ word) & 1;
+    }
+  }
+  state.signature.insert(state.signature.end(), words.begin(), words.end());
+  state.words = std::move(words);
+}
+
+Value BitParallelSimulator::GetValue(Node* node, int64 pattern) const {
+  XLS_CHECK_LT(pattern, batch_size_);
+  const NodeState& state = states_.at(node);
+  if (node->GetType()->IsBits()) {
+    return Value(GetPattern(state.words, pattern));
+  }
+  return state.values[pattern];
+}
+
+double BitParallelSimulator::GetToggleRate(Node* node) const {
+  int64 bit_count = node->BitCountOrDie();
+  if (pattern_count_ < 2 || bit_count == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(states_.at(node).toggle_count) /
+         (bit_count * (pattern_count_ - 1));
+}
+
+}  // namespace xls
@@ -0,0 +1,128 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_IR_BIT_PARALLEL_SIMULATOR_H_
+#define XLS_IR_BIT_PARALLEL_SIMULATOR_H_
+
+#include <random>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/ir/function.h"
+#include "xls/ir/node.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+
+// Simulates a function on a batch of up to 64 input patterns at once. Each bit
+// of a bits-typed node is represented by a word holding the value of the bit in
+// every pattern of the batch (bit slicing), so a bitwise operation evaluates
+// all patterns with one instruction per bit. Arithmetic, comparisons and
+// shifts are evaluated with bit-sliced adders, comparators and barrel
+// shifters. Operations without a bit-sliced implementation (division,
+// invokes, operations on tuples and arrays, etc.) are evaluated by the
+// interpreter once per pattern.
+//
+// Besides the values of the last batch, the simulator accumulates for each
+// bits-typed node a signature, the concatenated words of every batch, and the
+// toggle rate, the fraction of bits which change between consecutive
+// patterns. Nodes which are equivalent have equal signatures, which makes
+// signatures a cheap filter for equivalence candidates.
+//
+// The function must not be modified while it is simulated.
+class BitParallelSimulator {
+ public:
+  using Word = uint64;
+
+  // The maximum number of patterns in a batch: the number of bits in a word.
+  static constexpr int64 kBatchSize = 64;
+
+  explicit BitParallelSimulator(Function* f);
+
+  // Simulates a batch of patterns. 'args' holds the values of each parameter
+  // in order, and every parameter must have the same number of values, at
+  // most kBatchSize.
+  absl::Status Run(absl::Span<const std::vector<Value>> args);
+
+  // Simulates a batch of kBatchSize patterns of random arguments. The random
+  // sequence is deterministic.
+  absl::Status RunRandom();
+
+  // Returns the value of 'node' in the given pattern of the last batch.
+  Value GetValue(Node* node, int64 pattern) const;
+
+  // Returns the words of a bits-typed node in the last batch, one per bit
+  // starting with the least significant. Bit 'p' of each word is the value of
+  // the bit in pattern 'p'.
+  absl::Span<const Word> GetWords(Node* node) const {
+    return states_.at(node).words;
+  }
+
+  // Returns the signature of a bits-typed node: the words of every batch
+  // simulated so far. Bits of patterns beyond the size of a batch hold the
+  // value of the last pattern of the batch.
+  const std::vector<Word>& GetSignature(Node* node) const {
+    return states_.at(node).signature;
+  }
+
+  // Returns the fraction of the bits of a bits-typed node which change
+  // between consecutive patterns, over every pattern simulated so far.
+  double GetToggleRate(Node* node) const;
+
+  // Returns the number of patterns simulated so far.
+  int64 pattern_count() const { return pattern_count_; }
+
+  // Returns the number of patterns in the last batch.
+  int64 batch_size() const { return batch_size_; }
+
+ private:
+  struct NodeState {
+    // The value of a bits-typed node, one word per bit.
+    std::vector<Word> words;
+    // The values of any other node, one per pattern of the batch.
+    std::vector<Value> values;
+    std::vector<Word> signature;
+    int64 toggle_count = 0;
+  };
+
+  // Starts a batch of 'batch_size' patterns. Must be called before the values
+  // of the parameters are set.
+  void StartBatch(int64 batch_size);
+
+  // Evaluates every node other than the parameters, whose values must already
+  // be set.
+  absl::Status RunBatch();
+
+  // Evaluates the node once per pattern of the batch with the interpreter.
+  absl::Status EvaluateWithInterpreter(Node* node, NodeState* state);
+
+  // Sets the value of the node to 'words' and updates its signature and toggle
+  // count.
+  void SetWords(Node* node, std::vector<Word> words);
+
+  Function* f_;
+  std::vector<Node*> topo_order_;
+  absl::flat_hash_map<Node*, NodeState> states_;
+  std::minstd_rand random_;
+  int64 batch_size_ = 0;
+  int64 previous_batch_size_ = 0;
+  int64 pattern_count_ = 0;
+};
+
+}  // namespace xls
+
+#endif  // XLS_IR_BIT_PARALLEL_SIMULATOR_H_
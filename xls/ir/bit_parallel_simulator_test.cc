@@ -0,0 +1,213 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/bit_parallel_simulator.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/lsb_or_msb.h"
+#include "xls/ir/package.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+namespace {
+
+using status_testing::StatusIs;
+using ::testing::HasSubstr;
+
+class BitParallelSimulatorTest : public IrTestBase {};
+
+// Every operation is simulated exactly: the values of each pattern agree with
+// the interpreter.
+TEST_F(BitParallelSimulatorTest, MatchesInterpreter) {
+  auto p = CreatePackage();
+  Function* callee;
+  {
+    FunctionBuilder fb("callee", p.get());
+    BValue a = fb.Param("a", p->GetBitsType(8));
+    fb.Add(a, fb.Literal(UBits(3, 8)));
+    XLS_ASSERT_OK_AND_ASSIGN(callee, fb.Build());
+  }
+  FunctionBuilder fb(TestName(), p.get());
+  BValue a = fb.Param("a", p->GetBitsType(8));
+  BValue b = fb.Param("b", p->GetBitsType(8));
+  BValue s = fb.Param("s", p->GetBitsType(2));
+  BValue t = fb.Param("t", p->GetTupleType({p->GetBitsType(8),
+                                            p->GetBitsType(3)}));
+  BValue t0 = fb.TupleIndex(t, 0);
+  BValue t1 = fb.TupleIndex(t, 1);
+  std::vector<BValue> values = {
+      fb.Add(a, b),
+      fb.Subtract(a, b),
+      fb.Negate(b),
+      fb.Not(a),
+      fb.And(a, t0),
+      fb.Or(a, b),
+      fb.Xor(a, t0),
+      fb.AddNaryOp(Op::kNand, {a, b, t0}),
+      fb.AddNaryOp(Op::kNor, {a, b}),
+      fb.AndReduce(a),
+      fb.OrReduce(t1),
+      fb.XorReduce(b),
+      fb.Eq(a, b),
+      fb.Ne(a, t0),
+      fb.ULt(a, b),
+      fb.UGt(a, b),
+      fb.ULe(a, b),
+      fb.UGe(a, b),
+      fb.SLt(a, b),
+      fb.SGt(a, b),
+      fb.SLe(a, b),
+      fb.SGe(a, b),
+      fb.UMul(a, b),
+      fb.UMul(a, t1, /*result_width=*/11),
+      fb.SMul(a, t1, /*result_width=*/12),
+      fb.SMul(a, b, /*result_width=*/6),
+      fb.UDiv(a, fb.ZeroExtend(t1, 8)),
+      fb.AddBinOp(Op::kSDiv, a, b),
+      fb.Shll(a, t1),
+      fb.Shrl(a, b),
+      fb.Shra(a, t1),
+      fb.Shra(a, fb.ZeroExtend(t1, 70)),
+      fb.ZeroExtend(t1, 12),
+      fb.SignExtend(t1, 12),
+      fb.Concat({t1, a, s}),
+      fb.BitSlice(a, /*start=*/2, /*width=*/5),
+      fb.DynamicBitSlice(a, t1, /*width=*/4),
+      fb.Reverse(a),
+      fb.Identity(b),
+      fb.Select(s, {a, b, t0, fb.Literal(UBits(42, 8))}),
+      fb.Select(fb.BitSlice(a, 0, 2), {b, t0},
+                /*default_value=*/fb.Literal(UBits(7, 8))),
+      fb.OneHotSelect(fb.BitSlice(b, 0, 3), {a, t0, b}),
+      fb.OneHot(t1, LsbOrMsb::kLsb),
+      fb.OneHot(t1, LsbOrMsb::kMsb),
+      fb.Encode(a),
+      fb.Decode(t1),
+      fb.Decode(s, /*width=*/3),
+      fb.Invoke({b}, callee),
+      fb.ArrayIndex(fb.Array({a, b, t0}, p->GetBitsType(8)), s),
+  };
+  fb.Tuple(values);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  BitParallelSimulator simulator(f);
+  for (int64 batch = 0; batch < 4; ++batch) {
+    XLS_ASSERT_OK(simulator.RunRandom());
+    for (int64 pattern = 0; pattern < BitParallelSimulator::kBatchSize;
+         ++pattern) {
+      std::vector<Value> args;
+      for (Param* param : f->params()) {
+        args.push_back(simulator.GetValue(param, pattern));
+      }
+      XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(f, args));
+      for (int64 i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(simulator.GetValue(values[i].node(), pattern),
+                  expected.element(i))
+            << values[i].node()->ToString();
+      }
+    }
+  }
+  EXPECT_EQ(simulator.pattern_count(), 4 * BitParallelSimulator::kBatchSize);
+}
+
+TEST_F(BitParallelSimulatorTest, PartialBatch) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(4));
+  BValue y = fb.Param("y", p->GetBitsType(4));
+  BValue sum = fb.Add(x, y);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  BitParallelSimulator simulator(f);
+  XLS_ASSERT_OK(simulator.Run(
+      {{Value(UBits(1, 4)), Value(UBits(7, 4)), Value(UBits(15, 4))},
+       {Value(UBits(2, 4)), Value(UBits(8, 4)), Value(UBits(3, 4))}}));
+  EXPECT_EQ(simulator.batch_size(), 3);
+  EXPECT_EQ(simulator.GetValue(sum.node(), 0), Value(UBits(3, 4)));
+  EXPECT_EQ(simulator.GetValue(sum.node(), 1), Value(UBits(15, 4)));
+  EXPECT_EQ(simulator.GetValue(sum.node(), 2), Value(UBits(2, 4)));
+  // The unused patterns hold the value of the last pattern: 0b0010.
+  EXPECT_THAT(simulator.GetWords(sum.node()),
+              ::testing::ElementsAre(0b011, ~uint64{0}, 0b010, 0b010));
+
+  EXPECT_THAT(simulator.Run({{Value(UBits(1, 4))}}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("expects 2 arguments")));
+  EXPECT_THAT(simulator.Run({{Value(UBits(1, 4))}, {Value(UBits(1, 5))}}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("does not match the type")));
+}
+
+TEST_F(BitParallelSimulatorTest, SignaturesOfEquivalentNodesAreEqual) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(16));
+  BValue y = fb.Param("y", p->GetBitsType(16));
+  BValue sum = fb.Add(x, y);
+  BValue difference = fb.Subtract(sum, y);
+  BValue shifted = fb.Shll(x, fb.Literal(UBits(1, 16)));
+  BValue doubled = fb.Add(x, x);
+  fb.Tuple({difference, shifted, doubled});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  BitParallelSimulator simulator(f);
+  XLS_ASSERT_OK(simulator.RunRandom());
+  XLS_ASSERT_OK(simulator.RunRandom());
+  EXPECT_EQ(simulator.GetSignature(x.node()).size(), 2 * 16);
+  EXPECT_EQ(simulator.GetSignature(difference.node()),
+            simulator.GetSignature(x.node()));
+  EXPECT_EQ(simulator.GetSignature(shifted.node()),
+            simulator.GetSignature(doubled.node()));
+  EXPECT_NE(simulator.GetSignature(sum.node()),
+            simulator.GetSignature(doubled.node()));
+}
+
+TEST_F(BitParallelSimulatorTest, ToggleRate) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(2));
+  BValue not_x = fb.Not(x);
+  BValue literal = fb.Literal(UBits(2, 2));
+  fb.Tuple({not_x, literal});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  BitParallelSimulator simulator(f);
+  // Count 0, 1, 2, 3 across two batches: the low bit toggles three times and
+  // the high bit once.
+  XLS_ASSERT_OK(simulator.Run({{Value(UBits(0, 2)), Value(UBits(1, 2))}}));
+  XLS_ASSERT_OK(simulator.Run({{Value(UBits(2, 2)), Value(UBits(3, 2))}}));
+  EXPECT_EQ(simulator.pattern_count(), 4);
+  EXPECT_DOUBLE_EQ(simulator.GetToggleRate(x.node()), 4.0 / 6.0);
+  EXPECT_DOUBLE_EQ(simulator.GetToggleRate(not_x.node()), 4.0 / 6.0);
+  EXPECT_DOUBLE_EQ(simulator.GetToggleRate(literal.node()), 0.0);
+
+  // Uniformly random values toggle about half of the time.
+  BitParallelSimulator random_simulator(f);
+  for (int64 i = 0; i < 16; ++i) {
+    XLS_ASSERT_OK(random_simulator.RunRandom());
+  }
+  EXPECT_NEAR(random_simulator.GetToggleRate(x.node()), 0.5, 0.05);
+}
+
+}  // namespace
+}  // namespace xls
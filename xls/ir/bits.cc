@@ -24,13 +24,13 @@
 namespace xls {
 
 /* static */ Bits Bits::FromBytes(absl::Span<const uint8> bytes,
-                                  int64 bit_count) {
+                                  int64 bit_count, bool big_endian) {
   XLS_CHECK_GE(bit_count, 0);
   int64 byte_count = bytes.size();
   XLS_CHECK_LE(bit_count, byte_count * 8);
   InlineBitmap bitmap(bit_count);
   for (int64 i = 0; i < byte_count; ++i) {
-    bitmap.SetByte(byte_count - i - 1, bytes[i]);
+    bitmap.SetByte(big_endian ? byte_count - i - 1 : i, bytes[i]);
   }
   return Bits(std::move(bitmap));
 }
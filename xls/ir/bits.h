@@ -77,7 +77,12 @@ class Bits {
   // order where the byte zero is the most significant byte. The size of 'bytes'
   // must be at least than bit_count / 8. Any bits beyond 'bit_count' in 'bytes'
   // are ignored.
-  static Bits FromBytes(absl::Span<const uint8> bytes, int64 bit_count);
+  //
+  // As with ToBytes(), "big_endian" may be set to false to indicate that byte
+  // zero is instead the least significant byte, as is the case when reading
+  // values directly out of (little-endian) machine memory.
+  static Bits FromBytes(absl::Span<const uint8> bytes, int64 bit_count,
+                        bool big_endian = true);
 
   // Note: we flatten into the pushbuffer with the MSb pushed first.
   void FlattenTo(BitPushBuffer* buffer) const {
@@ -88,6 +88,24 @@ TEST(BitsTest, BitsVectorConstructor) {
             "0x1ab_cdef_1234_5678_90fe_dcba");
 }
 
+TEST(BitsTest, LittleEndianBitsVectorConstructor) {
+  EXPECT_EQ(Bits::FromBytes({}, 0, /*big_endian=*/false), Bits());
+  EXPECT_EQ(Bits::FromBytes({42}, 6, /*big_endian=*/false), UBits(42, 6));
+  EXPECT_EQ(Bits::FromBytes({42, 0, 0, 0, 0, 0, 0, 0, 0, 0}, 73,
+                            /*big_endian=*/false),
+            UBits(42, 73));
+  EXPECT_EQ(Bits::FromBytes({0xef, 0xbe, 0xad, 0xde}, 32,
+                            /*big_endian=*/false),
+            UBits(0xdeadbeefULL, 32));
+
+  Bits wide = Bits::FromBytes({0x1, 0xab, 0xcd, 0xef, 0x12, 0x34, 0x56, 0x78,
+                               0x90, 0xfe, 0xdc, 0xba},
+                              89);
+  std::vector<uint8> bytes(12);
+  wide.ToBytes(absl::MakeSpan(bytes), /*big_endian=*/false);
+  EXPECT_EQ(Bits::FromBytes(bytes, 89, /*big_endian=*/false), wide);
+}
+
 TEST(BitsTest, BitsToBytes) {
   EXPECT_TRUE(Bits().ToBytes().empty());
   EXPECT_THAT(UBits(42, 6).ToBytes(), ElementsAre(42));
@@ -0,0 +1,82 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/channel_queue.h"
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/logging.h"
+
+namespace xls {
+
+ChannelQueue::ChannelQueue(int64 channel_id, int64 capacity)
+    : channel_id_(channel_id), slots_(capacity) {
+  XLS_CHECK_GT(capacity, 0);
+}
+
+int64 ChannelQueue::size() const {
+  // Read the head first: it only ever grows towards the tail, so the result
+  // cannot be negative.
+  int64 head = head_.load(std::memory_order_acquire);
+  return tail_.load(std::memory_order_acquire) - head;
+}
+
+bool ChannelQueue::TryEnqueue(Value message) {
+  int64 tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) == capacity()) {
+    return false;
+  }
+  slots_[tail % capacity()] = std::move(message);
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+absl::optional<Value> ChannelQueue::TryDequeue() {
+  int64 head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire)) {
+    return absl::nullopt;
+  }
+  Value message = std::move(slots_[head % capacity()]);
+  head_.store(head + 1, std::memory_order_release);
+  return message;
+}
+
+xabsl::StatusOr<ChannelQueue*> ChannelQueueManager::CreateQueue(
+    int64 channel_id, int64 capacity) {
+  if (capacity <= 0) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Queue capacity must be positive, is %d for channel %d", capacity,
+        channel_id));
+  }
+  auto [it, inserted] = queues_.insert(
+      {channel_id, absl::make_unique<ChannelQueue>(channel_id, capacity)});
+  if (!inserted) {
+    return absl::AlreadyExistsError(
+        absl::StrFormat("Queue already exists for channel %d", channel_id));
+  }
+  return it->second.get();
+}
+
+xabsl::StatusOr<ChannelQueue*> ChannelQueueManager::GetQueue(
+    int64 channel_id) const {
+  auto it = queues_.find(channel_id);
+  if (it == queues_.end()) {
+    return absl::NotFoundError(
+        absl::StrFormat("No queue exists for channel %d", channel_id));
+  }
+  return it->second.get();
+}
+
+}  // namespace xls
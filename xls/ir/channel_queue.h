@@ -0,0 +1,83 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_IR_CHANNEL_QUEUE_H_
+#define XLS_IR_CHANNEL_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/optional.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+
+// A bounded queue holding the messages in flight on a single channel. Each
+// message is a tuple Value holding the data operands of one channel send.
+//
+// The queue is lock-free, but only for a single producer and a single
+// consumer: at most one thread may enqueue and at most one (possibly
+// different) thread may dequeue at any given time.
+class ChannelQueue {
+ public:
+  ChannelQueue(int64 channel_id, int64 capacity);
+
+  int64 channel_id() const { return channel_id_; }
+  int64 capacity() const { return slots_.size(); }
+
+  // Returns the number of messages in the queue. When called concurrently with
+  // the producer (consumer), this is a lower (upper) bound.
+  int64 size() const;
+  bool empty() const { return size() == 0; }
+
+  // Appends the given message to the queue. Returns false (and drops nothing)
+  // if the queue is full. Producer-side only.
+  bool TryEnqueue(Value message);
+
+  // Removes and returns the oldest message in the queue, or nullopt if the
+  // queue is empty. Consumer-side only.
+  absl::optional<Value> TryDequeue();
+
+ private:
+  int64 channel_id_;
+  std::vector<Value> slots_;
+
+  // Total number of messages ever dequeued/enqueued; the next slot to read or
+  // write is the respective count modulo capacity. Each count is only written
+  // by one side, and kept on its own cache line to avoid false sharing.
+  alignas(64) std::atomic<int64> head_{0};
+  alignas(64) std::atomic<int64> tail_{0};
+};
+
+// Owns the queues of a set of channels, keyed by channel id.
+class ChannelQueueManager {
+ public:
+  // Creates a queue for the given channel. Returns an error if a queue already
+  // exists for it.
+  xabsl::StatusOr<ChannelQueue*> CreateQueue(int64 channel_id, int64 capacity);
+
+  // Returns the queue of the given channel, or a NotFound error.
+  xabsl::StatusOr<ChannelQueue*> GetQueue(int64 channel_id) const;
+
+ private:
+  absl::flat_hash_map<int64, std::unique_ptr<ChannelQueue>> queues_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_IR_CHANNEL_QUEUE_H_
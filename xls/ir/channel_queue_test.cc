@@ -0,0 +1,98 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/channel_queue.h"
+
+#include <thread>  // NOLINT(build/c++11)
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bits.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+using status_testing::StatusIs;
+
+Value Message(int64 value) { return Value::Tuple({Value(UBits(value, 32))}); }
+
+TEST(ChannelQueueTest, FifoOrder) {
+  ChannelQueue queue(/*channel_id=*/42, /*capacity=*/3);
+  EXPECT_EQ(queue.channel_id(), 42);
+  EXPECT_EQ(queue.capacity(), 3);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.TryDequeue().has_value());
+
+  // Wrap around the ring a few times.
+  for (int64 i = 0; i < 10; ++i) {
+    EXPECT_TRUE(queue.TryEnqueue(Message(2 * i)));
+    EXPECT_TRUE(queue.TryEnqueue(Message(2 * i + 1)));
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_EQ(queue.TryDequeue(), Message(2 * i));
+    EXPECT_EQ(queue.TryDequeue(), Message(2 * i + 1));
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(ChannelQueueTest, Full) {
+  ChannelQueue queue(/*channel_id=*/0, /*capacity=*/2);
+  EXPECT_TRUE(queue.TryEnqueue(Message(1)));
+  EXPECT_TRUE(queue.TryEnqueue(Message(2)));
+  EXPECT_FALSE(queue.TryEnqueue(Message(3)));
+  EXPECT_EQ(queue.size(), 2);
+  EXPECT_EQ(queue.TryDequeue(), Message(1));
+  EXPECT_TRUE(queue.TryEnqueue(Message(3)));
+  EXPECT_EQ(queue.TryDequeue(), Message(2));
+  EXPECT_EQ(queue.TryDequeue(), Message(3));
+  EXPECT_FALSE(queue.TryDequeue().has_value());
+}
+
+TEST(ChannelQueueTest, ProducerConsumerThreads) {
+  constexpr int64 kMessageCount = 100000;
+  ChannelQueue queue(/*channel_id=*/0, /*capacity=*/4);
+  std::thread producer([&] {
+    for (int64 i = 0; i < kMessageCount; ++i) {
+      while (!queue.TryEnqueue(Message(i))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (int64 i = 0; i < kMessageCount; ++i) {
+    absl::optional<Value> message;
+    while (!(message = queue.TryDequeue()).has_value()) {
+      std::this_thread::yield();
+    }
+    ASSERT_EQ(*message, Message(i));
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(ChannelQueueManagerTest, CreateAndGet) {
+  ChannelQueueManager manager;
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * queue, manager.CreateQueue(1, 8));
+  EXPECT_EQ(queue->channel_id(), 1);
+  EXPECT_EQ(queue->capacity(), 8);
+  EXPECT_THAT(manager.GetQueue(1), IsOkAndHolds(queue));
+  EXPECT_THAT(manager.GetQueue(2), StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_THAT(manager.CreateQueue(1, 8),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+  EXPECT_THAT(manager.CreateQueue(2, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace xls
@@ -17,6 +17,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "xls/common/fingerprint.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/ret_check.h"
 #include "xls/common/status/status_macros.h"
@@ -122,6 +123,7 @@ absl::Status Function::RemoveNode(Node* node, bool remove_param_ok) {
     XLS_RET_CHECK(remove_param_ok)
         << "Attempting to remove parameter when !remove_param_ok: " << *node;
   }
+  node->RemoveFromFunctionFingerprint();
   std::vector<Node*> unique_operands;
   for (Node* operand : node->operands()) {
     if (!absl::c_linear_search(unique_operands, operand)) {
@@ -232,6 +234,40 @@ bool Function::IsDefinitelyEqualTo(const Function* other) const {
   return result;
 }
 
+void Function::BeginLocalNodeIds(int64 base) {
+  XLS_CHECK(!local_node_ids_.has_value());
+  XLS_CHECK_GE(base, package_->next_node_id());
+  local_node_ids_ = LocalNodeIds{base, base};
+}
+
+void Function::EndLocalNodeIds() {
+  XLS_CHECK(local_node_ids_.has_value());
+  // Nodes which existed before BeginLocalNodeIds() all have ids below the base.
+  int64 offset = package_->next_node_id() - local_node_ids_->base;
+  for (Node* node : nodes()) {
+    if (node->id() >= local_node_ids_->base) {
+      node->set_id(node->id() + offset);
+    }
+  }
+  package_->set_next_node_id(local_node_ids_->next + offset);
+  local_node_ids_.reset();
+}
+
+void Function::AddToFingerprint(Node* node) {
+  node->immutable_fingerprint_ = node->ComputeImmutableFingerprint();
+  node_fingerprint_sum_ += node->Fingerprint();
+}
+
+uint64 Function::Fingerprint() const {
+  uint64 fingerprint = FingerprintString(name_);
+  fingerprint = FingerprintCombine(fingerprint, node_fingerprint_sum_);
+  for (Param* param : params_) {
+    fingerprint = FingerprintCombine(fingerprint, param->id());
+  }
+  return FingerprintCombine(
+      fingerprint, return_value_ == nullptr ? -1 : return_value_->id());
+}
+
 std::ostream& operator<<(std::ostream& os, const Function& function) {
   os << function.DumpIr();
   return os;
@@ -21,6 +21,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/types/optional.h"
 #include "xls/common/iterator_range.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/dfs_visitor.h"
@@ -91,6 +92,7 @@ class Function {
     }
     T* ptr = n.get();
     node_iterators_[ptr] = nodes_.insert(nodes_.end(), std::move(n));
+    AddToFingerprint(ptr);
     return ptr;
   }
 
@@ -133,7 +135,43 @@ class Function {
   // conservative and false may be returned for some "equivalent" functions.
   bool IsDefinitelyEqualTo(const Function* other) const;
 
+  // Returns the id to assign to a new node in this function. For use in node
+  // construction.
+  int64 AllocateNodeId() {
+    if (local_node_ids_.has_value()) {
+      return local_node_ids_->next++;
+    }
+    return package_->GetNextNodeId();
+  }
+
+  // Between BeginLocalNodeIds() and EndLocalNodeIds(), ids of new nodes in this
+  // function are drawn from a private range starting at "base" rather than
+  // from the package, which allows nodes to be created in different functions
+  // of the package concurrently. The ranges of functions modified concurrently
+  // must not overlap, and must lie above the package's next node id.
+  //
+  // EndLocalNodeIds() moves the nodes created in between into the package's
+  // id space, numbering them exactly as if their ids had been allocated from
+  // the package in order. Hence, ending the local ranges of several functions
+  // in package order gives the same ids as modifying them one at a time.
+  void BeginLocalNodeIds(int64 base);
+  void EndLocalNodeIds();
+
+  // Returns a fingerprint of the function: its name, the fingerprints of its
+  // nodes (see Node::Fingerprint), its parameters and its return value. Two
+  // functions with the same fingerprint print the same IR with very high
+  // probability. The fingerprint is kept up to date as the function is
+  // mutated, so computing it takes time proportional to the number of
+  // parameters only.
+  uint64 Fingerprint() const;
+
  private:
+  // Node maintains node_fingerprint_sum_ as it is mutated.
+  friend class Node;
+
+  // Adds the fingerprint of a newly added node to node_fingerprint_sum_.
+  void AddToFingerprint(Node* node);
+
   Function(const Function& other) = delete;
   void operator=(const Function& other) = delete;
 
@@ -149,6 +187,17 @@ class Function {
 
   std::vector<Param*> params_;
   Node* return_value_ = nullptr;
+
+  // The sum of the fingerprints of the nodes, which can be updated as nodes
+  // are added, removed and mutated.
+  uint64 node_fingerprint_sum_ = 0;
+
+  // The local id range in use, if any; see BeginLocalNodeIds().
+  struct LocalNodeIds {
+    int64 base;
+    int64 next;
+  };
+  absl::optional<LocalNodeIds> local_node_ids_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Function& function);
@@ -233,6 +233,42 @@ BValue FunctionBuilder::AfterAll(absl::Span<const BValue> dependencies,
   return AddNode<xls::AfterAll>(loc, nodes);
 }
 
+BValue FunctionBuilder::ChannelReceive(BValue token, int64 channel_id,
+                                       absl::Span<Type* const> data_types,
+                                       absl::optional<SourceLocation> loc) {
+  if (ErrorPending()) {
+    return BValue();
+  }
+  if (!GetType(token)->IsToken()) {
+    return SetError(StrFormat("First operand of channel receive must be of "
+                              "token type; is: %s",
+                              GetType(token)->ToString()),
+                    loc);
+  }
+  return AddNode<xls::ChannelReceive>(loc, token.node(), channel_id,
+                                      data_types);
+}
+
+BValue FunctionBuilder::ChannelSend(BValue token, int64 channel_id,
+                                    absl::Span<const BValue> data,
+                                    absl::optional<SourceLocation> loc) {
+  if (ErrorPending()) {
+    return BValue();
+  }
+  if (!GetType(token)->IsToken()) {
+    return SetError(StrFormat("First operand of channel send must be of "
+                              "token type; is: %s",
+                              GetType(token)->ToString()),
+                    loc);
+  }
+  std::vector<Node*> nodes;
+  nodes.reserve(data.size());
+  for (const BValue& value : data) {
+    nodes.push_back(value.node());
+  }
+  return AddNode<xls::ChannelSend>(loc, token.node(), nodes, channel_id);
+}
+
 BValue FunctionBuilder::Tuple(absl::Span<const BValue> elements,
                               absl::optional<SourceLocation> loc) {
   if (ErrorPending()) {
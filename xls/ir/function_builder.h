@@ -285,6 +285,19 @@ class FunctionBuilder {
   BValue AfterAll(absl::Span<const BValue> dependencies,
                   absl::optional<SourceLocation> loc = absl::nullopt);
 
+  // Creates a receive of a single message from the channel with the given id.
+  // The result is a tuple of a token (ordering the receive before users of the
+  // token) followed by the received data, which has the given types.
+  BValue ChannelReceive(BValue token, int64 channel_id,
+                        absl::Span<Type* const> data_types,
+                        absl::optional<SourceLocation> loc = absl::nullopt);
+
+  // Creates a send of "data" as a single message on the channel with the given
+  // id. The result is a token ordering the send before users of the token.
+  BValue ChannelSend(BValue token, int64 channel_id,
+                     absl::Span<const BValue> data,
+                     absl::optional<SourceLocation> loc = absl::nullopt);
+
   // Creates an array of values. Each value in element must be the same type
   // which is given by element_type.
   BValue Array(absl::Span<const BValue> elements, Type* element_type,
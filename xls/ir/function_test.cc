@@ -16,6 +16,7 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_format.h"
 #include "xls/common/status/matchers.h"
 #include "xls/ir/function_builder.h"
 #include "xls/ir/ir_test_base.h"
@@ -166,5 +167,65 @@ fn id(x: bits[16], y: bits[32]) -> bits[16] {
                          "match type of xor")));
 }
 
+TEST_F(FunctionTest, FingerprintTracksMutations) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, ParseFunction(R"(
+fn f(x: bits[32], y: bits[32]) -> bits[32] {
+  sub.3: bits[32] = sub(x, y)
+  ret add.4: bits[32] = add(sub.3, y)
+}
+)",
+                                                          p.get()));
+  Node* sub = FindNode("sub.3", func);
+  Node* add = FindNode("add.4", func);
+  uint64 original = func->Fingerprint();
+
+  sub->SwapOperands(0, 1);
+  uint64 swapped = func->Fingerprint();
+  EXPECT_NE(swapped, original);
+  sub->SwapOperands(0, 1);
+  EXPECT_EQ(func->Fingerprint(), original);
+
+  XLS_ASSERT_OK(add->ReplaceOperandNumber(0, FindNode("x", func)));
+  EXPECT_NE(func->Fingerprint(), original);
+  XLS_ASSERT_OK(add->ReplaceOperandNumber(0, sub));
+  EXPECT_EQ(func->Fingerprint(), original);
+
+  XLS_ASSERT_OK_AND_ASSIGN(Node * neg,
+                           func->MakeNode<UnOp>(absl::nullopt, add, Op::kNeg));
+  EXPECT_NE(func->Fingerprint(), original);
+  func->set_return_value(neg);
+  EXPECT_NE(func->Fingerprint(), original);
+  func->set_return_value(add);
+  XLS_ASSERT_OK(func->RemoveNode(neg));
+  EXPECT_EQ(func->Fingerprint(), original);
+}
+
+TEST_F(FunctionTest, FingerprintDependsOnlyOnIr) {
+  auto make_function = [](int64 value) {
+    return absl::StrFormat(R"(
+fn f(x: bits[32]) -> bits[32] {
+  literal.2: bits[32] = literal(value=%d)
+  ret add.3: bits[32] = add(x, literal.2)
+}
+)",
+                           value);
+  };
+  auto p1 = CreatePackage();
+  auto p2 = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Function * f1, ParseFunction(make_function(1), p1.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Function * f2, ParseFunction(make_function(1), p2.get()));
+  EXPECT_EQ(f1->Fingerprint(), f2->Fingerprint());
+  EXPECT_EQ(p1->Fingerprint(), p2->Fingerprint());
+
+  auto p3 = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Function * f3, ParseFunction(make_function(2), p3.get()));
+  EXPECT_NE(f1->Fingerprint(), f3->Fingerprint());
+  EXPECT_NE(p1->Fingerprint(), p3->Fingerprint());
+}
+
 }  // namespace
 }  // namespace xls
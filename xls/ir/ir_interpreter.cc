@@ -39,7 +39,8 @@ class InterpreterVisitor : public DfsVisitor {
   // indexed by parameter name.
   static xabsl::StatusOr<Value> Run(Function* function,
                                     absl::Span<const Value> args,
-                                    InterpreterStats* stats) {
+                                    InterpreterStats* stats,
+                                    ChannelQueueManager* queues) {
     if (args.size() != function->params().size()) {
       return absl::InvalidArgumentError(absl::StrFormat(
           "Function %s wants %d arguments, got %d.", function->name(),
@@ -56,13 +57,15 @@ class InterpreterVisitor : public DfsVisitor {
             value.ToString(), argno, param_type->ToString()));
       }
     }
-    InterpreterVisitor visitor(args, stats);
-    XLS_RETURN_IF_ERROR(function->return_value()->Accept(&visitor));
+    InterpreterVisitor visitor(args, stats, queues);
+    // Visit all nodes, not just those reaching the return value, so that
+    // channel operations which do not reach it are performed as in the JIT.
+    XLS_RETURN_IF_ERROR(function->Accept(&visitor));
     return visitor.ResolveAsValue(function->return_value());
   }
 
   static xabsl::StatusOr<Value> EvaluateNodeWithLiteralOperands(Node* node) {
-    InterpreterVisitor visitor({}, /*stats=*/nullptr);
+    InterpreterVisitor visitor({}, /*stats=*/nullptr, /*queues=*/nullptr);
     XLS_RETURN_IF_ERROR(node->Accept(&visitor));
     return visitor.ResolveAsValue(node);
   }
@@ -70,7 +73,7 @@ class InterpreterVisitor : public DfsVisitor {
   static xabsl::StatusOr<Value> EvaluateNode(
       Node* node, absl::Span<const Value* const> operand_values) {
     XLS_RET_CHECK_EQ(node->operand_count(), operand_values.size());
-    InterpreterVisitor visitor({}, /*stats=*/nullptr);
+    InterpreterVisitor visitor({}, /*stats=*/nullptr, /*queues=*/nullptr);
     for (int64 i = 0; i < operand_values.size(); ++i) {
       visitor.node_values_[node->operand(i)] = *operand_values[i];
     }
@@ -137,11 +140,33 @@ class InterpreterVisitor : public DfsVisitor {
   }
 
   absl::Status HandleChannelReceive(ChannelReceive* receive) override {
-    return absl::UnimplementedError("ChannelReceive not yet implemented");
+    XLS_ASSIGN_OR_RETURN(ChannelQueue * queue,
+                         GetChannelQueue(receive->channel_id()));
+    absl::optional<Value> message = queue->TryDequeue();
+    if (!message.has_value()) {
+      return absl::UnavailableError(
+          absl::StrFormat("Channel %d is empty; cannot evaluate %s",
+                          receive->channel_id(), receive->ToString()));
+    }
+    std::vector<Value> elements = {Value::Token()};
+    elements.insert(elements.end(), message->elements().begin(),
+                    message->elements().end());
+    return SetValueResult(receive, Value::TupleOwned(std::move(elements)));
   }
 
   absl::Status HandleChannelSend(ChannelSend* send) override {
-    return absl::UnimplementedError("ChannelSend not yet implemented");
+    XLS_ASSIGN_OR_RETURN(ChannelQueue * queue,
+                         GetChannelQueue(send->channel_id()));
+    std::vector<Value> data;
+    for (int64 i = 1; i < send->operand_count(); ++i) {
+      data.push_back(ResolveAsValue(send->operand(i)));
+    }
+    if (!queue->TryEnqueue(Value::TupleOwned(std::move(data)))) {
+      return absl::UnavailableError(
+          absl::StrFormat("Channel %d is full; cannot evaluate %s",
+                          send->channel_id(), send->ToString()));
+    }
+    return SetValueResult(send, Value::Token());
   }
 
   absl::Status HandleArray(Array* array) override {
@@ -205,7 +230,8 @@ class InterpreterVisitor : public DfsVisitor {
       for (const auto& value : invariant_args) {
         args_for_body.push_back(value);
       }
-      XLS_ASSIGN_OR_RETURN(loop_state, Run(body, args_for_body, stats_));
+      XLS_ASSIGN_OR_RETURN(loop_state,
+                           Run(body, args_for_body, stats_, queues_));
     }
     return SetValueResult(counted_for, loop_state);
   }
@@ -307,7 +333,7 @@ class InterpreterVisitor : public DfsVisitor {
     for (int64 i = 0; i < to_apply->params().size(); ++i) {
       args.push_back(ResolveAsValue(invoke->operand(i)));
     }
-    XLS_ASSIGN_OR_RETURN(Value result, Run(to_apply, args, stats_));
+    XLS_ASSIGN_OR_RETURN(Value result, Run(to_apply, args, stats_, queues_));
     return SetValueResult(invoke, result);
   }
 
@@ -345,7 +371,7 @@ class InterpreterVisitor : public DfsVisitor {
     for (const Value& operand_element :
          ResolveAsValue(map->operand(0)).elements()) {
       XLS_ASSIGN_OR_RETURN(Value result,
-                           Run(to_apply, {operand_element}, stats_));
+                           Run(to_apply, {operand_element}, stats_, queues_));
       results.push_back(result);
     }
     XLS_ASSIGN_OR_RETURN(Value result_array, Value::Array(results));
@@ -504,8 +530,18 @@ class InterpreterVisitor : public DfsVisitor {
   }
 
  private:
-  InterpreterVisitor(absl::Span<const Value> args, InterpreterStats* stats)
-      : stats_(stats), args_(args) {}
+  InterpreterVisitor(absl::Span<const Value> args, InterpreterStats* stats,
+                     ChannelQueueManager* queues)
+      : stats_(stats), queues_(queues), args_(args) {}
+
+  // Returns the queue on which operations on the given channel act.
+  xabsl::StatusOr<ChannelQueue*> GetChannelQueue(int64 channel_id) {
+    if (queues_ == nullptr) {
+      return absl::FailedPreconditionError(absl::StrFormat(
+          "No channel queues were provided for channel %d", channel_id));
+    }
+    return queues_->GetQueue(channel_id);
+  }
 
   // Verifies that the width of the given node and all of its operands are less
   // than or equal to 64 bits. Also returns an error if an operand or the node
@@ -659,6 +695,10 @@ class InterpreterVisitor : public DfsVisitor {
   // Statistics on interpreter execution. May be nullptr.
   InterpreterStats* stats_;
 
+  // Queues on which channel operations act. May be nullptr if the function
+  // has no channel operations.
+  ChannelQueueManager* queues_;
+
   // The arguments to the Function being evaluated indexed by parameter name.
   absl::Span<const Value> args_;
 
@@ -668,10 +708,17 @@ class InterpreterVisitor : public DfsVisitor {
 
 xabsl::StatusOr<Value> Run(Function* function, absl::Span<const Value> args,
                            InterpreterStats* stats) {
+  return RunWithChannels(function, args, /*queues=*/nullptr, stats);
+}
+
+xabsl::StatusOr<Value> RunWithChannels(Function* function,
+                                       absl::Span<const Value> args,
+                                       ChannelQueueManager* queues,
+                                       InterpreterStats* stats) {
   XLS_VLOG(3) << "Function:";
   XLS_VLOG_LINES(3, function->DumpIr());
   XLS_ASSIGN_OR_RETURN(Value result,
-                       InterpreterVisitor::Run(function, args, stats));
+                       InterpreterVisitor::Run(function, args, stats, queues));
   XLS_VLOG(2) << "Result = " << result;
   return result;
 }
@@ -18,6 +18,7 @@
 #include "absl/types/span.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/bits.h"
+#include "xls/ir/channel_queue.h"
 #include "xls/ir/function.h"
 #include "xls/ir/function_builder.h"
 #include "xls/ir/ir_interpreter_stats.h"
@@ -35,6 +36,16 @@ xabsl::StatusOr<Value> RunKwargs(
 xabsl::StatusOr<Value> Run(Function* function, absl::Span<const Value> args,
                            InterpreterStats* stats = nullptr);
 
+// As above, but channel sends and receives in the function act on the given
+// queues. A receive from an empty queue or a send to a full one is an error
+// (rather than blocking), so callers should ensure enough messages/space are
+// available beforehand; see ProcRuntime. Channel operations are performed even
+// if they do not reach the return value.
+xabsl::StatusOr<Value> RunWithChannels(Function* function,
+                                       absl::Span<const Value> args,
+                                       ChannelQueueManager* queues,
+                                       InterpreterStats* stats = nullptr);
+
 // Evaluates the given node. All operands of the nodes must be literal which are
 // used in the evaluation.
 xabsl::StatusOr<Value> EvaluateNodeWithLiteralOperands(Node* node);
@@ -18,6 +18,7 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "xls/common/integral_types.h"
@@ -47,6 +48,18 @@ class InterpreterStats {
     Meet(bits, &lattice);
   }
 
+  // Returns the bits of the node with the given string which held the same
+  // value every time it was noted, or nullopt if it was never noted.
+  absl::optional<TernaryVector> GetNodeBits(
+      absl::string_view node_string) const {
+    absl::MutexLock lock(&mutex_);
+    auto it = value_profile_.find(node_string);
+    if (it == value_profile_.end()) {
+      return absl::nullopt;
+    }
+    return it->second;
+  }
+
   // Returns a multi-line report string suitable for, e.g. XLS_LOG_LINES'ing.
   std::string ToReport() const;
 
@@ -632,6 +632,35 @@ xabsl::StatusOr<BValue> Parser::ParseFunctionBody(
         bvalue = fb->AfterAll(operands, *loc);
         break;
       }
+      case Op::kChannelReceive: {
+        int64* channel_id = arg_parser.AddKeywordArg<int64>("channel_id");
+        XLS_ASSIGN_OR_RETURN(operands, arg_parser.Run(/*arity=*/1));
+        // The data types are given by the declared type, which must be a tuple
+        // of a token followed by the received data.
+        if (!type->IsTuple() || type->AsTupleOrDie()->size() < 1 ||
+            !type->AsTupleOrDie()->element_type(0)->IsToken()) {
+          return absl::InvalidArgumentError(absl::StrFormat(
+              "Expected tuple type with leading token element @ %s",
+              op_token.pos().ToHumanString()));
+        }
+        absl::Span<Type* const> element_types =
+            type->AsTupleOrDie()->element_types();
+        bvalue = fb->ChannelReceive(operands[0], *channel_id,
+                                    element_types.subspan(1), *loc);
+        break;
+      }
+      case Op::kChannelSend: {
+        int64* channel_id = arg_parser.AddKeywordArg<int64>("channel_id");
+        XLS_ASSIGN_OR_RETURN(operands, arg_parser.Run(ArgParser::kVariadic));
+        if (operands.empty()) {
+          return absl::InvalidArgumentError(
+              absl::StrFormat("Expected token operand @ %s",
+                              op_token.pos().ToHumanString()));
+        }
+        bvalue = fb->ChannelSend(operands[0], *channel_id,
+                                 absl::MakeSpan(operands).subspan(1), *loc);
+        break;
+      }
       case Op::kArray: {
         if (!type->IsArray()) {
           return absl::InvalidArgumentError(absl::StrFormat(
@@ -944,6 +973,19 @@ xabsl::StatusOr<Function*> Parser::ParseFunction(absl::string_view input_string,
   return function;
 }
 
+/* static */
+xabsl::StatusOr<Function*> Parser::ParseFunctionWithFreshIds(
+    absl::string_view input_string, Package* package) {
+  XLS_ASSIGN_OR_RETURN(auto scanner, Scanner::Create(input_string));
+  Parser p(std::move(scanner));
+  XLS_ASSIGN_OR_RETURN(Function * function, p.ParseFunction(package));
+  for (Node* node : function->nodes()) {
+    node->set_id(package->GetNextNodeId());
+  }
+  XLS_RETURN_IF_ERROR(VerifyPackage(package));
+  return function;
+}
+
 /* static */
 xabsl::StatusOr<std::unique_ptr<Package>> Parser::ParsePackage(
     absl::string_view input_string,
@@ -58,6 +58,12 @@ class Parser {
   static xabsl::StatusOr<Function*> ParseFunction(
       absl::string_view input_string, Package* package);
 
+  // Parse the input_string as a function into the given package, numbering its
+  // nodes from the package's next node id instead of using the ids suggested by
+  // the node names. Use this to add a function dumped from another package.
+  static xabsl::StatusOr<Function*> ParseFunctionWithFreshIds(
+      absl::string_view input_string, Package* package);
+
   // Parse the input_string as a function type into the given package.
   static xabsl::StatusOr<FunctionType*> ParseFunctionType(
       absl::string_view input_string, Package* package);
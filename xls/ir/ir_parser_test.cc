@@ -436,6 +436,31 @@ fn after_all_func() -> token {
                        HasSubstr("Expected token type @")));
 }
 
+TEST(IrParserTest, ParseChannelReceiveAndSend) {
+  std::string input = R"(
+fn proc_func(t: token, x: bits[32]) -> token {
+  channel_receive.1: (token, bits[32], bits[8][2]) = channel_receive(t, channel_id=3)
+  tuple_index.3: bits[32] = tuple_index(channel_receive.1, index=1)
+  tuple_index.2: token = tuple_index(channel_receive.1, index=0)
+  add.4: bits[32] = add(tuple_index.3, x)
+  ret channel_send.5: token = channel_send(tuple_index.2, add.4, channel_id=4)
+}
+)";
+  ParseFunctionAndCheckDump(input);
+}
+
+TEST(IrParserTest, ParseChannelReceiveNonTupleType) {
+  Package p("my_package");
+  std::string input = R"(
+fn proc_func(t: token) -> bits[32] {
+  ret channel_receive.1: bits[32] = channel_receive(t, channel_id=3)
+}
+)";
+  EXPECT_THAT(Parser::ParseFunction(input, &p).status(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Expected tuple type with leading token")));
+}
+
 TEST(IrParserTest, ParseArray) {
   std::string input = R"(
 fn array_and_array(x: bits[32], y: bits[32], z: bits[32]) -> bits[32][3] {
@@ -1190,4 +1215,22 @@ fn main() -> bits[1] {
   EXPECT_GT(package->next_node_id(), 1000);
 }
 
+TEST(IrParserTest, ParseFunctionWithFreshIds) {
+  Package p("my_package");
+  XLS_ASSERT_OK(Parser::ParseFunction(R"(fn f(x: bits[8]) -> bits[8] {
+  ret neg.2: bits[8] = neg(x)
+})",
+                                      &p)
+                    .status());
+  // The ids suggested by the names would collide with the nodes of 'f'.
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Function * g,
+      Parser::ParseFunctionWithFreshIds(R"(fn g(x: bits[8]) -> bits[8] {
+  ret not.1: bits[8] = not(x)
+})",
+                                        &p));
+  EXPECT_GE(g->return_value()->id(), 3);
+  EXPECT_GT(p.next_node_id(), g->return_value()->id());
+}
+
 }  // namespace xls
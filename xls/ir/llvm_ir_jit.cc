@@ -69,6 +69,30 @@ namespace {
 // Convenience alias for XLS type => LLVM type mapping used as a cache.
 using TypeCache = absl::flat_hash_map<const Type*, llvm::Type*>;
 
+// Called from JIT-compiled code to send a message: "data" holds the sent
+// values, laid out as a tuple of the data operands.
+void JitChannelSend(JitChannelContext* context, int64 channel_id,
+                    const LlvmTypeLayout* layout, const uint8* data) {
+  ChannelQueue* queue = context->queues->GetQueue(channel_id).value();
+  // Called from generated code, so errors cannot be propagated.
+  Value value = layout->NativeLayoutToValue(data).value();
+  XLS_CHECK(queue->TryEnqueue(std::move(value)))
+      << "Channel " << channel_id << " is full";
+}
+
+// Called from JIT-compiled code to receive a message into "result", laid out
+// as the receive's (token, data...) result tuple.
+void JitChannelReceive(JitChannelContext* context, int64 channel_id,
+                       const LlvmTypeLayout* layout, uint8* result) {
+  ChannelQueue* queue = context->queues->GetQueue(channel_id).value();
+  absl::optional<Value> message = queue->TryDequeue();
+  XLS_CHECK(message.has_value()) << "Channel " << channel_id << " is empty";
+  std::vector<Value> elements = {Value::Token()};
+  elements.insert(elements.end(), message->elements().begin(),
+                  message->elements().end());
+  layout->ValueToNativeLayout(Value::TupleOwned(std::move(elements)), result);
+}
+
 // Visitor to construct LLVM IR for each encountered XLS IR node. Based on
 // DfsVisitorWithDefault to highlight any unhandled IR nodes.
 class BuilderVisitor : public DfsVisitorWithDefault {
@@ -77,18 +101,25 @@ class BuilderVisitor : public DfsVisitorWithDefault {
   // the entry function to the XLS Package. It's necessary to know for parameter
   // handling (whether or not we handle params as normal LLVM values or values
   // read from an input char buffer).
+  //
+  // If "profile" is non-null, code is emitted to update its counters as each
+  // node is evaluated. Channel operations call back into the host with
+  // "channel_context".
   explicit BuilderVisitor(llvm::Module* module, llvm::IRBuilder<>* builder,
                           absl::Span<Param* const> params,
                           absl::optional<Function*> llvm_entry_function,
                           LlvmTypeConverter* type_converter,
-                          bool generate_packed)
+                          bool generate_packed, JitProfile* profile,
+                          JitChannelContext* channel_context)
       : module_(module),
         context_(&module_->getContext()),
         builder_(builder),
         return_value_(nullptr),
         type_converter_(type_converter),
         llvm_entry_function_(llvm_entry_function),
-        generate_packed_(generate_packed) {
+        generate_packed_(generate_packed),
+        profile_(profile),
+        channel_context_(channel_context) {
     for (int i = 0; i < params.size(); ++i) {
       int64 start = i == 0 ? 0 : arg_indices_[i - 1].second + 1;
       int64 end =
@@ -272,6 +303,45 @@ class BuilderVisitor : public DfsVisitorWithDefault {
     return StoreResult(dynamic_bit_slice, result);
   }
 
+  absl::Status HandleChannelReceive(ChannelReceive* receive) override {
+    // The host writes the whole (token, data...) result into a stack buffer.
+    llvm::Type* result_type =
+        type_converter_->ConvertToLlvmType(*receive->GetType());
+    llvm::AllocaInst* buffer = builder_->CreateAlloca(result_type);
+    channel_context_->layouts.push_back(
+        type_converter_->CreateTypeLayout(*receive->GetType()));
+    EmitChannelCall(reinterpret_cast<const void*>(&JitChannelReceive),
+                    receive->channel_id(), &channel_context_->layouts.back(),
+                    buffer);
+    return StoreResult(receive, builder_->CreateLoad(result_type, buffer));
+  }
+
+  absl::Status HandleChannelSend(ChannelSend* send) override {
+    // Gather the data operands into a tuple in a stack buffer for the host.
+    std::vector<Type*> data_types;
+    for (int64 i = 1; i < send->operand_count(); ++i) {
+      data_types.push_back(send->operand(i)->GetType());
+    }
+    TupleType* data_type = send->package()->GetTupleType(data_types);
+    llvm::Type* llvm_data_type = type_converter_->ConvertToLlvmType(*data_type);
+    llvm::Value* data = llvm::UndefValue::get(llvm_data_type);
+    for (uint32 i = 0; i < data_types.size(); ++i) {
+      data = builder_->CreateInsertValue(
+          data, node_map_.at(send->operand(i + 1)), {i});
+    }
+    llvm::AllocaInst* buffer = builder_->CreateAlloca(llvm_data_type);
+    builder_->CreateStore(data, buffer);
+    channel_context_->layouts.push_back(
+        type_converter_->CreateTypeLayout(*data_type));
+    EmitChannelCall(reinterpret_cast<const void*>(&JitChannelSend),
+                    send->channel_id(), &channel_context_->layouts.back(),
+                    buffer);
+    return StoreResult(
+        send, llvm::ConstantArray::get(
+                  llvm::ArrayType::get(llvm::IntegerType::get(*context_, 1), 0),
+                  llvm::ArrayRef<llvm::Constant*>()));
+  }
+
   absl::Status HandleConcat(Concat* concat) override {
     llvm::Type* dest_type =
         type_converter_->ConvertToLlvmType(*concat->GetType());
@@ -605,6 +675,13 @@ class BuilderVisitor : public DfsVisitorWithDefault {
     llvm::Argument* arg_pointer = llvm_function->getArg(0);
     XLS_ASSIGN_OR_RETURN(int index, param->function()->GetParamIndex(param));
 
+    // Zero-width params (e.g., tokens) occupy no space in packed buffers.
+    if (param->GetType()->GetFlatBitCount() == 0) {
+      return StoreResult(param, CreateTypedZeroValue(
+                                    type_converter_->ConvertToLlvmType(
+                                        *param->GetType())));
+    }
+
     // First, load the arg buffer (as an i8*).
     // Then pull out elements from that buffer to make the final type.
     // Load 1: Get the pointer to arg N out of memory (the arg redirect buffer).
@@ -704,6 +781,9 @@ class BuilderVisitor : public DfsVisitorWithDefault {
         llvm_sel = builder_->CreateSelect(cmp, node_map_.at(node), llvm_sel);
       }
     }
+    if (profile_ != nullptr) {
+      EmitSelectProfiling(sel, selector);
+    }
     return StoreResult(sel, llvm_sel);
   }
 
@@ -875,6 +955,9 @@ class BuilderVisitor : public DfsVisitorWithDefault {
       case Op::kShll:
       case Op::kShra:
       case Op::kShrl:
+        if (profile_ != nullptr) {
+          EmitShiftProfiling(binop, rhs);
+        }
         result = EmitShiftOp(binop->op(), lhs, rhs);
         break;
       case Op::kSub:
@@ -1081,7 +1164,8 @@ class BuilderVisitor : public DfsVisitorWithDefault {
                                  function, /*InsertBefore=*/nullptr);
     llvm::IRBuilder<> builder(block);
     BuilderVisitor visitor(module_, &builder, {}, absl::nullopt,
-                           type_converter_, /*generate_packed=*/false);
+                           type_converter_, /*generate_packed=*/false,
+                           profile_, channel_context_);
     XLS_RETURN_IF_ERROR(xls_function->Accept(&visitor));
     if (function_type->getReturnType()->isVoidTy()) {
       builder.CreateRetVoid();
@@ -1092,8 +1176,126 @@ class BuilderVisitor : public DfsVisitorWithDefault {
     return function;
   }
 
+  // Returns a pointer to the given (host) address, for use in generated code.
+  llvm::Value* HostPointer(const void* address, llvm::Type* pointee_type) {
+    return llvm::ConstantExpr::getIntToPtr(
+        builder_->getInt64(reinterpret_cast<uint64>(address)),
+        llvm::PointerType::get(pointee_type, /*AddressSpace=*/0));
+  }
+
+  // Emits a call to "function" (JitChannelSend or JitChannelReceive) for the
+  // given channel, with "buffer" holding the message in the given layout.
+  void EmitChannelCall(const void* function, int64 channel_id,
+                       const LlvmTypeLayout* layout, llvm::Value* buffer) {
+    llvm::Type* i8_type = builder_->getInt8Ty();
+    llvm::Type* i8_ptr_type = llvm::PointerType::get(i8_type, 0);
+    llvm::FunctionType* function_type = llvm::FunctionType::get(
+        builder_->getVoidTy(),
+        {i8_ptr_type, builder_->getInt64Ty(), i8_ptr_type, i8_ptr_type},
+        /*isVarArg=*/false);
+    builder_->CreateCall(
+        function_type, HostPointer(function, function_type),
+        {HostPointer(channel_context_, i8_type),
+         builder_->getInt64(channel_id), HostPointer(layout, i8_type),
+         builder_->CreateBitCast(buffer, i8_ptr_type)});
+  }
+
+  // Emits code to add "amount" (an i64) to the given host counter.
+  void EmitCounterAdd(llvm::Value* counter, llvm::Value* amount) {
+    llvm::Value* count = builder_->CreateLoad(builder_->getInt64Ty(), counter);
+    builder_->CreateStore(builder_->CreateAdd(count, amount), counter);
+  }
+
+  // Emits code to count an evaluation of "node", which produced "value", and
+  // the number of its bits which changed since the previous evaluation.
+  void EmitNodeProfiling(Node* node, llvm::Value* value) {
+    llvm::Type* i64_type = builder_->getInt64Ty();
+    int64* counters = profile_->GetCounters(node);
+    llvm::Value* evaluations_pointer =
+        HostPointer(counters + JitProfile::kEvaluationCounter, i64_type);
+    llvm::Value* evaluations =
+        builder_->CreateLoad(i64_type, evaluations_pointer);
+    builder_->CreateStore(
+        builder_->CreateAdd(evaluations, builder_->getInt64(1)),
+        evaluations_pointer);
+
+    uint8* previous = profile_->GetPreviousValue(node);
+    llvm::Type* value_type = value->getType();
+    if (previous == nullptr || !value_type->isIntegerTy()) {
+      return;
+    }
+    llvm::Value* previous_pointer = HostPointer(previous, value_type);
+    llvm::Value* previous_value = builder_->CreateAlignedLoad(
+        value_type, previous_pointer, llvm::MaybeAlign(8));
+    builder_->CreateAlignedStore(value, previous_pointer, llvm::MaybeAlign(8));
+    llvm::Function* ctpop_fn = llvm::Intrinsic::getDeclaration(
+        module_, llvm::Intrinsic::ctpop, {value_type});
+    llvm::Value* toggles = builder_->CreateZExtOrTrunc(
+        builder_->CreateCall(ctpop_fn,
+                             {builder_->CreateXor(value, previous_value)}),
+        i64_type);
+    // The first evaluation has nothing to compare against.
+    llvm::Value* zero = builder_->getInt64(0);
+    toggles = builder_->CreateSelect(builder_->CreateICmpEQ(evaluations, zero),
+                                     zero, toggles);
+    EmitCounterAdd(
+        HostPointer(counters + JitProfile::kBitToggleCounter, i64_type),
+        toggles);
+  }
+
+  // Emits code to count which arm of "sel" was chosen by "selector".
+  void EmitSelectProfiling(Select* sel, llvm::Value* selector) {
+    // Out-of-range selectors choose the default value, which is the last arm.
+    // Compare at no less than 64 bits, so the case count is representable.
+    int64 arm_count =
+        sel->cases().size() + (sel->default_value().has_value() ? 1 : 0);
+    llvm::Type* compare_type = llvm::IntegerType::get(
+        *context_, std::max(selector->getType()->getIntegerBitWidth(), 64u));
+    llvm::Value* arm = builder_->CreateZExt(selector, compare_type);
+    arm = builder_->CreateSelect(
+        builder_->CreateICmpUGE(
+            arm, llvm::ConstantInt::get(compare_type, sel->cases().size())),
+        llvm::ConstantInt::get(compare_type, arm_count - 1), arm);
+    arm = builder_->CreateTrunc(arm, builder_->getInt64Ty());
+
+    int64* first_arm =
+        profile_->GetCounters(sel) + JitProfile::kFirstSelectArmCounter;
+    llvm::Value* address = builder_->CreateAdd(
+        builder_->getInt64(reinterpret_cast<uint64>(first_arm)),
+        builder_->CreateMul(arm, builder_->getInt64(sizeof(int64))));
+    llvm::Value* counter = builder_->CreateIntToPtr(
+        address, llvm::PointerType::get(builder_->getInt64Ty(),
+                                        /*AddressSpace=*/0));
+    EmitCounterAdd(counter, builder_->getInt64(1));
+  }
+
+  // Emits code to count zero and overlarge shift amounts for "shift", as
+  // InterpreterStats::NoteShllAmountForBitCount() does in the interpreter.
+  void EmitShiftProfiling(BinOp* shift, llvm::Value* amount) {
+    llvm::Type* i64_type = builder_->getInt64Ty();
+    llvm::Type* compare_type = llvm::IntegerType::get(
+        *context_, std::max(amount->getType()->getIntegerBitWidth(), 64u));
+    llvm::Value* wide_amount = builder_->CreateZExt(amount, compare_type);
+    llvm::Value* is_zero = builder_->CreateICmpEQ(
+        wide_amount, llvm::ConstantInt::get(compare_type, 0));
+    llvm::Value* is_overlarge = builder_->CreateICmpUGE(
+        wide_amount,
+        llvm::ConstantInt::get(compare_type, shift->BitCountOrDie()));
+
+    int64* counters = profile_->GetCounters(shift);
+    EmitCounterAdd(
+        HostPointer(counters + JitProfile::kZeroShiftCounter, i64_type),
+        builder_->CreateZExt(is_zero, i64_type));
+    EmitCounterAdd(
+        HostPointer(counters + JitProfile::kOverlargeShiftCounter, i64_type),
+        builder_->CreateZExt(is_overlarge, i64_type));
+  }
+
   absl::Status StoreResult(Node* node, llvm::Value* value) {
     XLS_RET_CHECK(!node_map_.contains(node));
+    if (profile_ != nullptr) {
+      EmitNodeProfiling(node, value);
+    }
     value->setName(verilog::SanitizeIdentifier(node->GetName()));
     if (node->function()->return_value() == node) {
       return_value_ = value;
@@ -1132,6 +1334,12 @@ class BuilderVisitor : public DfsVisitorWithDefault {
   // True if this builder should generate packed parameter loads (as in the
   // header comment for LlvmIrJit::RunWithPackedViews()).
   bool generate_packed_;
+
+  // Counters to update from the generated code, or nullptr if not profiling.
+  JitProfile* profile_;
+
+  // Host state for channel operations.
+  JitChannelContext* channel_context_;
 };
 
 absl::once_flag once;
@@ -1144,10 +1352,15 @@ void OnceInit() {
 }  // namespace
 
 xabsl::StatusOr<std::unique_ptr<LlvmIrJit>> LlvmIrJit::Create(
-    Function* xls_function, int64 opt_level) {
+    Function* xls_function, int64 opt_level, bool enable_profiling) {
   absl::call_once(once, OnceInit);
 
   auto jit = absl::WrapUnique(new LlvmIrJit(xls_function, opt_level));
+  if (enable_profiling) {
+    // Counters must be allocated before compilation, as their addresses are
+    // baked into the generated code.
+    jit->profile_ = std::make_unique<JitProfile>(xls_function);
+  }
   XLS_RETURN_IF_ERROR(jit->Init());
   XLS_RETURN_IF_ERROR(jit->Compile());
   return jit;
@@ -1316,6 +1529,7 @@ absl::Status LlvmIrJit::CompileFunction(llvm::Module* module) {
 
   for (const Type* type : xls_function_type_->parameters()) {
     arg_type_bytes_.push_back(type_converter_->GetTypeByteSize(*type));
+    arg_layouts_.push_back(type_converter_->CreateTypeLayout(*type));
   }
 
   // Pass the last param as a pointer to the actual return type.
@@ -1340,7 +1554,8 @@ absl::Status LlvmIrJit::CompileFunction(llvm::Module* module) {
   llvm::IRBuilder<> builder(basic_block);
   BuilderVisitor visitor(module, &builder, xls_function_->params(),
                          xls_function_, type_converter_.get(),
-                         /*generate_packed=*/false);
+                         /*generate_packed=*/false, profile_.get(),
+                         &channel_context_);
   XLS_RETURN_IF_ERROR(xls_function_->Accept(&visitor));
   llvm::Value* return_value = visitor.return_value();
   if (return_value == nullptr) {
@@ -1350,6 +1565,7 @@ absl::Status LlvmIrJit::CompileFunction(llvm::Module* module) {
 
   // Store the result to the output pointer.
   return_type_bytes_ = type_converter_->GetTypeByteSize(*return_type);
+  return_layout_ = type_converter_->CreateTypeLayout(*return_type);
   if (return_value->getType()->isPointerTy()) {
     llvm::Type* pointee_type = return_value->getType()->getPointerElementType();
     if (pointee_type != llvm_return_type) {
@@ -1374,7 +1590,7 @@ absl::Status LlvmIrJit::CompileFunction(llvm::Module* module) {
   return absl::OkStatus();
 }
 
-xabsl::StatusOr<Value> LlvmIrJit::Run(absl::Span<const Value> args) {
+absl::Status LlvmIrJit::CheckArgs(absl::Span<const Value> args) {
   absl::Span<Param* const> params = xls_function_->params();
   if (args.size() != params.size()) {
     return absl::InvalidArgumentError(
@@ -1389,25 +1605,37 @@ xabsl::StatusOr<Value> LlvmIrJit::Run(absl::Span<const Value> args) {
           args[i].ToString(), i, params[i]->GetType()->ToString()));
     }
   }
+  return absl::OkStatus();
+}
+
+absl::Status LlvmIrJit::CheckChannelQueues() {
+  if (!channel_context_.layouts.empty() && channel_context_.queues == nullptr) {
+    return absl::FailedPreconditionError(absl::StrFormat(
+        "Function %s uses channels, but no channel queues were set.",
+        xls_function_->name()));
+  }
+  return absl::OkStatus();
+}
+
+xabsl::StatusOr<Value> LlvmIrJit::Run(absl::Span<const Value> args) {
+  XLS_RETURN_IF_ERROR(CheckArgs(args));
+  XLS_RETURN_IF_ERROR(CheckChannelQueues());
 
   std::vector<std::unique_ptr<uint8[]>> unique_arg_buffers;
   std::vector<uint8*> arg_buffers;
-  unique_arg_buffers.reserve(xls_function_type_->parameters().size());
-  arg_buffers.reserve(unique_arg_buffers.size());
-  for (const Type* type : xls_function_type_->parameters()) {
+  unique_arg_buffers.reserve(arg_layouts_.size());
+  arg_buffers.reserve(arg_layouts_.size());
+  for (int64 i = 0; i < arg_layouts_.size(); ++i) {
     unique_arg_buffers.push_back(
-        std::make_unique<uint8[]>(type_converter_->GetTypeByteSize(*type)));
+        std::make_unique<uint8[]>(arg_layouts_[i].size()));
     arg_buffers.push_back(unique_arg_buffers.back().get());
+    arg_layouts_[i].ValueToNativeLayout(args[i], arg_buffers.back());
   }
 
-  XLS_RETURN_IF_ERROR(ir_runtime_->PackArgs(
-      args, xls_function_type_->parameters(), absl::MakeSpan(arg_buffers)));
-
   absl::InlinedVector<uint8, 16> outputs(return_type_bytes_);
   invoker_(arg_buffers.data(), outputs.data());
 
-  return ir_runtime_->UnpackBuffer(outputs.data(),
-                                   xls_function_type_->return_type());
+  return return_layout_->NativeLayoutToValue(outputs.data());
 }
 
 xabsl::StatusOr<Value> LlvmIrJit::Run(
@@ -1417,6 +1645,35 @@ xabsl::StatusOr<Value> LlvmIrJit::Run(
   return Run(positional_args);
 }
 
+xabsl::StatusOr<std::vector<Value>> LlvmIrJit::RunBatched(
+    absl::Span<const std::vector<Value>> arg_sets) {
+  XLS_RETURN_IF_ERROR(CheckChannelQueues());
+  std::vector<std::unique_ptr<uint8[]>> unique_arg_buffers;
+  std::vector<uint8*> arg_buffers;
+  unique_arg_buffers.reserve(arg_layouts_.size());
+  arg_buffers.reserve(arg_layouts_.size());
+  for (const LlvmTypeLayout& layout : arg_layouts_) {
+    unique_arg_buffers.push_back(std::make_unique<uint8[]>(layout.size()));
+    arg_buffers.push_back(unique_arg_buffers.back().get());
+  }
+
+  // Results are written side by side and unpacked together at the end.
+  std::vector<uint8> outputs(return_type_bytes_ * arg_sets.size());
+  for (int64 i = 0; i < arg_sets.size(); ++i) {
+    absl::Span<const Value> args = arg_sets[i];
+    XLS_RETURN_IF_ERROR(CheckArgs(args));
+    for (int64 j = 0; j < args.size(); ++j) {
+      arg_layouts_[j].ValueToNativeLayout(args[j], arg_buffers[j]);
+    }
+    invoker_(arg_buffers.data(), outputs.data() + i * return_type_bytes_);
+  }
+
+  std::vector<Value> results(arg_sets.size());
+  XLS_RETURN_IF_ERROR(return_layout_->NativeLayoutToValues(
+      outputs.data(), return_type_bytes_, absl::MakeSpan(results)));
+  return results;
+}
+
 absl::Status LlvmIrJit::RunWithViews(absl::Span<const uint8*> args,
                                      absl::Span<uint8> result_buffer) {
   absl::Span<Param* const> params = xls_function_->params();
@@ -1432,6 +1689,7 @@ absl::Status LlvmIrJit::RunWithViews(absl::Span<const uint8*> args,
                      return_type_bytes_));
   }
 
+  XLS_RETURN_IF_ERROR(CheckChannelQueues());
   invoker_(args.data(), result_buffer.data());
   return absl::OkStatus();
 }
@@ -1503,7 +1761,8 @@ absl::Status LlvmIrJit::CompilePackedViewFunction(llvm::Module* module) {
   llvm::IRBuilder<> builder(basic_block);
   BuilderVisitor visitor(module, &builder, xls_function_->params(),
                          xls_function_, type_converter_.get(),
-                         /*generate_packed=*/true);
+                         /*generate_packed=*/true, profile_.get(),
+                         &channel_context_);
   XLS_RETURN_IF_ERROR(xls_function_->Accept(&visitor));
   llvm::Value* return_value = visitor.return_value();
   if (return_value == nullptr) {
@@ -1567,6 +1826,9 @@ xabsl::StatusOr<llvm::Value*> LlvmIrJit::PackElement(llvm::IRBuilder<>& builder,
       }
       return buffer;
     }
+    case TypeKind::kToken:
+      // Tokens carry no data.
+      return buffer;
     default:
       return absl::InvalidArgumentError(absl::StrCat(
           "Unhandled element kind: ", TypeKindToString(element_type->kind())));
@@ -15,7 +15,10 @@
 #ifndef XLS_IR_LLVM_IR_JIT_H_
 #define XLS_IR_LLVM_IR_JIT_H_
 
+#include <deque>
+
 #include "absl/status/status.h"
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
@@ -28,23 +31,39 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Target/TargetMachine.h"
 #include "xls/common/status/status_macros.h"
+#include "xls/ir/channel_queue.h"
 #include "xls/ir/function.h"
+#include "xls/ir/llvm_ir_jit_profile.h"
 #include "xls/ir/llvm_ir_runtime.h"
 #include "xls/ir/llvm_type_converter.h"
+#include "xls/ir/llvm_type_layout.h"
 #include "xls/ir/package.h"
 #include "xls/ir/value.h"
 #include "xls/ir/value_view.h"
 
 namespace xls {
 
+// Host-side state shared with the channel operations in JIT-compiled code.
+struct JitChannelContext {
+  // Queues on which the channel operations act; see
+  // LlvmIrJit::SetChannelQueues().
+  ChannelQueueManager* queues = nullptr;
+
+  // Layouts of the data exchanged by each compiled channel operation. The
+  // generated code refers to these by address, so they must not move.
+  std::deque<LlvmTypeLayout> layouts;
+};
+
 // This class provides a facility to execute XLS functions (on the host) by
 // converting it to LLVM IR, compiling it, and finally executing it.
 class LlvmIrJit {
  public:
   // Returns an object containing a host-compiled version of the specified XLS
-  // function.
+  // function. If "enable_profiling" is true, the compiled code additionally
+  // maintains per-node counters, available via profile().
   static xabsl::StatusOr<std::unique_ptr<LlvmIrJit>> Create(
-      Function* xls_function, int64 opt_level = 3);
+      Function* xls_function, int64 opt_level = 3,
+      bool enable_profiling = false);
 
   // Executes the compiled function with the specified arguments.
   xabsl::StatusOr<Value> Run(absl::Span<const Value> args);
@@ -53,6 +72,14 @@ class LlvmIrJit {
   xabsl::StatusOr<Value> Run(
       const absl::flat_hash_map<std::string, Value>& kwargs);
 
+  // Executes the compiled function once for each set of arguments, returning
+  // the results in the same order. Argument and result buffers are allocated
+  // once for the whole batch, and results are unpacked as a single column, so
+  // this is considerably cheaper than repeated calls to Run() when evaluating
+  // many inputs (e.g., when comparing against the interpreter).
+  xabsl::StatusOr<std::vector<Value>> RunBatched(
+      absl::Span<const std::vector<Value>> arg_sets);
+
   // Executes the compiled function with the arguments and results specified as
   // "views" - flat buffers onto which structures layouts can be applied (see
   // value_view.h).
@@ -96,6 +123,23 @@ class LlvmIrJit {
   // Returns the function that the JIT executes.
   Function* function() { return xls_function_; }
 
+  // Sets the queues on which channel sends and receives in the function act.
+  // Must be called before running a function containing channel operations.
+  // As in the interpreter, a receive from an empty queue or a send to a full
+  // one is a fatal error, so callers must check for messages/space first; see
+  // ProcRuntime.
+  void SetChannelQueues(ChannelQueueManager* queues) {
+    channel_context_.queues = queues;
+  }
+
+  // Returns the counters accumulated by all executions so far, or nullptr if
+  // profiling was not enabled at creation.
+  JitProfile* profile() { return profile_.get(); }
+
+  // Returns the converter describing the native (LLVM) representation of the
+  // function's types, e.g., to compute offsets within view buffers.
+  LlvmTypeConverter* type_converter() { return type_converter_.get(); }
+
   // Gets the size of the compiled function's args or return type in bytes.
   // These values only correspond to view buffers, and not *PACKED* view
   // buffers.
@@ -108,6 +152,12 @@ class LlvmIrJit {
   // Performs non-trivial initialization (i.e., that which can fail).
   absl::Status Init();
 
+  // Returns an error if "args" do not match the function's parameters.
+  absl::Status CheckArgs(absl::Span<const Value> args);
+
+  // Returns an error if the function uses channels, but no queues were set.
+  absl::Status CheckChannelQueues();
+
   // Drives regular and packed function compilation.
   absl::Status Compile();
 
@@ -171,12 +221,23 @@ class LlvmIrJit {
   std::vector<int64> arg_type_bytes_;
   int64 return_type_bytes_;
 
+  // Precomputed plans for packing arguments into (and unpacking the result out
+  // of) LLVM-space buffers.
+  std::vector<LlvmTypeLayout> arg_layouts_;
+  absl::optional<LlvmTypeLayout> return_layout_;
+
   // Cache for XLS type => LLVM type conversions.
   absl::flat_hash_map<const Type*, llvm::Type*> xls_to_llvm_type_;
 
   std::unique_ptr<LlvmTypeConverter> type_converter_;
   std::unique_ptr<LlvmIrRuntime> ir_runtime_;
 
+  // Profiling counters updated by the compiled code; null if not profiling.
+  std::unique_ptr<JitProfile> profile_;
+
+  // State used by compiled channel operations.
+  JitChannelContext channel_context_;
+
   // When initialized, this points to the compiled output.
   using JitFunctionType = void (*)(const uint8* const* inputs, uint8* output);
   JitFunctionType invoker_;
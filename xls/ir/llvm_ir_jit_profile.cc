@@ -0,0 +1,204 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/llvm_ir_jit_profile.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/math_util.h"
+#include "xls/ir/nodes.h"
+
+namespace xls {
+namespace {
+
+bool IsShift(Node* node) {
+  return node->op() == Op::kShll || node->op() == Op::kShrl ||
+         node->op() == Op::kShra;
+}
+
+}  // namespace
+
+JitProfile::JitProfile(Function* function) {
+  AllocateFunction(function);
+  Reset();
+}
+
+void JitProfile::AllocateFunction(Function* function) {
+  if (std::find(functions_.begin(), functions_.end(), function) !=
+      functions_.end()) {
+    return;
+  }
+  functions_.push_back(function);
+
+  int64 counter_count = 0;
+  int64 previous_value_count = 0;
+  for (Node* node : function->nodes()) {
+    NodeCounters entry;
+    entry.counter_offset = counter_count;
+    entry.counter_count = kBitToggleCounter + 1;
+    if (IsShift(node)) {
+      entry.counter_count = kOverlargeShiftCounter + 1;
+    } else if (node->Is<Select>()) {
+      Select* sel = node->As<Select>();
+      entry.counter_count = kFirstSelectArmCounter + sel->cases().size() +
+                            (sel->default_value().has_value() ? 1 : 0);
+    }
+    entry.previous_value_offset = -1;
+    if (node->GetType()->IsBits()) {
+      // Zero-width values are represented as i1 in LLVM space.
+      int64 bit_count = std::max(node->BitCountOrDie(), int64{1});
+      entry.previous_value_offset = previous_value_count;
+      previous_value_count += CeilOfRatio(bit_count, int64{64});
+    }
+    counter_count += entry.counter_count;
+    node_counters_[node] = entry;
+
+    if (node->Is<Invoke>()) {
+      AllocateFunction(node->As<Invoke>()->to_apply());
+    } else if (node->Is<Map>()) {
+      AllocateFunction(node->As<Map>()->to_apply());
+    } else if (node->Is<CountedFor>()) {
+      AllocateFunction(node->As<CountedFor>()->body());
+    }
+  }
+
+  // Offsets above are relative to this function; place its storage after that
+  // of the functions it calls, which were allocated during the loop.
+  for (Node* node : function->nodes()) {
+    NodeCounters& entry = node_counters_.at(node);
+    entry.counter_offset += counters_.size();
+    if (entry.previous_value_offset != -1) {
+      entry.previous_value_offset += previous_values_.size();
+    }
+  }
+  counters_.resize(counters_.size() + counter_count);
+  previous_values_.resize(previous_values_.size() + previous_value_count);
+}
+
+int64* JitProfile::GetCounters(Node* node) {
+  return &counters_[node_counters_.at(node).counter_offset];
+}
+
+uint8* JitProfile::GetPreviousValue(Node* node) {
+  const NodeCounters& entry = node_counters_.at(node);
+  if (entry.previous_value_offset == -1) {
+    return nullptr;
+  }
+  return reinterpret_cast<uint8*>(
+      &previous_values_[entry.previous_value_offset]);
+}
+
+JitProfile::NodeProfile JitProfile::GetNodeProfile(Node* node) const {
+  const NodeCounters& entry = node_counters_.at(node);
+  const int64* counters = &counters_[entry.counter_offset];
+  NodeProfile profile;
+  profile.evaluation_count = counters[kEvaluationCounter];
+  profile.bit_toggle_count = counters[kBitToggleCounter];
+  if (IsShift(node)) {
+    profile.zero_shift_count = counters[kZeroShiftCounter];
+    profile.overlarge_shift_count = counters[kOverlargeShiftCounter];
+  } else if (node->Is<Select>()) {
+    profile.select_arm_counts.assign(counters + kFirstSelectArmCounter,
+                                     counters + entry.counter_count);
+  }
+  return profile;
+}
+
+void JitProfile::Reset() {
+  std::fill(counters_.begin(), counters_.end(), 0);
+  std::fill(previous_values_.begin(), previous_values_.end(), 0);
+}
+
+std::string JitProfile::ToReport() const {
+  std::string result = "JIT profile report:\n";
+
+  // Shift totals per op. The shll section uses the same definitions and format
+  // as InterpreterStats::ToReport(), which only counts shll; shrl and shra are
+  // reported in sections of their own.
+  auto percent = [](int64 value, int64 all) -> double {
+    if (all == 0) {
+      return 100.0;
+    }
+    return static_cast<double>(value) / all * 100.0;
+  };
+  for (Op op : {Op::kShll, Op::kShrl, Op::kShra}) {
+    int64 all = 0;
+    int64 zero = 0;
+    int64 overlarge = 0;
+    for (Function* function : functions_) {
+      for (Node* node : function->nodes()) {
+        if (node->op() != op) {
+          continue;
+        }
+        NodeProfile profile = GetNodeProfile(node);
+        all += profile.evaluation_count;
+        zero += profile.zero_shift_count;
+        overlarge += profile.overlarge_shift_count;
+      }
+    }
+    if (op != Op::kShll && all == 0) {
+      continue;
+    }
+    int64 in_range = all - zero - overlarge;
+    absl::StrAppendFormat(&result,
+                          R"(%-11s %d
+ zero:      %d (%.2f%%)
+ overlarge: %d (%.2f%%)
+ in-range:  %d (%.2f%%)
+)",
+                          absl::StrCat(OpToString(op), ":"), all, zero,
+                          percent(zero, all), overlarge,
+                          percent(overlarge, all), in_range,
+                          percent(in_range, all));
+  }
+
+  for (Function* function : functions_) {
+    std::vector<std::pair<Node*, NodeProfile>> profiles;
+    for (Node* node : function->nodes()) {
+      profiles.push_back({node, GetNodeProfile(node)});
+    }
+    std::stable_sort(profiles.begin(), profiles.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.second.evaluation_count >
+                              b.second.evaluation_count;
+                     });
+
+    absl::StrAppendFormat(&result, "%s:\n", function->name());
+    for (const auto& [node, profile] : profiles) {
+      absl::StrAppendFormat(&result, " %s: evaluations: %d", node->GetName(),
+                            profile.evaluation_count);
+      if (node->GetType()->IsBits()) {
+        absl::StrAppendFormat(&result, ", bit toggles: %d",
+                              profile.bit_toggle_count);
+      }
+      if (IsShift(node)) {
+        absl::StrAppendFormat(
+            &result, ", zero shifts: %d, overlarge shifts: %d",
+            profile.zero_shift_count, profile.overlarge_shift_count);
+      }
+      if (node->Is<Select>()) {
+        absl::StrAppendFormat(&result, ", arms: [%s]",
+                              absl::StrJoin(profile.select_arm_counts, ", "));
+      }
+      absl::StrAppend(&result, "\n");
+    }
+  }
+  return result;
+}
+
+}  // namespace xls
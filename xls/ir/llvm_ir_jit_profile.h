@@ -0,0 +1,114 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_IR_LLVM_IR_JIT_PROFILE_H_
+#define XLS_IR_LLVM_IR_JIT_PROFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "xls/common/integral_types.h"
+#include "xls/ir/function.h"
+#include "xls/ir/node.h"
+
+namespace xls {
+
+// Counters accumulated by JIT-compiled code when profiling is enabled (see
+// LlvmIrJit::Create()); this is the JIT analogue of InterpreterStats.
+//
+// All counters for a function (and every function it transitively invokes)
+// are allocated up front in a single flat buffer, and the generated code
+// updates them in place via absolute addresses, so the buffer must outlive the
+// compiled code and is never resized. Counter updates are not atomic: results
+// are only meaningful if the profiled function is run from one thread at a
+// time.
+class JitProfile {
+ public:
+  // Counter indices (relative to a node's first counter) common to all nodes.
+  static constexpr int64 kEvaluationCounter = 0;
+  static constexpr int64 kBitToggleCounter = 1;
+
+  // For shift nodes.
+  static constexpr int64 kZeroShiftCounter = 2;
+  static constexpr int64 kOverlargeShiftCounter = 3;
+
+  // For select nodes: index of the counter for the first case; the default
+  // value, if any, follows the last case.
+  static constexpr int64 kFirstSelectArmCounter = 2;
+
+  // Profile data for a single node, as read back out of the counters buffer.
+  struct NodeProfile {
+    // Number of times the node was evaluated.
+    int64 evaluation_count = 0;
+
+    // Number of result bits which changed value between consecutive
+    // evaluations, summed over all evaluations. Only collected for bits-typed
+    // nodes.
+    int64 bit_toggle_count = 0;
+
+    // For selects, the number of times each case was chosen, with the default
+    // value (if present) last.
+    std::vector<int64> select_arm_counts;
+
+    // For shifts, the number of evaluations in which the shift amount was zero
+    // or at least the width of the shifted value, respectively.
+    int64 zero_shift_count = 0;
+    int64 overlarge_shift_count = 0;
+  };
+
+  // Allocates counters for all nodes in "function" and every function it
+  // calls (via invoke, map or counted_for).
+  explicit JitProfile(Function* function);
+
+  // Returns the address of the first counter for the given node; individual
+  // counters are at the indices given by the constants above.
+  int64* GetCounters(Node* node);
+
+  // Returns the address of the storage holding the last-seen value of the
+  // given node, used to compute toggle counts, or nullptr if no such storage
+  // was allocated (i.e., the node is not bits-typed). The storage is 8-byte
+  // aligned and large enough to hold the node's LLVM representation.
+  uint8* GetPreviousValue(Node* node);
+
+  // Returns the profile of the given node, which must be in one of the
+  // profiled functions.
+  NodeProfile GetNodeProfile(Node* node) const;
+
+  // Zeroes all counters, e.g., between profiling runs.
+  void Reset();
+
+  // Returns a multi-line report string suitable for, e.g. XLS_LOG_LINES'ing.
+  // Nodes are listed per function, most frequently evaluated first.
+  std::string ToReport() const;
+
+ private:
+  struct NodeCounters {
+    int64 counter_offset;
+    int64 counter_count;
+    // Offset into previous_values_ (in 8-byte words), or -1 if none.
+    int64 previous_value_offset;
+  };
+
+  void AllocateFunction(Function* function);
+
+  std::vector<Function*> functions_;
+  absl::flat_hash_map<Node*, NodeCounters> node_counters_;
+  std::vector<int64> counters_;
+  std::vector<uint64> previous_values_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_IR_LLVM_IR_JIT_PROFILE_H_
@@ -30,6 +30,8 @@ namespace xls {
 namespace {
 
 using status_testing::IsOkAndHolds;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 
 INSTANTIATE_TEST_SUITE_P(
     LlvmIrJitTest, IrEvaluatorTest,
@@ -63,6 +65,100 @@ TEST(LlvmIrJitTest, ReuseTest) {
   EXPECT_THAT(jit->Run({Value(UBits(7, 8))}), IsOkAndHolds(Value(UBits(7, 8))));
 }
 
+// Verifies that batched execution matches one-at-a-time execution, including
+// for aggregate-typed arguments and results.
+TEST(LlvmIrJitTest, RunBatched) {
+  Package package("my_package");
+  std::string ir_text = R"(
+  fn f(x: (bits[3], bits[65])[2], y: bits[1]) -> (bits[65], bits[3], bits[1]) {
+    elem: (bits[3], bits[65]) = array_index(x, y)
+    a: bits[3] = tuple_index(elem, index=0)
+    b: bits[65] = tuple_index(elem, index=1)
+    ret result: (bits[65], bits[3], bits[1]) = tuple(b, a, y)
+  }
+  )";
+  XLS_ASSERT_OK_AND_ASSIGN(Function * function,
+                           Parser::ParseFunction(ir_text, &package));
+  XLS_ASSERT_OK_AND_ASSIGN(auto jit, LlvmIrJit::Create(function));
+
+  std::minstd_rand rng_engine;
+  std::vector<std::vector<Value>> arg_sets;
+  for (int64 i = 0; i < 64; ++i) {
+    arg_sets.push_back(RandomFunctionArguments(function, &rng_engine));
+  }
+  XLS_ASSERT_OK_AND_ASSIGN(std::vector<Value> results,
+                           jit->RunBatched(arg_sets));
+  ASSERT_EQ(results.size(), arg_sets.size());
+  for (int64 i = 0; i < arg_sets.size(); ++i) {
+    EXPECT_THAT(jit->Run(arg_sets[i]), IsOkAndHolds(results[i]));
+  }
+
+  EXPECT_THAT(jit->RunBatched({{Value(UBits(0, 1))}}),
+              status_testing::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlvmIrJitTest, Profiling) {
+  std::string ir_text = R"(
+  package my_package
+
+  fn twice(a: bits[8]) -> bits[8] {
+    ret add.1: bits[8] = add(a, a)
+  }
+
+  fn main(x: bits[8], s: bits[2], amt: bits[4], arr: bits[8][3]) -> (bits[8], bits[8], bits[8][3]) {
+    literal.2: bits[8] = literal(value=42)
+    sel.3: bits[8] = sel(s, cases=[x, literal.2], default=x)
+    shll.4: bits[8] = shll(x, amt)
+    map.5: bits[8][3] = map(arr, to_apply=twice)
+    ret tuple.6: (bits[8], bits[8], bits[8][3]) = tuple(sel.3, shll.4, map.5)
+  }
+  )";
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> package,
+                           Parser::ParsePackage(ir_text));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main, package->GetFunction("main"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * twice, package->GetFunction("twice"));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto jit,
+      LlvmIrJit::Create(main, /*opt_level=*/3, /*enable_profiling=*/true));
+  ASSERT_NE(jit->profile(), nullptr);
+
+  Value arr = Value::ArrayOrDie(
+      {Value(UBits(1, 8)), Value(UBits(2, 8)), Value(UBits(3, 8))});
+  for (int64 s : {0, 1, 2, 3, 1}) {
+    for (int64 amt : {0, 3, 8}) {
+      XLS_ASSERT_OK(jit->Run({Value(UBits(0xff, 8)), Value(UBits(s, 2)),
+                              Value(UBits(amt, 4)), arr})
+                        .status());
+    }
+  }
+
+  XLS_ASSERT_OK_AND_ASSIGN(Node * sel, main->GetNode("sel.3"));
+  JitProfile::NodeProfile sel_profile = jit->profile()->GetNodeProfile(sel);
+  EXPECT_EQ(sel_profile.evaluation_count, 15);
+  EXPECT_THAT(sel_profile.select_arm_counts, ElementsAre(3, 6, 6));
+  // The result switches between 0xff and 42 (five bits differ) whenever the
+  // selector moves on or off of case 1, which happens three times.
+  EXPECT_EQ(sel_profile.bit_toggle_count, 3 * 5);
+
+  XLS_ASSERT_OK_AND_ASSIGN(Node * shll, main->GetNode("shll.4"));
+  JitProfile::NodeProfile shll_profile = jit->profile()->GetNodeProfile(shll);
+  EXPECT_EQ(shll_profile.evaluation_count, 15);
+  EXPECT_EQ(shll_profile.zero_shift_count, 5);
+  EXPECT_EQ(shll_profile.overlarge_shift_count, 5);
+
+  // The mapped function is evaluated once per array element.
+  EXPECT_EQ(
+      jit->profile()->GetNodeProfile(twice->return_value()).evaluation_count,
+      45);
+  EXPECT_THAT(jit->profile()->ToReport(),
+              HasSubstr("sel.3: evaluations: 15"));
+  EXPECT_THAT(jit->profile()->ToReport(),
+              HasSubstr("shll:       15\n zero:      5 (33.33%)"));
+
+  jit->profile()->Reset();
+  EXPECT_EQ(jit->profile()->GetNodeProfile(sel).evaluation_count, 0);
+}
+
 // Verifies that the QuickCheck mechanism can find counter-examples for a simple
 // erroneous function.
 //
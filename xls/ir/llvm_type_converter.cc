@@ -129,4 +129,64 @@ int64 LlvmTypeConverter::GetTypeByteSize(const Type& type) {
   return data_layout_.getTypeAllocSize(ConvertToLlvmType(type)).getFixedSize();
 }
 
+int64 LlvmTypeConverter::GetTupleElementByteOffset(const TupleType& type,
+                                                   int64 index) {
+  const llvm::StructLayout* layout = data_layout_.getStructLayout(
+      llvm::cast<llvm::StructType>(ConvertToLlvmType(type)));
+  return layout->getElementOffset(index);
+}
+
+LlvmTypeLayout LlvmTypeConverter::CreateTypeLayout(const Type& type) {
+  std::vector<LlvmTypeLayout::ElementLayout> elements;
+  std::vector<LlvmTypeLayout::Step> steps;
+  AppendTypeLayout(type, /*offset=*/0, &elements, &steps);
+  return LlvmTypeLayout(&type, GetTypeByteSize(type),
+                        data_layout_.isBigEndian(), std::move(elements),
+                        std::move(steps));
+}
+
+void LlvmTypeConverter::AppendTypeLayout(
+    const Type& type, int64 offset,
+    std::vector<LlvmTypeLayout::ElementLayout>* elements,
+    std::vector<LlvmTypeLayout::Step>* steps) {
+  switch (type.kind()) {
+    case TypeKind::kBits: {
+      int64 store_size =
+          data_layout_.getTypeStoreSize(ConvertToLlvmType(type)).getFixedSize();
+      elements->push_back(
+          {offset, type.AsBitsOrDie()->bit_count(), store_size});
+      steps->push_back({TypeKind::kBits, /*size=*/0});
+      return;
+    }
+    case TypeKind::kTuple: {
+      // As with the LLVM IR itself, tuples are structs, so the DataLayout
+      // tells us where each element lives.
+      const TupleType* tuple_type = type.AsTupleOrDie();
+      const llvm::StructLayout* layout = data_layout_.getStructLayout(
+          llvm::cast<llvm::StructType>(ConvertToLlvmType(type)));
+      for (int64 i = 0; i < tuple_type->size(); ++i) {
+        AppendTypeLayout(*tuple_type->element_type(i),
+                         offset + layout->getElementOffset(i), elements,
+                         steps);
+      }
+      steps->push_back({TypeKind::kTuple, tuple_type->size()});
+      return;
+    }
+    case TypeKind::kArray: {
+      const ArrayType* array_type = type.AsArrayOrDie();
+      int64 element_size = GetTypeByteSize(*array_type->element_type());
+      for (int64 i = 0; i < array_type->size(); ++i) {
+        AppendTypeLayout(*array_type->element_type(), offset + i * element_size,
+                         elements, steps);
+      }
+      steps->push_back({TypeKind::kArray, array_type->size()});
+      return;
+    }
+    case TypeKind::kToken:
+      // Tokens contain no data.
+      steps->push_back({TypeKind::kToken, /*size=*/0});
+      return;
+  }
+}
+
 }  // namespace xls
@@ -23,6 +23,7 @@
 #include "xls/common/integral_types.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/ir/llvm_type_layout.h"
 #include "xls/ir/type.h"
 #include "xls/ir/value.h"
 
@@ -53,6 +54,15 @@ class LlvmTypeConverter {
   // DataLayout object can handle ~all of the work for us.
   int64 GetTypeByteSize(const Type& type);
 
+  // Returns the byte offset of element "index" within the LLVM representation
+  // of the given tuple type.
+  int64 GetTupleElementByteOffset(const TupleType& type, int64 index);
+
+  // Returns a precomputed plan for converting Values of the given type into
+  // and out of the memory layout LLVM uses for it. "type" must outlive the
+  // returned object.
+  LlvmTypeLayout CreateTypeLayout(const Type& type);
+
  private:
   using TypeCache = absl::flat_hash_map<const Type*, llvm::Type*>;
 
@@ -60,6 +70,12 @@ class LlvmTypeConverter {
   xabsl::StatusOr<llvm::Constant*> ToIntegralConstant(llvm::Type* type,
                                                       const Value& value);
 
+  // Appends the leaf elements and reconstruction steps for "type", located at
+  // the given byte offset, to the layout under construction.
+  void AppendTypeLayout(const Type& type, int64 offset,
+                        std::vector<LlvmTypeLayout::ElementLayout>* elements,
+                        std::vector<LlvmTypeLayout::Step>* steps);
+
   llvm::LLVMContext& context_;
   llvm::DataLayout data_layout_;
 
@@ -0,0 +1,111 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/llvm_type_layout.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/math_util.h"
+#include "xls/common/status/status_macros.h"
+
+namespace xls {
+
+void LlvmTypeLayout::ValueToNativeLayout(const Value& value,
+                                         uint8* buffer) const {
+  // Walk the value depth-first with an explicit stack; leaves are visited in
+  // the same order as the precomputed element layouts.
+  absl::InlinedVector<const Value*, 16> stack = {&value};
+  int64 leaf_index = 0;
+  while (!stack.empty()) {
+    const Value* current = stack.back();
+    stack.pop_back();
+    if (current->IsBits()) {
+      XLS_DCHECK_LT(leaf_index, elements_.size());
+      const ElementLayout& element = elements_[leaf_index++];
+      const Bits& bits = current->bits();
+      XLS_DCHECK_EQ(bits.bit_count(), element.bit_count);
+      int64 byte_count = CeilOfRatio(element.bit_count, int64{8});
+      uint8* leaf_buffer = buffer + element.offset;
+      bits.ToBytes(absl::MakeSpan(leaf_buffer, byte_count), big_endian_);
+      if (element.store_size > byte_count) {
+        // Zero-width leaves still occupy storage (as i1); keep it cleared.
+        memset(leaf_buffer + byte_count, 0, element.store_size - byte_count);
+      }
+      continue;
+    }
+    // Tuples, arrays and tokens; tokens have no elements and no storage.
+    absl::Span<const Value> elements = current->elements();
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+      stack.push_back(&*it);
+    }
+  }
+  XLS_DCHECK_EQ(leaf_index, elements_.size());
+}
+
+xabsl::StatusOr<Value> LlvmTypeLayout::NativeLayoutToValue(
+    const uint8* buffer) const {
+  std::vector<Value> stack;
+  stack.reserve(steps_.size());
+  int64 leaf_index = 0;
+  for (const Step& step : steps_) {
+    switch (step.kind) {
+      case TypeKind::kBits: {
+        const ElementLayout& element = elements_[leaf_index++];
+        int64 byte_count = CeilOfRatio(element.bit_count, int64{8});
+        stack.push_back(Value(Bits::FromBytes(
+            absl::MakeConstSpan(buffer + element.offset, byte_count),
+            element.bit_count, big_endian_)));
+        break;
+      }
+      case TypeKind::kTuple:
+      case TypeKind::kArray: {
+        XLS_DCHECK_GE(stack.size(), step.size);
+        if (step.kind == TypeKind::kArray && step.size == 0) {
+          return absl::UnimplementedError(absl::StrFormat(
+              "Cannot unpack a value of type %s: empty array Values are not "
+              "supported.",
+              type_->ToString()));
+        }
+        auto first = stack.end() - step.size;
+        std::vector<Value> elements(std::make_move_iterator(first),
+                                    std::make_move_iterator(stack.end()));
+        stack.erase(first, stack.end());
+        stack.push_back(step.kind == TypeKind::kTuple
+                            ? Value::TupleOwned(std::move(elements))
+                            : Value::ArrayOwned(std::move(elements)));
+        break;
+      }
+      case TypeKind::kToken:
+        stack.push_back(Value::Token());
+        break;
+    }
+  }
+  XLS_DCHECK_EQ(stack.size(), 1);
+  return std::move(stack.back());
+}
+
+absl::Status LlvmTypeLayout::NativeLayoutToValues(
+    const uint8* buffer, int64 stride, absl::Span<Value> values) const {
+  XLS_DCHECK_GE(stride, size_);
+  for (int64 i = 0; i < values.size(); ++i) {
+    XLS_ASSIGN_OR_RETURN(values[i], NativeLayoutToValue(buffer + i * stride));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace xls
@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_IR_LLVM_TYPE_LAYOUT_H_
+#define XLS_IR_LLVM_TYPE_LAYOUT_H_
+
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/type.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+
+// Precomputed description of how a value of a particular XLS type is laid out
+// in the native (LLVM) memory representation used by the JIT.
+//
+// Converting between xls::Values and JIT buffers by walking the Type tree is
+// expensive: every element requires LLVM type conversion and DataLayout
+// queries. A layout resolves all of that once, up front, into a flat list of
+// leaf copy operations (byte offset plus bit width) and a post-order list of
+// aggregate constructions, so packing and unpacking become single loops.
+//
+// Layouts are created by LlvmTypeConverter::CreateTypeLayout().
+class LlvmTypeLayout {
+ public:
+  // Placement of a single Bits leaf within the native buffer.
+  struct ElementLayout {
+    // Offset of the leaf from the start of the buffer, in bytes.
+    int64 offset;
+
+    // Width of the leaf in bits.
+    int64 bit_count;
+
+    // Number of bytes LLVM loads/stores for the leaf; always at least
+    // ceil(bit_count / 8), and at least one (zero-width values are held as i1).
+    int64 store_size;
+  };
+
+  // One step in the post-order reconstruction of a Value: either consumes the
+  // next leaf (kBits), or builds an aggregate out of the most recently
+  // produced "size" values.
+  struct Step {
+    TypeKind kind;
+    int64 size;
+  };
+
+  LlvmTypeLayout(const Type* type, int64 size, bool big_endian,
+                 std::vector<ElementLayout> elements, std::vector<Step> steps)
+      : type_(type),
+        size_(size),
+        big_endian_(big_endian),
+        elements_(std::move(elements)),
+        steps_(std::move(steps)) {}
+
+  // Writes "value" into "buffer" in native layout. "buffer" must hold at least
+  // size() bytes, and "value" must conform to type().
+  void ValueToNativeLayout(const Value& value, uint8* buffer) const;
+
+  // Returns a Value read out of "buffer", which must be in native layout.
+  // Returns an error if the type contains a zero-element array, which cannot
+  // be represented as a Value.
+  xabsl::StatusOr<Value> NativeLayoutToValue(const uint8* buffer) const;
+
+  // Batch variant of the above: reads values.size() values out of "buffer",
+  // where value i begins at byte offset i * stride. "stride" must be at least
+  // size().
+  absl::Status NativeLayoutToValues(const uint8* buffer, int64 stride,
+                                    absl::Span<Value> values) const;
+
+  const Type* type() const { return type_; }
+
+  // Size of the type's native representation in bytes.
+  int64 size() const { return size_; }
+
+  // The leaf elements, in the same order as a depth-first walk of the type.
+  absl::Span<const ElementLayout> elements() const { return elements_; }
+
+ private:
+  const Type* type_;
+  int64 size_;
+  bool big_endian_;
+  std::vector<ElementLayout> elements_;
+  std::vector<Step> steps_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_IR_LLVM_TYPE_LAYOUT_H_
@@ -0,0 +1,158 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/llvm_type_layout.h"
+
+#include <algorithm>
+#include <random>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/llvm_ir_runtime.h"
+#include "xls/ir/llvm_type_converter.h"
+#include "xls/ir/package.h"
+#include "xls/ir/value_helpers.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+using status_testing::StatusIs;
+using ::testing::HasSubstr;
+
+// Data layout for x86-64 Linux.
+constexpr const char kDataLayout[] = "e-m:e-i64:64-f80:128-n8:16:32:64-S128";
+
+class LlvmTypeLayoutTest : public ::testing::Test {
+ protected:
+  LlvmTypeLayoutTest()
+      : package_("test_package"),
+        data_layout_(kDataLayout),
+        type_converter_(&context_, data_layout_),
+        runtime_(data_layout_, &type_converter_) {}
+
+  Type* ParseType(absl::string_view text) {
+    return Parser::ParseType(text, &package_).value();
+  }
+
+  // Checks that the layout produces exactly the same buffer contents as the
+  // (recursive) runtime routines, and that values survive a round trip.
+  void ExpectRoundTrip(const Type* type, const Value& value) {
+    LlvmTypeLayout layout = type_converter_.CreateTypeLayout(*type);
+    ASSERT_EQ(layout.size(), type_converter_.GetTypeByteSize(*type));
+
+    std::vector<uint8> expected(layout.size(), 0);
+    runtime_.BlitValueToBuffer(value, *type, absl::MakeSpan(expected));
+    std::vector<uint8> actual(layout.size(), 0);
+    layout.ValueToNativeLayout(value, actual.data());
+    EXPECT_EQ(actual, expected) << value.ToString();
+
+    EXPECT_THAT(layout.NativeLayoutToValue(actual.data()), IsOkAndHolds(value));
+    EXPECT_EQ(runtime_.UnpackBuffer(actual.data(), type), value);
+  }
+
+  Package package_;
+  llvm::LLVMContext context_;
+  llvm::DataLayout data_layout_;
+  LlvmTypeConverter type_converter_;
+  LlvmIrRuntime runtime_;
+};
+
+TEST_F(LlvmTypeLayoutTest, Bits) {
+  std::minstd_rand rng_engine;
+  for (int64 bit_count : {1, 7, 8, 9, 31, 64, 65, 127, 128, 200}) {
+    Type* type = package_.GetBitsType(bit_count);
+    ExpectRoundTrip(type, Value(Bits(bit_count)));
+    ExpectRoundTrip(type, Value(Bits::AllOnes(bit_count)));
+    ExpectRoundTrip(type, RandomValue(type, &rng_engine));
+  }
+}
+
+TEST_F(LlvmTypeLayoutTest, ZeroWidthBits) {
+  Type* type = package_.GetBitsType(0);
+  LlvmTypeLayout layout = type_converter_.CreateTypeLayout(*type);
+  ASSERT_EQ(layout.elements().size(), 1);
+  EXPECT_EQ(layout.elements()[0].bit_count, 0);
+  EXPECT_EQ(layout.elements()[0].store_size, 1);
+
+  std::vector<uint8> buffer(layout.size(), 0xff);
+  layout.ValueToNativeLayout(Value(Bits()), buffer.data());
+  EXPECT_EQ(buffer[0], 0);
+  EXPECT_THAT(layout.NativeLayoutToValue(buffer.data()),
+              IsOkAndHolds(Value(Bits())));
+}
+
+TEST_F(LlvmTypeLayoutTest, ZeroElementArray) {
+  Type* type = ParseType("(bits[8], bits[8][0])");
+  LlvmTypeLayout layout = type_converter_.CreateTypeLayout(*type);
+  std::vector<uint8> buffer(std::max(layout.size(), int64{1}), 0);
+  EXPECT_THAT(layout.NativeLayoutToValue(buffer.data()),
+              StatusIs(absl::StatusCode::kUnimplemented,
+                       HasSubstr("empty array")));
+}
+
+TEST_F(LlvmTypeLayoutTest, ElementOffsets) {
+  Type* type = ParseType("(bits[1], bits[32], bits[8][3], ())");
+  LlvmTypeLayout layout = type_converter_.CreateTypeLayout(*type);
+  std::vector<int64> offsets;
+  for (const LlvmTypeLayout::ElementLayout& element : layout.elements()) {
+    offsets.push_back(element.offset);
+  }
+  EXPECT_THAT(offsets, testing::ElementsAre(0, 4, 8, 9, 10));
+}
+
+TEST_F(LlvmTypeLayoutTest, Aggregates) {
+  std::minstd_rand rng_engine;
+  for (absl::string_view type_text :
+       {"()", "(bits[3])", "(bits[1], bits[32], bits[8][3])",
+        "bits[5][7]", "(bits[3], bits[65])[2]", "((bits[9], (bits[1])), ())",
+        "(bits[17][2], (bits[2], bits[100]))[3]"}) {
+    Type* type = ParseType(type_text);
+    for (int64 i = 0; i < 16; ++i) {
+      ExpectRoundTrip(type, RandomValue(type, &rng_engine));
+    }
+  }
+}
+
+TEST_F(LlvmTypeLayoutTest, Tokens) {
+  ExpectRoundTrip(package_.GetTokenType(), Value::Token());
+  ExpectRoundTrip(ParseType("(bits[7], token, bits[9])"),
+                  Value::Tuple({Value(UBits(3, 7)), Value::Token(),
+                                Value(UBits(300, 9))}));
+}
+
+TEST_F(LlvmTypeLayoutTest, BatchUnpack) {
+  std::minstd_rand rng_engine;
+  Type* type = ParseType("(bits[3], bits[65])[2]");
+  LlvmTypeLayout layout = type_converter_.CreateTypeLayout(*type);
+
+  std::vector<Value> expected;
+  std::vector<uint8> buffer(layout.size() * 10);
+  for (int64 i = 0; i < 10; ++i) {
+    expected.push_back(RandomValue(type, &rng_engine));
+    layout.ValueToNativeLayout(expected.back(),
+                               buffer.data() + i * layout.size());
+  }
+  std::vector<Value> actual(10);
+  XLS_ASSERT_OK(layout.NativeLayoutToValues(buffer.data(), layout.size(),
+                                            absl::MakeSpan(actual)));
+  EXPECT_EQ(actual, expected);
+}
+
+}  // namespace
+}  // namespace xls
@@ -18,6 +18,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "xls/common/fingerprint.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/ret_check.h"
 #include "xls/common/status/status_macros.h"
@@ -31,7 +32,7 @@ namespace xls {
 Node::Node(Op op, Type* type, absl::optional<SourceLocation> loc,
            Function* function)
     : function_(function),
-      id_(function_->package()->GetNextNodeId()),
+      id_(function_->AllocateNodeId()),
       op_(op),
       type_(type),
       loc_(loc) {}
@@ -39,7 +40,9 @@ Node::Node(Op op, Type* type, absl::optional<SourceLocation> loc,
 void Node::AddOperand(Node* operand) {
   XLS_VLOG(3) << " Adding operand " << operand->GetName() << " as #"
               << operands_.size() << " operand of " << GetName();
+  RemoveFromFunctionFingerprint();
   operands_.push_back(operand);
+  AddToFunctionFingerprint();
   operand->AddUser(this);
   XLS_VLOG(3) << " " << operand->GetName()
               << " user now: " << operand->GetUsersString();
@@ -64,6 +67,62 @@ absl::Status Node::AddNodeToFunctionAndReplace(
   return ReplaceUsesWith(replacement_ptr).status();
 }
 
+void Node::SwapOperands(int64 a, int64 b) {
+  // Operand/user chains already set up properly.
+  RemoveFromFunctionFingerprint();
+  std::swap(operands_[a], operands_[b]);
+  AddToFunctionFingerprint();
+}
+
+void Node::set_id(int64 id) {
+  // The fingerprints of the users of the node include its id.
+  RemoveFromFunctionFingerprint();
+  for (Node* user : users_) {
+    user->RemoveFromFunctionFingerprint();
+  }
+  id_ = id;
+  AddToFunctionFingerprint();
+  for (Node* user : users_) {
+    user->AddToFunctionFingerprint();
+  }
+}
+
+uint64 Node::ComputeImmutableFingerprint() const {
+  uint64 fingerprint = FingerprintString(OpToString(op_));
+  fingerprint = FingerprintCombine(fingerprint, type_->fingerprint());
+  fingerprint = FingerprintCombine(fingerprint, AttributeFingerprint());
+  if (loc_.has_value()) {
+    fingerprint = FingerprintCombine(fingerprint, loc_->fileno().value());
+    fingerprint = FingerprintCombine(fingerprint, loc_->lineno().value());
+    fingerprint = FingerprintCombine(fingerprint, loc_->colno().value());
+  }
+  return fingerprint;
+}
+
+uint64 Node::Fingerprint() const {
+  uint64 fingerprint = FingerprintCombine(
+      immutable_fingerprint_.has_value() ? *immutable_fingerprint_
+                                         : ComputeImmutableFingerprint(),
+      id_);
+  for (const Node* operand : operands_) {
+    fingerprint = FingerprintCombine(fingerprint,
+                                     operand == nullptr ? -1 : operand->id());
+  }
+  return fingerprint;
+}
+
+void Node::RemoveFromFunctionFingerprint() {
+  if (immutable_fingerprint_.has_value()) {
+    function_->node_fingerprint_sum_ -= Fingerprint();
+  }
+}
+
+void Node::AddToFunctionFingerprint() {
+  if (immutable_fingerprint_.has_value()) {
+    function_->node_fingerprint_sum_ += Fingerprint();
+  }
+}
+
 void Node::AddUser(Node* user) {
   auto insert_result = users_set_.insert(user);
   if (insert_result.second) {
@@ -402,6 +461,14 @@ std::string Node::ToStringInternal(bool include_operand_types) const {
     case Op::kDecode:
       args.push_back(absl::StrFormat("width=%d", As<Decode>()->width()));
       break;
+    case Op::kChannelReceive:
+      args.push_back(absl::StrFormat("channel_id=%d",
+                                     As<ChannelReceive>()->channel_id()));
+      break;
+    case Op::kChannelSend:
+      args.push_back(
+          absl::StrFormat("channel_id=%d", As<ChannelSend>()->channel_id()));
+      break;
     default:
       break;
   }
@@ -466,6 +533,7 @@ bool Node::ReplaceOperand(Node* old_operand, Node* new_operand) {
   if (this == new_operand) {
     return true;
   }
+  RemoveFromFunctionFingerprint();
   bool did_replace = false;
   for (int64 i = 0; i < operand_count(); ++i) {
     if (operands_[i] == old_operand) {
@@ -478,6 +546,7 @@ bool Node::ReplaceOperand(Node* old_operand, Node* new_operand) {
     }
   }
   old_operand->RemoveUser(this);
+  AddToFunctionFingerprint();
   return did_replace;
 }
 
@@ -490,7 +559,9 @@ absl::Status Node::ReplaceOperandNumber(int64 operand_no, Node* new_operand) {
   // AddUser is idempotent so even if the new operand is already used by this
   // node in another operand slot, it is safe to call.
   new_operand->AddUser(this);
+  RemoveFromFunctionFingerprint();
   operands_[operand_no] = new_operand;
+  AddToFunctionFingerprint();
 
   for (Node* operand : operands()) {
     if (operand == old_operand) {
@@ -110,16 +110,23 @@ class Node {
   }
 
   // Swaps the operands at indices 'a' and 'b' in the operands sequence.
-  void SwapOperands(int64 a, int64 b) {
-    // Operand/user chains already set up properly.
-    std::swap(operands_[a], operands_[b]);
-  }
+  void SwapOperands(int64 a, int64 b);
 
   // Returns true if analysis indicates that this node always produces the
   // same value as 'other' when run with the same operands. The analysis is
   // conservative and false may be returned for some "equivalent" nodes.
   virtual bool IsDefinitelyEqualTo(const Node* other) const;
 
+  // Returns a fingerprint of the attributes of the node (e.g., the start and
+  // width of a bit slice). Zero for nodes without attributes.
+  virtual uint64 AttributeFingerprint() const { return 0; }
+
+  // Returns a fingerprint of the node: its id, op, type, attributes, source
+  // location and the ids of its operands. The fingerprints of the nodes of a
+  // function make up the fingerprint of the function (see
+  // Function::Fingerprint).
+  uint64 Fingerprint() const;
+
   // Returns whether this Op is of the template argument subclass. For example:
   // Is<Param>().
   template <typename OpT>
@@ -183,7 +190,7 @@ class Node {
 
   // Note: use with caution, the id should be unique among all nodes in a
   // function.
-  void set_id(int64 id) { id_ = id; }
+  void set_id(int64 id);
 
   // Clones the node with the new operands. Returns the newly created
   // instruction. The instruction is owned by new_function which must also
@@ -221,6 +228,16 @@ class Node {
   void AddUser(Node* user);
   void RemoveUser(Node* user);
 
+  // Returns the fingerprint of the parts of the node which never change: its
+  // op, type, attributes and source location.
+  uint64 ComputeImmutableFingerprint() const;
+
+  // Remove the fingerprint of this node from the fingerprint of its function
+  // before the node is mutated, and add it back afterwards. No-ops if the node
+  // has not been added to its function yet.
+  void RemoveFromFunctionFingerprint();
+  void AddToFunctionFingerprint();
+
   Function* function_;
   int64 id_;
   Op op_;
@@ -229,6 +246,10 @@ class Node {
   absl::optional<SourceLocation> loc_;
   std::vector<Node*> operands_;
 
+  // The result of ComputeImmutableFingerprint(), set when the node is added to
+  // its function.
+  absl::optional<uint64> immutable_fingerprint_;
+
 #include "xls/ir/container_hack.inc"
   UnorderedSet<Node*> users_set_;
 #include "xls/ir/container_hack_undef.inc"
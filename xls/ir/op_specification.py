@@ -214,6 +214,7 @@ class Property(enum.Enum):
   ASSOCIATIVE = 2
   COMMUTATIVE = 3
   COMPARISON = 4
+  SIDE_EFFECTING = 5  # Ops such as kChannelSend which must not be removed
 
 
 class Operand(object):
@@ -691,13 +692,13 @@ OPS = [
         enum_name='kChannelReceive',
         name='channel_receive',
         op_class=OpClass.kinds['CHANNEL_RECEIVE'],
-        properties=[],
+        properties=[Property.SIDE_EFFECTING],
     ),
     Op(
         enum_name='kChannelSend',
         name='channel_send',
         op_class=OpClass.kinds['CHANNEL_SEND'],
-        properties=[],
+        properties=[Property.SIDE_EFFECTING],
     ),
     Op(
         enum_name='kNand',
@@ -15,21 +15,46 @@
 #include "xls/ir/package.h"
 
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "xls/common/fingerprint.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/status_macros.h"
 #include "xls/common/strong_int.h"
 #include "xls/ir/function.h"
+#include "xls/ir/nodes.h"
 #include "xls/ir/type.h"
 #include "xls/ir/value.h"
 
 namespace xls {
 namespace {
 constexpr char kMain[] = "main";
+
+// Appends "f" to "order", after any functions it (transitively) calls which are
+// not yet in "visited".
+void AppendCalleesFirst(const Function* f,
+                        absl::flat_hash_set<const Function*>* visited,
+                        std::vector<const Function*>* order) {
+  if (!visited->insert(f).second) {
+    return;
+  }
+  for (Node* node : f->nodes()) {
+    if (node->Is<Invoke>()) {
+      AppendCalleesFirst(node->As<Invoke>()->to_apply(), visited, order);
+    } else if (node->Is<Map>()) {
+      AppendCalleesFirst(node->As<Map>()->to_apply(), visited, order);
+    } else if (node->Is<CountedFor>()) {
+      AppendCalleesFirst(node->As<CountedFor>()->body(), visited, order);
+    }
+  }
+  order->push_back(f);
 }
 
+}  // namespace
+
 Package::Package(absl::string_view name,
                  absl::optional<absl::string_view> entry)
     : entry_(entry), name_(name) {
@@ -141,6 +166,7 @@ SourceLocation Package::AddSourceLocation(absl::string_view filename,
 }
 
 std::string Package::SourceLocationToString(const SourceLocation loc) {
+  absl::MutexLock lock(&mutex_);
   const std::string unknown = "UNKNOWN";
   absl::string_view filename =
       fileno_to_filename_.find(loc.fileno()) != fileno_to_filename_.end()
@@ -150,6 +176,7 @@ std::string Package::SourceLocationToString(const SourceLocation loc) {
 }
 
 BitsType* Package::GetBitsType(int64 bit_count) {
+  absl::MutexLock lock(&mutex_);
   if (bit_count_to_type_.find(bit_count) != bit_count_to_type_.end()) {
     return &bit_count_to_type_.at(bit_count);
   }
@@ -160,11 +187,12 @@ BitsType* Package::GetBitsType(int64 bit_count) {
 }
 
 ArrayType* Package::GetArrayType(int64 size, Type* element_type) {
+  absl::MutexLock lock(&mutex_);
   ArrayKey key{size, element_type};
   if (array_types_.find(key) != array_types_.end()) {
     return &array_types_.at(key);
   }
-  XLS_CHECK(IsOwnedType(element_type))
+  XLS_CHECK(owned_types_.find(element_type) != owned_types_.end())
       << "Type is not owned by package: " << *element_type;
   auto it = array_types_.emplace(key, ArrayType(size, element_type));
   ArrayType* new_type = &(it.first->second);
@@ -173,12 +201,13 @@ ArrayType* Package::GetArrayType(int64 size, Type* element_type) {
 }
 
 TupleType* Package::GetTupleType(absl::Span<Type* const> element_types) {
+  absl::MutexLock lock(&mutex_);
   TypeVec key(element_types.begin(), element_types.end());
   if (tuple_types_.find(key) != tuple_types_.end()) {
     return &tuple_types_.at(key);
   }
   for (const Type* element_type : element_types) {
-    XLS_CHECK(IsOwnedType(element_type))
+    XLS_CHECK(owned_types_.find(element_type) != owned_types_.end())
         << "Type is not owned by package: " << *element_type;
   }
   auto it = tuple_types_.emplace(key, TupleType(element_types));
@@ -192,11 +221,12 @@ TokenType* Package::GetTokenType() { return &token_type_; }
 FunctionType* Package::GetFunctionType(absl::Span<Type* const> args_types,
                                        Type* return_type) {
   std::string key = FunctionType(args_types, return_type).ToString();
+  absl::MutexLock lock(&mutex_);
   if (function_types_.find(key) != function_types_.end()) {
     return &function_types_.at(key);
   }
   for (Type* t : args_types) {
-    XLS_CHECK(IsOwnedType(t))
+    XLS_CHECK(owned_types_.find(t) != owned_types_.end())
         << "Parameter type is not owned by package: " << t->ToString();
   }
   auto it = function_types_.emplace(key, FunctionType(args_types, return_type));
@@ -284,6 +314,7 @@ Type* Package::GetTypeForValue(const Value& value) {
 }
 
 Fileno Package::GetOrCreateFileno(absl::string_view filename) {
+  absl::MutexLock lock(&mutex_);
   // Attempt to add a new fileno/filename pair to the map.
   auto this_fileno = Fileno(filename_to_fileno_.size());
   if (auto it = filename_to_fileno_.find(std::string(filename));
@@ -304,6 +335,16 @@ int64 Package::GetNodeCount() const {
   return count;
 }
 
+uint64 Package::Fingerprint() const {
+  uint64 fingerprint = FingerprintString(name_);
+  fingerprint = FingerprintCombine(
+      fingerprint, entry_.has_value() ? FingerprintString(*entry_) : 0);
+  for (const auto& f : functions()) {
+    fingerprint = FingerprintCombine(fingerprint, f->Fingerprint());
+  }
+  return fingerprint;
+}
+
 bool Package::IsDefinitelyEqualTo(const Package* other) const {
   auto entry_function_status = EntryFunction();
   if (!entry_function_status.ok()) {
@@ -321,8 +362,16 @@ bool Package::IsDefinitelyEqualTo(const Package* other) const {
 std::string Package::DumpIr() const {
   std::string out;
   absl::StrAppend(&out, "package ", name(), "\n\n");
+  // The parser requires functions to be defined before they are referenced, but
+  // passes may add callees after their callers (e.g., loop bodies created by
+  // partial unrolling), so dump callees first. Otherwise package order is kept.
+  absl::flat_hash_set<const Function*> visited;
+  std::vector<const Function*> order;
+  for (const std::unique_ptr<Function>& function : functions()) {
+    AppendCalleesFirst(function.get(), &visited, &order);
+  }
   std::vector<std::string> function_dumps;
-  for (auto& function : functions()) {
+  for (const Function* function : order) {
     function_dumps.push_back(function->DumpIr());
   }
   absl::StrAppend(&out, absl::StrJoin(function_dumps, "\n"));
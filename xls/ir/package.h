@@ -24,6 +24,7 @@
 #include "absl/container/inlined_vector.h"
 #include "absl/container/node_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "xls/common/integral_types.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/fileno.h"
@@ -49,13 +50,17 @@ class Package {
 
   // Returns whether the given type is one of the types owned by this package.
   bool IsOwnedType(const Type* type) {
+    absl::MutexLock lock(&mutex_);
     return owned_types_.find(type) != owned_types_.end();
   }
   bool IsOwnedFunctionType(const FunctionType* function_type) {
+    absl::MutexLock lock(&mutex_);
     return owned_function_types_.find(function_type) !=
            owned_function_types_.end();
   }
 
+  // The type and source location accessors are thread-safe, so that passes
+  // may modify different functions of a package concurrently.
   BitsType* GetBitsType(int64 bit_count);
   ArrayType* GetArrayType(int64 size, Type* element_type);
   TupleType* GetTupleType(absl::Span<Type* const> element_types);
@@ -75,7 +80,8 @@ class Package {
   // Get a function by name.
   xabsl::StatusOr<Function*> GetFunction(absl::string_view func_name) const;
 
-  // Remove (dead) functions.
+  // Remove (dead) functions. Callers holding state keyed by the functions
+  // (e.g., QueryEngineCache in passes) must drop it first.
   void DeleteDeadFunctions(absl::Span<Function* const> dead_funcs);
 
   // Returns the entry function of the package.
@@ -108,7 +114,8 @@ class Package {
   std::string SourceLocationToString(const SourceLocation loc);
 
   // Retrieves the next node ID to assign to a node in the package and
-  // increments the next node counter. For use in node construction.
+  // increments the next node counter. For use in node construction (see
+  // Function::AllocateNodeId()). Not thread-safe.
   int64 GetNextNodeId() { return next_node_id_++; }
 
   // Adds a file to the file-number table and returns its corresponding number.
@@ -134,9 +141,16 @@ class Package {
   // conservative and false may be returned for some "equivalent" packages.
   bool IsDefinitelyEqualTo(const Package* other) const;
 
-  // Dumps the IR in a parsable text format.
+  // Dumps the IR in a parsable text format. Functions are dumped in package
+  // order, except that each is preceded by the functions it calls.
   std::string DumpIr() const;
 
+  // Returns a fingerprint of the package: its name, its entry function and the
+  // fingerprints of its functions in order (see Function::Fingerprint). Two
+  // packages with the same fingerprint dump the same IR with very high
+  // probability.
+  uint64 Fingerprint() const;
+
   std::vector<std::string> GetFunctionNames() const;
 
   int64 next_node_id() const { return next_node_id_; }
@@ -161,41 +175,45 @@ class Package {
   // Ordinal to assign to the next node created in this package.
   int64 next_node_id_ = 1;
 
+  // Guards the type and fileno tables below.
+  absl::Mutex mutex_;
+
   std::vector<std::unique_ptr<Function>> functions_;
 
   // Set of owned types in this package.
-  UnorderedSet<const Type*> owned_types_;
+  UnorderedSet<const Type*> owned_types_ ABSL_GUARDED_BY(mutex_);
 
   // Set of owned function types in this package.
-  UnorderedSet<const FunctionType*> owned_function_types_;
+  UnorderedSet<const FunctionType*> owned_function_types_
+      ABSL_GUARDED_BY(mutex_);
 
   // Mapping from bit count to the owned "bits" type with that many bits. Use
   // node_hash_map for pointer stability.
-  StableMap<int64, BitsType> bit_count_to_type_;
+  StableMap<int64, BitsType> bit_count_to_type_ ABSL_GUARDED_BY(mutex_);
 
   // Mapping from the size and element type of an array type to the owned
   // ArrayType. Use node_hash_map for pointer stability.
   using ArrayKey = std::pair<int64, const Type*>;
-  StableMap<ArrayKey, ArrayType> array_types_;
+  StableMap<ArrayKey, ArrayType> array_types_ ABSL_GUARDED_BY(mutex_);
 
   // Mapping from elements to the owned tuple type.
   //
   // Uses node_hash_map for pointer stability.
   using TypeVec = absl::InlinedVector<const Type*, 4>;
-  StableMap<TypeVec, TupleType> tuple_types_;
+  StableMap<TypeVec, TupleType> tuple_types_ ABSL_GUARDED_BY(mutex_);
 
   // Owned token type.
   TokenType token_type_;
 
   // Mapping from Type:ToString to the owned function type. Use
   // node_hash_map for pointer stability.
-  StableMap<std::string, FunctionType> function_types_;
+  StableMap<std::string, FunctionType> function_types_ ABSL_GUARDED_BY(mutex_);
 
   // Mapping of Fileno ids to string filenames, and vice-versa for reverse
   // lookups. These two data structures must be updated together for consistency
   // and should always contain the same number of entries.
-  UnorderedMap<Fileno, std::string> fileno_to_filename_;
-  UnorderedMap<std::string, Fileno> filename_to_fileno_;
+  UnorderedMap<Fileno, std::string> fileno_to_filename_ ABSL_GUARDED_BY(mutex_);
+  UnorderedMap<std::string, Fileno> filename_to_fileno_ ABSL_GUARDED_BY(mutex_);
 
 #include "xls/ir/container_hack_undef.inc"
 };
@@ -0,0 +1,323 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/proc_runtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/value_helpers.h"
+
+namespace xls {
+namespace {
+
+// Returns an error if "function" or any function it calls contains a channel
+// operation.
+absl::Status CheckNoChannelOperations(Function* function,
+                                      Function* proc_function) {
+  for (Node* node : function->nodes()) {
+    if (node->Is<ChannelSend>() || node->Is<ChannelReceive>()) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Channel operations must appear directly in proc function %s, but "
+          "%s is in called function %s",
+          proc_function->name(), node->GetName(), function->name()));
+    }
+  }
+  for (Node* node : function->nodes()) {
+    if (node->Is<Invoke>()) {
+      XLS_RETURN_IF_ERROR(CheckNoChannelOperations(
+          node->As<Invoke>()->to_apply(), proc_function));
+    } else if (node->Is<Map>()) {
+      XLS_RETURN_IF_ERROR(
+          CheckNoChannelOperations(node->As<Map>()->to_apply(), proc_function));
+    } else if (node->Is<CountedFor>()) {
+      XLS_RETURN_IF_ERROR(CheckNoChannelOperations(
+          node->As<CountedFor>()->body(), proc_function));
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Returns an error if "function" does not have the signature of a proc; sets
+// "has_state" according to whether it has a state parameter.
+absl::Status CheckProcSignature(Function* function, bool* has_state) {
+  auto error = [&](absl::string_view message) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Function %s is not a proc: %s", function->name(), message));
+  };
+  if (function->params().empty() || function->params().size() > 2 ||
+      !function->param(0)->GetType()->IsToken()) {
+    return error("expected parameters (token) or (token, state)");
+  }
+  *has_state = function->params().size() == 2;
+  Type* return_type = function->return_value()->GetType();
+  if (*has_state) {
+    Type* state_type = function->param(1)->GetType();
+    if (!return_type->IsTuple() || return_type->AsTupleOrDie()->size() != 2 ||
+        !return_type->AsTupleOrDie()->element_type(0)->IsToken() ||
+        return_type->AsTupleOrDie()->element_type(1) != state_type) {
+      return error("expected return type (token, state)");
+    }
+  } else if (!return_type->IsToken()) {
+    return error("expected return type token");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+xabsl::StatusOr<std::unique_ptr<ProcRuntime>> ProcRuntime::Create(
+    absl::Span<const ProcConfig> procs, Backend backend, int64 queue_capacity) {
+  auto runtime = absl::WrapUnique(new ProcRuntime());
+
+  // The procs sending on and receiving from each channel.
+  absl::flat_hash_map<int64, Function*> senders;
+  absl::flat_hash_map<int64, Function*> receivers;
+  auto add_endpoint = [](int64 channel_id, Function* function,
+                         absl::string_view direction,
+                         absl::flat_hash_map<int64, Function*>* endpoints) {
+    auto [it, inserted] = endpoints->insert({channel_id, function});
+    if (!inserted && it->second != function) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Channel %d is %s by more than one proc: %s and %s", channel_id,
+          direction, it->second->name(), function->name()));
+    }
+    return absl::OkStatus();
+  };
+
+  // Per-proc message counts, keyed by channel id.
+  std::vector<absl::flat_hash_map<int64, int64>> receive_counts;
+  std::vector<absl::flat_hash_map<int64, int64>> send_counts;
+  for (const ProcConfig& config : procs) {
+    Proc proc;
+    proc.function = config.function;
+    XLS_RETURN_IF_ERROR(CheckProcSignature(config.function, &proc.has_state));
+    if (proc.has_state) {
+      if (!ValueConformsToType(config.initial_state,
+                               config.function->param(1)->GetType())) {
+        return absl::InvalidArgumentError(absl::StrFormat(
+            "Initial state %s of proc %s is not of type %s",
+            config.initial_state.ToString(), config.function->name(),
+            config.function->param(1)->GetType()->ToString()));
+      }
+      proc.state = config.initial_state;
+    }
+
+    receive_counts.emplace_back();
+    send_counts.emplace_back();
+    for (Node* node : config.function->nodes()) {
+      if (node->Is<ChannelReceive>()) {
+        int64 channel_id = node->As<ChannelReceive>()->channel_id();
+        XLS_RETURN_IF_ERROR(add_endpoint(channel_id, config.function,
+                                         "received from", &receivers));
+        receive_counts.back()[channel_id]++;
+      } else if (node->Is<ChannelSend>()) {
+        int64 channel_id = node->As<ChannelSend>()->channel_id();
+        XLS_RETURN_IF_ERROR(
+            add_endpoint(channel_id, config.function, "sent on", &senders));
+        send_counts.back()[channel_id]++;
+      } else if (node->Is<Invoke>()) {
+        XLS_RETURN_IF_ERROR(CheckNoChannelOperations(
+            node->As<Invoke>()->to_apply(), config.function));
+      } else if (node->Is<Map>()) {
+        XLS_RETURN_IF_ERROR(CheckNoChannelOperations(
+            node->As<Map>()->to_apply(), config.function));
+      } else if (node->Is<CountedFor>()) {
+        XLS_RETURN_IF_ERROR(CheckNoChannelOperations(
+            node->As<CountedFor>()->body(), config.function));
+      }
+    }
+
+    if (backend == Backend::kJit) {
+      XLS_ASSIGN_OR_RETURN(proc.jit, LlvmIrJit::Create(config.function));
+      proc.jit->SetChannelQueues(&runtime->queues_);
+    }
+    runtime->procs_.push_back(std::move(proc));
+  }
+
+  auto get_or_create_queue =
+      [&](int64 channel_id) -> xabsl::StatusOr<ChannelQueue*> {
+    if (runtime->queues_.GetQueue(channel_id).ok()) {
+      return runtime->queues_.GetQueue(channel_id);
+    }
+    return runtime->queues_.CreateQueue(channel_id, queue_capacity);
+  };
+  for (int64 i = 0; i < runtime->procs_.size(); ++i) {
+    Proc& proc = runtime->procs_[i];
+    for (auto [counts, endpoints] :
+         {std::make_pair(&receive_counts[i], &proc.receives),
+          std::make_pair(&send_counts[i], &proc.sends)}) {
+      for (const auto& [channel_id, count] : *counts) {
+        // Such a proc could never be activated.
+        if (count > queue_capacity) {
+          return absl::InvalidArgumentError(absl::StrFormat(
+              "Proc %s uses channel %d %d times per activation, which exceeds "
+              "the queue capacity %d",
+              proc.function->name(), channel_id, count, queue_capacity));
+        }
+        XLS_ASSIGN_OR_RETURN(ChannelQueue * queue,
+                             get_or_create_queue(channel_id));
+        endpoints->push_back({queue, count});
+      }
+    }
+  }
+  return runtime;
+}
+
+bool ProcRuntime::IsReady(const Proc& proc) {
+  // These sizes are only conservative bounds while other threads use the
+  // queues, but they err in the safe direction: a proc's input queues can only
+  // grow, and its output queues only shrink, behind its back.
+  for (const auto& [queue, count] : proc.receives) {
+    if (queue->size() < count) {
+      return false;
+    }
+  }
+  for (const auto& [queue, count] : proc.sends) {
+    if (queue->capacity() - queue->size() < count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+absl::Status ProcRuntime::Activate(Proc* proc) {
+  std::vector<Value> args = {Value::Token()};
+  if (proc->has_state) {
+    args.push_back(proc->state);
+  }
+  Value result;
+  if (proc->jit != nullptr) {
+    XLS_ASSIGN_OR_RETURN(result, proc->jit->Run(args));
+  } else {
+    XLS_ASSIGN_OR_RETURN(result, ir_interpreter::RunWithChannels(
+                                     proc->function, args, &queues_));
+  }
+  if (proc->has_state) {
+    proc->state = result.element(1);
+  }
+  ++proc->activation_count;
+  return absl::OkStatus();
+}
+
+xabsl::StatusOr<bool> ProcRuntime::Tick() {
+  bool activated = false;
+  for (Proc& proc : procs_) {
+    if (IsReady(proc)) {
+      XLS_RETURN_IF_ERROR(Activate(&proc));
+      activated = true;
+    }
+  }
+  return activated;
+}
+
+xabsl::StatusOr<int64> ProcRuntime::RunUntilIdle(int64 max_ticks) {
+  int64 ticks = 0;
+  while (ticks < max_ticks) {
+    XLS_ASSIGN_OR_RETURN(bool activated, Tick());
+    if (!activated) {
+      break;
+    }
+    ++ticks;
+  }
+  return ticks;
+}
+
+absl::Status ProcRuntime::RunThreadedUntilIdle(
+    int64 max_activations_per_proc) {
+  // Idle workers record the epoch (the total number of activations) they last
+  // observed before finding themselves blocked. The network is idle once every
+  // worker is idle and none of them has missed an activation which might have
+  // unblocked it. Workers which have run out of activations never wake up.
+  constexpr int64 kNotIdle = -1;
+  constexpr int64 kRetired = -2;
+  std::atomic<int64> epoch(0);
+  std::atomic<int64> idle_count(0);
+  absl::Mutex mutex;
+  absl::CondVar wake;
+  std::vector<int64> idle_epochs(procs_.size(), kNotIdle);
+  bool done = false;
+  absl::Status status;
+
+  auto worker = [&](Proc* proc, int64 index) {
+    int64 activations = 0;
+    while (true) {
+      int64 observed_epoch = epoch.load();
+      if (activations < max_activations_per_proc && IsReady(*proc)) {
+        absl::Status activate_status = Activate(proc);
+        if (!activate_status.ok()) {
+          absl::MutexLock lock(&mutex);
+          if (status.ok()) {
+            status = activate_status;
+          }
+          done = true;
+          wake.SignalAll();
+          return;
+        }
+        ++activations;
+        epoch.fetch_add(1);
+        if (idle_count.load() > 0) {
+          absl::MutexLock lock(&mutex);
+          wake.SignalAll();
+        }
+        continue;
+      }
+
+      absl::MutexLock lock(&mutex);
+      if (done) {
+        return;
+      }
+      idle_epochs[index] =
+          activations < max_activations_per_proc ? observed_epoch : kRetired;
+      idle_count.fetch_add(1);
+      if (idle_count.load() == procs_.size() &&
+          std::all_of(idle_epochs.begin(), idle_epochs.end(), [&](int64 e) {
+            return e == kRetired || e == epoch.load();
+          })) {
+        done = true;
+        wake.SignalAll();
+        return;
+      }
+      while (!done && (idle_epochs[index] == kRetired ||
+                       epoch.load() == observed_epoch)) {
+        wake.Wait(&mutex);
+      }
+      idle_count.fetch_sub(1);
+      idle_epochs[index] = kNotIdle;
+      if (done) {
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(procs_.size());
+  for (int64 i = 0; i < procs_.size(); ++i) {
+    threads.emplace_back(worker, &procs_[i], i);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return status;
+}
+
+}  // namespace xls
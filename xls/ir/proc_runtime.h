@@ -0,0 +1,122 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_IR_PROC_RUNTIME_H_
+#define XLS_IR_PROC_RUNTIME_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/channel_queue.h"
+#include "xls/ir/function.h"
+#include "xls/ir/llvm_ir_jit.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+
+// Executes a network of "procs": functions which are activated repeatedly and
+// communicate over channels via channel_send/channel_receive.
+//
+// A proc function's first parameter is a token. It may have a second
+// parameter holding its state, in which case it returns a (token, next state)
+// tuple; otherwise it returns a token. Channel operations must appear directly
+// in the proc function (not in functions it invokes), so the number of
+// messages each activation consumes and produces is known statically. A proc
+// is only activated when all of its input queues hold enough messages and all
+// of its output queues have enough free space, so activations never block.
+//
+// Each channel is backed by a bounded single-producer, single-consumer queue,
+// so it may be sent on by at most one proc and received from by at most one
+// proc. The other end of a channel which leaves the network is driven by the
+// caller via queue().
+class ProcRuntime {
+ public:
+  enum class Backend { kInterpreter, kJit };
+
+  // A proc and its initial state (ignored for stateless procs).
+  struct ProcConfig {
+    Function* function;
+    Value initial_state;
+  };
+
+  // Creates a runtime for the given procs, with a queue of the given capacity
+  // for every channel they use. With the JIT backend, each proc is compiled
+  // here.
+  static xabsl::StatusOr<std::unique_ptr<ProcRuntime>> Create(
+      absl::Span<const ProcConfig> procs, Backend backend,
+      int64 queue_capacity = 16);
+
+  // Returns the queue of the given channel, e.g., to inject inputs into or
+  // drain outputs out of the network.
+  xabsl::StatusOr<ChannelQueue*> queue(int64 channel_id) const {
+    return queues_.GetQueue(channel_id);
+  }
+
+  // Activates each proc that is ready once, in order. Returns whether any proc
+  // was activated.
+  xabsl::StatusOr<bool> Tick();
+
+  // Calls Tick() until no proc is ready or "max_ticks" ticks have run. Returns
+  // the number of ticks run.
+  xabsl::StatusOr<int64> RunUntilIdle(int64 max_ticks);
+
+  // As RunUntilIdle(), but each proc runs on its own thread, activating
+  // whenever it is ready (up to "max_activations_per_proc" times). Returns once
+  // no proc can make progress. The caller must not access the queues while
+  // this runs.
+  absl::Status RunThreadedUntilIdle(int64 max_activations_per_proc);
+
+  // Returns the current state and the number of activations of the given proc,
+  // indexed as in the arguments to Create().
+  const Value& state(int64 proc_index) const {
+    return procs_.at(proc_index).state;
+  }
+  int64 activation_count(int64 proc_index) const {
+    return procs_.at(proc_index).activation_count;
+  }
+
+ private:
+  struct Proc {
+    Function* function;
+    bool has_state;
+    Value state;
+    int64 activation_count = 0;
+
+    // Number of messages received from/sent on each channel per activation.
+    std::vector<std::pair<ChannelQueue*, int64>> receives;
+    std::vector<std::pair<ChannelQueue*, int64>> sends;
+
+    // Only set for the JIT backend.
+    std::unique_ptr<LlvmIrJit> jit;
+  };
+
+  ProcRuntime() = default;
+
+  // Returns whether the given proc can be activated without blocking.
+  static bool IsReady(const Proc& proc);
+
+  // Activates the given proc once; it must be ready.
+  absl::Status Activate(Proc* proc);
+
+  ChannelQueueManager queues_;
+  std::vector<Proc> procs_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_IR_PROC_RUNTIME_H_
@@ -0,0 +1,263 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/ir/proc_runtime.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+using status_testing::StatusIs;
+using ::testing::HasSubstr;
+
+// A proc which sends its (incrementing) state on channel 0, and one which
+// receives from channel 0 and sends twice the value on channel 1.
+constexpr char kPipelineText[] = R"(
+package pipeline
+
+fn producer(t: token, count: bits[32]) -> (token, bits[32]) {
+  channel_send.1: token = channel_send(t, count, channel_id=0)
+  literal.2: bits[32] = literal(value=1)
+  add.3: bits[32] = add(count, literal.2)
+  ret tuple.4: (token, bits[32]) = tuple(channel_send.1, add.3)
+}
+
+fn doubler(t: token) -> token {
+  channel_receive.5: (token, bits[32]) = channel_receive(t, channel_id=0)
+  tuple_index.6: token = tuple_index(channel_receive.5, index=0)
+  tuple_index.7: bits[32] = tuple_index(channel_receive.5, index=1)
+  add.8: bits[32] = add(tuple_index.7, tuple_index.7)
+  ret channel_send.9: token = channel_send(tuple_index.6, add.8, channel_id=1)
+}
+)";
+
+Value Message(int64 value) { return Value::Tuple({Value(UBits(value, 32))}); }
+
+class ProcRuntimeTest
+    : public IrTestBase,
+      public ::testing::WithParamInterface<ProcRuntime::Backend> {
+ protected:
+  xabsl::StatusOr<std::unique_ptr<ProcRuntime>> CreatePipeline(
+      Package* package, int64 queue_capacity) {
+    XLS_ASSIGN_OR_RETURN(Function * producer, package->GetFunction("producer"));
+    XLS_ASSIGN_OR_RETURN(Function * doubler, package->GetFunction("doubler"));
+    return ProcRuntime::Create({{producer, Value(UBits(0, 32))}, {doubler}},
+                               GetParam(), queue_capacity);
+  }
+};
+
+TEST_P(ProcRuntimeTest, Pipeline) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(kPipelineText));
+  XLS_ASSERT_OK_AND_ASSIGN(auto runtime,
+                           CreatePipeline(package.get(), /*queue_capacity=*/4));
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * output, runtime->queue(1));
+
+  // The producer runs until both queues are full, then stalls until the
+  // outputs are drained.
+  int64 expected = 0;
+  for (int64 round = 0; round < 3; ++round) {
+    XLS_ASSERT_OK_AND_ASSIGN(int64 ticks, runtime->RunUntilIdle(100));
+    EXPECT_GT(ticks, 0);
+    EXPECT_EQ(output->size(), 4);
+    while (!output->empty()) {
+      EXPECT_EQ(output->TryDequeue(), Message(2 * expected));
+      ++expected;
+    }
+  }
+  EXPECT_EQ(runtime->activation_count(0), 16);
+  EXPECT_EQ(runtime->activation_count(1), 12);
+  EXPECT_EQ(runtime->state(0), Value(UBits(16, 32)));
+}
+
+TEST_P(ProcRuntimeTest, Threaded) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(kPipelineText));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto runtime, CreatePipeline(package.get(), /*queue_capacity=*/64));
+  XLS_ASSERT_OK(
+      runtime->RunThreadedUntilIdle(/*max_activations_per_proc=*/50));
+  EXPECT_EQ(runtime->activation_count(0), 50);
+  EXPECT_EQ(runtime->activation_count(1), 50);
+  EXPECT_EQ(runtime->state(0), Value(UBits(50, 32)));
+
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * output, runtime->queue(1));
+  ASSERT_EQ(output->size(), 50);
+  for (int64 i = 0; i < 50; ++i) {
+    EXPECT_EQ(output->TryDequeue(), Message(2 * i));
+  }
+}
+
+TEST_P(ProcRuntimeTest, ThreadedStallsOnFullQueue) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(kPipelineText));
+  XLS_ASSERT_OK_AND_ASSIGN(auto runtime,
+                           CreatePipeline(package.get(), /*queue_capacity=*/4));
+  XLS_ASSERT_OK(
+      runtime->RunThreadedUntilIdle(/*max_activations_per_proc=*/100));
+  EXPECT_EQ(runtime->activation_count(0), 8);
+  EXPECT_EQ(runtime->activation_count(1), 4);
+}
+
+TEST_P(ProcRuntimeTest, ExternalInputs) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package accumulate
+
+fn accumulate(t: token, sum: bits[32]) -> (token, bits[32]) {
+  channel_receive.1: (token, bits[32], bits[32]) = channel_receive(t, channel_id=7)
+  tuple_index.2: token = tuple_index(channel_receive.1, index=0)
+  tuple_index.3: bits[32] = tuple_index(channel_receive.1, index=1)
+  tuple_index.4: bits[32] = tuple_index(channel_receive.1, index=2)
+  umul.5: bits[32] = umul(tuple_index.3, tuple_index.4)
+  add.6: bits[32] = add(sum, umul.5)
+  channel_send.7: token = channel_send(tuple_index.2, add.6, channel_id=8)
+  ret tuple.8: (token, bits[32]) = tuple(channel_send.7, add.6)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, package->GetFunction("accumulate"));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto runtime,
+      ProcRuntime::Create({{f, Value(UBits(100, 32))}}, GetParam()));
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * input, runtime->queue(7));
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * output, runtime->queue(8));
+
+  EXPECT_THAT(runtime->Tick(), IsOkAndHolds(false));
+  for (int64 i = 1; i <= 3; ++i) {
+    ASSERT_TRUE(input->TryEnqueue(
+        Value::Tuple({Value(UBits(i, 32)), Value(UBits(10, 32))})));
+  }
+  EXPECT_THAT(runtime->RunUntilIdle(100), IsOkAndHolds(3));
+  EXPECT_EQ(output->TryDequeue(), Message(110));
+  EXPECT_EQ(output->TryDequeue(), Message(130));
+  EXPECT_EQ(output->TryDequeue(), Message(160));
+  EXPECT_TRUE(output->empty());
+  EXPECT_EQ(runtime->state(0), Value(UBits(160, 32)));
+}
+
+TEST_P(ProcRuntimeTest, DeadSend) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package dead_send
+
+fn counter(t: token, count: bits[32]) -> (token, bits[32]) {
+  channel_send.1: token = channel_send(t, count, channel_id=0)
+  literal.2: bits[32] = literal(value=1)
+  add.3: bits[32] = add(count, literal.2)
+  ret tuple.4: (token, bits[32]) = tuple(t, add.3)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, package->GetFunction("counter"));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto runtime,
+      ProcRuntime::Create({{f, Value(UBits(0, 32))}}, GetParam(),
+                          /*queue_capacity=*/4));
+  XLS_ASSERT_OK_AND_ASSIGN(ChannelQueue * output, runtime->queue(0));
+
+  // The send does not reach the return value but is performed on every
+  // activation, so the proc stalls once the queue is full.
+  EXPECT_THAT(runtime->RunUntilIdle(100), IsOkAndHolds(4));
+  EXPECT_EQ(runtime->activation_count(0), 4);
+  for (int64 i = 0; i < 4; ++i) {
+    EXPECT_EQ(output->TryDequeue(), Message(i));
+  }
+  EXPECT_TRUE(output->empty());
+  EXPECT_EQ(runtime->state(0), Value(UBits(4, 32)));
+}
+
+TEST_P(ProcRuntimeTest, MultipleSenders) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package multiple_senders
+
+fn a(t: token) -> token {
+  literal.1: bits[8] = literal(value=1)
+  ret channel_send.2: token = channel_send(t, literal.1, channel_id=0)
+}
+
+fn b(t: token) -> token {
+  literal.3: bits[8] = literal(value=2)
+  ret channel_send.4: token = channel_send(t, literal.3, channel_id=0)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * a, package->GetFunction("a"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * b, package->GetFunction("b"));
+  EXPECT_THAT(
+      ProcRuntime::Create({{a}, {b}}, GetParam()).status(),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               HasSubstr("Channel 0 is sent on by more than one proc")));
+}
+
+TEST_P(ProcRuntimeTest, TooManySendsForQueue) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package too_many_sends
+
+fn a(t: token) -> token {
+  literal.1: bits[8] = literal(value=1)
+  channel_send.2: token = channel_send(t, literal.1, channel_id=0)
+  ret channel_send.3: token = channel_send(channel_send.2, literal.1, channel_id=0)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * a, package->GetFunction("a"));
+  EXPECT_THAT(
+      ProcRuntime::Create({{a}}, GetParam(), /*queue_capacity=*/1).status(),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               HasSubstr("exceeds the queue capacity 1")));
+}
+
+TEST_P(ProcRuntimeTest, NotAProc) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package not_a_proc
+
+fn a(t: token, x: bits[32]) -> bits[32] {
+  ret neg.1: bits[32] = neg(x)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * a, package->GetFunction("a"));
+  EXPECT_THAT(ProcRuntime::Create({{a, Value(UBits(0, 32))}}, GetParam())
+                  .status(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("expected return type (token, state)")));
+}
+
+TEST_P(ProcRuntimeTest, ChannelOperationInInvokedFunction) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto package, ParsePackage(R"(
+package nested_send
+
+fn callee(t: token) -> token {
+  literal.1: bits[8] = literal(value=1)
+  ret channel_send.2: token = channel_send(t, literal.1, channel_id=0)
+}
+
+fn a(t: token) -> token {
+  ret invoke.3: token = invoke(t, to_apply=callee)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * a, package->GetFunction("a"));
+  EXPECT_THAT(ProcRuntime::Create({{a}}, GetParam()).status(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("is in called function callee")));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ProcRuntimeTestInstantiation, ProcRuntimeTest,
+    ::testing::Values(ProcRuntime::Backend::kInterpreter,
+                      ProcRuntime::Backend::kJit),
+    [](const ::testing::TestParamInfo<ProcRuntime::Backend>& info) {
+      return info.param == ProcRuntime::Backend::kJit ? "Jit" : "Interpreter";
+    });
+
+}  // namespace
+}  // namespace xls
@@ -144,6 +144,7 @@ std::string TupleType::ToString() const {
 BitsType::BitsType(int64 bit_count)
     : Type(TypeKind::kBits), bit_count_(bit_count) {
   XLS_CHECK_GE(bit_count_, 0);
+  AddToFingerprint(bit_count);
 }
 
 std::string BitsType::ToString() const {
@@ -23,6 +23,7 @@
 
 #include "absl/types/span.h"
 #include "xls/common/casts.h"
+#include "xls/common/fingerprint.h"
 #include "xls/common/integral_types.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/statusor.h"
@@ -89,11 +90,23 @@ class Type {
 
   virtual std::string ToString() const = 0;
 
+  // Returns a fingerprint of the structure of the type, computed on
+  // construction. Equal types have equal fingerprints, also across packages.
+  uint64 fingerprint() const { return fingerprint_; }
+
  protected:
-  explicit Type(TypeKind kind) : kind_(kind) {}
+  explicit Type(TypeKind kind)
+      : kind_(kind), fingerprint_(FingerprintMix(static_cast<uint64>(kind))) {}
+
+  // Folds "value" into the fingerprint; subclasses call this on construction
+  // for each of their parameters.
+  void AddToFingerprint(uint64 value) {
+    fingerprint_ = FingerprintCombine(fingerprint_, value);
+  }
 
  private:
   TypeKind kind_;
+  uint64 fingerprint_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Type& type);
@@ -130,6 +143,7 @@ class TupleType : public Type {
     leaf_count_ = 0;
     for (Type* t : members) {
       leaf_count_ += t->leaf_count();
+      AddToFingerprint(t->fingerprint());
     }
   }
   ~TupleType() override {}
@@ -168,7 +182,10 @@ class TupleType : public Type {
 class ArrayType : public Type {
  public:
   explicit ArrayType(int64 size, Type* element_type)
-      : Type(TypeKind::kArray), size_(size), element_type_(element_type) {}
+      : Type(TypeKind::kArray), size_(size), element_type_(element_type) {
+    AddToFingerprint(size);
+    AddToFingerprint(element_type->fingerprint());
+  }
   ~ArrayType() override {}
   std::string ToString() const override;
 
@@ -126,5 +126,32 @@ TEST(TypeTest, TestVariousTypes) {
   EXPECT_FALSE(f_type1.IsEqualTo(&f_type5));
 }
 
+TEST(TypeTest, Fingerprint) {
+  BitsType b42(42);
+  BitsType b42_2(42);
+  BitsType b43(43);
+  EXPECT_EQ(b42.fingerprint(), b42_2.fingerprint());
+  EXPECT_NE(b42.fingerprint(), b43.fingerprint());
+
+  TupleType t_empty({});
+  TupleType t1({&b42, &b43});
+  TupleType t2({&b42_2, &b43});
+  TupleType t3({&b43, &b42});
+  EXPECT_EQ(t1.fingerprint(), t2.fingerprint());
+  EXPECT_NE(t1.fingerprint(), t3.fingerprint());
+  EXPECT_NE(t_empty.fingerprint(), t1.fingerprint());
+
+  ArrayType a1(3, &b42);
+  ArrayType a2(3, &b42_2);
+  ArrayType a3(4, &b42);
+  ArrayType a4(3, &t1);
+  EXPECT_EQ(a1.fingerprint(), a2.fingerprint());
+  EXPECT_NE(a1.fingerprint(), a3.fingerprint());
+  EXPECT_NE(a1.fingerprint(), a4.fingerprint());
+
+  TokenType token;
+  EXPECT_NE(token.fingerprint(), t_empty.fingerprint());
+}
+
 }  // namespace
 }  // namespace xls
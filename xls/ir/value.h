@@ -17,6 +17,7 @@
 
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
+#include "xls/common/logging/logging.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/bits.h"
 #include "xls/ir/xls_type.pb.h"
@@ -59,7 +60,7 @@ class Value {
     return Value(ValueKind::kTuple, elements);
   }
   static Value TupleOwned(std::vector<Value>&& elements) {
-    return Value(ValueKind::kTuple, elements);
+    return Value(ValueKind::kTuple, std::move(elements));
   }
 
   // All members of "elements" must be of the same type, or an error status will
@@ -72,6 +73,14 @@ class Value {
     return Array(elements).value();
   }
 
+  // As above, but takes ownership of the elements and does not check that they
+  // are of the same type. Useful when constructing many arrays whose element
+  // types are already known to agree, e.g., when unpacking typed JIT buffers.
+  static Value ArrayOwned(std::vector<Value>&& elements) {
+    XLS_DCHECK(!elements.empty());
+    return Value(ValueKind::kArray, std::move(elements));
+  }
+
   static Value Token() {
     return Value(ValueKind::kToken, std::vector<Value>({}));
   }
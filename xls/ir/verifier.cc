@@ -79,11 +79,30 @@ class NodeChecker : public DfsVisitor {
   }
 
   absl::Status HandleChannelReceive(ChannelReceive* receive) override {
-    return absl::UnimplementedError("ChannelReceive not yet implemented");
+    XLS_RETURN_IF_ERROR(ExpectOperandCount(receive, 1));
+    XLS_RETURN_IF_ERROR(ExpectOperandHasTokenType(receive, /*operand_no=*/0));
+    XLS_RETURN_IF_ERROR(ExpectHasTupleType(receive));
+    TupleType* type = receive->GetType()->AsTupleOrDie();
+    if (type->size() != receive->data_types().size() + 1 ||
+        !type->element_type(0)->IsToken()) {
+      return absl::InternalError(StrFormat(
+          "Expected receive type to be a token followed by the received data "
+          "types: %s",
+          receive->ToString()));
+    }
+    for (int64 i = 0; i < receive->data_types().size(); ++i) {
+      XLS_RETURN_IF_ERROR(ExpectSameType(
+          receive, type->element_type(i + 1), receive,
+          receive->data_types()[i], StrFormat("tuple element %d", i + 1),
+          StrFormat("data type %d", i)));
+    }
+    return absl::OkStatus();
   }
 
   absl::Status HandleChannelSend(ChannelSend* send) override {
-    return absl::UnimplementedError("ChannelSend not yet implemented");
+    XLS_RETURN_IF_ERROR(ExpectOperandCountGt(send, 0));
+    XLS_RETURN_IF_ERROR(ExpectOperandHasTokenType(send, /*operand_no=*/0));
+    return ExpectHasTokenType(send);
   }
 
   absl::Status HandleArray(Array* array) override {
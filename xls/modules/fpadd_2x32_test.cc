@@ -15,9 +15,14 @@
 // Random-sampling test for the DSLX 2x32 floating-point adder.
 #include <cmath>
 #include <limits>
+#include <random>
+#include <string>
+#include <vector>
 
 #include "absl/random/random.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "xls/common/file/get_runfile_path.h"
 #include "xls/common/init_xls.h"
 #include "xls/common/logging/logging.h"
@@ -32,6 +37,9 @@ ABSL_FLAG(bool, use_opt_ir, true, "Use optimized IR.");
 ABSL_FLAG(int, num_threads, 0,
           "Number of threads to use. Set to 0 to use all.");
 ABSL_FLAG(int64, num_samples, 1024 * 1024, "Number of random samples to test.");
+ABSL_FLAG(std::string, checkpoint_path, "",
+          "If set, progress is saved to this file, and resumed from it if it "
+          "already exists.");
 
 namespace xls {
 
@@ -52,12 +60,16 @@ bool ZeroOrSubnormal(float value) {
   return value == 0 || std::fpclassify(value) == FP_SUBNORMAL;
 }
 
-// Generates two floats with reasonably unformly random bit patterns.
-Float2x32 IndexToInput(uint64 index) {
-  thread_local absl::BitGen bitgen;
-  uint32 a = absl::Uniform(bitgen, 0u, std::numeric_limits<uint32>::max());
-  uint32 b = absl::Uniform(bitgen, 0u, std::numeric_limits<uint32>::max());
-  return Float2x32(absl::bit_cast<float>(a), absl::bit_cast<float>(b));
+// Generates pairs of floats with reasonably uniformly random bit patterns.
+// The generator is seeded with the chunk's first index so that a resumed run
+// tests exactly the same samples.
+void IndexToInputs(uint64 first_index, absl::Span<Float2x32> inputs) {
+  std::mt19937_64 bitgen(first_index);
+  for (Float2x32& input : inputs) {
+    uint32 a = absl::Uniform(bitgen, 0u, std::numeric_limits<uint32>::max());
+    uint32 b = absl::Uniform(bitgen, 0u, std::numeric_limits<uint32>::max());
+    input = Float2x32(absl::bit_cast<float>(a), absl::bit_cast<float>(b));
+  }
 }
 
 // The DSLX implementation uses the "round to nearest (half to even)"
@@ -65,34 +77,60 @@ Float2x32 IndexToInput(uint64 index) {
 // to call fesetround().
 // The DSLX implementation also flushes input subnormals to 0, so we do that
 // here as well.
-float ComputeExpected(Float2x32 input) {
-  float x = FlushDenormals(std::get<0>(input));
-  float y = FlushDenormals(std::get<1>(input));
-  return x + y;
+void ComputeExpected(absl::Span<const Float2x32> inputs,
+                     absl::Span<float> results) {
+  for (int64 i = 0; i < inputs.size(); ++i) {
+    float x = FlushDenormals(std::get<0>(inputs[i]));
+    float y = FlushDenormals(std::get<1>(inputs[i]));
+    results[i] = x + y;
+  }
 }
 
 // Computes FP addition via DSLX & the JIT.
-float ComputeActual(Fpadd2x32* jit_wrapper, absl::Span<uint8> result_buffer,
-                    Float2x32 input) {
-  return jit_wrapper->Run(std::get<0>(input), std::get<1>(input)).value();
+void ComputeActual(Fpadd2x32* jit_wrapper, absl::Span<const Float2x32> inputs,
+                   absl::Span<float> results) {
+  for (int64 i = 0; i < inputs.size(); ++i) {
+    results[i] =
+        jit_wrapper->Run(std::get<0>(inputs[i]), std::get<1>(inputs[i]))
+            .value();
+  }
 }
 
 // Compares expected vs. actual results, taking into account two special cases.
-bool CompareResults(float a, float b) {
-  // DSLX flushes subnormal outputs, while regular FP addition does not, so
-  // just check for that here.
-  return a == b || (std::isnan(a) && std::isnan(b)) ||
-         (ZeroOrSubnormal(a) && ZeroOrSubnormal(b));
+void CompareResults(absl::Span<const float> expected,
+                    absl::Span<const float> actual,
+                    std::vector<int64>* mismatches) {
+  for (int64 i = 0; i < expected.size(); ++i) {
+    float a = expected[i];
+    float b = actual[i];
+    // DSLX flushes subnormal outputs, while regular FP addition does not, so
+    // just check for that here.
+    if (!(a == b || (std::isnan(a) && std::isnan(b)) ||
+          (ZeroOrSubnormal(a) && ZeroOrSubnormal(b)))) {
+      mismatches->push_back(i);
+    }
+  }
 }
 
-absl::Status RealMain(bool use_opt_ir, uint64 num_samples, int num_threads) {
+std::string FormatInput(const Float2x32& input) {
+  return absl::StrFormat("(%s, %s)",
+                         TestbenchDefaultFormat(std::get<0>(input)),
+                         TestbenchDefaultFormat(std::get<1>(input)));
+}
+
+absl::Status RealMain(bool use_opt_ir, uint64 num_samples, int num_threads,
+                      const std::string& checkpoint_path) {
   Testbench<Fpadd2x32, Float2x32, float> testbench(
       0, num_samples,
-      /*max_failures=*/1, IndexToInput, ComputeExpected, ComputeActual,
+      /*max_failures=*/1, IndexToInputs, ComputeExpected, ComputeActual,
       CompareResults);
   if (num_threads != 0) {
     XLS_RETURN_IF_ERROR(testbench.SetNumThreads(num_threads));
   }
+  if (!checkpoint_path.empty()) {
+    XLS_RETURN_IF_ERROR(testbench.SetCheckpointPath(checkpoint_path));
+  }
+  XLS_RETURN_IF_ERROR(testbench.SetInputFormatter(FormatInput));
   return testbench.Run();
 }
 
@@ -102,6 +140,7 @@ int main(int argc, char** argv) {
   xls::InitXls(argv[0], argc, argv);
   XLS_QCHECK_OK(xls::RealMain(absl::GetFlag(FLAGS_use_opt_ir),
                               absl::GetFlag(FLAGS_num_samples),
-                              absl::GetFlag(FLAGS_num_threads)));
+                              absl::GetFlag(FLAGS_num_threads),
+                              absl::GetFlag(FLAGS_checkpoint_path)));
   return 0;
 }
@@ -0,0 +1,309 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/aig_function.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/log_lines.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/abstract_evaluator.h"
+#include "xls/ir/abstract_node_evaluator.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/value.h"
+
+namespace xls {
+namespace {
+
+// The abstract evaluator whose elements are literals of an AIG.
+class AigEvaluator : public AbstractEvaluator<AigLiteral> {
+ public:
+  explicit AigEvaluator(AndInverterGraph* aig) : aig_(aig) {}
+
+  AigLiteral One() const override { return aig_->one(); }
+
+  AigLiteral Zero() const override { return aig_->zero(); }
+
+  AigLiteral Not(const AigLiteral& input) const override {
+    return AndInverterGraph::Not(input);
+  }
+
+  AigLiteral And(const AigLiteral& a, const AigLiteral& b) const override {
+    return aig_->And(a, b);
+  }
+
+  AigLiteral Or(const AigLiteral& a, const AigLiteral& b) const override {
+    return aig_->Or(a, b);
+  }
+
+ private:
+  AndInverterGraph* aig_;
+};
+
+// Evaluates the given node with the abstract evaluator. Unlike
+// AbstractEvaluate, this also evaluates arithmetic operations and signed
+// comparisons.
+xabsl::StatusOr<AigEvaluator::Vector> EvaluateNode(
+    Node* node, absl::Span<const AigEvaluator::Vector> operands,
+    AigEvaluator* evaluator,
+    const std::function<AigEvaluator::Vector(Node*)>& default_handler) {
+  bool has_empty_operand =
+      std::any_of(operands.begin(), operands.end(),
+                  [](const AigEvaluator::Vector& v) { return v.empty(); });
+  if (has_empty_operand || node->BitCountOrDie() == 0) {
+    return AbstractEvaluate(node, operands, evaluator, default_handler);
+  }
+  int64 width = node->BitCountOrDie();
+  auto negate = [&](const AigEvaluator::Vector& v) {
+    return evaluator->Add(evaluator->BitwiseNot(v),
+                          evaluator->BitsToVector(UBits(1, v.size())));
+  };
+  // Signed comparisons are unsigned comparisons with the sign bits inverted.
+  auto flip_sign = [&](AigEvaluator::Vector v) {
+    v.back() = evaluator->Not(v.back());
+    return v;
+  };
+  auto signed_less_than = [&](const AigEvaluator::Vector& a,
+                              const AigEvaluator::Vector& b) {
+    return evaluator->ULessThan(flip_sign(a), flip_sign(b));
+  };
+  switch (node->op()) {
+    case Op::kAdd:
+      return evaluator->Add(operands[0], operands[1]);
+    case Op::kSub:
+      return evaluator->Add(operands[0], negate(operands[1]));
+    case Op::kNeg:
+      return negate(operands[0]);
+    case Op::kSLt:
+      return AigEvaluator::Vector(
+          {signed_less_than(operands[0], operands[1])});
+    case Op::kSGt:
+      return AigEvaluator::Vector(
+          {signed_less_than(operands[1], operands[0])});
+    case Op::kSLe:
+      return AigEvaluator::Vector(
+          {evaluator->Not(signed_less_than(operands[1], operands[0]))});
+    case Op::kSGe:
+      return AigEvaluator::Vector(
+          {evaluator->Not(signed_less_than(operands[0], operands[1]))});
+    case Op::kUMul: {
+      // The product of the full width of the operands is exact.
+      AigEvaluator::Vector product =
+          evaluator->UMul(operands[0], operands[1]);
+      return width <= product.size() ? evaluator->BitSlice(product, 0, width)
+                                     : evaluator->ZeroExtend(product, width);
+    }
+    case Op::kSMul: {
+      AigEvaluator::Vector product =
+          evaluator->SMul(operands[0], operands[1]);
+      return width <= product.size() ? evaluator->BitSlice(product, 0, width)
+                                     : evaluator->SignExtend(product, width);
+    }
+    default:
+      return AbstractEvaluate(node, operands, evaluator, default_handler);
+  }
+}
+
+// Returns the literals whose nodes are the operands of the node built for the
+// given literal: an and of the fanins of an uncomplemented AND node, an or of
+// the inverted fanins of a complemented AND node whose fanins are both
+// complemented, and a not of any other complemented literal.
+absl::InlinedVector<AigLiteral, 2> GetOperandLiterals(
+    const AndInverterGraph& aig, AigLiteral literal) {
+  if (AndInverterGraph::NodeIndex(literal) == 0) {
+    return {};
+  }
+  const AigNode& node = aig.GetNode(literal);
+  if (!AndInverterGraph::IsComplemented(literal)) {
+    if (!aig.IsAnd(literal)) {
+      return {};
+    }
+    return {node.fanin0, node.fanin1};
+  }
+  if (aig.IsAnd(literal) && AndInverterGraph::IsComplemented(node.fanin0) &&
+      AndInverterGraph::IsComplemented(node.fanin1)) {
+    return {AndInverterGraph::Not(node.fanin0),
+            AndInverterGraph::Not(node.fanin1)};
+  }
+  return {AndInverterGraph::Not(literal)};
+}
+
+}  // namespace
+
+/* static */ xabsl::StatusOr<std::unique_ptr<AigFunction>> AigFunction::Run(
+    Function* f) {
+  XLS_VLOG(1) << absl::StreamFormat("AigFunction::Run(%s):", f->name());
+  XLS_VLOG_LINES(5, f->DumpIr());
+
+  auto aig_function = absl::WrapUnique(new AigFunction(f));
+  AndInverterGraph& aig = aig_function->aig_;
+  AigEvaluator evaluator(&aig);
+
+  // The bits of the nodes which are not lowered are new inputs.
+  auto make_cut_point = [&](Node* node) {
+    AigEvaluator::Vector v;
+    for (int64 i = 0; i < node->BitCountOrDie(); ++i) {
+      v.push_back(aig.NewInput());
+      aig_function->input_bits_.push_back({node, i});
+    }
+    aig_function->cut_points_.insert(node);
+    return v;
+  };
+
+  for (Node* node : TopoSort(f)) {
+    if (!node->GetType()->IsBits()) {
+      continue;
+    }
+    bool has_non_bits_operand =
+        std::any_of(node->operands().begin(), node->operands().end(),
+                    [](Node* o) { return !o->GetType()->IsBits(); });
+    if (node->Is<Param>() || has_non_bits_operand) {
+      aig_function->literals_[node] = make_cut_point(node);
+      continue;
+    }
+    std::vector<AigEvaluator::Vector> operand_values;
+    for (Node* operand : node->operands()) {
+      operand_values.push_back(aig_function->literals_.at(operand));
+    }
+    XLS_ASSIGN_OR_RETURN(
+        aig_function->literals_[node],
+        EvaluateNode(node, operand_values, &evaluator,
+                     /*default_handler=*/make_cut_point));
+  }
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Lowered %s to an AIG of %d AND nodes and %d inputs", f->name(),
+      aig.and_count(), aig.inputs().size());
+  return std::move(aig_function);
+}
+
+void AigFunction::Optimize(absl::Span<Node* const> nodes) {
+  std::vector<AigLiteral> roots;
+  for (Node* node : nodes) {
+    const std::vector<AigLiteral>& literals = literals_.at(node);
+    roots.insert(roots.end(), literals.begin(), literals.end());
+  }
+  int64 original_count = aig_.and_count();
+  int32 original_depth = aig_.GetDepth(roots);
+  aig_.Balance(&roots);
+  aig_.Rewrite(&roots);
+  aig_.Refactor(&roots);
+  aig_.Balance(&roots);
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Optimized the AIG of %s from %d AND nodes of depth %d to %d of depth "
+      "%d",
+      func_->name(), original_count, original_depth, aig_.and_count(),
+      aig_.GetDepth(roots));
+
+  absl::flat_hash_map<Node*, std::vector<AigLiteral>> literals;
+  auto it = roots.begin();
+  for (Node* node : nodes) {
+    int64 width = literals_.at(node).size();
+    literals[node].assign(it, it + width);
+    it += width;
+  }
+  literals_ = std::move(literals);
+  built_literals_.clear();
+  input_positions_.clear();
+}
+
+xabsl::StatusOr<Node*> AigFunction::BuildLiteral(
+    AigLiteral literal, absl::optional<SourceLocation> loc) {
+  if (input_positions_.empty()) {
+    for (int64 i = 0; i < aig_.inputs().size(); ++i) {
+      input_positions_[AndInverterGraph::NodeIndex(aig_.inputs()[i])] = i;
+    }
+  }
+  // Build the literals in post order with an explicit stack, as the AIG may
+  // be deep.
+  std::vector<AigLiteral> stack = {literal};
+  while (!stack.empty()) {
+    AigLiteral a = stack.back();
+    if (built_literals_.contains(a)) {
+      stack.pop_back();
+      continue;
+    }
+    absl::InlinedVector<AigLiteral, 2> operand_literals =
+        GetOperandLiterals(aig_, a);
+    bool operands_built = true;
+    for (AigLiteral operand : operand_literals) {
+      if (!built_literals_.contains(operand)) {
+        stack.push_back(operand);
+        operands_built = false;
+      }
+    }
+    if (!operands_built) {
+      continue;
+    }
+    stack.pop_back();
+    std::vector<Node*> operands;
+    for (AigLiteral operand : operand_literals) {
+      operands.push_back(built_literals_.at(operand));
+    }
+    Node* built;
+    if (AndInverterGraph::NodeIndex(a) == 0) {
+      XLS_ASSIGN_OR_RETURN(
+          built, func_->MakeNode<Literal>(
+                     loc, Value(UBits(a == aig_.one() ? 1 : 0, 1))));
+    } else if (!AndInverterGraph::IsComplemented(a) && !aig_.IsAnd(a)) {
+      const std::pair<Node*, int64>& input_bit =
+          input_bits_.at(input_positions_.at(AndInverterGraph::NodeIndex(a)));
+      XLS_ASSIGN_OR_RETURN(built, func_->MakeNode<BitSlice>(
+                                      loc, input_bit.first, input_bit.second,
+                                      /*width=*/1));
+    } else if (!AndInverterGraph::IsComplemented(a)) {
+      XLS_ASSIGN_OR_RETURN(built,
+                           func_->MakeNode<NaryOp>(loc, operands, Op::kAnd));
+    } else if (operands.size() == 2) {
+      XLS_ASSIGN_OR_RETURN(built,
+                           func_->MakeNode<NaryOp>(loc, operands, Op::kOr));
+    } else {
+      XLS_ASSIGN_OR_RETURN(built,
+                           func_->MakeNode<UnOp>(loc, operands[0], Op::kNot));
+    }
+    built_literals_[a] = built;
+  }
+  return built_literals_.at(literal);
+}
+
+xabsl::StatusOr<Node*> AigFunction::BuildIr(Node* node) {
+  XLS_RET_CHECK(node->GetType()->IsBits());
+  XLS_RET_CHECK(literals_.contains(node))
+      << "No literals of " << node->GetName();
+  if (!IsLowered(node)) {
+    return node;
+  }
+  const std::vector<AigLiteral>& literals = literals_.at(node);
+  if (literals.empty()) {
+    return func_->MakeNode<Literal>(node->loc(), Value(UBits(0, 0)));
+  }
+  // The operands of a concat are ordered from the most significant bit.
+  std::vector<Node*> bits;
+  for (auto it = literals.rbegin(); it != literals.rend(); ++it) {
+    XLS_ASSIGN_OR_RETURN(Node * bit, BuildLiteral(*it, node->loc()));
+    bits.push_back(bit);
+  }
+  if (bits.size() == 1) {
+    return bits.front();
+  }
+  return func_->MakeNode<Concat>(node->loc(), bits);
+}
+
+}  // namespace xls
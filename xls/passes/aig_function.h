@@ -0,0 +1,100 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_AIG_FUNCTION_H_
+#define XLS_PASSES_AIG_FUNCTION_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/statusor.h"
+#include "xls/data_structures/and_inverter_graph.h"
+#include "xls/ir/function.h"
+#include "xls/ir/node.h"
+#include "xls/ir/source_location.h"
+
+namespace xls {
+
+// A class which represents the bit-level logic of an XLS function as an
+// and-inverter graph (AIG). The AIG is constructed by an abstract evaluation
+// of the bits-typed nodes of the function using the And/Not functions of the
+// AIG. Arithmetic operations, including multiplications and signed
+// comparisons, are lowered to adders and comparators. Nodes which are not
+// lowered (parameters, divisions, invokes, nodes of other types and nodes with
+// operands of other types) are cut points: each of their bits is an input of
+// the AIG.
+//
+// The AIG can be optimized and mapped back to IR built from single-bit
+// and/or/not nodes.
+class AigFunction {
+ public:
+  static xabsl::StatusOr<std::unique_ptr<AigFunction>> Run(Function* f);
+
+  const AndInverterGraph& aig() const { return aig_; }
+
+  // Returns the literal of the given bit of a bits-typed node.
+  AigLiteral GetLiteral(Node* node, int64 bit_index) const {
+    XLS_CHECK(node->GetType()->IsBits());
+    return literals_.at(node).at(bit_index);
+  }
+
+  // Returns whether the node is lowered into the AIG, or is a cut point.
+  bool IsLowered(Node* node) const { return !cut_points_.contains(node); }
+
+  // Returns the node and bit index of each input of the AIG, in order.
+  absl::Span<const std::pair<Node*, int64>> input_bits() const {
+    return input_bits_;
+  }
+
+  // Optimizes the AIG by balancing, rewriting and refactoring. Only the
+  // literals of the given nodes are kept; the literals of other nodes are no
+  // longer available.
+  void Optimize(absl::Span<Node* const> nodes);
+
+  // Adds nodes to the function which compute the value of the given node from
+  // its AIG: single-bit and/or/not nodes of bits of the cut points, joined by
+  // a concat. Returns the node computing the value. The function must not
+  // have been modified in a way that changes the values of the cut points.
+  xabsl::StatusOr<Node*> BuildIr(Node* node);
+
+ private:
+  explicit AigFunction(Function* f) : func_(f) {}
+
+  // Returns the single-bit node computing the value of the literal, adding it
+  // and the nodes it depends on to the function if needed.
+  xabsl::StatusOr<Node*> BuildLiteral(AigLiteral literal,
+                                      absl::optional<SourceLocation> loc);
+
+  Function* func_;
+  AndInverterGraph aig_;
+  absl::flat_hash_map<Node*, std::vector<AigLiteral>> literals_;
+  absl::flat_hash_set<Node*> cut_points_;
+  std::vector<std::pair<Node*, int64>> input_bits_;
+
+  // The single-bit nodes built for literals by BuildIr, and the position in
+  // the inputs of the AIG of each input node.
+  absl::flat_hash_map<AigLiteral, Node*> built_literals_;
+  absl::flat_hash_map<int32, int64> input_positions_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_AIG_FUNCTION_H_
@@ -0,0 +1,140 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/aig_function.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bit_parallel_simulator.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+
+namespace xls {
+namespace {
+
+class AigFunctionTest : public IrTestBase {};
+
+// The IR built from the AIG computes the same values as the original nodes,
+// before and after optimization.
+TEST_F(AigFunctionTest, RoundTrip) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue a = fb.Param("a", p->GetBitsType(8));
+  BValue b = fb.Param("b", p->GetBitsType(8));
+  BValue s = fb.Param("s", p->GetBitsType(2));
+  BValue t = fb.Param("t", p->GetTupleType({p->GetBitsType(8)}));
+  BValue t0 = fb.TupleIndex(t, 0);
+  std::vector<BValue> values = {
+      fb.And(a, fb.Not(b)),
+      fb.Or(a, t0),
+      fb.Xor(a, b),
+      fb.Add(a, b),
+      fb.Subtract(a, t0),
+      fb.Negate(b),
+      fb.ULt(a, b),
+      fb.SLt(a, b),
+      fb.SGe(a, t0),
+      fb.Eq(a, b),
+      fb.UMul(a, b),
+      fb.UMul(a, s, /*result_width=*/12),
+      fb.SMul(a, s, /*result_width=*/6),
+      fb.Shll(a, s),
+      fb.Shra(b, s),
+      fb.Select(s, {a, b, t0, fb.Literal(UBits(42, 8))}),
+      fb.UDiv(a, b),
+      fb.Add(fb.UDiv(a, b), b),
+      fb.Concat({s, fb.BitSlice(a, 3, 4)}),
+      fb.Literal(UBits(5, 3)),
+      fb.XorReduce(b),
+  };
+  fb.Tuple(values);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<AigFunction> aig_function,
+                           AigFunction::Run(f));
+
+  // The bits of the parameters, the tuple index and the divisions are inputs.
+  EXPECT_EQ(aig_function->aig().inputs().size(), 8 + 8 + 2 + 8 + 2 * 8);
+  EXPECT_TRUE(aig_function->IsLowered(values[0].node()));
+  EXPECT_FALSE(aig_function->IsLowered(t0.node()));
+  EXPECT_EQ(aig_function->aig().FindAnd(
+                aig_function->GetLiteral(a.node(), 0),
+                AndInverterGraph::Not(aig_function->GetLiteral(b.node(), 0))),
+            aig_function->GetLiteral(values[0].node(), 0));
+
+  std::vector<Node*> nodes;
+  for (const BValue& value : values) {
+    nodes.push_back(value.node());
+  }
+  std::vector<Node*> built;
+  for (Node* node : nodes) {
+    XLS_ASSERT_OK_AND_ASSIGN(Node * n, aig_function->BuildIr(node));
+    built.push_back(n);
+  }
+  int64 and_count = aig_function->aig().and_count();
+  aig_function->Optimize(nodes);
+  EXPECT_LE(aig_function->aig().and_count(), and_count);
+  std::vector<Node*> optimized;
+  for (Node* node : nodes) {
+    XLS_ASSERT_OK_AND_ASSIGN(Node * n, aig_function->BuildIr(node));
+    optimized.push_back(n);
+  }
+
+  BitParallelSimulator simulator(f);
+  for (int64 batch = 0; batch < 4; ++batch) {
+    XLS_ASSERT_OK(simulator.RunRandom());
+    for (int64 i = 0; i < nodes.size(); ++i) {
+      EXPECT_EQ(simulator.GetWords(built[i]), simulator.GetWords(nodes[i]))
+          << nodes[i]->ToString();
+      EXPECT_EQ(simulator.GetWords(optimized[i]),
+                simulator.GetWords(nodes[i]))
+          << nodes[i]->ToString();
+    }
+  }
+}
+
+TEST_F(AigFunctionTest, OptimizationRemovesRedundantLogic) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(4));
+  BValue y = fb.Param("y", p->GetBitsType(4));
+  // (x & y) | (x & ~y) is x.
+  BValue redundant = fb.Or(fb.And(x, y), fb.And(x, fb.Not(y)));
+  fb.Tuple({redundant, fb.Add(x, y)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<AigFunction> aig_function,
+                           AigFunction::Run(f));
+
+  aig_function->Optimize({redundant.node(), x.node()});
+  EXPECT_EQ(aig_function->aig().and_count(), 0);
+  for (int64 i = 0; i < 4; ++i) {
+    EXPECT_EQ(aig_function->GetLiteral(redundant.node(), i),
+              aig_function->GetLiteral(x.node(), i));
+  }
+  XLS_ASSERT_OK_AND_ASSIGN(Node * built,
+                           aig_function->BuildIr(redundant.node()));
+  EXPECT_EQ(built->op(), Op::kConcat);
+  for (Node* bit : built->operands()) {
+    EXPECT_EQ(bit->op(), Op::kBitSlice);
+    EXPECT_EQ(bit->operand(0), x.node());
+  }
+}
+
+}  // namespace
+}  // namespace xls
@@ -544,4 +544,8 @@ xabsl::StatusOr<bool> ArithSimplificationPass::RunOnFunction(
   return modified;
 }
 
+xabsl::StatusOr<bool> ArithSimplificationRule::Rewrite(Node* node) const {
+  return MatchArithPatterns(node);
+}
+
 }  // namespace xls
@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -34,6 +35,14 @@ class ArithSimplificationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the simplifications of ArithSimplificationPass to a single node.
+class ArithSimplificationRule : public NodeRewriteRule {
+ public:
+  ArithSimplificationRule() : NodeRewriteRule("arith_simp") {}
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_ARITH_SIMPLIFICATION_PASS_H_
@@ -109,4 +109,8 @@ xabsl::StatusOr<bool> ArraySimplificationPass::RunOnFunction(
   return changed;
 }
 
+xabsl::StatusOr<bool> ArraySimplificationRule::Rewrite(Node* node) const {
+  return SimplifyArrayIndex(node->As<ArrayIndex>());
+}
+
 }  // namespace xls
@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -32,6 +33,16 @@ class ArraySimplificationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the simplifications of ArraySimplificationPass to a single node.
+class ArraySimplificationRule : public NodeRewriteRule {
+ public:
+  ArraySimplificationRule() : NodeRewriteRule("array_simp") {}
+
+  bool AppliesTo(Op op) const override { return op == Op::kArrayIndex; }
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_ARRAY_SIMPLIFICATION_H_
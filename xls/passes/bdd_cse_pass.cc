@@ -28,11 +28,10 @@
 #include "xls/ir/node.h"
 #include "xls/ir/node_iterator.h"
 #include "xls/passes/bdd_function.h"
+#include "xls/passes/bdd_query_engine.h"
 
 namespace xls {
 
-namespace {
-
 // Returns the order in which to visit the nodes when performing the
 // optimization. If a pair of equivalent nodes is found during the optimization
 // then the earlier visited node replaces the later visited node so this order
@@ -45,7 +44,7 @@ namespace {
 //     in the list. This ensures that the CSE replacement does not increase
 //     critical-path
 //
-xabsl::StatusOr<std::vector<Node*>> GetNodeOrder(Function* f) {
+xabsl::StatusOr<std::vector<Node*>> GetCseNodeOrder(Function* f) {
   // Index of each node in the topological sort.
   absl::flat_hash_map<Node*, int64> topo_index;
   // Critical-path distance from root in the graph to each node.
@@ -89,8 +88,6 @@ xabsl::StatusOr<std::vector<Node*>> GetNodeOrder(Function* f) {
   return nodes;
 }
 
-}  // namespace
-
 xabsl::StatusOr<bool> BddCsePass::RunOnFunction(Function* f,
                                                 const PassOptions& options,
                                                 PassResults* results) const {
@@ -98,9 +95,21 @@ xabsl::StatusOr<bool> BddCsePass::RunOnFunction(Function* f,
   XLS_VLOG(3) << "Before:";
   XLS_VLOG_LINES(3, f->DumpIr());
 
-  // TODO(meheff): Try tuning the minterm limit.
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<BddFunction> bdd_function,
-                       BddFunction::Run(f, /*minterm_limit=*/4096));
+  if (options.DeadlineExceeded()) {
+    return false;
+  }
+  XLS_ASSIGN_OR_RETURN(BddQueryEngine * query_engine,
+                       results->query_engine_cache.GetBddQueryEngine(
+                           f, BddMintermLimit(f, options),
+                           /*do_not_evaluate_ops=*/{}, options.num_threads));
+  const BddFunction& bdd_function = query_engine->bdd_function();
+
+  // Each BDD partition has its own node indices, so a bit is identified by its
+  // partition as well as its BDD node. The constant zero and one nodes have the
+  // same indices in every partition.
+  auto is_constant = [](BddNodeIndex bdd_node) {
+    return bdd_node.value() <= 1;
+  };
 
   // To improve efficiency, bucket potentially common nodes together. The
   // bucketing is done via a int64 hash value of the BDD node indices of each
@@ -110,7 +119,11 @@ xabsl::StatusOr<bool> BddCsePass::RunOnFunction(Function* f,
     XLS_CHECK(n->GetType()->IsBits());
     std::vector<int64> values_to_hash;
     for (int64 i = 0; i < n->BitCountOrDie(); ++i) {
-      values_to_hash.push_back(bdd_function->GetBddNode(n, i).value());
+      BddNodeIndex bdd_node = bdd_function.GetBddNode(n, i);
+      values_to_hash.push_back(bdd_node.value());
+      if (!is_constant(bdd_node)) {
+        values_to_hash.push_back(bdd_function.GetPartition(n));
+      }
     }
     return hasher(values_to_hash);
   };
@@ -119,8 +132,12 @@ xabsl::StatusOr<bool> BddCsePass::RunOnFunction(Function* f,
     if (a->BitCountOrDie() != b->BitCountOrDie()) {
       return false;
     }
+    bool same_partition =
+        bdd_function.GetPartition(a) == bdd_function.GetPartition(b);
     for (int64 i = 0; i < a->BitCountOrDie(); ++i) {
-      if (bdd_function->GetBddNode(a, i) != bdd_function->GetBddNode(b, i)) {
+      BddNodeIndex a_bdd_node = bdd_function.GetBddNode(a, i);
+      if (a_bdd_node != bdd_function.GetBddNode(b, i) ||
+          (!same_partition && !is_constant(a_bdd_node))) {
         return false;
       }
     }
@@ -130,7 +147,7 @@ xabsl::StatusOr<bool> BddCsePass::RunOnFunction(Function* f,
   bool changed = false;
   absl::flat_hash_map<int64, std::vector<Node*>> node_buckets;
   node_buckets.reserve(f->node_count());
-  XLS_ASSIGN_OR_RETURN(std::vector<Node*> node_order, GetNodeOrder(f));
+  XLS_ASSIGN_OR_RETURN(std::vector<Node*> node_order, GetCseNodeOrder(f));
   for (Node* node : node_order) {
     if (!node->GetType()->IsBits() || node->Is<Literal>()) {
       continue;
@@ -15,12 +15,21 @@
 #ifndef XLS_PASSES_BDD_CSE_PASS_H_
 #define XLS_PASSES_BDD_CSE_PASS_H_
 
+#include <vector>
+
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/ir/node.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
 
+// Returns the nodes of the function in a topological order along which the
+// critical-path delay to each node increases monotonically. Replacing a node by
+// an equivalent node earlier in the order neither creates a cycle nor lengthens
+// the critical path.
+xabsl::StatusOr<std::vector<Node*>> GetCseNodeOrder(Function* f);
+
 // Pass which commons equivalent expressions in the graph using binary decision
 // diagrams.
 class BddCsePass : public FunctionPass {
@@ -14,8 +14,14 @@
 
 #include "xls/passes/bdd_function.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/base/internal/sysinfo.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
@@ -24,8 +30,10 @@
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/ret_check.h"
 #include "xls/common/status/status_macros.h"
+#include "xls/data_structures/union_find.h"
 #include "xls/ir/abstract_evaluator.h"
 #include "xls/ir/abstract_node_evaluator.h"
+#include "xls/ir/bits.h"
 #include "xls/ir/dfs_visitor.h"
 #include "xls/ir/ir_interpreter.h"
 #include "xls/ir/node.h"
@@ -131,7 +139,9 @@ class SaturatingBddEvaluator
 };
 
 // Returns whether the given op should be included in BDD computations.
-bool ShouldEvaluate(Node* node) {
+// 'bounded' indicates whether the BDD expressions are bounded by a minterm
+// limit.
+bool ShouldEvaluate(Node* node, bool bounded) {
   if (!node->GetType()->IsBits()) {
     return false;
   }
@@ -172,24 +182,31 @@ bool ShouldEvaluate(Node* node) {
     case Op::kEncode:
       return true;
 
-    // Comparison operation are only expressed if at least one of the operands
-    // is a literal. This avoids the potential exponential explosion of BDD
-    // nodes which can occur with pathological variable ordering.
+    // Without a minterm limit, comparison operations are only expressed if at
+    // least one of the operands is a literal. This avoids the potential
+    // exponential explosion of BDD nodes which can occur with pathological
+    // variable ordering. With a limit, the operands' variables are interleaved
+    // and the BDD is reordered as it grows, and any remaining blowup is
+    // bounded by the limit.
     case Op::kUGe:
     case Op::kUGt:
     case Op::kULe:
     case Op::kULt:
     case Op::kEq:
     case Op::kNe:
-      return node->operand(0)->Is<Literal>() || node->operand(1)->Is<Literal>();
+      return bounded || node->operand(0)->Is<Literal>() ||
+             node->operand(1)->Is<Literal>();
 
-    // Arithmetic ops
+    // Arithmetic ops. Additions are expressed under the same conditions as
+    // comparisons with non-literal operands. Multiplications and divisions
+    // blow up with any variable ordering.
     case Op::kAdd:
+    case Op::kNeg:
+    case Op::kSub:
+      return bounded;
     case Op::kSMul:
     case Op::kUMul:
-    case Op::kNeg:
     case Op::kSDiv:
-    case Op::kSub:
     case Op::kUDiv:
       return false;
 
@@ -232,43 +249,123 @@ bool ShouldEvaluate(Node* node) {
   }
 }
 
-}  // namespace
+// Returns whether the node is an addition or comparison whose operands'
+// variables should be interleaved.
+bool IsArithmetic(Node* node) {
+  switch (node->op()) {
+    case Op::kAdd:
+    case Op::kSub:
+    case Op::kUGe:
+    case Op::kUGt:
+    case Op::kULe:
+    case Op::kULt:
+    case Op::kEq:
+    case Op::kNe:
+      return true;
+    default:
+      return false;
+  }
+}
 
-/* static */ xabsl::StatusOr<std::unique_ptr<BddFunction>> BddFunction::Run(
-    Function* f, int64 minterm_limit,
-    absl::Span<const Op> do_not_evaluate_ops) {
-  XLS_VLOG(1) << absl::StreamFormat("BddFunction::Run(%s):", f->name());
-  XLS_VLOG_LINES(5, f->DumpIr());
+// Evaluates the given node with the abstract evaluator. Unlike
+// AbstractEvaluate, this also evaluates additions, subtractions and
+// negations.
+xabsl::StatusOr<SaturatingBddNodeVector> EvaluateNode(
+    Node* node, absl::Span<const SaturatingBddNodeVector> operands,
+    SaturatingBddEvaluator* evaluator,
+    const std::function<SaturatingBddNodeVector(Node*)>& default_handler) {
+  auto negate = [&](const SaturatingBddNodeVector& v) {
+    return evaluator->Add(evaluator->BitwiseNot(v),
+                          evaluator->BitsToVector(UBits(1, v.size())));
+  };
+  if (node->GetType()->IsBits() && node->BitCountOrDie() > 0) {
+    switch (node->op()) {
+      case Op::kAdd:
+        return evaluator->Add(operands[0], operands[1]);
+      case Op::kSub:
+        return evaluator->Add(operands[0], negate(operands[1]));
+      case Op::kNeg:
+        return negate(operands[0]);
+      default:
+        break;
+    }
+  }
+  return AbstractEvaluate(node, operands, evaluator, default_handler);
+}
 
-  auto bdd_function = absl::WrapUnique(new BddFunction(f));
-  SaturatingBddEvaluator evaluator(minterm_limit, &bdd_function->bdd());
-  absl::flat_hash_set<Op> do_not_evaluate_ops_set;
-  for (Op op : do_not_evaluate_ops) {
-    do_not_evaluate_ops_set.insert(op);
+// Evaluates the given nodes, in topological order, into the given BDD. If
+// 'is_evaluated' is false for a node, its bits are modeled as new variables.
+// The nodes must not have operands outside the given nodes unless they are not
+// evaluated.
+absl::Status EvaluatePartition(absl::Span<Node* const> nodes,
+                               const std::function<bool(Node*)>& is_evaluated,
+                               int64 minterm_limit, BinaryDecisionDiagram* bdd,
+                               NodeMap* node_map,
+                               absl::flat_hash_set<Node*>* saturated) {
+  SaturatingBddEvaluator evaluator(minterm_limit, bdd);
+
+  // The BDDs of adders and comparators are only linear in the width of their
+  // operands if the variables of the operands are interleaved bit by bit, so
+  // these variables are created upfront in that order, least significant bit
+  // first. The operands are traced through extensions and negations to the
+  // nodes whose bits are variables.
+  absl::flat_hash_map<Node*, SaturatingBddNodeVector> interleaved;
+  for (Node* node : nodes) {
+    if (!IsArithmetic(node) || !is_evaluated(node)) {
+      continue;
+    }
+    std::vector<Node*> sources;
+    int64 max_width = 0;
+    for (Node* source : node->operands()) {
+      while (is_evaluated(source) &&
+             (source->op() == Op::kZeroExt || source->op() == Op::kSignExt ||
+              source->op() == Op::kIdentity || source->op() == Op::kNot)) {
+        source = source->operand(0);
+      }
+      if (!is_evaluated(source) && !interleaved.contains(source) &&
+          !absl::c_linear_search(sources, source)) {
+        sources.push_back(source);
+        max_width = std::max(max_width, source->BitCountOrDie());
+      }
+    }
+    if (sources.size() < 2) {
+      continue;
+    }
+    for (int64 i = 0; i < max_width; ++i) {
+      for (Node* source : sources) {
+        if (i < source->BitCountOrDie()) {
+          interleaved[source].push_back(bdd->NewVariable());
+        }
+      }
+    }
   }
 
   // Create and return a vector containing newly defined BDD variables.
   auto create_new_node_vector = [&](Node* n) {
     SaturatingBddNodeVector v;
-    for (int64 i = 0; i < n->BitCountOrDie(); ++i) {
-      v.push_back(bdd_function->bdd().NewVariable());
+    auto it = interleaved.find(n);
+    if (it != interleaved.end()) {
+      v = std::move(it->second);
+      interleaved.erase(it);
+    } else {
+      for (int64 i = 0; i < n->BitCountOrDie(); ++i) {
+        v.push_back(bdd->NewVariable());
+      }
     }
-    bdd_function->saturated_expressions_.insert(n);
+    saturated->insert(n);
     return v;
   };
 
-  XLS_VLOG(3) << "BDD expressions:";
+  // Reorder the variables by sifting whenever the BDD has doubled in size
+  // since the last reordering.
+  int64 reorder_size = 1 << 14;
+  if (minterm_limit > 0) {
+    bdd->set_reorder_threshold(reorder_size);
+  }
+
   absl::flat_hash_map<Node*, SaturatingBddNodeVector> values;
-  for (Node* node : TopoSort(f)) {
-    if (!node->GetType()->IsBits()) {
-      continue;
-    }
-    // If we shouldn't evaluate this node, the node is to be modeled as
-    // variables, or the node includes some non-bits-typed operands, then just
-    // create a vector of new BDD variables for this node.
-    if (!ShouldEvaluate(node) || do_not_evaluate_ops_set.contains(node->op()) ||
-        std::any_of(node->operands().begin(), node->operands().end(),
-                    [](Node* o) { return !o->GetType()->IsBits(); })) {
+  for (Node* node : nodes) {
+    if (!is_evaluated(node)) {
       values[node] = create_new_node_vector(node);
     } else {
       std::vector<SaturatingBddNodeVector> operand_values;
@@ -277,15 +374,15 @@ bool ShouldEvaluate(Node* node) {
       }
       XLS_ASSIGN_OR_RETURN(
           values[node],
-          AbstractEvaluate(node, operand_values, &evaluator,
-                           /*default_handler=*/create_new_node_vector));
+          EvaluateNode(node, operand_values, &evaluator,
+                       /*default_handler=*/create_new_node_vector));
 
       // Associate a new BDD variable with each bit that exceeded the minterm
       // limit.
       for (SaturatingBddNodeIndex& value : values.at(node)) {
         if (absl::holds_alternative<TooManyMinterms>(value)) {
-          bdd_function->saturated_expressions_.insert(node);
-          value = bdd_function->bdd().NewVariable();
+          saturated->insert(node);
+          value = bdd->NewVariable();
         }
       }
     }
@@ -293,17 +390,166 @@ bool ShouldEvaluate(Node* node) {
     for (int64 i = 0; i < node->BitCountOrDie(); ++i) {
       XLS_VLOG(5) << absl::StreamFormat(
           "    bit %d : %s", i,
-          bdd_function->bdd().ToStringDnf(
-              absl::get<BddNodeIndex>(values.at(node)[i]),
-              /*minterm_limit=*/15));
+          bdd->ToStringDnf(absl::get<BddNodeIndex>(values.at(node)[i]),
+                           /*minterm_limit=*/15));
+    }
+
+    // Most of the nodes are usually intermediate expressions, so these are
+    // freed first and the variables are only reordered if the remaining BDD
+    // has grown past 'reorder_size'.
+    if (bdd->ReorderingDue()) {
+      std::vector<BddNodeIndex> roots;
+      for (const auto& pair : values) {
+        for (const SaturatingBddNodeIndex& value : pair.second) {
+          roots.push_back(absl::get<BddNodeIndex>(value));
+        }
+      }
+      bdd->GarbageCollect(roots);
+      if (bdd->size() >= reorder_size) {
+        int64 size = bdd->size();
+        bdd->Sift(roots);
+        reorder_size = 2 * bdd->size();
+        XLS_VLOG(3) << absl::StreamFormat("Reordered BDD from %d to %d nodes",
+                                          size, bdd->size());
+      }
+      bdd->set_reorder_threshold(std::max(reorder_size, 2 * bdd->size()));
     }
   }
 
   // Copy over the vector and BDD variables into the node map which is exposed
   // via the BddFunction interface. At this point any TooManyMinterm sentinel
   // values have been replaced with new Bdd variables.
+  std::vector<BddNodeIndex> roots;
   for (const auto& pair : values) {
-    bdd_function->node_map_[pair.first] = ToBddNodeVector(pair.second);
+    BddNodeVector& bdd_nodes = (*node_map)[pair.first];
+    bdd_nodes = ToBddNodeVector(pair.second);
+    roots.insert(roots.end(), bdd_nodes.begin(), bdd_nodes.end());
+  }
+
+  // Free the intermediate expressions created while evaluating the nodes.
+  bdd->GarbageCollect(roots);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+/* static */ xabsl::StatusOr<std::unique_ptr<BddFunction>> BddFunction::Run(
+    Function* f, int64 minterm_limit, absl::Span<const Op> do_not_evaluate_ops,
+    int64 num_threads) {
+  XLS_VLOG(1) << absl::StreamFormat("BddFunction::Run(%s):", f->name());
+  XLS_VLOG_LINES(5, f->DumpIr());
+
+  auto bdd_function = absl::WrapUnique(new BddFunction(f));
+  absl::flat_hash_set<Op> do_not_evaluate_ops_set;
+  for (Op op : do_not_evaluate_ops) {
+    do_not_evaluate_ops_set.insert(op);
+  }
+
+  // If we shouldn't evaluate a node, the node is to be modeled as variables,
+  // or the node includes some non-bits-typed operands, then its bits are new
+  // BDD variables.
+  auto is_evaluated = [&](Node* node) {
+    return ShouldEvaluate(node, /*bounded=*/minterm_limit > 0) &&
+           !do_not_evaluate_ops_set.contains(node->op()) &&
+           std::all_of(node->operands().begin(), node->operands().end(),
+                       [](Node* o) { return o->GetType()->IsBits(); });
+  };
+
+  // Cluster each evaluated node with its operands. Clusters share no BDD
+  // variables.
+  std::vector<Node*> nodes;
+  for (Node* node : TopoSort(f)) {
+    if (node->GetType()->IsBits()) {
+      nodes.push_back(node);
+    }
+  }
+  absl::flat_hash_map<Node*, int64> node_indices;
+  for (int64 i = 0; i < nodes.size(); ++i) {
+    node_indices[nodes[i]] = i;
+  }
+  std::vector<UnionFind<int64>> clusters(nodes.size());
+  for (int64 i = 0; i < nodes.size(); ++i) {
+    if (is_evaluated(nodes[i])) {
+      for (Node* operand : nodes[i]->operands()) {
+        clusters[i].Merge(&clusters[node_indices.at(operand)]);
+      }
+    }
+  }
+
+  // Assign the clusters to partitions in the order of their first node.
+  // Clusters smaller than this are grouped into partitions of at least this
+  // many nodes.
+  constexpr int64 kMinPartitionSize = 256;
+  absl::flat_hash_map<UnionFind<int64>*, int64> cluster_partitions;
+  std::vector<std::vector<Node*>> partition_nodes;
+  int64 small_cluster_partition = -1;
+  for (int64 i = 0; i < nodes.size(); ++i) {
+    UnionFind<int64>* cluster = clusters[i].FindRoot();
+    auto it = cluster_partitions.find(cluster);
+    if (it == cluster_partitions.end()) {
+      int64 partition;
+      if (cluster->Size() < kMinPartitionSize &&
+          small_cluster_partition != -1 &&
+          partition_nodes[small_cluster_partition].size() < kMinPartitionSize) {
+        partition = small_cluster_partition;
+      } else {
+        partition = partition_nodes.size();
+        partition_nodes.emplace_back();
+        bdd_function->bdds_.push_back(
+            absl::make_unique<BinaryDecisionDiagram>());
+        if (cluster->Size() < kMinPartitionSize) {
+          small_cluster_partition = partition;
+        }
+      }
+      it = cluster_partitions.insert({cluster, partition}).first;
+    }
+    partition_nodes[it->second].push_back(nodes[i]);
+    bdd_function->partitions_[nodes[i]] = it->second;
+  }
+  XLS_VLOG(2) << absl::StreamFormat("Evaluating %s in %d BDD partitions",
+                                    f->name(), partition_nodes.size());
+
+  // Evaluate the partitions, each into its own node map.
+  int64 partition_count = partition_nodes.size();
+  std::vector<NodeMap> node_maps(partition_count);
+  std::vector<absl::flat_hash_set<Node*>> saturated(partition_count);
+  std::vector<absl::Status> statuses(partition_count);
+  auto evaluate = [&](int64 partition) {
+    statuses[partition] = EvaluatePartition(
+        partition_nodes[partition], is_evaluated, minterm_limit,
+        bdd_function->bdds_[partition].get(), &node_maps[partition],
+        &saturated[partition]);
+  };
+  if (num_threads == 0) {
+    num_threads = absl::base_internal::NumCPUs();
+  }
+  num_threads = std::min(num_threads, partition_count);
+  if (num_threads <= 1) {
+    for (int64 partition = 0; partition < partition_count; ++partition) {
+      evaluate(partition);
+    }
+  } else {
+    std::atomic<int64> next_partition(0);
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int64 i = 0; i < num_threads; ++i) {
+      threads.emplace_back([&]() {
+        for (int64 partition = next_partition.fetch_add(1);
+             partition < partition_count;
+             partition = next_partition.fetch_add(1)) {
+          evaluate(partition);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  for (int64 partition = 0; partition < partition_count; ++partition) {
+    XLS_RETURN_IF_ERROR(statuses[partition]);
+    bdd_function->node_map_.merge(node_maps[partition]);
+    bdd_function->saturated_expressions_.merge(saturated[partition]);
   }
   return std::move(bdd_function);
 }
@@ -312,8 +558,9 @@ xabsl::StatusOr<Value> BddFunction::Evaluate(
     absl::Span<const Value> args) const {
   // Map containing the result of each node.
   absl::flat_hash_map<const Node*, Value> values;
-  // Map of the BDD variable values.
-  absl::flat_hash_map<BddNodeIndex, bool> bdd_variable_values;
+  // Map of the BDD variable values of each partition.
+  std::vector<absl::flat_hash_map<BddNodeIndex, bool>> bdd_variable_values(
+      bdds_.size());
   XLS_RET_CHECK_EQ(args.size(), func_->params().size());
   for (Node* node : TopoSort(func_)) {
     XLS_VLOG(2) << "node: " << node;
@@ -331,11 +578,14 @@ xabsl::StatusOr<Value> BddFunction::Evaluate(
       XLS_ASSIGN_OR_RETURN(result,
                            ir_interpreter::EvaluateNode(node, operand_values));
     } else {
+      int64 partition = partitions_.at(node);
       const BddNodeVector& bdd_vector = node_map_.at(node);
       absl::InlinedVector<bool, 64> bits;
       for (int64 i = 0; i < bdd_vector.size(); ++i) {
-        XLS_ASSIGN_OR_RETURN(bool bit_result,
-                             bdd_.Evaluate(bdd_vector[i], bdd_variable_values));
+        XLS_ASSIGN_OR_RETURN(
+            bool bit_result,
+            bdds_[partition]->Evaluate(bdd_vector[i],
+                                       bdd_variable_values[partition]));
         bits.push_back(bit_result);
       }
       result = Value(Bits(bits));
@@ -345,10 +595,12 @@ xabsl::StatusOr<Value> BddFunction::Evaluate(
     XLS_VLOG(2) << "  result: " << result;
     // Write BDD variable values into the map used for evaluation.
     if (node_map_.contains(node)) {
+      int64 partition = partitions_.at(node);
       const BddNodeVector& bdd_vector = node_map_.at(node);
       for (int64 i = 0; i < bdd_vector.size(); ++i) {
-        if (bdd_.IsVariableBaseNode(bdd_vector.at(i))) {
-          bdd_variable_values[bdd_vector.at(i)] = result.bits().Get(i);
+        if (bdds_[partition]->IsVariableBaseNode(bdd_vector.at(i))) {
+          bdd_variable_values[partition][bdd_vector.at(i)] =
+              result.bits().Get(i);
         }
       }
     }
@@ -15,7 +15,12 @@
 #ifndef XLS_PASSES_BDD_FUNCTION_H_
 #define XLS_PASSES_BDD_FUNCTION_H_
 
+#include <memory>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/statusor.h"
 #include "xls/data_structures/binary_decision_diagram.h"
@@ -32,13 +37,23 @@ using NodeMap = absl::flat_hash_map<const Node*, BddNodeVector>;
 // (BDD). The BDD is constructed by an abstract evaluation of the operations in
 // the function using compositions of the And/Or/Not functions of the BDD. Only
 // a subset of the function's nodes are evaluated with the BDD (defined by
-// BddFunction::IsExpressedInBdd). For example, arithmetic operations are not
-// evaluated as they generally produce very large BDDs. Non-bits types are
-// skipped as well.
+// BddFunction::IsExpressedInBdd). For example, multiplications and divisions
+// are not evaluated as they generally produce very large BDDs. Additions and
+// comparisons of two non-literal values are only evaluated with a minterm
+// limit; the variables of their operands are then interleaved, and the BDD is
+// reordered by sifting as it grows. Non-bits types are skipped as well.
 //
 // For each bits-typed XLS Node, BddFunction holds a BddNodeVector which is a
 // vector of BDD nodes corresponding to the expression for each bit in the XLS
 // Node output.
+//
+// The nodes are split into partitions which share no BDD variables, each with
+// its own BinaryDecisionDiagram: two nodes are in the same partition if one is
+// evaluated from the other, directly or indirectly. Bits in different
+// partitions are independent of each other, so the partitions can be built
+// concurrently and each BDD only holds the expressions of its partition.
+// Small partitions are grouped together to avoid the overhead of many small
+// BDDs.
 class BddFunction {
  public:
   // Construct a BDD representing the given function. 'minterm_limit' is an
@@ -47,16 +62,28 @@ class BddFunction {
   // exceeds this value the bit's representation in the BDD is replaced with a
   // new BDD variable. If a node's op is in 'do_not_evaluate_ops', its
   // bits are modeled as BDD variables. Otherwise, bits are represented as BDD
-  // nodes whose values are determined by the values of other BDD nodes.
+  // nodes whose values are determined by the values of other BDD nodes. The
+  // partitions are built using up to 'num_threads' threads; zero means one per
+  // CPU. The result does not depend on the number of threads.
   static xabsl::StatusOr<std::unique_ptr<BddFunction>> Run(
       Function* f, int64 minterm_limit = 0,
-      absl::Span<const Op> do_not_evaluate_ops = {});
+      absl::Span<const Op> do_not_evaluate_ops = {}, int64 num_threads = 1);
 
-  // Returns the underlying BDD.
-  const BinaryDecisionDiagram& bdd() const { return bdd_; }
-  BinaryDecisionDiagram& bdd() { return bdd_; }
+  // Returns the number of partitions and the BDD of the given partition.
+  int64 partition_count() const { return bdds_.size(); }
+  const BinaryDecisionDiagram& bdd(int64 partition) const {
+    return *bdds_.at(partition);
+  }
+  BinaryDecisionDiagram& bdd(int64 partition) { return *bdds_.at(partition); }
 
-  // Returns the node associated with the given bit.
+  // Returns the partition holding the expressions of the given node.
+  int64 GetPartition(Node* node) const {
+    XLS_CHECK(node->GetType()->IsBits());
+    return partitions_.at(node);
+  }
+
+  // Returns the node associated with the given bit in the BDD of the node's
+  // partition.
   BddNodeIndex GetBddNode(Node* node, int64 bit_index) const {
     XLS_CHECK(node->GetType()->IsBits());
     return node_map_.at(node).at(bit_index);
@@ -72,7 +99,10 @@ class BddFunction {
   explicit BddFunction(Function* f) : func_(f) {}
 
   Function* func_;
-  BinaryDecisionDiagram bdd_;
+  std::vector<std::unique_ptr<BinaryDecisionDiagram>> bdds_;
+
+  // A map from bits-typed XLS Node to the index of its partition.
+  absl::flat_hash_map<const Node*, int64> partitions_;
 
   // A map from XLS Node to vector of BDD nodes representing the XLS Node's
   // expression.
@@ -67,7 +67,8 @@ TEST_F(BddFunctionTest, AndNot) {
   // AND of a value and its inverse should be zero.
   for (int64 i = 0; i < 8; ++i) {
     EXPECT_EQ(bdd_function->GetBddNode(f->return_value(), i),
-              bdd_function->bdd().zero());
+              bdd_function->bdd(bdd_function->GetPartition(f->return_value()))
+                  .zero());
   }
 
   EXPECT_THAT(bdd_function->Evaluate({Value(UBits(0b11000011, 8))}),
@@ -105,6 +106,71 @@ TEST_F(BddFunctionTest, Parity) {
   }
 }
 
+TEST_F(BddFunctionTest, IndependentConesArePartitioned) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  // Build two large cones which share no nodes.
+  std::vector<BValue> cones;
+  for (absl::string_view name : {"x", "y"}) {
+    BValue param = fb.Param(name, p->GetBitsType(8));
+    BValue value = param;
+    for (int64 i = 0; i < 300; ++i) {
+      value = i % 2 == 0 ? fb.Not(fb.Xor(value, param))
+                         : fb.Or(fb.Add(value, value), fb.And(value, param));
+    }
+    cones.push_back(value);
+  }
+  fb.Tuple(cones);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  std::minstd_rand engine;
+  for (int64 num_threads : {1, 4}) {
+    XLS_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<BddFunction> bdd_function,
+        BddFunction::Run(f, /*minterm_limit=*/0, /*do_not_evaluate_ops=*/{},
+                         num_threads));
+    EXPECT_EQ(bdd_function->partition_count(), 2);
+    EXPECT_NE(bdd_function->GetPartition(cones[0].node()),
+              bdd_function->GetPartition(cones[1].node()));
+    for (int64 i = 0; i < 32; ++i) {
+      std::vector<Value> inputs = RandomFunctionArguments(f, &engine);
+      XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(f, inputs));
+      XLS_ASSERT_OK_AND_ASSIGN(Value actual, bdd_function->Evaluate(inputs));
+      EXPECT_EQ(expected, actual);
+    }
+  }
+}
+
+TEST_F(BddFunctionTest, ArithmeticWithMintermLimit) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  Type* t = p->GetBitsType(6);
+  BValue x = fb.Param("x", t);
+  BValue y = fb.Param("y", t);
+  BValue sum = fb.Add(x, y);
+  BValue commuted = fb.Eq(sum, fb.Add(y, x));
+  BValue difference = fb.Eq(fb.Subtract(sum, y), x);
+  fb.Tuple({commuted, difference, fb.ULt(x, sum), fb.Negate(x)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  // The minterm counts of the adders' bits triple with each bit, so the
+  // identities are proven as long as the operands are narrow enough.
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<BddFunction> bdd_function,
+                           BddFunction::Run(f, /*minterm_limit=*/4096));
+  const BinaryDecisionDiagram& bdd =
+      bdd_function->bdd(bdd_function->GetPartition(sum.node()));
+  EXPECT_EQ(bdd_function->GetBddNode(commuted.node(), 0), bdd.one());
+  EXPECT_EQ(bdd_function->GetBddNode(difference.node(), 0), bdd.one());
+
+  std::minstd_rand engine;
+  for (int64 i = 0; i < 100; ++i) {
+    std::vector<Value> inputs = RandomFunctionArguments(f, &engine);
+    XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(f, inputs));
+    XLS_ASSERT_OK_AND_ASSIGN(Value actual, bdd_function->Evaluate(inputs));
+    EXPECT_EQ(expected, actual);
+  }
+}
+
 TEST_F(BddFunctionTest, BenchmarkTest) {
   // Run samples through various bechmarks and verify against the interpreter.
   for (std::string benchmark : {"crc32", "sha256"}) {
@@ -14,6 +14,10 @@
 
 #include "xls/passes/bdd_query_engine.h"
 
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "xls/common/logging/logging.h"
@@ -24,32 +28,48 @@
 
 namespace xls {
 
+namespace {
+
+// Returns the given bits grouped by BDD partition, in order of first
+// appearance.
+template <typename GetPartitionFn>
+std::vector<std::pair<int64, std::vector<BitLocation>>> GroupByPartition(
+    absl::Span<BitLocation const> bits, GetPartitionFn get_partition) {
+  std::vector<std::pair<int64, std::vector<BitLocation>>> groups;
+  absl::flat_hash_map<int64, int64> group_indices;
+  for (const BitLocation& location : bits) {
+    int64 partition = get_partition(location);
+    auto it = group_indices.find(partition);
+    if (it == group_indices.end()) {
+      it = group_indices.insert({partition, groups.size()}).first;
+      groups.push_back({partition, {}});
+    }
+    groups[it->second].second.push_back(location);
+  }
+  return groups;
+}
+
+}  // namespace
+
 /* static */
 xabsl::StatusOr<std::unique_ptr<BddQueryEngine>> BddQueryEngine::Run(
-    Function* f, int64 minterm_limit,
-    absl::Span<const Op> do_not_evaluate_ops) {
+    Function* f, int64 minterm_limit, absl::Span<const Op> do_not_evaluate_ops,
+    int64 num_threads) {
   auto query_engine = absl::WrapUnique(new BddQueryEngine(minterm_limit));
   XLS_ASSIGN_OR_RETURN(query_engine->bdd_function_,
-                       BddFunction::Run(f, minterm_limit, do_not_evaluate_ops));
+                       BddFunction::Run(f, minterm_limit, do_not_evaluate_ops,
+                                        num_threads));
   // Construct the Bits objects indication which bit values are statically known
   // for each node and what those values are (0 or 1) if known.
-  BinaryDecisionDiagram& bdd = query_engine->bdd();
   for (Node* node : f->nodes()) {
     if (node->GetType()->IsBits()) {
       absl::InlinedVector<bool, 1> known_bits;
       absl::InlinedVector<bool, 1> bits_values;
       for (int64 i = 0; i < node->BitCountOrDie(); ++i) {
-        if (query_engine->GetBddNode(BitLocation(node, i)) == bdd.zero()) {
-          known_bits.push_back(true);
-          bits_values.push_back(false);
-        } else if (query_engine->GetBddNode(BitLocation(node, i)) ==
-                   bdd.one()) {
-          known_bits.push_back(true);
-          bits_values.push_back(true);
-        } else {
-          known_bits.push_back(false);
-          bits_values.push_back(false);
-        }
+        absl::optional<bool> value =
+            query_engine->KnownValue(BitLocation(node, i));
+        known_bits.push_back(value.has_value());
+        bits_values.push_back(value.value_or(false));
       }
       query_engine->known_bits_[node] = Bits(known_bits);
       query_engine->bits_values_[node] = Bits(bits_values);
@@ -58,58 +78,112 @@ xabsl::StatusOr<std::unique_ptr<BddQueryEngine>> BddQueryEngine::Run(
   return std::move(query_engine);
 }
 
+absl::optional<bool> BddQueryEngine::KnownValue(
+    const BitLocation& location) const {
+  BinaryDecisionDiagram& partition_bdd = bdd(GetPartition(location));
+  if (GetBddNode(location) == partition_bdd.zero()) {
+    return false;
+  }
+  if (GetBddNode(location) == partition_bdd.one()) {
+    return true;
+  }
+  return absl::nullopt;
+}
+
 bool BddQueryEngine::AtMostOneTrue(absl::Span<BitLocation const> bits) const {
-  BddNodeIndex result = bdd().zero();
   for (int64 i = 0; i < bits.size(); ++i) {
     if (!IsTracked(bits[i].node)) {
       return false;
     }
   }
-  // Compute the OR-reduction of a pairwise AND of all bits. If this value is
-  // zero then no two bits can be simultaneously true. Equivalently: at most one
-  // bit is true.
-  for (int64 i = 0; i < bits.size(); ++i) {
-    for (int64 j = i + 1; j < bits.size(); ++j) {
-      result =
-          bdd().Or(result, bdd().And(GetBddNode(bits[i]), GetBddNode(bits[j])));
-      if (ExceedsMintermLimit(result)) {
-        XLS_VLOG(3) << "AtMostOneTrue exceeded minterm limit of "
-                    << minterm_limit_;
-        return false;
+  // Bits in different partitions are independent, so at most one bit is true
+  // if at most one bit is true within each partition and the bits of at most
+  // one partition can be true at all.
+  auto groups = GroupByPartition(bits, [&](const BitLocation& location) {
+    return GetPartition(location);
+  });
+  int64 partitions_which_can_be_true = 0;
+  for (const auto& [partition, group] : groups) {
+    BinaryDecisionDiagram& partition_bdd = bdd(partition);
+    // Compute the OR-reduction of a pairwise AND of all bits. If this value is
+    // zero then no two bits can be simultaneously true. Equivalently: at most
+    // one bit is true.
+    BddNodeIndex result = partition_bdd.zero();
+    for (int64 i = 0; i < group.size(); ++i) {
+      for (int64 j = i + 1; j < group.size(); ++j) {
+        result = partition_bdd.Or(
+            result,
+            partition_bdd.And(GetBddNode(group[i]), GetBddNode(group[j])));
+        if (ExceedsMintermLimit(partition, result)) {
+          XLS_VLOG(3) << "AtMostOneTrue exceeded minterm limit of "
+                      << minterm_limit_;
+          return false;
+        }
+      }
+    }
+    if (result != partition_bdd.zero()) {
+      return false;
+    }
+    if (groups.size() > 1) {
+      BddNodeIndex any_true = partition_bdd.zero();
+      for (const BitLocation& location : group) {
+        any_true = partition_bdd.Or(any_true, GetBddNode(location));
+      }
+      if (any_true != partition_bdd.zero()) {
+        ++partitions_which_can_be_true;
       }
     }
   }
-  return result == bdd().zero();
+  return partitions_which_can_be_true <= 1;
 }
 
 bool BddQueryEngine::AtLeastOneTrue(absl::Span<BitLocation const> bits) const {
-  BddNodeIndex result = bdd().zero();
-  // At least one bit is true is equivalent to an OR-reduction of all the bits.
   for (const BitLocation& location : bits) {
     if (!IsTracked(location.node)) {
       return false;
     }
-    result = bdd().Or(result, GetBddNode(location));
-    if (ExceedsMintermLimit(result)) {
-      XLS_VLOG(3) << "AtLeastOneTrue exceeded minterm limit of "
-                  << minterm_limit_;
-      return false;
+  }
+  // At least one bit is true is equivalent to an OR-reduction of all the bits.
+  // Bits in different partitions are independent, so this holds if it holds
+  // for the bits of one partition.
+  auto groups = GroupByPartition(bits, [&](const BitLocation& location) {
+    return GetPartition(location);
+  });
+  for (const auto& [partition, group] : groups) {
+    BinaryDecisionDiagram& partition_bdd = bdd(partition);
+    BddNodeIndex result = partition_bdd.zero();
+    for (const BitLocation& location : group) {
+      result = partition_bdd.Or(result, GetBddNode(location));
+      if (ExceedsMintermLimit(partition, result)) {
+        XLS_VLOG(3) << "AtLeastOneTrue exceeded minterm limit of "
+                    << minterm_limit_;
+        break;
+      }
+    }
+    if (result == partition_bdd.one()) {
+      return true;
     }
   }
-  return result == bdd().one();
+  return false;
 }
 
-bool BddQueryEngine::Implies(const BddNodeIndex& a,
+bool BddQueryEngine::Implies(int64 partition, const BddNodeIndex& a,
                              const BddNodeIndex& b) const {
   // A implies B  <=>  !(A && !B)
-  return bdd().And(a, bdd().Not(b)) == bdd().zero();
+  BinaryDecisionDiagram& partition_bdd = bdd(partition);
+  return partition_bdd.And(a, partition_bdd.Not(b)) == partition_bdd.zero();
 }
 
 bool BddQueryEngine::Implies(const BitLocation& a, const BitLocation& b) const {
   if (!IsTracked(a.node) || !IsTracked(b.node)) {
     return false;
   }
-  return Implies(GetBddNode(a), GetBddNode(b));
+  if (GetPartition(a) != GetPartition(b)) {
+    absl::optional<bool> a_value = KnownValue(a);
+    absl::optional<bool> b_value = KnownValue(b);
+    return a_value == false || b_value == true;
+  }
+  return Implies(GetPartition(a), GetBddNode(a), GetBddNode(b));
 }
 
 absl::optional<Bits> BddQueryEngine::ImpliedNodeValue(
@@ -119,27 +193,39 @@ absl::optional<Bits> BddQueryEngine::ImpliedNodeValue(
     return absl::nullopt;
   }
 
-  // Create a Bdd node for the predicate_bit_values.
-  BddNodeIndex bdd_predicate_bit = bdd().one();
+  // Create a Bdd node for the predicate_bit_values in each partition.
+  absl::flat_hash_map<int64, BddNodeIndex> bdd_predicate_bits;
   for (const auto& [conjuction_bit_location, conjunction_value] :
        predicate_bit_values) {
+    int64 partition = GetPartition(conjuction_bit_location);
+    BinaryDecisionDiagram& partition_bdd = bdd(partition);
+    auto it =
+        bdd_predicate_bits.insert({partition, partition_bdd.one()}).first;
     BddNodeIndex conjuction_bit = GetBddNode(conjuction_bit_location);
     conjuction_bit =
-        conjunction_value ? conjuction_bit : bdd().Not(conjuction_bit);
-    bdd_predicate_bit = bdd().And(bdd_predicate_bit, conjuction_bit);
+        conjunction_value ? conjuction_bit : partition_bdd.Not(conjuction_bit);
+    it->second = partition_bdd.And(it->second, conjuction_bit);
   }
   // If the predicate evaluates to false, we can't determine
   // what node value it implies. That is, !predicate || node_bit
   // evaluates to true for both node_bit == 1 and == 0.
-  if (bdd_predicate_bit == bdd().zero()) {
-    return absl::nullopt;
+  for (const auto& [partition, bdd_predicate_bit] : bdd_predicate_bits) {
+    if (bdd_predicate_bit == bdd(partition).zero()) {
+      return absl::nullopt;
+    }
   }
 
+  // The predicate bits in other partitions are independent of the node.
+  int64 partition = bdd_function_->GetPartition(node);
+  BinaryDecisionDiagram& partition_bdd = bdd(partition);
+  BddNodeIndex bdd_predicate_bit = bdd_predicate_bits.contains(partition)
+                                       ? bdd_predicate_bits.at(partition)
+                                       : partition_bdd.one();
   auto implied_true_or_false = [&](int node_idx, bool node_bit_true) {
     BddNodeIndex bdd_node_bit = GetBddNode({node, node_idx});
     BddNodeIndex qualified_bdd_node_bit =
-        node_bit_true ? bdd_node_bit : bdd().Not(bdd_node_bit);
-    return Implies(bdd_predicate_bit, qualified_bdd_node_bit);
+        node_bit_true ? bdd_node_bit : partition_bdd.Not(bdd_node_bit);
+    return Implies(partition, bdd_predicate_bit, qualified_bdd_node_bit);
   };
 
   // Check if bdd_predicate_bit implies that node has a particular value for
@@ -164,6 +250,10 @@ bool BddQueryEngine::KnownEquals(const BitLocation& a,
   if (!IsTracked(a.node) || !IsTracked(b.node)) {
     return false;
   }
+  if (GetPartition(a) != GetPartition(b)) {
+    absl::optional<bool> a_value = KnownValue(a);
+    return a_value.has_value() && a_value == KnownValue(b);
+  }
   return GetBddNode(a) == GetBddNode(b);
 }
 
@@ -172,7 +262,12 @@ bool BddQueryEngine::KnownNotEquals(const BitLocation& a,
   if (!IsTracked(a.node) || !IsTracked(b.node)) {
     return false;
   }
-  return GetBddNode(a) == bdd().Not(GetBddNode(b));
+  if (GetPartition(a) != GetPartition(b)) {
+    absl::optional<bool> a_value = KnownValue(a);
+    absl::optional<bool> b_value = KnownValue(b);
+    return a_value.has_value() && b_value.has_value() && *a_value != *b_value;
+  }
+  return GetBddNode(a) == bdd(GetPartition(a)).Not(GetBddNode(b));
 }
 
 }  // namespace xls
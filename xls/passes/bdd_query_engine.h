@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/types/optional.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/bits.h"
 #include "xls/ir/function.h"
@@ -34,15 +35,21 @@ namespace xls {
 // particular for some operations such as arithmetic and comparison
 // operations. For this reason, these operations are generally excluded from the
 // analysis.
+//
+// Queries are answered in the BDD partitions of the bits involved (see
+// BddFunction). Bits in different partitions are independent, so, e.g., one
+// only implies the other if the first is known to be zero or the second is
+// known to be one.
 class BddQueryEngine : public QueryEngine {
  public:
   // 'minterm_limit' is the maximum number of minterms to allow in a BDD
   // expression before truncating it. If a node's op is in
-  // 'do_not_evaluate_ops', its bits are modeled as BDD variables. See
-  // BddFunction for details.
+  // 'do_not_evaluate_ops', its bits are modeled as BDD variables. The BDD
+  // partitions are built using up to 'num_threads' threads. See BddFunction
+  // for details.
   static xabsl::StatusOr<std::unique_ptr<BddQueryEngine>> Run(
       Function* f, int64 minterm_limit = 0,
-      absl::Span<const Op> do_not_evaluate_ops = {});
+      absl::Span<const Op> do_not_evaluate_ops = {}, int64 num_threads = 1);
 
   bool IsTracked(Node* node) const override {
     return known_bits_.contains(node);
@@ -72,28 +79,39 @@ class BddQueryEngine : public QueryEngine {
   explicit BddQueryEngine(int64 minterm_limit)
       : minterm_limit_(minterm_limit) {}
 
-  // Returns the underlying BDD. This method is const, but queries on a BDD
-  // generally mutate the object. We sneakily avoid conflicts with C++ const
-  // because the BDD is only held indirectly via pointers.
+  // Returns the BDD of the given partition. This method is const, but queries
+  // on a BDD generally mutate the object. We sneakily avoid conflicts with C++
+  // const because the BDD is only held indirectly via pointers.
   // TODO(meheff): Enable queries on a BDD with out mutating the BDD itself.
-  BinaryDecisionDiagram& bdd() const { return bdd_function_->bdd(); }
+  BinaryDecisionDiagram& bdd(int64 partition) const {
+    return bdd_function_->bdd(partition);
+  }
+
+  // Returns the BDD partition of the given bit.
+  int64 GetPartition(const BitLocation& location) const {
+    return bdd_function_->GetPartition(location.node);
+  }
 
   // Returns the BDD node associated with the given bit.
   BddNodeIndex GetBddNode(const BitLocation& location) const {
     return bdd_function_->GetBddNode(location.node, location.bit_index);
   }
 
+  // Returns the value of the given bit if it is known.
+  absl::optional<bool> KnownValue(const BitLocation& location) const;
+
   // A implies B  <=>  !(A && !B)
-  bool Implies(const BddNodeIndex& a, const BddNodeIndex& b) const;
+  bool Implies(int64 partition, const BddNodeIndex& a,
+               const BddNodeIndex& b) const;
 
   // Returns true if the expression of the given BDD node exceeds the minterm
   // limit.
   // TODO(meheff): This should be part of the BDD itself where a query can be
   // performed and the BDD method returns a union of minterm limit exceeded or
   // the result of the query.
-  bool ExceedsMintermLimit(BddNodeIndex node) const {
+  bool ExceedsMintermLimit(int64 partition, BddNodeIndex node) const {
     return minterm_limit_ > 0 &&
-           bdd().GetNode(node).minterm_count > minterm_limit_;
+           bdd(partition).minterm_count(node) > minterm_limit_;
   }
 
   // The maximum number of minterms in expression in the BDD before truncating.
@@ -43,6 +43,16 @@ class BddQueryEngineTest : public IrTestBase {
   bool KnownNotEquals(const QueryEngine& engine, Node* a, Node* b) {
     return engine.KnownNotEquals(BitLocation(a, 0), BitLocation(b, 0));
   }
+
+  // Returns a value computed from 'x' by enough nodes that it is placed in its
+  // own BDD partition.
+  BValue LargeCone(FunctionBuilder* fb, BValue x) {
+    BValue value = x;
+    for (int64 i = 0; i < 300; ++i) {
+      value = fb->Xor(fb->Not(value), x);
+    }
+    return value;
+  }
 };
 
 TEST_F(BddQueryEngineTest, EqualToPredicates) {
@@ -266,6 +276,56 @@ TEST_F(BddQueryEngineTest, ForceNodeToBeModeledAsVariable) {
       KnownEquals(*query_engine_empty_op_set, orop.node(), my_zero.node()));
 }
 
+TEST_F(BddQueryEngineTest, QueriesAcrossPartitions) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(1));
+  BValue y = fb.Param("y", p->GetBitsType(1));
+  BValue x_cone = LargeCone(&fb, x);
+  BValue y_cone = LargeCone(&fb, y);
+  BValue x_zero = fb.And(x_cone, fb.Not(x_cone));
+  BValue y_zero = fb.And(y_cone, fb.Not(y_cone));
+  BValue y_one = fb.Not(y_zero);
+  fb.Tuple({x_zero, y_one});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(auto query_engine,
+                           BddQueryEngine::Run(f, /*minterm_limit=*/0,
+                                               /*do_not_evaluate_ops=*/{},
+                                               /*num_threads=*/2));
+  ASSERT_EQ(query_engine->bdd_function().partition_count(), 2);
+
+  EXPECT_TRUE(KnownEquals(*query_engine, x_zero.node(), y_zero.node()));
+  EXPECT_TRUE(KnownNotEquals(*query_engine, x_zero.node(), y_one.node()));
+  EXPECT_FALSE(KnownEquals(*query_engine, x_cone.node(), y_cone.node()));
+  EXPECT_FALSE(KnownNotEquals(*query_engine, x_cone.node(), y_cone.node()));
+
+  EXPECT_TRUE(Implies(*query_engine, x_zero.node(), y_cone.node()));
+  EXPECT_TRUE(Implies(*query_engine, x_cone.node(), y_one.node()));
+  EXPECT_FALSE(Implies(*query_engine, x_cone.node(), y_cone.node()));
+
+  EXPECT_TRUE(
+      query_engine->AtMostOneNodeTrue({x_cone.node(), y_zero.node()}));
+  EXPECT_FALSE(
+      query_engine->AtMostOneNodeTrue({x_cone.node(), y_cone.node()}));
+  EXPECT_TRUE(query_engine->AtLeastOneNodeTrue({x_cone.node(), y_one.node()}));
+  EXPECT_FALSE(
+      query_engine->AtLeastOneNodeTrue({x_cone.node(), y_cone.node()}));
+
+  // A predicate on 'y' tells nothing about 'x' unless it is unsatisfiable.
+  EXPECT_FALSE(query_engine
+                   ->ImpliedNodeValue({{{y_cone.node(), 0}, true}},
+                                      x_cone.node())
+                   .has_value());
+  EXPECT_FALSE(query_engine
+                   ->ImpliedNodeValue({{{y_one.node(), 0}, false}},
+                                      x_cone.node())
+                   .has_value());
+  auto result = query_engine->ImpliedNodeValue(
+      {{{y_cone.node(), 0}, true}, {{x.node(), 0}, true}}, x_cone.node());
+  EXPECT_TRUE(result.has_value());
+  EXPECT_THAT(result.value().ToBitVector(), testing::ElementsAre(true));
+}
+
 TEST_F(BddQueryEngineTest, BitValuesImplyNodeValuePredicateAlwaysFalse) {
   auto p = CreatePackage();
   FunctionBuilder fb(TestName(), p.get());
@@ -35,6 +35,7 @@
 #include "xls/passes/bdd_query_engine.h"
 #include "xls/passes/post_dominator_analysis.h"
 #include "xls/passes/query_engine.h"
+#include "xls/passes/query_engine_cache.h"
 
 namespace xls {
 
@@ -322,15 +323,15 @@ xabsl::StatusOr<bool> SimplifyNode(Node* node, const QueryEngine& query_engine,
   return false;
 }
 
-xabsl::StatusOr<bool> SimplifyOneHotMsb(Function* f) {
+xabsl::StatusOr<bool> SimplifyOneHotMsb(Function* f,
+                                        QueryEngineCache* query_engine_cache) {
   // TODO(meheff): 2020-08-24 Disabled for debugging of crasher
   // xls/dslx/fuzzer/crashers/2020-08-24-min.x
   return false;
 #if 0
   bool changed = false;
-  XLS_ASSIGN_OR_RETURN(
-      std::unique_ptr<PostDominatorAnalysis> post_dominator_analysis,
-      PostDominatorAnalysis::Run(f));
+  XLS_ASSIGN_OR_RETURN(PostDominatorAnalysis * post_dominator_analysis,
+                       query_engine_cache->GetPostDominatorAnalysis(f));
   // We performa a variant of bdd analysis without analyzing OneHot nodes. This
   // is because we will check if a OneHot's MSB = 0 and LSBs = {0,...} implies
   // the same value for another node as MSB = 1 and LSBs = {0,...}.  However,
@@ -342,11 +343,12 @@ xabsl::StatusOr<bool> SimplifyOneHotMsb(Function* f) {
   // this is not necessary for the case MSB = 1. Performing BDD analysis
   // including OneHots in this case gives more information / opens up more
   // optimization opportunities.
+  XLS_ASSIGN_OR_RETURN(BddQueryEngine * bdd_query_engine_minus_one_hot,
+                       query_engine_cache->GetBddQueryEngine(
+                           f, /*minterm_limit=*/4096, {Op::kOneHot}));
   XLS_ASSIGN_OR_RETURN(
-      std::unique_ptr<BddQueryEngine> bdd_query_engine_minus_one_hot,
-      BddQueryEngine::Run(f, /*minterm_limit=*/4096, {Op::kOneHot}));
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<BddQueryEngine> bdd_query_engine_default,
-                       BddQueryEngine::Run(f, /*minterm_limit=*/4096));
+      BddQueryEngine * bdd_query_engine_default,
+      query_engine_cache->GetBddQueryEngine(f, /*minterm_limit=*/4096));
 
   for (Node* node : f->nodes()) {
     // Check if one-hot's MSB affect the function's output.
@@ -446,17 +448,27 @@ xabsl::StatusOr<bool> BddSimplificationPass::RunOnFunction(
   XLS_VLOG(3) << "Before:";
   XLS_VLOG_LINES(3, f->DumpIr());
 
-  // TODO(meheff): Try tuning the minterm limit.
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<BddQueryEngine> query_engine,
-                       BddQueryEngine::Run(f, /*minterm_limit=*/4096));
-
+  if (options.DeadlineExceeded()) {
+    return false;
+  }
   bool one_hot_modified = false;
   if (split_ops_) {
-    XLS_ASSIGN_OR_RETURN(one_hot_modified, SimplifyOneHotMsb(f));
+    XLS_ASSIGN_OR_RETURN(one_hot_modified,
+                         SimplifyOneHotMsb(f, &results->query_engine_cache));
   }
 
+  // Requested only after SimplifyOneHotMsb, which requests (and so may replace)
+  // cached BDD engines for this function itself.
+  XLS_ASSIGN_OR_RETURN(BddQueryEngine * query_engine,
+                       results->query_engine_cache.GetBddQueryEngine(
+                           f, BddMintermLimit(f, options),
+                           /*do_not_evaluate_ops=*/{}, options.num_threads));
+
   bool modified = false;
   for (Node* node : TopoSort(f)) {
+    if (options.DeadlineExceeded()) {
+      break;
+    }
     XLS_ASSIGN_OR_RETURN(bool node_modified,
                          SimplifyNode(node, *query_engine, split_ops_));
     modified |= node_modified;
@@ -270,4 +270,10 @@ xabsl::StatusOr<bool> BitSliceSimplificationPass::RunOnFunction(
   return changed;
 }
 
+xabsl::StatusOr<bool> BitSliceSimplificationRule::Rewrite(Node* node) const {
+  // Newly created bit slices are visited by the NodeRewritePass anyway.
+  std::deque<BitSlice*> worklist;
+  return SimplifyBitSlice(node->As<BitSlice>(), &worklist);
+}
+
 }  // namespace xls
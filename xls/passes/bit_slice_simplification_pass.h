@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -33,6 +34,16 @@ class BitSliceSimplificationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the simplifications of BitSliceSimplificationPass to a single node.
+class BitSliceSimplificationRule : public NodeRewriteRule {
+ public:
+  BitSliceSimplificationRule() : NodeRewriteRule("bitslice_simp") {}
+
+  bool AppliesTo(Op op) const override { return op == Op::kBitSlice; }
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_BIT_SLICE_SIMPLIFICATION_PASS_H_
@@ -130,4 +130,8 @@ xabsl::StatusOr<bool> CanonicalizationPass::RunOnFunction(
   return changed;
 }
 
+xabsl::StatusOr<bool> CanonicalizationRule::Rewrite(Node* node) const {
+  return CanonicalizeNodes(node, node->function());
+}
+
 }  // namespace xls
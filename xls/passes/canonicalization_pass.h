@@ -19,6 +19,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -37,6 +38,14 @@ class CanonicalizationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the canonicalizations of CanonicalizationPass to a single node.
+class CanonicalizationRule : public NodeRewriteRule {
+ public:
+  CanonicalizationRule() : NodeRewriteRule("canon") {}
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_CANONICALIZATION_PASS_H_
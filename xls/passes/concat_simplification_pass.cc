@@ -509,4 +509,25 @@ xabsl::StatusOr<bool> ConcatSimplificationPass::RunOnFunction(
   return changed;
 }
 
+xabsl::StatusOr<bool> ConcatSimplificationRule::Rewrite(Node* node) const {
+  if (node->Is<Concat>()) {
+    // Newly created concats are visited by the NodeRewritePass anyway.
+    std::deque<Concat*> worklist;
+    XLS_ASSIGN_OR_RETURN(bool changed,
+                         SimplifyConcat(node->As<Concat>(), &worklist));
+    if (changed) {
+      return true;
+    }
+  }
+  if (OpIsBitWise(node->op())) {
+    return TryHoistBitWiseOperation(node);
+  }
+  XLS_ASSIGN_OR_RETURN(bool distribute_changed,
+                       TryDistributeReducibleOperation(node));
+  if (distribute_changed) {
+    return true;
+  }
+  return TryBypassReductionOfConcatenation(node);
+}
+
 }  // namespace xls
@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -33,6 +34,14 @@ class ConcatSimplificationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the simplifications of ConcatSimplificationPass to a single node.
+class ConcatSimplificationRule : public NodeRewriteRule {
+ public:
+  ConcatSimplificationRule() : NodeRewriteRule("concat_simp") {}
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_CONCAT_SIMPLIFICATION_PASS_H_
@@ -20,6 +20,26 @@
 #include "xls/ir/node_iterator.h"
 
 namespace xls {
+namespace {
+
+// Replaces the given node with a literal if all of its operands are literals.
+// Returns whether the node was replaced.
+xabsl::StatusOr<bool> FoldNode(Node* node) {
+  // TODO(meheff): 2019/6/26 Consider not folding loops with large trip counts
+  // to avoid hanging at compile time.
+  if (node->operand_count() > 0 &&
+      std::all_of(node->operands().begin(), node->operands().end(),
+                  [](Node* o) { return o->Is<Literal>(); })) {
+    XLS_VLOG(2) << "Folding: " << *node;
+    XLS_ASSIGN_OR_RETURN(Value result,
+                         ir_interpreter::EvaluateNodeWithLiteralOperands(node));
+    XLS_RETURN_IF_ERROR(node->ReplaceUsesWithNew<Literal>(result).status());
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
 
 xabsl::StatusOr<bool> ConstantFoldingPass::RunOnFunction(
     Function* f, const PassOptions& options, PassResults* results) const {
@@ -28,17 +48,8 @@ xabsl::StatusOr<bool> ConstantFoldingPass::RunOnFunction(
   XLS_VLOG_LINES(3, f->DumpIr());
   bool changed = false;
   for (Node* node : TopoSort(f)) {
-    // TODO(meheff): 2019/6/26 Consider not folding loops with large trip counts
-    // to avoid hanging at compile time.
-    if (node->operand_count() > 0 &&
-        std::all_of(node->operands().begin(), node->operands().end(),
-                    [](Node* o) { return o->Is<Literal>(); })) {
-      XLS_VLOG(2) << "Folding: " << *node;
-      XLS_ASSIGN_OR_RETURN(
-          Value result, ir_interpreter::EvaluateNodeWithLiteralOperands(node));
-      XLS_RETURN_IF_ERROR(node->ReplaceUsesWithNew<Literal>(result).status());
-      changed = true;
-    }
+    XLS_ASSIGN_OR_RETURN(bool node_changed, FoldNode(node));
+    changed |= node_changed;
   }
 
   XLS_VLOG(3) << "After:";
@@ -47,4 +58,8 @@ xabsl::StatusOr<bool> ConstantFoldingPass::RunOnFunction(
   return changed;
 }
 
+xabsl::StatusOr<bool> ConstantFoldingRule::Rewrite(Node* node) const {
+  return FoldNode(node);
+}
+
 }  // namespace xls
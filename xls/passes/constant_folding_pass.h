@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -32,6 +33,14 @@ class ConstantFoldingPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the folding of ConstantFoldingPass to a single node.
+class ConstantFoldingRule : public NodeRewriteRule {
+ public:
+  ConstantFoldingRule() : NodeRewriteRule("const_fold") {}
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_CONSTANT_FOLDING_PASS_H_
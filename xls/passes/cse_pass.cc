@@ -40,6 +40,11 @@ xabsl::StatusOr<bool> CsePass::RunOnFunction(Function* f,
   absl::flat_hash_map<int64, std::vector<Node*>> node_buckets;
   node_buckets.reserve(f->node_count());
   for (Node* node : TopoSort(f)) {
+    // Identical side-effecting operations (e.g., two receives on the same
+    // channel) each have their own effect, so must not be merged.
+    if (OpIsSideEffecting(node->op())) {
+      continue;
+    }
     int64 hash = node_hash(node);
     if (!node_buckets.contains(hash)) {
       node_buckets[hash].push_back(node);
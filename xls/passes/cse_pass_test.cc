@@ -175,5 +175,22 @@ fn main(x: bits[11]) -> (bits[11], bits[11], bits[11]) {
             entry->DumpIr());
 }
 
+TEST_F(CsePassTest, IdenticalChannelOperationsAreKept) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(t: token, x: bits[42]) -> ((token, bits[42]), (token, bits[42]), token, token) {
+       channel_receive.1: (token, bits[42]) = channel_receive(t, channel_id=0)
+       channel_receive.2: (token, bits[42]) = channel_receive(t, channel_id=0)
+       channel_send.3: token = channel_send(t, x, channel_id=1)
+       channel_send.4: token = channel_send(t, x, channel_id=1)
+       ret tuple.5: ((token, bits[42]), (token, bits[42]), token, token) = tuple(channel_receive.1, channel_receive.2, channel_send.3, channel_send.4)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_EQ(f->node_count(), 7);
+  EXPECT_THAT(Run(f), IsOkAndHolds(false));
+  EXPECT_EQ(f->node_count(), 7);
+}
+
 }  // namespace
 }  // namespace xls
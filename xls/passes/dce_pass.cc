@@ -18,14 +18,21 @@
 #include "xls/common/status/status_macros.h"
 #include "xls/ir/dfs_visitor.h"
 #include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
 
 namespace xls {
 
+/* static */ bool DeadCodeEliminationPass::IsRemovable(Node* node) {
+  // Side-effecting operations (e.g., channel operations) are never removed.
+  return node != node->function()->return_value() && !node->Is<Param>() &&
+         !OpIsSideEffecting(node->op());
+}
+
 xabsl::StatusOr<bool> DeadCodeEliminationPass::RunOnFunction(
     Function* f, const PassOptions& options, PassResults* results) const {
   std::deque<Node*> worklist;
   for (Node* n : f->nodes()) {
-    if (n->users().empty() && n != f->return_value() && !n->Is<Param>()) {
+    if (n->users().empty() && IsRemovable(n)) {
       worklist.push_back(n);
     }
   }
@@ -40,8 +47,7 @@ xabsl::StatusOr<bool> DeadCodeEliminationPass::RunOnFunction(
     unique_operands.clear();
     for (Node* operand : node->operands()) {
       if (unique_operands.insert(operand).second) {
-        if (operand->users().size() == 1 && operand != f->return_value() &&
-            !operand->Is<Param>()) {
+        if (operand->users().size() == 1 && IsRemovable(operand)) {
           worklist.push_back(operand);
         }
       }
@@ -34,6 +34,9 @@ class DeadCodeEliminationPass : public FunctionPass {
   // Iterate all nodes, mark and eliminate the unvisited nodes.
   xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
                                       PassResults* results) const override;
+
+  // Returns whether the given node may be removed once it has no users.
+  static bool IsRemovable(Node* node);
 };
 
 }  // namespace xls
@@ -80,5 +80,21 @@ TEST_F(DeadCodeEliminationPassTest, RepeatedOperand) {
   EXPECT_EQ(f->node_count(), 3);
 }
 
+TEST_F(DeadCodeEliminationPassTest, ChannelOperationsAreKept) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(t: token, x: bits[42]) -> bits[42] {
+       channel_receive.1: (token, bits[42]) = channel_receive(t, channel_id=0)
+       channel_send.2: token = channel_send(t, x, channel_id=1)
+       neg.3: bits[42] = neg(x)
+       ret add.4: bits[42] = add(x, x)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_EQ(f->node_count(), 6);
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_EQ(f->node_count(), 5);
+}
+
 }  // namespace
 }  // namespace xls
@@ -0,0 +1,135 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/dead_bit_elimination_pass.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/value.h"
+#include "xls/passes/demanded_bits_analysis.h"
+
+namespace xls {
+namespace {
+
+// Returns whether bit i of the node only depends on bit i of its operands
+// (other than the selector of a select), so it can be computed at any
+// narrower range of bits.
+bool IsBitwise(Node* node) {
+  switch (node->op()) {
+    case Op::kAnd:
+    case Op::kNand:
+    case Op::kNor:
+    case Op::kNot:
+    case Op::kOr:
+    case Op::kXor:
+    case Op::kSel:
+    case Op::kOneHotSel:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Replaces the bitwise node with the same operation on bits [start, start +
+// width) of its operands, padded with zeros to its original width.
+absl::Status NarrowBitwise(Node* node, int64 start, int64 width) {
+  Function* f = node->function();
+  int64 bit_count = node->BitCountOrDie();
+  bool has_selector = node->op() == Op::kSel || node->op() == Op::kOneHotSel;
+  std::vector<Node*> new_operands;
+  for (int64 i = 0; i < node->operand_count(); ++i) {
+    if (has_selector && i == 0) {
+      new_operands.push_back(node->operand(i));
+      continue;
+    }
+    XLS_ASSIGN_OR_RETURN(Node * slice, f->MakeNode<BitSlice>(
+                                           node->loc(), node->operand(i),
+                                           start, width));
+    new_operands.push_back(slice);
+  }
+  XLS_ASSIGN_OR_RETURN(Node * narrowed, node->Clone(new_operands, f));
+  if (start == 0) {
+    return node->ReplaceUsesWithNew<ExtendOp>(narrowed, bit_count,
+                                              Op::kZeroExt)
+        .status();
+  }
+  std::vector<Node*> concat_operands;
+  int64 leading = bit_count - start - width;
+  if (leading > 0) {
+    XLS_ASSIGN_OR_RETURN(
+        Node * zero, f->MakeNode<Literal>(node->loc(), Value(Bits(leading))));
+    concat_operands.push_back(zero);
+  }
+  concat_operands.push_back(narrowed);
+  XLS_ASSIGN_OR_RETURN(
+      Node * zero, f->MakeNode<Literal>(node->loc(), Value(Bits(start))));
+  concat_operands.push_back(zero);
+  return node->ReplaceUsesWithNew<Concat>(concat_operands).status();
+}
+
+}  // namespace
+
+xabsl::StatusOr<bool> DeadBitEliminationPass::RunOnFunction(
+    Function* f, const PassOptions& options, PassResults* results) const {
+  XLS_ASSIGN_OR_RETURN(std::unique_ptr<DemandedBitsAnalysis> analysis,
+                       DemandedBitsAnalysis::Run(f));
+
+  // The rewrites only change bits which are not demanded, so the analysis
+  // remains valid (if conservative) for the nodes not yet visited. The nodes
+  // added by the rewrites are not visited.
+  int64 zeroed_count = 0;
+  int64 narrowed_count = 0;
+  for (Node* node : TopoSort(f)) {
+    if (options.DeadlineExceeded()) {
+      break;
+    }
+    if (!node->GetType()->IsBits() || node->BitCountOrDie() == 0 ||
+        node->users().empty() || node->Is<Literal>()) {
+      continue;
+    }
+    const Bits& demanded = analysis->GetDemandedBits(node);
+    if (demanded.IsAllZeros()) {
+      XLS_VLOG(3) << "No bits demanded of " << node->GetName();
+      XLS_RETURN_IF_ERROR(
+          node->ReplaceUsesWithNew<Literal>(Value(Bits(node->BitCountOrDie())))
+              .status());
+      ++zeroed_count;
+      continue;
+    }
+    int64 leading = demanded.CountLeadingZeros();
+    int64 trailing = demanded.CountTrailingZeros();
+    if (IsBitwise(node) && leading + trailing > 0) {
+      XLS_VLOG(3) << absl::StreamFormat(
+          "Narrowing %s to bits [%d, %d)", node->GetName(), trailing,
+          node->BitCountOrDie() - leading);
+      XLS_RETURN_IF_ERROR(NarrowBitwise(
+          node, /*start=*/trailing,
+          /*width=*/node->BitCountOrDie() - leading - trailing));
+      ++narrowed_count;
+    }
+  }
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Replaced %d nodes with zero and narrowed %d nodes", zeroed_count,
+      narrowed_count);
+  return zeroed_count + narrowed_count > 0;
+}
+
+}  // namespace xls
@@ -0,0 +1,42 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_DEAD_BIT_ELIMINATION_PASS_H_
+#define XLS_PASSES_DEAD_BIT_ELIMINATION_PASS_H_
+
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+
+// A pass which removes the logic computing bits which are never observed, as
+// found by DemandedBitsAnalysis. Nodes none of whose bits are demanded are
+// replaced by zero, so their whole cone of influence becomes dead unless
+// something else uses it. Bitwise operations and selects whose leading or
+// trailing bits are not demanded are narrowed to the demanded range and
+// padded with zeros; arithmetic operations are narrowed by NarrowingPass with
+// the same analysis.
+class DeadBitEliminationPass : public FunctionPass {
+ public:
+  DeadBitEliminationPass() : FunctionPass("dbe", "Dead Bit Elimination") {}
+  ~DeadBitEliminationPass() override {}
+
+  xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
+                                      PassResults* results) const override;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_DEAD_BIT_ELIMINATION_PASS_H_
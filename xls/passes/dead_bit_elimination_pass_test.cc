@@ -0,0 +1,122 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/dead_bit_elimination_pass.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/ir_matcher.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/passes/dce_pass.h"
+
+namespace m = ::xls::op_matchers;
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+using ::testing::AllOf;
+
+class DeadBitEliminationPassTest : public IrTestBase {
+ protected:
+  DeadBitEliminationPassTest() = default;
+
+  xabsl::StatusOr<bool> Run(Function* f) {
+    PassResults results;
+    XLS_ASSIGN_OR_RETURN(bool changed,
+                         DeadBitEliminationPass().RunOnFunction(
+                             f, PassOptions(), &results));
+    XLS_RETURN_IF_ERROR(DeadCodeEliminationPass()
+                            .RunOnFunction(f, PassOptions(), &results)
+                            .status());
+    return changed;
+  }
+};
+
+TEST_F(DeadBitEliminationPassTest, NoDeadBits) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(x: bits[8], y: bits[8]) -> bits[8] {
+       and.1: bits[8] = and(x, y)
+       ret add.2: bits[8] = add(and.1, y)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_THAT(Run(f), IsOkAndHolds(false));
+  EXPECT_EQ(f->node_count(), 4);
+}
+
+TEST_F(DeadBitEliminationPassTest, UndemandedNodeReplacedByZero) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(x: bits[8], y: bits[4]) -> bits[4] {
+       neg.1: bits[8] = neg(x)
+       concat.2: bits[12] = concat(neg.1, y)
+       ret bit_slice.3: bits[4] = bit_slice(concat.2, start=0, width=4)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_THAT(f->return_value(),
+              m::BitSlice(m::Concat(m::Literal(0), m::Param("y"))));
+}
+
+TEST_F(DeadBitEliminationPassTest, BitwiseOperationNarrowed) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(x: bits[8], y: bits[8]) -> bits[4] {
+       and.1: bits[8] = and(x, y)
+       ret bit_slice.2: bits[4] = bit_slice(and.1, start=2, width=4)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_THAT(
+      f->return_value(),
+      m::BitSlice(m::Concat(
+          AllOf(m::Literal(0), m::Type("bits[2]")),
+          AllOf(m::And(m::BitSlice(m::Param("x"), /*start=*/2, /*width=*/4),
+                       m::BitSlice(m::Param("y"), /*start=*/2, /*width=*/4)),
+                m::Type("bits[4]")),
+          AllOf(m::Literal(0), m::Type("bits[2]")))));
+}
+
+TEST_F(DeadBitEliminationPassTest, SelectNarrowedToLowBits) {
+  auto p = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, ParseFunction(R"(
+     fn func(p: bits[1], x: bits[16], y: bits[16]) -> bits[16] {
+       sel.1: bits[16] = sel(p, cases=[x, y])
+       literal.2: bits[16] = literal(value=0xff)
+       ret and.3: bits[16] = and(sel.1, literal.2)
+     }
+  )",
+                                                       p.get()));
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_THAT(
+      f->return_value(),
+      m::And(m::ZeroExt(AllOf(
+                 m::Select(m::Param("p"),
+                           {m::BitSlice(m::Param("x"), /*start=*/0,
+                                        /*width=*/8),
+                            m::BitSlice(m::Param("y"), /*start=*/0,
+                                        /*width=*/8)}),
+                 m::Type("bits[8]"))),
+             m::Literal(0xff)));
+}
+
+}  // namespace
+}  // namespace xls
@@ -0,0 +1,183 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/demanded_bits_analysis.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "absl/memory/memory.h"
+#include "absl/types/optional.h"
+#include "xls/ir/bits_ops.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+
+namespace xls {
+namespace {
+
+// Returns a mask of the given width with the 'count' least significant bits
+// set.
+Bits LowBits(int64 count, int64 bit_count) {
+  return bits_ops::ZeroExtend(Bits::AllOnes(std::min(count, bit_count)),
+                              bit_count);
+}
+
+// Returns the value of the node if it is a bits-typed literal which fits in
+// an int64.
+absl::optional<int64> GetLiteralAmount(Node* node) {
+  if (!node->Is<Literal>() || !node->GetType()->IsBits()) {
+    return absl::nullopt;
+  }
+  const Bits& bits = node->As<Literal>()->value().bits();
+  if (!bits.FitsInUint64() || bits.ToUint64().value() >
+                                  std::numeric_limits<int64>::max()) {
+    return absl::nullopt;
+  }
+  return bits.ToUint64().value();
+}
+
+// Returns the bits of operand number 'operand_no' demanded by the bits-typed
+// node 'user' given the demanded bits of 'user'.
+Bits OperandDemandedBits(Node* user, int64 operand_no,
+                         const Bits& user_demanded) {
+  Node* operand = user->operand(operand_no);
+  int64 bit_count = operand->BitCountOrDie();
+  Bits all = Bits::AllOnes(bit_count);
+  if (user_demanded.IsAllZeros()) {
+    return Bits(bit_count);
+  }
+  int64 demanded_width =
+      user_demanded.bit_count() - user_demanded.CountLeadingZeros();
+  switch (user->op()) {
+    case Op::kAnd:
+    case Op::kNand:
+    case Op::kOr:
+    case Op::kNor: {
+      // A bit ANDed with a literal zero or ORed with a literal one does not
+      // affect the result.
+      bool is_and = user->op() == Op::kAnd || user->op() == Op::kNand;
+      Bits demanded = user_demanded;
+      for (int64 i = 0; i < user->operand_count(); ++i) {
+        if (i != operand_no && user->operand(i)->Is<Literal>()) {
+          const Bits& mask = user->operand(i)->As<Literal>()->value().bits();
+          demanded = bits_ops::And(demanded,
+                                   is_and ? mask : bits_ops::Not(mask));
+        }
+      }
+      return demanded;
+    }
+    case Op::kXor:
+    case Op::kNot:
+    case Op::kIdentity:
+      return user_demanded;
+    case Op::kBitSlice: {
+      BitSlice* bit_slice = user->As<BitSlice>();
+      return bits_ops::ShiftLeftLogical(
+          bits_ops::ZeroExtend(user_demanded, bit_count), bit_slice->start());
+    }
+    case Op::kConcat: {
+      // The operands of a concat are ordered from the most significant bit.
+      int64 offset = 0;
+      for (int64 i = operand_no + 1; i < user->operand_count(); ++i) {
+        offset += user->operand(i)->BitCountOrDie();
+      }
+      return user_demanded.Slice(offset, bit_count);
+    }
+    case Op::kZeroExt:
+      return user_demanded.Slice(0, bit_count);
+    case Op::kSignExt: {
+      Bits demanded = user_demanded.Slice(0, bit_count);
+      if (demanded_width > bit_count && bit_count > 0) {
+        demanded = demanded.UpdateWithSet(bit_count - 1, true);
+      }
+      return demanded;
+    }
+    case Op::kReverse:
+      return bits_ops::Reverse(user_demanded);
+    case Op::kShll:
+    case Op::kShrl:
+    case Op::kShra: {
+      absl::optional<int64> amount = GetLiteralAmount(user->operand(1));
+      if (operand_no == 1 || !amount.has_value()) {
+        return all;
+      }
+      int64 shift = std::min(*amount, bit_count);
+      if (user->op() == Op::kShll) {
+        return bits_ops::ShiftRightLogical(user_demanded, shift);
+      }
+      Bits demanded = bits_ops::ShiftLeftLogical(user_demanded, shift);
+      // The bits shifted in by an arithmetic shift are copies of the sign bit.
+      if (user->op() == Op::kShra && bit_count > 0 &&
+          demanded_width > bit_count - shift) {
+        demanded = demanded.UpdateWithSet(bit_count - 1, true);
+      }
+      return demanded;
+    }
+    case Op::kAdd:
+    case Op::kSub:
+    case Op::kNeg:
+    case Op::kUMul:
+    case Op::kSMul:
+      // The low bits of the result only depend on the low bits of the
+      // operands.
+      return LowBits(demanded_width, bit_count);
+    case Op::kSel:
+    case Op::kOneHotSel:
+      return operand_no == 0 ? all : user_demanded;
+    default:
+      return all;
+  }
+}
+
+}  // namespace
+
+/* static */ xabsl::StatusOr<std::unique_ptr<DemandedBitsAnalysis>>
+DemandedBitsAnalysis::Run(Function* f) {
+  auto analysis = absl::WrapUnique(new DemandedBitsAnalysis());
+  absl::flat_hash_map<Node*, Bits>& demanded_bits = analysis->demanded_bits_;
+  for (Node* node : f->nodes()) {
+    if (node->GetType()->IsBits()) {
+      demanded_bits[node] = Bits(node->BitCountOrDie());
+    }
+  }
+  if (f->return_value()->GetType()->IsBits()) {
+    demanded_bits[f->return_value()] =
+        Bits::AllOnes(f->return_value()->BitCountOrDie());
+  }
+
+  // Users are visited before their operands, so the demanded bits of a node
+  // are complete when it is visited.
+  for (Node* node : ReverseTopoSort(f)) {
+    for (int64 i = 0; i < node->operand_count(); ++i) {
+      Node* operand = node->operand(i);
+      if (!operand->GetType()->IsBits()) {
+        continue;
+      }
+      Bits& operand_demanded = demanded_bits.at(operand);
+      if (operand_demanded.IsAllOnes()) {
+        continue;
+      }
+      if (node->GetType()->IsBits()) {
+        operand_demanded = bits_ops::Or(
+            operand_demanded,
+            OperandDemandedBits(node, i, demanded_bits.at(node)));
+      } else {
+        operand_demanded = Bits::AllOnes(operand->BitCountOrDie());
+      }
+    }
+  }
+  return std::move(analysis);
+}
+
+}  // namespace xls
@@ -0,0 +1,75 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_DEMANDED_BITS_ANALYSIS_H_
+#define XLS_PASSES_DEMANDED_BITS_ANALYSIS_H_
+
+#include <memory>
+
+#include "absl/container/flat_hash_map.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function.h"
+#include "xls/ir/node.h"
+
+namespace xls {
+
+// A backward analysis of which bits of each bits-typed node may affect the
+// value of the function (or a side effect): the demanded bits. A bit which is
+// not demanded can take any value without changing the result, so the logic
+// computing it is dead even if the node itself is live.
+//
+// The demanded bits of a node are the union over its users of the bits each
+// user demands of it given its own demanded bits. Bit-moving operations
+// (slices, concats, extensions, reverses and shifts by constant amounts) map
+// demanded bits to the operand bits they come from; bitwise operations demand
+// the same bits of their operands, except those masked by a literal operand
+// (e.g., bits ANDed with zero); arithmetic operations demand the operand bits
+// at or below the most significant demanded bit, as carries only propagate
+// upward; and any other operation, such as a comparison, demands every bit of
+// its operands if any bit of its result is demanded. Every bit of the return
+// value and of the operands of nodes which are not bits-typed is demanded.
+class DemandedBitsAnalysis {
+ public:
+  static xabsl::StatusOr<std::unique_ptr<DemandedBitsAnalysis>> Run(
+      Function* f);
+
+  // Returns the demanded bits of a bits-typed node as a mask of its width.
+  const Bits& GetDemandedBits(Node* node) const {
+    XLS_CHECK(node->GetType()->IsBits());
+    return demanded_bits_.at(node);
+  }
+
+  bool IsDemanded(Node* node, int64 bit_index) const {
+    return GetDemandedBits(node).Get(bit_index);
+  }
+
+  // Returns the number of bits of the node up to and including its most
+  // significant demanded bit. Bits above this width are not demanded.
+  int64 GetDemandedWidth(Node* node) const {
+    const Bits& demanded = GetDemandedBits(node);
+    return demanded.bit_count() - demanded.CountLeadingZeros();
+  }
+
+ private:
+  DemandedBitsAnalysis() = default;
+
+  absl::flat_hash_map<Node*, Bits> demanded_bits_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_DEMANDED_BITS_ANALYSIS_H_
@@ -0,0 +1,108 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/demanded_bits_analysis.h"
+
+#include <memory>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+
+namespace xls {
+namespace {
+
+class DemandedBitsAnalysisTest : public IrTestBase {};
+
+TEST_F(DemandedBitsAnalysisTest, SliceAndConcat) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(4));
+  BValue concat = fb.Concat({x, y});
+  fb.BitSlice(concat, /*start=*/2, /*width=*/4);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DemandedBitsAnalysis> analysis,
+                           DemandedBitsAnalysis::Run(f));
+  EXPECT_EQ(analysis->GetDemandedBits(concat.node()), UBits(0b111100, 12));
+  EXPECT_EQ(analysis->GetDemandedBits(x.node()), UBits(0b11, 8));
+  EXPECT_EQ(analysis->GetDemandedBits(y.node()), UBits(0b1100, 4));
+  EXPECT_EQ(analysis->GetDemandedWidth(x.node()), 2);
+  EXPECT_TRUE(analysis->IsDemanded(y.node(), 3));
+  EXPECT_FALSE(analysis->IsDemanded(y.node(), 1));
+}
+
+TEST_F(DemandedBitsAnalysisTest, ShiftsAndMasks) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  Type* u8 = p->GetBitsType(8);
+  BValue x = fb.Param("x", u8);
+  BValue y = fb.Param("y", u8);
+  BValue z = fb.Param("z", u8);
+  BValue shll = fb.Shll(x, fb.Literal(UBits(3, 8)));
+  BValue shra = fb.Shra(y, fb.Literal(UBits(4, 8)));
+  BValue masked = fb.And(z, fb.Literal(UBits(0x0f, 8)));
+  fb.Concat({fb.BitSlice(shll, /*start=*/0, /*width=*/4),
+             fb.BitSlice(shra, /*start=*/4, /*width=*/4), masked});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DemandedBitsAnalysis> analysis,
+                           DemandedBitsAnalysis::Run(f));
+  // The low three bits of the shll are zeros shifted in.
+  EXPECT_EQ(analysis->GetDemandedBits(x.node()), UBits(0b1, 8));
+  // The high bits of the shra are copies of the sign bit.
+  EXPECT_EQ(analysis->GetDemandedBits(y.node()), UBits(0x80, 8));
+  EXPECT_EQ(analysis->GetDemandedBits(z.node()), UBits(0x0f, 8));
+}
+
+TEST_F(DemandedBitsAnalysisTest, ArithmeticAndComparisons) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  Type* u8 = p->GetBitsType(8);
+  BValue a = fb.Param("a", u8);
+  BValue b = fb.Param("b", u8);
+  BValue c = fb.Param("c", u8);
+  BValue d = fb.Param("d", p->GetBitsType(4));
+  BValue sum = fb.Add(a, b);
+  fb.Concat({fb.BitSlice(sum, /*start=*/1, /*width=*/2),
+             fb.ULt(c, a), fb.BitSlice(fb.SignExtend(d, 8), 7, 1)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DemandedBitsAnalysis> analysis,
+                           DemandedBitsAnalysis::Run(f));
+  // Carries only propagate upward, so all bits at or below the most
+  // significant demanded bit of the sum are demanded.
+  EXPECT_EQ(analysis->GetDemandedBits(b.node()), UBits(0b111, 8));
+  EXPECT_TRUE(analysis->GetDemandedBits(a.node()).IsAllOnes());
+  EXPECT_TRUE(analysis->GetDemandedBits(c.node()).IsAllOnes());
+  EXPECT_EQ(analysis->GetDemandedBits(d.node()), UBits(0b1000, 4));
+}
+
+TEST_F(DemandedBitsAnalysisTest, NonBitsUserDemandsAllBits) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  fb.Tuple({x, fb.BitSlice(y, /*start=*/0, /*width=*/1)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<DemandedBitsAnalysis> analysis,
+                           DemandedBitsAnalysis::Run(f));
+  EXPECT_TRUE(analysis->GetDemandedBits(x.node()).IsAllOnes());
+  EXPECT_EQ(analysis->GetDemandedBits(y.node()), UBits(1, 8));
+}
+
+}  // namespace
+}  // namespace xls
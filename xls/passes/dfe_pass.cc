@@ -68,6 +68,9 @@ xabsl::StatusOr<bool> DeadFunctionEliminationPass::Run(
     }
   }
   if (!to_unlink.empty()) {
+    for (Function* f : to_unlink) {
+      results->query_engine_cache.Invalidate(f);
+    }
     p->DeleteDeadFunctions(to_unlink);
   }
   return !to_unlink.empty();
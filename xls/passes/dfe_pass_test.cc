@@ -73,6 +73,26 @@ TEST_F(DeadFunctionEliminationPassTest, OneDeadFunction) {
   EXPECT_EQ(p->functions().size(), 2);
 }
 
+TEST_F(DeadFunctionEliminationPassTest, DeadFunctionLeavesQueryEngineCache) {
+  auto p = absl::make_unique<Package>(TestName(), /*entry=*/"the_entry");
+  XLS_ASSERT_OK_AND_ASSIGN(Function * a, MakeFunction("a", p.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * dead, MakeFunction("dead", p.get()));
+  FunctionBuilder fb("the_entry", p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  fb.Invoke({x}, a);
+  XLS_ASSERT_OK(fb.Build().status());
+
+  PassResults results;
+  XLS_ASSERT_OK(results.query_engine_cache.GetTernaryQueryEngine(a).status());
+  XLS_ASSERT_OK(
+      results.query_engine_cache.GetTernaryQueryEngine(dead).status());
+  EXPECT_THAT(DeadFunctionEliminationPass().Run(p.get(), PassOptions(),
+                                                &results),
+              IsOkAndHolds(true));
+  EXPECT_TRUE(results.query_engine_cache.Contains(a));
+  EXPECT_FALSE(results.query_engine_cache.Contains(dead));
+}
+
 TEST_F(DeadFunctionEliminationPassTest, OneDeadFunctionButNoEntry) {
   // If no entry function is specified, then DFS cannot happen as all functions
   // are live.
@@ -33,6 +33,9 @@ class DumpPass : public FunctionPass {
   // Dumps the IR and keeps it unmodified.
   xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
                                       PassResults* results) const override;
+
+  // Dumps functions in package order.
+  bool IsFunctionLocal() const override { return false; }
 };
 
 }  // namespace xls
@@ -0,0 +1,357 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/function_specialization_pass.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/types/optional.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/bits_ops.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/ternary.h"
+#include "xls/passes/arith_simplification_pass.h"
+#include "xls/passes/array_simplification_pass.h"
+#include "xls/passes/bit_slice_simplification_pass.h"
+#include "xls/passes/canonicalization_pass.h"
+#include "xls/passes/concat_simplification_pass.h"
+#include "xls/passes/constant_folding_pass.h"
+#include "xls/passes/select_simplification_pass.h"
+#include "xls/passes/ternary_query_engine.h"
+#include "xls/passes/tuple_simplification_pass.h"
+
+namespace xls {
+namespace {
+
+// The known bits of the arguments of a call site, indexed by the parameters
+// of the callee. Parameters about which nothing is known have no value.
+using ArgKnowledge = std::vector<absl::optional<TernaryVector>>;
+
+bool KnowsAnyBit(const ArgKnowledge& knowledge) {
+  return absl::c_any_of(knowledge, [](const absl::optional<TernaryVector>& t) {
+    return t.has_value();
+  });
+}
+
+// A call site and the function it should call instead.
+struct Redirect {
+  Node* node;
+  Function* callee;
+};
+
+// Returns the known bits of 'node', or nullopt if it is not bits-typed or no
+// bit is known.
+absl::optional<TernaryVector> GetKnownBits(Node* node,
+                                           const QueryEngine& query_engine) {
+  if (!node->GetType()->IsBits() || !query_engine.IsTracked(node)) {
+    return absl::nullopt;
+  }
+  const Bits& known = query_engine.GetKnownBits(node);
+  if (known.IsAllZeros()) {
+    return absl::nullopt;
+  }
+  const Bits& values = query_engine.GetKnownBitsValues(node);
+  TernaryVector result(node->BitCountOrDie());
+  for (int64 i = 0; i < result.size(); ++i) {
+    if (!known.Get(i)) {
+      result[i] = TernaryValue::kUnknown;
+    } else {
+      result[i] = values.Get(i) ? TernaryValue::kKnownOne
+                                : TernaryValue::kKnownZero;
+    }
+  }
+  return result;
+}
+
+// Returns the bits known to be the same in every element of the array 'node'.
+absl::optional<TernaryVector> GetKnownElementBits(
+    Node* node, const QueryEngine& query_engine) {
+  absl::optional<TernaryVector> result;
+  auto meet = [&](const TernaryVector& element) {
+    result = result.has_value() ? ternary_ops::Equals(*result, element)
+                                : element;
+  };
+  if (node->Is<Literal>()) {
+    const Value& value = node->As<Literal>()->value();
+    for (const Value& element : value.elements()) {
+      if (!element.IsBits()) {
+        return absl::nullopt;
+      }
+      meet(ternary_ops::BitsToTernary(element.bits()));
+    }
+  } else if (node->Is<Array>()) {
+    for (Node* element : node->operands()) {
+      absl::optional<TernaryVector> element_bits =
+          GetKnownBits(element, query_engine);
+      if (!element_bits.has_value()) {
+        return absl::nullopt;
+      }
+      meet(*element_bits);
+    }
+  }
+  if (!result.has_value() || ternary_ops::AllUnknown(*result)) {
+    return absl::nullopt;
+  }
+  return result;
+}
+
+// Returns the known bits of the arguments of the call site 'node', or nullopt
+// if it is not a call site or nothing is known about its arguments.
+absl::optional<ArgKnowledge> GetArgKnowledge(Node* node,
+                                             const QueryEngine& query_engine) {
+  ArgKnowledge knowledge;
+  if (node->Is<Invoke>()) {
+    for (Node* arg : node->operands()) {
+      knowledge.push_back(GetKnownBits(arg, query_engine));
+    }
+  } else if (node->Is<CountedFor>()) {
+    // The induction variable and the loop carry vary between iterations.
+    knowledge.resize(2);
+    for (Node* arg : node->As<CountedFor>()->invariant_args()) {
+      knowledge.push_back(GetKnownBits(arg, query_engine));
+    }
+  } else if (node->Is<Map>()) {
+    knowledge.push_back(GetKnownElementBits(node->operand(0), query_engine));
+  } else {
+    return absl::nullopt;
+  }
+  if (!KnowsAnyBit(knowledge)) {
+    return absl::nullopt;
+  }
+  return knowledge;
+}
+
+Function* GetCallee(Node* node) {
+  if (node->Is<Invoke>()) {
+    return node->As<Invoke>()->to_apply();
+  }
+  if (node->Is<CountedFor>()) {
+    return node->As<CountedFor>()->body();
+  }
+  return node->As<Map>()->to_apply();
+}
+
+// Returns whether the function already ignores the values of the known bits
+// of 'param': it does not use the parameter, or only uses it masked by a
+// literal which clears those bits, as in a specialization.
+bool ParamIgnoresKnownBits(Param* param, const TernaryVector& known) {
+  if (param == param->function()->return_value()) {
+    return false;
+  }
+  if (param->users().empty()) {
+    return true;
+  }
+  if (param->users().size() != 1) {
+    return false;
+  }
+  Node* user = *param->users().begin();
+  if (user->op() != Op::kAnd || user->operand_count() != 2) {
+    return false;
+  }
+  Node* mask = user->operand(0) == param ? user->operand(1) : user->operand(0);
+  if (!mask->Is<Literal>()) {
+    return false;
+  }
+  const Bits& mask_bits = mask->As<Literal>()->value().bits();
+  for (int64 i = 0; i < known.size(); ++i) {
+    if (ternary_ops::IsKnown(known[i]) && mask_bits.Get(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the key under which the specialization of 'callee' for the given
+// knowledge is memoized.
+std::string SpecializationKey(Function* callee,
+                              const ArgKnowledge& knowledge) {
+  return absl::StrCat(
+      callee->name(), ":",
+      absl::StrJoin(knowledge, ",",
+                    [](std::string* out,
+                       const absl::optional<TernaryVector>& t) {
+                      absl::StrAppend(out, t.has_value() ? ToString(*t) : "-");
+                    }));
+}
+
+// Replaces the uses of 'param' in its function with a value whose known bits
+// are those of 'known': a literal if every bit is known, and otherwise the
+// parameter with the known bits forced to their values.
+absl::Status SubstituteKnownBits(Param* param, const TernaryVector& known) {
+  Function* f = param->function();
+  absl::InlinedVector<bool, 64> mask;
+  absl::InlinedVector<bool, 64> values;
+  for (TernaryValue bit : known) {
+    mask.push_back(ternary_ops::IsKnown(bit));
+    values.push_back(bit == TernaryValue::kKnownOne);
+  }
+  Bits mask_bits(mask);
+  Bits values_bits(values);
+  std::vector<Node*> users(param->users().begin(), param->users().end());
+  Node* replacement;
+  if (mask_bits.IsAllOnes()) {
+    XLS_ASSIGN_OR_RETURN(replacement, f->MakeNode<Literal>(
+                                          param->loc(), Value(values_bits)));
+  } else {
+    XLS_ASSIGN_OR_RETURN(
+        Node * unknown_mask,
+        f->MakeNode<Literal>(param->loc(),
+                             Value(bits_ops::Not(mask_bits))));
+    XLS_ASSIGN_OR_RETURN(
+        Node * unknown_bits,
+        f->MakeNode<NaryOp>(param->loc(),
+                            std::vector<Node*>{param, unknown_mask},
+                            Op::kAnd));
+    XLS_ASSIGN_OR_RETURN(
+        Node * known_bits,
+        f->MakeNode<Literal>(param->loc(), Value(values_bits)));
+    XLS_ASSIGN_OR_RETURN(
+        replacement,
+        f->MakeNode<NaryOp>(param->loc(),
+                            std::vector<Node*>{unknown_bits, known_bits},
+                            Op::kOr));
+  }
+  for (Node* user : users) {
+    user->ReplaceOperand(param, replacement);
+  }
+  if (f->return_value() == param) {
+    f->set_return_value(replacement);
+  }
+  return absl::OkStatus();
+}
+
+// Replaces the call site with one calling 'callee' instead.
+absl::Status RedirectCallSite(Node* node, Function* callee) {
+  std::vector<Node*> operands(node->operands().begin(),
+                              node->operands().end());
+  if (node->Is<Invoke>()) {
+    XLS_RETURN_IF_ERROR(
+        node->ReplaceUsesWithNew<Invoke>(operands, callee).status());
+  } else if (node->Is<CountedFor>()) {
+    CountedFor* loop = node->As<CountedFor>();
+    XLS_RETURN_IF_ERROR(
+        node->ReplaceUsesWithNew<CountedFor>(
+                loop->initial_value(),
+                absl::MakeSpan(operands).subspan(1), loop->trip_count(),
+                loop->stride(), callee)
+            .status());
+  } else {
+    XLS_RETURN_IF_ERROR(
+        node->ReplaceUsesWithNew<Map>(node->operand(0), callee).status());
+  }
+  return node->function()->RemoveNode(node);
+}
+
+}  // namespace
+
+FunctionSpecializationPass::FunctionSpecializationPass()
+    : Pass("func_spec", "Function specialization"),
+      simplification_("func_spec_simp", "Specialized function simplification") {
+  simplification_.Add<ConstantFoldingRule>();
+  simplification_.Add<CanonicalizationRule>();
+  simplification_.Add<ArithSimplificationRule>();
+  simplification_.Add<BitSliceSimplificationRule>();
+  simplification_.Add<ConcatSimplificationRule>();
+  simplification_.Add<TupleSimplificationRule>();
+  simplification_.Add<ArraySimplificationRule>();
+}
+
+xabsl::StatusOr<bool> FunctionSpecializationPass::Run(
+    Package* p, const PassOptions& options, PassResults* results) const {
+  // The specializations made so far, keyed by the callee and the known bits of
+  // the arguments.
+  absl::flat_hash_map<std::string, Function*> specializations;
+  bool changed = false;
+  // Specializations are added to the package and processed in turn.
+  for (int64 i = 0; i < p->functions().size(); ++i) {
+    Function* f = p->functions()[i].get();
+    if (results->frozen_functions.contains(f->name())) {
+      continue;
+    }
+    XLS_ASSIGN_OR_RETURN(
+        TernaryQueryEngine * query_engine,
+        results->query_engine_cache.GetTernaryQueryEngine(f));
+    std::vector<Redirect> redirects;
+    for (Node* node : TopoSort(f)) {
+      absl::optional<ArgKnowledge> knowledge =
+          GetArgKnowledge(node, *query_engine);
+      if (!knowledge.has_value()) {
+        continue;
+      }
+      Function* callee = GetCallee(node);
+      // Loops which are left rolled keep their bodies, which are generated
+      // separately.
+      if (absl::c_linear_search(options.rolled_loop_bodies, callee->name())) {
+        continue;
+      }
+      XLS_RET_CHECK_EQ(knowledge->size(), callee->params().size());
+      for (int64 j = 0; j < knowledge->size(); ++j) {
+        if ((*knowledge)[j].has_value() &&
+            ParamIgnoresKnownBits(callee->params()[j], *(*knowledge)[j])) {
+          (*knowledge)[j] = absl::nullopt;
+        }
+      }
+      if (!KnowsAnyBit(*knowledge)) {
+        continue;
+      }
+      std::string key = SpecializationKey(callee, *knowledge);
+      auto it = specializations.find(key);
+      if (it == specializations.end()) {
+        std::string name = absl::StrFormat("%s__spec_%d", callee->name(),
+                                           specializations.size());
+        for (int64 j = 1; p->GetFunction(name).ok(); ++j) {
+          name = absl::StrFormat("%s__spec_%d_%d", callee->name(),
+                                 specializations.size(), j);
+        }
+        XLS_VLOG(2) << absl::StreamFormat("Specializing %s as %s for %s",
+                                          callee->name(), name, key);
+        XLS_ASSIGN_OR_RETURN(Function * specialized, callee->Clone(name));
+        for (int64 j = 0; j < knowledge->size(); ++j) {
+          if ((*knowledge)[j].has_value()) {
+            XLS_RETURN_IF_ERROR(SubstituteKnownBits(specialized->params()[j],
+                                                    *(*knowledge)[j]));
+          }
+        }
+        XLS_RETURN_IF_ERROR(
+            simplification_.RunOnFunction(specialized, options, results)
+                .status());
+        XLS_RETURN_IF_ERROR(SelectSimplificationPass(/*split_ops=*/false)
+                                .RunOnFunction(specialized, options, results)
+                                .status());
+        XLS_RETURN_IF_ERROR(
+            simplification_.RunOnFunction(specialized, options, results)
+                .status());
+        it = specializations.emplace(key, specialized).first;
+      }
+      redirects.push_back({node, it->second});
+    }
+    for (const Redirect& redirect : redirects) {
+      XLS_RETURN_IF_ERROR(RedirectCallSite(redirect.node, redirect.callee));
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+}  // namespace xls
@@ -0,0 +1,51 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_FUNCTION_SPECIALIZATION_PASS_H_
+#define XLS_PASSES_FUNCTION_SPECIALIZATION_PASS_H_
+
+#include "xls/common/status/statusor.h"
+#include "xls/ir/package.h"
+#include "xls/passes/node_rewrite_pass.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+
+// Specializes called functions for the values of their arguments which are
+// known at the call site: the arguments of invokes, the invariant arguments
+// of counted for loops, and the elements of the arrays mapped over. Bits
+// whose values the ternary query engine of the caller knows are substituted
+// into a clone of the callee, which is simplified once and shared by every
+// call site with the same known bits, and the call sites are redirected to
+// it. Inlining then copies the simplified function rather than simplifying
+// each inlined copy separately. Functions added by the pass are processed as
+// well, so specialization follows the call graph; unused originals are left
+// to DeadFunctionEliminationPass. The bodies of loops in
+// PassOptions::rolled_loop_bodies are not specialized.
+class FunctionSpecializationPass : public Pass {
+ public:
+  FunctionSpecializationPass();
+  ~FunctionSpecializationPass() override {}
+
+  xabsl::StatusOr<bool> Run(Package* p, const PassOptions& options,
+                            PassResults* results) const override;
+
+ private:
+  // Simplifies the specialized functions.
+  NodeRewritePass simplification_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_FUNCTION_SPECIALIZATION_PASS_H_
@@ -0,0 +1,210 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/function_specialization_pass.h"
+
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ir_matcher.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/passes/pass_base.h"
+
+namespace m = ::xls::op_matchers;
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+class FunctionSpecializationPassTest : public IrTestBase {
+ protected:
+  xabsl::StatusOr<bool> Run(Package* p) {
+    PassResults results;
+    return FunctionSpecializationPass().Run(p, PassOptions(), &results);
+  }
+};
+
+TEST_F(FunctionSpecializationPassTest, InvokesShareSpecializations) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn callee(mode: bits[2], x: bits[8]) -> bits[8] {
+  literal.1: bits[8] = literal(value=1)
+  add.2: bits[8] = add(x, literal.1)
+  sub.3: bits[8] = sub(x, literal.1)
+  not.4: bits[8] = not(x)
+  neg.5: bits[8] = neg(x)
+  ret sel.6: bits[8] = sel(mode, cases=[add.2, sub.3, not.4, neg.5])
+}
+
+fn caller(x: bits[8], y: bits[8]) -> (bits[8], bits[8], bits[8]) {
+  literal.7: bits[2] = literal(value=1)
+  literal.8: bits[2] = literal(value=3)
+  invoke.9: bits[8] = invoke(literal.7, x, to_apply=callee)
+  invoke.10: bits[8] = invoke(literal.7, y, to_apply=callee)
+  invoke.11: bits[8] = invoke(literal.8, x, to_apply=callee)
+  ret tuple.12: (bits[8], bits[8], bits[8]) = tuple(invoke.9, invoke.10, invoke.11)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * caller, p->GetFunction("caller"));
+  std::vector<Value> args = {Value(UBits(5, 8)), Value(UBits(9, 8))};
+  XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(caller, args));
+
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(true));
+  EXPECT_EQ(p->functions().size(), 4);
+  Node* ret = caller->return_value();
+  ASSERT_TRUE(ret->operand(0)->Is<Invoke>());
+  ASSERT_TRUE(ret->operand(1)->Is<Invoke>());
+  ASSERT_TRUE(ret->operand(2)->Is<Invoke>());
+  Function* mode1 = ret->operand(0)->As<Invoke>()->to_apply();
+  Function* mode3 = ret->operand(2)->As<Invoke>()->to_apply();
+  EXPECT_EQ(ret->operand(1)->As<Invoke>()->to_apply(), mode1);
+  EXPECT_NE(mode1, mode3);
+  EXPECT_THAT(mode1->return_value(), m::Sub(m::Param("x"), m::Literal(1)));
+  EXPECT_THAT(mode3->return_value(), m::Neg(m::Param("x")));
+  EXPECT_THAT(ir_interpreter::Run(caller, args), IsOkAndHolds(expected));
+
+  // The specializations are not specialized again.
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(false));
+}
+
+TEST_F(FunctionSpecializationPassTest, KnownBitsArgument) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn callee(x: bits[8]) -> bits[4] {
+  ret bit_slice.1: bits[4] = bit_slice(x, start=4, width=4)
+}
+
+fn caller(y: bits[4]) -> bits[4] {
+  zero_ext.2: bits[8] = zero_ext(y, new_bit_count=8)
+  ret invoke.3: bits[4] = invoke(zero_ext.2, to_apply=callee)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * caller, p->GetFunction("caller"));
+
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(true));
+  ASSERT_TRUE(caller->return_value()->Is<Invoke>());
+  Function* specialized = caller->return_value()->As<Invoke>()->to_apply();
+  EXPECT_NE(specialized->name(), "callee");
+  EXPECT_THAT(specialized->return_value(), m::Literal(0));
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(false));
+}
+
+TEST_F(FunctionSpecializationPassTest, CountedForInvariantArgument) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn body(i: bits[4], acc: bits[8], up: bits[1]) -> bits[8] {
+  literal.1: bits[8] = literal(value=1)
+  add.2: bits[8] = add(acc, literal.1)
+  sub.3: bits[8] = sub(acc, literal.1)
+  ret sel.4: bits[8] = sel(up, cases=[sub.3, add.2])
+}
+
+fn caller(x: bits[8]) -> bits[8] {
+  literal.5: bits[1] = literal(value=1)
+  ret counted_for.6: bits[8] = counted_for(x, trip_count=4, stride=1, body=body, invariant_args=[literal.5])
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * caller, p->GetFunction("caller"));
+
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(true));
+  ASSERT_TRUE(caller->return_value()->Is<CountedFor>());
+  Function* body = caller->return_value()->As<CountedFor>()->body();
+  EXPECT_THAT(body->return_value(), m::Add(m::Param("acc"), m::Literal(1)));
+  EXPECT_THAT(ir_interpreter::Run(caller, {Value(UBits(3, 8))}),
+              IsOkAndHolds(Value(UBits(7, 8))));
+
+  // The specialized body is added after the caller, but must be dumped before
+  // it for the IR to parse.
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> reparsed,
+                           Parser::ParsePackage(p->DumpIr()));
+  EXPECT_EQ(reparsed->DumpIr(), p->DumpIr());
+  XLS_ASSERT_OK_AND_ASSIGN(Function * reparsed_caller,
+                           reparsed->GetFunction("caller"));
+  EXPECT_THAT(ir_interpreter::Run(reparsed_caller, {Value(UBits(3, 8))}),
+              IsOkAndHolds(Value(UBits(7, 8))));
+}
+
+TEST_F(FunctionSpecializationPassTest, RolledLoopBodyIsNotSpecialized) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn body(i: bits[4], acc: bits[8], up: bits[1]) -> bits[8] {
+  literal.1: bits[8] = literal(value=1)
+  add.2: bits[8] = add(acc, literal.1)
+  sub.3: bits[8] = sub(acc, literal.1)
+  ret sel.4: bits[8] = sel(up, cases=[sub.3, add.2])
+}
+
+fn caller(x: bits[8]) -> bits[8] {
+  literal.5: bits[1] = literal(value=1)
+  ret counted_for.6: bits[8] = counted_for(x, trip_count=4, stride=1, body=body, invariant_args=[literal.5])
+}
+)"));
+  PassOptions options;
+  options.rolled_loop_bodies = {"body"};
+  PassResults results;
+  EXPECT_THAT(FunctionSpecializationPass().Run(p.get(), options, &results),
+              IsOkAndHolds(false));
+}
+
+TEST_F(FunctionSpecializationPassTest, MapOverKnownElements) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn map_fn(x: bits[32]) -> bits[16] {
+  ret bit_slice.1: bits[16] = bit_slice(x, start=16, width=16)
+}
+
+fn main(a: bits[16], b: bits[16]) -> bits[16][2] {
+  zero_ext.2: bits[32] = zero_ext(a, new_bit_count=32)
+  zero_ext.3: bits[32] = zero_ext(b, new_bit_count=32)
+  array.4: bits[32][2] = array(zero_ext.2, zero_ext.3)
+  ret map.5: bits[16][2] = map(array.4, to_apply=map_fn)
+}
+)"));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main, p->GetFunction("main"));
+
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(true));
+  ASSERT_TRUE(main->return_value()->Is<Map>());
+  EXPECT_THAT(main->return_value()->As<Map>()->to_apply()->return_value(),
+              m::Literal(0));
+}
+
+TEST_F(FunctionSpecializationPassTest, UnknownArguments) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, Parser::ParsePackage(R"(
+package p
+
+fn callee(x: bits[8]) -> bits[8] {
+  ret not.1: bits[8] = not(x)
+}
+
+fn caller(y: bits[8]) -> bits[8] {
+  ret invoke.2: bits[8] = invoke(y, to_apply=callee)
+}
+)"));
+  EXPECT_THAT(Run(p.get()), IsOkAndHolds(false));
+  EXPECT_EQ(p->functions().size(), 2);
+}
+
+}  // namespace
+}  // namespace xls
@@ -14,7 +14,14 @@
 
 #include "xls/passes/inlining_pass.h"
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "xls/common/status/status_macros.h"
 #include "xls/ir/node_iterator.h"
 
@@ -29,64 +36,110 @@ bool ShouldInline(Invoke* invoke) {
   return true;
 }
 
-// Finds an "effectively used" (has users or is return value) invoke in the
-// function f, or returns nullptr if none is found.
-Invoke* FindInvoke(Function* f) {
-  for (Node* node : TopoSort(f)) {
-    if (node->Is<Invoke>() &&
-        (node == f->return_value() || !node->users().empty()) &&
-        ShouldInline(node->As<Invoke>())) {
-      return node->As<Invoke>();
-    }
-  }
-  return nullptr;
+// Returns whether the node is an "effectively used" (has users or is return
+// value) invoke which should be inlined.
+bool IsInlinedInvoke(Node* node) {
+  return node->Is<Invoke>() &&
+         (node == node->function()->return_value() ||
+          !node->users().empty()) &&
+         ShouldInline(node->As<Invoke>());
 }
 
-// Unrolls the node "loop" by replacing it with a sequence of dependent
-// invocations.
-absl::Status InlineInvoke(Invoke* invoke, Function* f) {
-  Function* invoked = invoke->to_apply();
-  absl::flat_hash_map<Node*, Node*> invoked_node_to_replacement;
-  for (int64 i = 0; i < invoked->params().size(); ++i) {
-    Node* param = invoked->params()[i];
-    invoked_node_to_replacement[param] = invoke->operand(i);
+// The nodes of a function in topological order, from which the function is
+// cloned into its callers. The parameters come first. Operands are referred
+// to by their position in the order, so cloning needs no map lookups.
+struct InlineTemplate {
+  struct Entry {
+    Node* node;
+    std::vector<int64> operands;
+  };
+  std::vector<Entry> entries;
+  int64 return_index;
+};
+
+// Inlines functions into a function. The template of each invoked function is
+// built once, and the functions it invokes are inlined along with it, so the
+// call graph is processed bottom-up in a single pass over each function.
+class Inliner {
+ public:
+  explicit Inliner(Function* f) : f_(f) {}
+
+  // Clones the given function, with the given nodes as its arguments, into
+  // the function and returns the node of its return value.
+  xabsl::StatusOr<Node*> Inline(Function* callee,
+                                absl::Span<Node* const> args) {
+    const InlineTemplate& t = GetTemplate(callee);
+    std::vector<Node*> nodes(t.entries.size());
+    std::copy(args.begin(), args.end(), nodes.begin());
+    std::vector<Node*> operands;
+    for (int64 i = args.size(); i < t.entries.size(); ++i) {
+      const InlineTemplate::Entry& entry = t.entries[i];
+      operands.clear();
+      for (int64 operand : entry.operands) {
+        operands.push_back(nodes[operand]);
+      }
+      if (IsInlinedInvoke(entry.node)) {
+        XLS_ASSIGN_OR_RETURN(
+            nodes[i], Inline(entry.node->As<Invoke>()->to_apply(), operands));
+      } else {
+        XLS_ASSIGN_OR_RETURN(nodes[i], entry.node->Clone(operands, f_));
+      }
+    }
+    return nodes[t.return_index];
   }
-  for (Node* node : TopoSort(invoked)) {
-    if (invoked_node_to_replacement.find(node) !=
-        invoked_node_to_replacement.end()) {
-      // Already taken care of (e.g. parameters above).
-      continue;
+
+ private:
+  const InlineTemplate& GetTemplate(Function* callee) {
+    std::unique_ptr<InlineTemplate>& t = templates_[callee];
+    if (t != nullptr) {
+      return *t;
+    }
+    t = absl::make_unique<InlineTemplate>();
+    absl::flat_hash_map<Node*, int64> indices;
+    for (Param* param : callee->params()) {
+      indices[param] = t->entries.size();
+      t->entries.push_back({param, {}});
     }
-    std::vector<Node*> new_operands;
-    for (Node* operand : node->operands()) {
-      new_operands.push_back(invoked_node_to_replacement.at(operand));
+    for (Node* node : TopoSort(callee)) {
+      if (node->Is<Param>()) {
+        continue;
+      }
+      InlineTemplate::Entry entry{node, {}};
+      for (Node* operand : node->operands()) {
+        entry.operands.push_back(indices.at(operand));
+      }
+      indices[node] = t->entries.size();
+      t->entries.push_back(std::move(entry));
     }
-    XLS_ASSIGN_OR_RETURN(Node * new_node, node->Clone(new_operands, f));
-    invoked_node_to_replacement[node] = new_node;
+    t->return_index = indices.at(callee->return_value());
+    return *t;
   }
 
-  XLS_RETURN_IF_ERROR(invoke
-                          ->ReplaceUsesWith(invoked_node_to_replacement.at(
-                              invoked->return_value()))
-                          .status());
-  return f->RemoveNode(invoke);
-}
+  Function* f_;
+  absl::flat_hash_map<Function*, std::unique_ptr<InlineTemplate>> templates_;
+};
 
 }  // namespace
 
 xabsl::StatusOr<bool> InliningPass::RunOnFunction(Function* f,
                                                   const PassOptions& options,
                                                   PassResults* results) const {
-  bool changed = false;
-  while (true) {
-    Invoke* invoke = FindInvoke(f);
-    if (invoke == nullptr) {
-      break;
+  // Inlining an invoke also inlines the invokes in the callee, so all the
+  // invokes to inline are known upfront.
+  std::vector<Invoke*> invokes;
+  for (Node* node : TopoSort(f)) {
+    if (IsInlinedInvoke(node)) {
+      invokes.push_back(node->As<Invoke>());
     }
-    XLS_RETURN_IF_ERROR(InlineInvoke(invoke, f));
-    changed = true;
   }
-  return changed;
+  Inliner inliner(f);
+  for (Invoke* invoke : invokes) {
+    XLS_ASSIGN_OR_RETURN(
+        Node * result, inliner.Inline(invoke->to_apply(), invoke->operands()));
+    XLS_RETURN_IF_ERROR(invoke->ReplaceUsesWith(result).status());
+    XLS_RETURN_IF_ERROR(f->RemoveNode(invoke));
+  }
+  return !invokes.empty();
 }
 
 }  // namespace xls
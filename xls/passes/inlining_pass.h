@@ -27,6 +27,9 @@ class InliningPass : public FunctionPass {
 
   xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
                                       PassResults* results) const override;
+
+  // Reads the bodies of the invoked functions.
+  bool IsFunctionLocal() const override { return false; }
 };
 
 }  // namespace xls
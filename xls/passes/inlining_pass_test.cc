@@ -17,8 +17,11 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "xls/common/status/matchers.h"
+#include "xls/ir/ir_interpreter.h"
 #include "xls/ir/ir_parser.h"
+#include "xls/ir/node_iterator.h"
 #include "xls/passes/dce_pass.h"
+#include "xls/passes/unroll_pass.h"
 
 namespace xls {
 namespace {
@@ -85,11 +88,111 @@ fn caller() -> bits[32] {
 
   const std::string expected = R"(fn caller() -> bits[32] {
   literal.3: bits[32] = literal(value=2)
-  ret add.7: bits[32] = add(literal.3, literal.3)
+  ret add.6: bits[32] = add(literal.3, literal.3)
 }
 )";
   EXPECT_EQ(expected, output);
 }
 
+TEST(InliningPassTest, InlinesAllInvokes) {
+  const std::string program = R"(
+package some_package
+
+fn callee2(x: bits[32]) -> bits[32] {
+  ret neg.1: bits[32] = neg(x)
+}
+
+fn callee1(x: bits[32], y: bits[32]) -> bits[32] {
+  invoke.2: bits[32] = invoke(x, to_apply=callee2)
+  invoke.3: bits[32] = invoke(y, to_apply=callee2)
+  ret sub.4: bits[32] = sub(invoke.2, invoke.3)
+}
+
+fn caller(x: bits[32]) -> bits[32] {
+  invoke.5: bits[32] = invoke(x, x, to_apply=callee1)
+  ret invoke.6: bits[32] = invoke(invoke.5, x, to_apply=callee1)
+}
+)";
+
+  std::string output;
+  Inline(program, &output);
+
+  const std::string expected = R"(fn caller(x: bits[32]) -> bits[32] {
+  neg.9: bits[32] = neg(x)
+  neg.10: bits[32] = neg(x)
+  sub.11: bits[32] = sub(neg.9, neg.10)
+  neg.12: bits[32] = neg(sub.11)
+  neg.13: bits[32] = neg(x)
+  ret sub.14: bits[32] = sub(neg.12, neg.13)
+}
+)";
+  EXPECT_EQ(expected, output);
+}
+
+// Unrolls and inlines a deep call tree shaped like the rounds of SHA-256: a
+// loop of 64 rounds, each invoking helper functions which invoke others.
+TEST(InliningPassTest, DeepCallTree) {
+  const std::string program = R"(
+package some_package
+
+fn rotr(x: bits[32], n: bits[32]) -> bits[32] {
+  shrl.1: bits[32] = shrl(x, n)
+  literal.2: bits[32] = literal(value=32)
+  sub.3: bits[32] = sub(literal.2, n)
+  shll.4: bits[32] = shll(x, sub.3)
+  ret or.5: bits[32] = or(shrl.1, shll.4)
+}
+
+fn sigma(x: bits[32]) -> bits[32] {
+  literal.6: bits[32] = literal(value=2)
+  literal.7: bits[32] = literal(value=13)
+  literal.8: bits[32] = literal(value=22)
+  invoke.9: bits[32] = invoke(x, literal.6, to_apply=rotr)
+  invoke.10: bits[32] = invoke(x, literal.7, to_apply=rotr)
+  invoke.11: bits[32] = invoke(x, literal.8, to_apply=rotr)
+  ret xor.12: bits[32] = xor(invoke.9, invoke.10, invoke.11)
+}
+
+fn ch(e: bits[32], f: bits[32], g: bits[32]) -> bits[32] {
+  and.13: bits[32] = and(e, f)
+  not.14: bits[32] = not(e)
+  and.15: bits[32] = and(not.14, g)
+  ret xor.16: bits[32] = xor(and.13, and.15)
+}
+
+fn round(i: bits[32], state: (bits[32], bits[32]), k: bits[32]) -> (bits[32], bits[32]) {
+  a: bits[32] = tuple_index(state, index=0)
+  b: bits[32] = tuple_index(state, index=1)
+  invoke.17: bits[32] = invoke(a, to_apply=sigma)
+  invoke.18: bits[32] = invoke(a, b, k, to_apply=ch)
+  add.19: bits[32] = add(invoke.17, invoke.18)
+  add.20: bits[32] = add(add.19, i)
+  ret tuple.21: (bits[32], bits[32]) = tuple(add.20, a)
+}
+
+fn main(x: bits[32], y: bits[32]) -> (bits[32], bits[32]) {
+  tuple.22: (bits[32], bits[32]) = tuple(x, y)
+  ret counted_for.23: (bits[32], bits[32]) = counted_for(tuple.22, trip_count=64, stride=1, body=round, invariant_args=[y])
+}
+)";
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> p,
+                           Parser::ParsePackage(program));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p->GetFunction("main"));
+  std::vector<Value> args = {Value(UBits(0x6a09e667, 32)),
+                             Value(UBits(0xbb67ae85, 32))};
+  XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(f, args));
+
+  PassResults results;
+  EXPECT_THAT(UnrollPass().RunOnFunction(f, PassOptions(), &results),
+              status_testing::IsOkAndHolds(true));
+  EXPECT_THAT(InliningPass().RunOnFunction(f, PassOptions(), &results),
+              status_testing::IsOkAndHolds(true));
+  for (Node* node : f->nodes()) {
+    EXPECT_FALSE(node->Is<Invoke>() || node->Is<CountedFor>()) << node;
+  }
+  EXPECT_THAT(ir_interpreter::Run(f, args),
+              status_testing::IsOkAndHolds(expected));
+}
+
 }  // namespace
 }  // namespace xls
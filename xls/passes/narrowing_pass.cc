@@ -14,14 +14,19 @@
 
 #include "xls/passes/narrowing_pass.h"
 
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_format.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/ret_check.h"
 #include "xls/common/status/status_macros.h"
 #include "xls/ir/node_iterator.h"
 #include "xls/ir/node_util.h"
 #include "xls/ir/op.h"
+#include "xls/passes/demanded_bits_analysis.h"
 #include "xls/passes/query_engine.h"
-#include "xls/passes/ternary_query_engine.h"
+#include "xls/passes/range_query_engine.h"
 
 namespace xls {
 
@@ -238,37 +243,42 @@ xabsl::StatusOr<bool> MaybeNarrowAdd(Node* add,
   int64 common_leading_zeros = std::min(
       CountLeadingKnownZeros(lhs, query_engine),
       CountLeadingKnownZeros(rhs, query_engine));
+  if (common_leading_zeros == bit_count) {
+    // All of the bits of both operands are zero. This case is handled
+    // elsewhere by replacing the operands with literal zeros.
+    return false;
+  }
 
+  // Narrow the add removing all but one of the known-zero leading bits of the
+  // operands, or the known-zero leading bits of the result if there are more.
+  // Example:
+  //
+  //    000XXX + 0000YY => { 00, 0XXX + 00YY }
+  //
+  int64 narrowed_bit_count =
+      bit_count - CountLeadingKnownZeros(add, query_engine);
   if (common_leading_zeros > 1) {
-    // Narrow the add removing all but one of the known-zero leading
-    // bits. Example:
-    //
-    //    000XXX + 0000YY => { 00, 0XXX + 00YY }
-    //
-    if (common_leading_zeros == bit_count) {
-      // All of the bits of both operands are zero. This case is handled
-      // elsewhere by replacing the operands with literal zeros.
-      return false;
-    }
-    int64 narrowed_bit_count = bit_count - common_leading_zeros + 1;
-    XLS_ASSIGN_OR_RETURN(
-        Node * narrowed_lhs,
-        lhs->function()->MakeNode<BitSlice>(lhs->loc(), lhs, /*start=*/0,
-                                            /*width=*/narrowed_bit_count));
-    XLS_ASSIGN_OR_RETURN(
-        Node * narrowed_rhs,
-        rhs->function()->MakeNode<BitSlice>(rhs->loc(), rhs, /*start=*/0,
-                                            /*width=*/narrowed_bit_count));
-    XLS_ASSIGN_OR_RETURN(Node * narrowed_add,
-                         add->function()->MakeNode<BinOp>(
-                             add->loc(), narrowed_lhs, narrowed_rhs, Op::kAdd));
-    XLS_RETURN_IF_ERROR(
-        add->ReplaceUsesWithNew<ExtendOp>(narrowed_add, bit_count, Op::kZeroExt)
-            .status());
-    return true;
+    narrowed_bit_count =
+        std::min(narrowed_bit_count, bit_count - common_leading_zeros + 1);
   }
-
-  return false;
+  if (narrowed_bit_count == 0 || narrowed_bit_count == bit_count) {
+    return false;
+  }
+  XLS_ASSIGN_OR_RETURN(
+      Node * narrowed_lhs,
+      lhs->function()->MakeNode<BitSlice>(lhs->loc(), lhs, /*start=*/0,
+                                          /*width=*/narrowed_bit_count));
+  XLS_ASSIGN_OR_RETURN(
+      Node * narrowed_rhs,
+      rhs->function()->MakeNode<BitSlice>(rhs->loc(), rhs, /*start=*/0,
+                                          /*width=*/narrowed_bit_count));
+  XLS_ASSIGN_OR_RETURN(Node * narrowed_add,
+                       add->function()->MakeNode<BinOp>(
+                           add->loc(), narrowed_lhs, narrowed_rhs, Op::kAdd));
+  XLS_RETURN_IF_ERROR(
+      add->ReplaceUsesWithNew<ExtendOp>(narrowed_add, bit_count, Op::kZeroExt)
+          .status());
+  return true;
 }
 
 // Try to narrow the operands and/or the result of a multiply.
@@ -345,6 +355,29 @@ xabsl::StatusOr<bool> MaybeNarrowMultiply(ArithOp* mul,
     return true;
   }
 
+  // The low bits of a product only depend on the low bits of the operands, so
+  // if the leading bits of the result are known zeros the multiply can be done
+  // at the narrower width and zero-extended.
+  int64 result_leading_zeros = CountLeadingKnownZeros(mul, query_engine);
+  if (result_leading_zeros > 0 && result_leading_zeros < result_bit_count) {
+    int64 narrowed_bit_count = result_bit_count - result_leading_zeros;
+    XLS_ASSIGN_OR_RETURN(
+        Node * narrowed_lhs,
+        maybe_narrow(lhs, std::min(lhs_bit_count, narrowed_bit_count)));
+    XLS_ASSIGN_OR_RETURN(
+        Node * narrowed_rhs,
+        maybe_narrow(rhs, std::min(rhs_bit_count, narrowed_bit_count)));
+    XLS_ASSIGN_OR_RETURN(
+        Node * narrowed_mul,
+        mul->function()->MakeNode<ArithOp>(mul->loc(), narrowed_lhs,
+                                           narrowed_rhs, narrowed_bit_count,
+                                           mul->op()));
+    XLS_RETURN_IF_ERROR(mul->ReplaceUsesWithNew<ExtendOp>(
+                               narrowed_mul, result_bit_count, Op::kZeroExt)
+                            .status());
+    return true;
+  }
+
   // A multiply where the result and both operands are the same width is the
   // same operation whether it is signed or unsigned.
   bool is_sign_agnostic =
@@ -419,16 +452,64 @@ xabsl::StatusOr<bool> MaybeNarrowMultiply(ArithOp* mul,
   return false;
 }
 
+// Try to narrow an arithmetic operation whose high result bits are not
+// demanded: the low bits of the result only depend on the low bits of the
+// operands, so the operation can be done at the demanded width and
+// zero-extended.
+xabsl::StatusOr<bool> MaybeNarrowToDemandedBits(
+    Node* node, const DemandedBitsAnalysis& demanded_bits) {
+  XLS_RET_CHECK(node->op() == Op::kAdd || node->op() == Op::kSub ||
+                node->op() == Op::kNeg || node->op() == Op::kSMul ||
+                node->op() == Op::kUMul);
+  const int64 bit_count = node->BitCountOrDie();
+  const int64 demanded_width = demanded_bits.GetDemandedWidth(node);
+  // A node with no demanded bits is replaced by DeadBitEliminationPass.
+  if (demanded_width == 0 || demanded_width == bit_count) {
+    return false;
+  }
+  XLS_VLOG(3) << absl::StreamFormat("Narrowing %s to its %d demanded bits",
+                                    node->GetName(), demanded_width);
+  Function* f = node->function();
+  Node* narrowed;
+  if (node->op() == Op::kSMul || node->op() == Op::kUMul) {
+    XLS_ASSIGN_OR_RETURN(narrowed, f->MakeNode<ArithOp>(
+                                       node->loc(), node->operand(0),
+                                       node->operand(1), demanded_width,
+                                       node->op()));
+  } else {
+    std::vector<Node*> narrowed_operands;
+    for (Node* operand : node->operands()) {
+      XLS_ASSIGN_OR_RETURN(Node * narrowed_operand,
+                           f->MakeNode<BitSlice>(node->loc(), operand,
+                                                 /*start=*/0,
+                                                 /*width=*/demanded_width));
+      narrowed_operands.push_back(narrowed_operand);
+    }
+    XLS_ASSIGN_OR_RETURN(narrowed, node->Clone(narrowed_operands, f));
+  }
+  XLS_RETURN_IF_ERROR(
+      node->ReplaceUsesWithNew<ExtendOp>(narrowed, bit_count, Op::kZeroExt)
+          .status());
+  return true;
+}
+
 }  // namespace
 
 xabsl::StatusOr<bool> NarrowingPass::RunOnFunction(Function* f,
                                                    const PassOptions& options,
                                                    PassResults* results) const {
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<TernaryQueryEngine> query_engine,
-                       TernaryQueryEngine::Run(f));
+  XLS_ASSIGN_OR_RETURN(RangeQueryEngine * query_engine,
+                       results->query_engine_cache.GetRangeQueryEngine(f));
+  // The rewrites below preserve the value of every demanded bit, so the
+  // analysis remains valid for the nodes not yet visited.
+  XLS_ASSIGN_OR_RETURN(std::unique_ptr<DemandedBitsAnalysis> demanded_bits,
+                       DemandedBitsAnalysis::Run(f));
 
   bool modified = false;
   for (Node* node : TopoSort(f)) {
+    if (options.DeadlineExceeded()) {
+      break;
+    }
     // Narrow the shift-amount operand of shift operations if the shift-amount
     // has leading zeros.
     bool node_modified = false;
@@ -448,9 +529,13 @@ xabsl::StatusOr<bool> NarrowingPass::RunOnFunction(Function* f,
       }
       case Op::kSMul:
       case Op::kUMul: {
-        XLS_ASSIGN_OR_RETURN(
-            node_modified,
-            MaybeNarrowMultiply(node->As<ArithOp>(), *query_engine));
+        XLS_ASSIGN_OR_RETURN(node_modified,
+                             MaybeNarrowToDemandedBits(node, *demanded_bits));
+        if (!node_modified) {
+          XLS_ASSIGN_OR_RETURN(
+              node_modified,
+              MaybeNarrowMultiply(node->As<ArithOp>(), *query_engine));
+        }
         break;
       }
       case Op::kULe:
@@ -470,7 +555,17 @@ xabsl::StatusOr<bool> NarrowingPass::RunOnFunction(Function* f,
       }
       case Op::kAdd: {
         XLS_ASSIGN_OR_RETURN(node_modified,
-                             MaybeNarrowAdd(node, *query_engine));
+                             MaybeNarrowToDemandedBits(node, *demanded_bits));
+        if (!node_modified) {
+          XLS_ASSIGN_OR_RETURN(node_modified,
+                               MaybeNarrowAdd(node, *query_engine));
+        }
+        break;
+      }
+      case Op::kSub:
+      case Op::kNeg: {
+        XLS_ASSIGN_OR_RETURN(node_modified,
+                             MaybeNarrowToDemandedBits(node, *demanded_bits));
         break;
       }
       default:
@@ -322,5 +322,56 @@ TEST_F(NarrowingPassTest, AddWithAllZeroOperands) {
   ASSERT_THAT(Run(p.get()), IsOkAndHolds(false));
 }
 
+TEST_F(NarrowingPassTest, AddOfClampedValue) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  BValue limit = fb.Literal(UBits(100, 32));
+  fb.Add(fb.Select(fb.ULt(x, limit), {limit, x}),
+         fb.Literal(UBits(1, 32)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  ASSERT_THAT(Run(p.get()), IsOkAndHolds(true));
+  // The sum is at most 101, which fits in seven bits.
+  EXPECT_THAT(f->return_value(),
+              m::ZeroExt(AllOf(m::Add(m::BitSlice(/*start=*/0, /*width=*/7),
+                                      m::BitSlice(/*start=*/0, /*width=*/7)),
+                               m::Type("bits[7]"))));
+}
+
+TEST_F(NarrowingPassTest, MultiplyWithSmallResult) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(16));
+  BValue limit = fb.Literal(UBits(40, 16));
+  BValue clamped = fb.Select(fb.UGt(x, limit), {x, limit});
+  fb.UMul(clamped, fb.ZeroExtend(fb.Param("y", p->GetBitsType(3)), 16),
+          /*result_width=*/32);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  ASSERT_THAT(Run(p.get()), IsOkAndHolds(true));
+  // The product is at most 40 * 7 = 280, which fits in nine bits.
+  EXPECT_THAT(f->return_value(),
+              m::ZeroExt(AllOf(m::UMul(m::BitSlice(/*start=*/0, /*width=*/9),
+                                       m::BitSlice(/*start=*/0, /*width=*/9)),
+                               m::Type("bits[9]"))));
+}
+
+TEST_F(NarrowingPassTest, AddWithUndemandedHighBits) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  Type* u32 = p->GetBitsType(32);
+  BValue sum = fb.Add(fb.Param("x", u32), fb.Param("y", u32));
+  fb.BitSlice(sum, /*start=*/0, /*width=*/6);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  ASSERT_THAT(Run(p.get()), IsOkAndHolds(true));
+  // Only the low six bits of the sum are used, and they only depend on the
+  // low six bits of the operands.
+  EXPECT_THAT(
+      f->return_value(),
+      m::BitSlice(m::ZeroExt(
+          AllOf(m::Add(m::BitSlice(m::Param("x"), /*start=*/0, /*width=*/6),
+                       m::BitSlice(m::Param("y"), /*start=*/0, /*width=*/6)),
+                m::Type("bits[6]")))));
+}
+
 }  // namespace
 }  // namespace xls
@@ -0,0 +1,131 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/node_rewrite_pass.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/passes/dce_pass.h"
+
+namespace xls {
+
+xabsl::StatusOr<bool> NodeRewritePass::RunOnFunction(
+    Function* f, const PassOptions& options, PassResults* results) const {
+  // The rules to try on nodes of each op.
+  std::vector<std::vector<const NodeRewriteRule*>> rules_by_op(kOpLimit);
+  for (const std::unique_ptr<NodeRewriteRule>& rule : rules_) {
+    if (absl::c_linear_search(options.skip_passes, rule->name())) {
+      continue;
+    }
+    for (int64 op = 0; op < kOpLimit; ++op) {
+      if (rule->AppliesTo(static_cast<Op>(op))) {
+        rules_by_op[op].push_back(rule.get());
+      }
+    }
+  }
+
+  // Rules may undo each other's rewrites, so whether the function changed is
+  // decided by comparing fingerprints.
+  uint64 fingerprint = f->Fingerprint();
+
+  // The nodes to visit. A node is removed from 'queued' when it is deleted, so
+  // stale entries in 'worklist' are skipped.
+  std::deque<Node*> worklist;
+  absl::flat_hash_set<Node*> queued;
+  auto enqueue = [&](Node* node) {
+    if (queued.insert(node).second) {
+      worklist.push_back(node);
+    }
+  };
+
+  // Node ids increase with creation, so any node with a larger id than this
+  // was created by a rule and has not been seen yet.
+  int64 max_id = -1;
+  for (Node* node : TopoSort(f)) {
+    enqueue(node);
+    max_id = std::max(max_id, node->id());
+  }
+
+  int64 rewrite_count = 0;
+  int64 removed_count = 0;
+  while (!worklist.empty()) {
+    Node* node = worklist.front();
+    worklist.pop_front();
+    if (!queued.erase(node)) {
+      continue;
+    }
+
+    if (node->users().empty() && DeadCodeEliminationPass::IsRemovable(node)) {
+      std::vector<Node*> operands(node->operands().begin(),
+                                  node->operands().end());
+      XLS_RETURN_IF_ERROR(f->RemoveNode(node));
+      ++removed_count;
+      for (Node* operand : operands) {
+        enqueue(operand);
+      }
+      continue;
+    }
+
+    for (const NodeRewriteRule* rule :
+         rules_by_op[static_cast<int64>(node->op())]) {
+      std::vector<Node*> neighbors(node->operands().begin(),
+                                   node->operands().end());
+      neighbors.insert(neighbors.end(), node->users().begin(),
+                       node->users().end());
+      int64 last_id = max_id;
+      XLS_ASSIGN_OR_RETURN(bool rewritten, rule->Rewrite(node));
+      if (!rewritten) {
+        continue;
+      }
+      XLS_VLOG(3) << "Rule " << rule->name() << " rewrote " << node->GetName();
+      ++rewrite_count;
+
+      // Revisit the node and everything around it, including the nodes the rule
+      // created. New nodes are only reachable through the operands of nodes the
+      // rule changed.
+      enqueue(node);
+      for (Node* neighbor : neighbors) {
+        enqueue(neighbor);
+      }
+      std::vector<Node*> stack = std::move(neighbors);
+      stack.push_back(node);
+      stack.push_back(f->return_value());
+      while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        for (Node* operand : n->operands()) {
+          if (operand->id() > last_id && !queued.contains(operand)) {
+            enqueue(operand);
+            stack.push_back(operand);
+            max_id = std::max(max_id, operand->id());
+          }
+        }
+      }
+      break;
+    }
+  }
+
+  XLS_VLOG(2) << "Applied " << rewrite_count << " rewrites and removed "
+              << removed_count << " dead nodes in function " << f->name();
+  return (rewrite_count > 0 || removed_count > 0) &&
+         f->Fingerprint() != fingerprint;
+}
+
+}  // namespace xls
@@ -0,0 +1,86 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_NODE_REWRITE_PASS_H_
+#define XLS_PASSES_NODE_REWRITE_PASS_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/node.h"
+#include "xls/ir/op.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+
+// A local simplification of a single node, applied by a NodeRewritePass.
+class NodeRewriteRule {
+ public:
+  explicit NodeRewriteRule(absl::string_view name) : name_(name) {}
+  virtual ~NodeRewriteRule() = default;
+
+  // The name of the rule; by convention the short name of the pass which
+  // applies the same simplifications to a whole function.
+  const std::string& name() const { return name_; }
+
+  // Returns whether the rule can apply to nodes with the given op. The rule is
+  // only tried on such nodes.
+  virtual bool AppliesTo(Op op) const { return true; }
+
+  // Attempts to simplify the given node. Returns true if the IR was changed.
+  // The rule may replace the uses of the node, replace its operands and create
+  // new nodes, but must not remove nodes.
+  virtual xabsl::StatusOr<bool> Rewrite(Node* node) const = 0;
+
+ private:
+  std::string name_;
+};
+
+// Applies a set of rewrite rules to the nodes of each function until no rule
+// applies to any node. All nodes are visited once in topological order; after
+// that, a node is only revisited when something around it changes: when a
+// rule changes a node, its operands, its former users and any nodes the rule
+// created are revisited. Nodes are removed as soon as they become dead.
+//
+// Rules whose names appear in PassOptions::skip_passes are not applied.
+class NodeRewritePass : public FunctionPass {
+ public:
+  NodeRewritePass(absl::string_view short_name, absl::string_view long_name)
+      : FunctionPass(short_name, long_name) {}
+  ~NodeRewritePass() override {}
+
+  // Adds a new rule. Arguments to the method are the arguments to the rule
+  // constructor. Returns a pointer to the newly constructed rule.
+  template <typename T, typename... Args>
+  T* Add(Args&&... args) {
+    auto* rule = new T(std::forward<Args>(args)...);
+    rules_.emplace_back(rule);
+    return rule;
+  }
+
+  xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
+                                      PassResults* results) const override;
+
+ private:
+  std::vector<std::unique_ptr<NodeRewriteRule>> rules_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_NODE_REWRITE_PASS_H_
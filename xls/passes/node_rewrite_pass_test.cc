@@ -0,0 +1,120 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/node_rewrite_pass.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/package.h"
+#include "xls/passes/arith_simplification_pass.h"
+#include "xls/passes/constant_folding_pass.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+// Replaces not(not(x)) with x, counting the nodes it is tried on.
+class DoubleNegationRule : public NodeRewriteRule {
+ public:
+  DoubleNegationRule() : NodeRewriteRule("double_negation") {}
+
+  bool AppliesTo(Op op) const override { return op == Op::kNot; }
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override {
+    ++rewrite_calls_;
+    if (!node->operand(0)->Is<UnOp>() || node->operand(0)->op() != Op::kNot) {
+      return false;
+    }
+    return node->ReplaceUsesWith(node->operand(0)->operand(0));
+  }
+
+  int64 rewrite_calls() const { return rewrite_calls_; }
+
+ private:
+  mutable int64 rewrite_calls_ = 0;
+};
+
+class NodeRewritePassTest : public IrTestBase {
+ protected:
+  xabsl::StatusOr<bool> Run(const NodeRewritePass& pass, Function* f,
+                            const PassOptions& options = PassOptions()) {
+    PassResults results;
+    return pass.RunOnFunction(f, options, &results);
+  }
+};
+
+TEST_F(NodeRewritePassTest, CascadingRewritesInOneRun) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue three = fb.Add(fb.Literal(UBits(1, 8)), fb.Literal(UBits(2, 8)));
+  BValue zero = fb.Subtract(three, fb.Literal(UBits(3, 8)));
+  fb.Add(x, zero);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  NodeRewritePass pass("local_simp", "Local simplifications");
+  pass.Add<ConstantFoldingRule>();
+  pass.Add<ArithSimplificationRule>();
+  EXPECT_THAT(Run(pass, f), IsOkAndHolds(true));
+  EXPECT_EQ(f->return_value(), x.node());
+  EXPECT_EQ(f->node_count(), 1);
+  EXPECT_THAT(Run(pass, f), IsOkAndHolds(false));
+}
+
+TEST_F(NodeRewritePassTest, SkippedRulesAreNotApplied) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Add(x, fb.Subtract(fb.Literal(UBits(3, 8)), fb.Literal(UBits(3, 8))));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  NodeRewritePass pass("local_simp", "Local simplifications");
+  pass.Add<ConstantFoldingRule>();
+  pass.Add<ArithSimplificationRule>();
+  PassOptions options;
+  options.skip_passes = {"arith_simp"};
+  EXPECT_THAT(Run(pass, f, options), IsOkAndHolds(true));
+  EXPECT_EQ(f->return_value()->op(), Op::kAdd);
+  EXPECT_EQ(f->node_count(), 3);
+}
+
+TEST_F(NodeRewritePassTest, OnlyNeighborsAreRevisited) {
+  // A long chain of negations collapses pairwise from the bottom up. Each
+  // rewrite only causes the nodes around it to be revisited.
+  constexpr int64 kChainLength = 1000;
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue value = x;
+  for (int64 i = 0; i < kChainLength; ++i) {
+    value = fb.Not(value);
+  }
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  NodeRewritePass pass("local_simp", "Local simplifications");
+  DoubleNegationRule* rule = pass.Add<DoubleNegationRule>();
+  EXPECT_THAT(Run(pass, f), IsOkAndHolds(true));
+  EXPECT_EQ(f->return_value(), x.node());
+  EXPECT_EQ(f->node_count(), 1);
+  EXPECT_LT(rule->rewrite_calls(), 3 * kChainLength);
+}
+
+}  // namespace
+}  // namespace xls
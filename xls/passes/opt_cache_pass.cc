@@ -0,0 +1,290 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/opt_cache_pass.h"
+
+#include <unistd.h>
+
+#include <system_error>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "xls/common/file/filesystem.h"
+#include "xls/common/fingerprint.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/passes/dfe_pass.h"
+
+namespace xls {
+namespace {
+
+// Returns the functions the node calls.
+std::vector<Function*> CalledFunctions(Node* node) {
+  switch (node->op()) {
+    case Op::kCountedFor:
+      return {node->As<CountedFor>()->body()};
+    case Op::kInvoke:
+      return {node->As<Invoke>()->to_apply()};
+    case Op::kMap:
+      return {node->As<Map>()->to_apply()};
+    default:
+      return {};
+  }
+}
+
+uint64 ContentHash(Function* f,
+                   absl::flat_hash_map<Function*, uint64>* hashes) {
+  auto it = hashes->find(f);
+  if (it != hashes->end()) {
+    return it->second;
+  }
+  // Nodes are identified by their position in topological order.
+  absl::flat_hash_map<Node*, int64> positions;
+  uint64 hash = FingerprintString(f->name());
+  for (Node* node : TopoSort(f)) {
+    uint64 node_hash =
+        FingerprintCombine(static_cast<uint64>(node->op()),
+                           FingerprintString(node->GetType()->ToString()));
+    node_hash = FingerprintCombine(node_hash, node->AttributeFingerprint());
+    if (node->loc().has_value()) {
+      node_hash = FingerprintCombine(
+          node_hash, FingerprintString(node->loc()->ToString()));
+    }
+    for (Node* operand : node->operands()) {
+      node_hash = FingerprintCombine(node_hash, positions.at(operand));
+    }
+    for (Function* callee : CalledFunctions(node)) {
+      node_hash = FingerprintCombine(node_hash, ContentHash(callee, hashes));
+    }
+    int64 position = positions.size();
+    positions[node] = position;
+    hash = FingerprintCombine(hash, node_hash);
+  }
+  for (Param* param : f->params()) {
+    hash = FingerprintCombine(hash, positions.at(param));
+  }
+  hash = FingerprintCombine(hash, positions.at(f->return_value()));
+  (*hashes)[f] = hash;
+  return hash;
+}
+
+// Returns whether the function calls a function not in the given set of
+// names.
+bool CallsFunctionNotIn(Function* f,
+                        const absl::flat_hash_set<std::string>& names) {
+  for (Node* node : f->nodes()) {
+    for (Function* callee : CalledFunctions(node)) {
+      if (!names.contains(callee->name())) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Returns a description of the pass and the passes it contains.
+std::string PassTreeToString(const Pass& pass) {
+  if (!pass.IsCompound()) {
+    return pass.short_name();
+  }
+  return absl::StrFormat(
+      "%s(%s)", pass.short_name(),
+      absl::StrJoin(static_cast<const CompoundPass&>(pass).passes(), ",",
+                    [](std::string* out, const Pass* p) {
+                      absl::StrAppend(out, PassTreeToString(*p));
+                    }));
+}
+
+// Returns a description of the options which affect the optimized IR.
+std::string OptionsToString(const PassOptions& options) {
+  return absl::StrFormat(
+      "opt_level=%d run_only_passes=%s skip_passes=%s "
+      "max_fixed_point_iterations=%d unroll_node_limit=%d "
+      "rolled_loop_bodies=%s",
+      options.opt_level,
+      options.run_only_passes.has_value()
+          ? absl::StrJoin(*options.run_only_passes, ",")
+          : "all",
+      absl::StrJoin(options.skip_passes, ","),
+      options.max_fixed_point_iterations.value_or(-1),
+      options.unroll_node_limit.value_or(-1),
+      absl::StrJoin(options.rolled_loop_bodies, ","));
+}
+
+// Returns whether running the pass runs a pass with the given short name.
+bool RunsPass(const Pass& pass, absl::string_view short_name,
+              const PassOptions& options) {
+  if (absl::c_linear_search(options.skip_passes, pass.short_name())) {
+    return false;
+  }
+  if (pass.IsCompound()) {
+    return absl::c_any_of(static_cast<const CompoundPass&>(pass).passes(),
+                          [&](const Pass* p) {
+                            return RunsPass(*p, short_name, options);
+                          });
+  }
+  return pass.short_name() == short_name &&
+         (!options.run_only_passes.has_value() ||
+          absl::c_linear_search(*options.run_only_passes, short_name));
+}
+
+// Writes the cache entry so that concurrent readers never see a partial file.
+absl::Status WriteEntry(const std::filesystem::path& path,
+                        absl::string_view contents) {
+  std::filesystem::path temp_path = path;
+  temp_path += absl::StrFormat(".%d.tmp", getpid());
+  XLS_RETURN_IF_ERROR(SetFileContents(temp_path, contents));
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    return absl::InternalError(absl::StrFormat(
+        "Failed to rename %s to %s: %s", temp_path.string(), path.string(),
+        error.message()));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+uint64 FunctionContentHash(Function* f) {
+  absl::flat_hash_map<Function*, uint64> hashes;
+  return ContentHash(f, &hashes);
+}
+
+xabsl::StatusOr<bool> OptCachePass::Run(Package* p, const PassOptions& options,
+                                        PassResults* results) const {
+  XLS_RETURN_IF_ERROR(RecursivelyCreateDir(directory_));
+  uint64 config_hash = FingerprintString(
+      absl::StrCat(tool_version_, "\n", PassTreeToString(*pipeline_), "\n",
+                   OptionsToString(options)));
+
+  // Look up every function.
+  absl::flat_hash_map<Function*, uint64> content_hashes;
+  absl::flat_hash_map<std::string, std::filesystem::path> entry_paths;
+  absl::flat_hash_map<std::string, std::string> cached_ir;
+  std::vector<Function*> uncached;
+  absl::flat_hash_set<std::string> input_names;
+  for (std::unique_ptr<Function>& f : p->functions()) {
+    input_names.insert(f->name());
+    uint64 key = FingerprintCombine(ContentHash(f.get(), &content_hashes),
+                                    config_hash);
+    std::filesystem::path path = directory_ / absl::StrFormat("%016x.ir", key);
+    entry_paths[f->name()] = path;
+    if (FileExists(path).ok()) {
+      XLS_ASSIGN_OR_RETURN(cached_ir[f->name()], GetFileContents(path));
+    } else {
+      uncached.push_back(f.get());
+    }
+  }
+
+  // The functions being optimized may inline their callees, which must keep
+  // their original form and so are optimized as well.
+  std::vector<Function*> worklist = uncached;
+  while (!worklist.empty()) {
+    Function* f = worklist.back();
+    worklist.pop_back();
+    for (Node* node : f->nodes()) {
+      for (Function* callee : CalledFunctions(node)) {
+        if (cached_ir.erase(callee->name())) {
+          worklist.push_back(callee);
+        }
+      }
+    }
+  }
+  std::vector<std::string> uncached_names;
+  for (Function* f : uncached) {
+    uncached_names.push_back(f->name());
+  }
+  results->opt_cache_stats.misses += p->functions().size() - cached_ir.size();
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Restoring %d of %d functions from the optimization cache",
+      cached_ir.size(), p->functions().size());
+
+  uint64 fingerprint = p->Fingerprint();
+  for (const auto& [name, ir] : cached_ir) {
+    results->frozen_functions.insert(name);
+  }
+  xabsl::StatusOr<bool> pipeline_result = pipeline_->Run(p, options, results);
+  for (const auto& [name, ir] : cached_ir) {
+    results->frozen_functions.erase(name);
+  }
+  XLS_RETURN_IF_ERROR(pipeline_result.status());
+
+  // Store the optimized functions which the pipeline did not remove. Functions
+  // calling a function added by the pipeline (e.g., a partially unrolled loop
+  // body or a specialized callee) are not stored, as the added function is
+  // not in the cache and the entry could not be restored.
+  if (!options.deadline.has_value()) {
+    for (const std::string& name : uncached_names) {
+      xabsl::StatusOr<Function*> f = p->GetFunction(name);
+      if (!f.ok()) {
+        continue;
+      }
+      if (CallsFunctionNotIn(f.value(), input_names)) {
+        XLS_VLOG(1) << "Not storing " << name
+                    << " in the optimization cache as it calls a function "
+                       "added by the pipeline";
+        continue;
+      }
+      XLS_RETURN_IF_ERROR(
+          WriteEntry(entry_paths.at(name), f.value()->DumpIr()));
+      ++results->opt_cache_stats.stores;
+    }
+  }
+
+  // Replace the frozen functions by their optimized form. They are parsed in
+  // package order, so callees are added before their callers.
+  std::vector<Function*> frozen;
+  std::vector<std::string> frozen_names;
+  for (std::unique_ptr<Function>& f : p->functions()) {
+    if (cached_ir.contains(f->name())) {
+      frozen.push_back(f.get());
+      frozen_names.push_back(f->name());
+      results->query_engine_cache.Invalidate(f.get());
+    }
+  }
+  if (frozen.empty()) {
+    return p->Fingerprint() != fingerprint;
+  }
+  p->DeleteDeadFunctions(frozen);
+  for (const std::string& name : frozen_names) {
+    xabsl::StatusOr<Function*> f =
+        Parser::ParseFunctionWithFreshIds(cached_ir.at(name), p);
+    if (!f.ok() || f.value()->name() != name) {
+      return absl::DataLossError(absl::StrFormat(
+          "Invalid optimization cache entry %s for function %s: %s",
+          entry_paths.at(name).string(), name,
+          f.ok() ? "wrong function name" : std::string(f.status().message())));
+    }
+    ++results->opt_cache_stats.hits;
+  }
+
+  // Restored functions no longer call the functions they inlined.
+  DeadFunctionEliminationPass dfe;
+  if (RunsPass(*pipeline_, dfe.short_name(), options)) {
+    XLS_RETURN_IF_ERROR(dfe.Run(p, options, results).status());
+  }
+  return p->Fingerprint() != fingerprint;
+}
+
+}  // namespace xls
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_OPT_CACHE_PASS_H_
+#define XLS_PASSES_OPT_CACHE_PASS_H_
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/package.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+
+// Returns a fingerprint of the structure of the function and of the functions
+// it calls, directly or indirectly. Unlike Function::Fingerprint, it does not
+// depend on node ids, so equal functions in different packages have equal
+// content hashes.
+uint64 FunctionContentHash(Function* f);
+
+// Runs a pass pipeline with a persistent cache of optimized functions in a
+// directory. Each function is looked up by its content hash, the pipeline's
+// passes, the options which affect their results and the version of the tool.
+// Functions found in the cache are frozen while the pipeline runs (see
+// PassResults::frozen_functions) and then replaced by their cached optimized
+// form; the other functions are optimized as usual and added to the cache.
+// The results are reported in PassResults::opt_cache_stats.
+//
+// A function is only restored if none of the functions being optimized call
+// it, as those may need to inline it in its original form. Optimizing a
+// function must only depend on the function and its callees, which holds for
+// function passes. Restored functions are equivalent to what the pipeline
+// would produce, but their node ids differ. Results are not stored when a
+// deadline is set, as they depend on how quickly the passes ran, nor for
+// functions which call functions added by the pipeline, such as partially
+// unrolled loop bodies.
+class OptCachePass : public Pass {
+ public:
+  // 'tool_version' identifies the build of the tool; entries written by other
+  // builds are not used.
+  OptCachePass(std::unique_ptr<Pass> pipeline,
+               std::filesystem::path directory, absl::string_view tool_version)
+      : Pass("opt_cache", "Optimization cache"),
+        pipeline_(std::move(pipeline)),
+        directory_(std::move(directory)),
+        tool_version_(tool_version) {}
+  ~OptCachePass() override {}
+
+  xabsl::StatusOr<bool> Run(Package* p, const PassOptions& options,
+                            PassResults* results) const override;
+
+ private:
+  std::unique_ptr<Pass> pipeline_;
+  std::filesystem::path directory_;
+  std::string tool_version_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_OPT_CACHE_PASS_H_
@@ -0,0 +1,242 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/opt_cache_pass.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_replace.h"
+#include "absl/time/time.h"
+#include "xls/common/file/temp_directory.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/function.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/package.h"
+#include "xls/passes/arith_simplification_pass.h"
+#include "xls/passes/dce_pass.h"
+#include "xls/passes/standard_pipeline.h"
+
+namespace xls {
+namespace {
+
+constexpr char kInvokePackage[] = R"(
+package test
+
+fn helper(x: bits[8]) -> bits[8] {
+  zero: bits[8] = literal(value=0)
+  ret sum: bits[8] = add(x, zero)
+}
+
+fn main(x: bits[8]) -> bits[8] {
+  a: bits[8] = invoke(x, to_apply=helper)
+  b: bits[8] = neg(a)
+  ret c: bits[8] = neg(b)
+}
+)";
+
+constexpr char kTwoFunctionPackage[] = R"(
+package test
+
+fn f(x: bits[8]) -> bits[8] {
+  zero: bits[8] = literal(value=0)
+  ret sum: bits[8] = add(x, zero)
+}
+
+fn g(x: bits[8]) -> bits[8] {
+  zero: bits[8] = literal(value=0)
+  ret difference: bits[8] = sub(x, zero)
+}
+)";
+
+constexpr char kLoopPackage[] = R"(
+package test
+
+fn body(i: bits[8], accum: bits[32], x: bits[32]) -> bits[32] {
+  zero_ext.3: bits[32] = zero_ext(i, new_bit_count=32)
+  add.4: bits[32] = add(zero_ext.3, accum)
+  ret xor.5: bits[32] = xor(add.4, x)
+}
+
+fn main(x: bits[32]) -> bits[32] {
+  literal.1: bits[32] = literal(value=0)
+  ret counted_for.2: bits[32] = counted_for(literal.1, trip_count=10, stride=3, body=body, invariant_args=[x])
+}
+)";
+
+constexpr char kSpecializedLoopPackage[] = R"(
+package test
+
+fn body(i: bits[4], acc: bits[8], up: bits[1]) -> bits[8] {
+  literal.1: bits[8] = literal(value=1)
+  add.2: bits[8] = add(acc, literal.1)
+  sub.3: bits[8] = sub(acc, literal.1)
+  ret sel.4: bits[8] = sel(up, cases=[sub.3, add.2])
+}
+
+fn main(x: bits[8]) -> bits[8] {
+  literal.5: bits[1] = literal(value=1)
+  ret counted_for.6: bits[8] = counted_for(x, trip_count=4, stride=1, body=body, invariant_args=[literal.5])
+}
+)";
+
+class OptCachePassTest : public IrTestBase {
+ protected:
+  void SetUp() override {
+    XLS_ASSERT_OK_AND_ASSIGN(temp_dir_, TempDirectory::Create());
+  }
+
+  // Runs the standard pipeline through the cache on the given package.
+  xabsl::StatusOr<OptCacheStats> RunStandard(
+      Package* p, const PassOptions& options = PassOptions()) {
+    OptCachePass pass(CreateStandardPassPipeline(), temp_dir_->path(),
+                      /*tool_version=*/"test");
+    PassResults results;
+    XLS_RETURN_IF_ERROR(pass.Run(p, options, &results).status());
+    return results.opt_cache_stats;
+  }
+
+  // Runs a pipeline without dead function elimination through the cache.
+  xabsl::StatusOr<OptCacheStats> RunSimple(
+      Package* p, const PassOptions& options = PassOptions()) {
+    auto pipeline = absl::make_unique<CompoundPass>("simple", "Simple");
+    pipeline->Add<ArithSimplificationPass>();
+    pipeline->Add<DeadCodeEliminationPass>();
+    OptCachePass pass(std::move(pipeline), temp_dir_->path(),
+                      /*tool_version=*/"test");
+    PassResults results;
+    XLS_RETURN_IF_ERROR(pass.Run(p, options, &results).status());
+    EXPECT_TRUE(results.frozen_functions.empty());
+    return results.opt_cache_stats;
+  }
+
+  absl::optional<TempDirectory> temp_dir_;
+};
+
+TEST_F(OptCachePassTest, RestoresOptimizedFunction) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kInvokePackage));
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats, RunStandard(p1.get()));
+  EXPECT_EQ(stats.hits, 0);
+  EXPECT_EQ(stats.misses, 2);
+  // The helper is inlined and removed, so only 'main' is stored.
+  EXPECT_EQ(stats.stores, 1);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main1, p1->GetFunction("main"));
+  EXPECT_EQ(main1->return_value()->op(), Op::kParam);
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto p2, ParsePackage(kInvokePackage));
+  XLS_ASSERT_OK_AND_ASSIGN(stats, RunStandard(p2.get()));
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(p2->functions().size(), 1);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main2, p2->GetFunction("main"));
+  EXPECT_EQ(FunctionContentHash(main2), FunctionContentHash(main1));
+}
+
+TEST_F(OptCachePassTest, ChangedCalleeInvalidatesCaller) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kInvokePackage));
+  XLS_ASSERT_OK(RunStandard(p1.get()).status());
+
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto p2,
+      ParsePackage(absl::StrReplaceAll(
+          kInvokePackage, {{"literal(value=0)", "literal(value=1)"}})));
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats, RunStandard(p2.get()));
+  EXPECT_EQ(stats.hits, 0);
+  EXPECT_EQ(stats.misses, 2);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main2, p2->GetFunction("main"));
+  EXPECT_EQ(main2->return_value()->op(), Op::kAdd);
+}
+
+TEST_F(OptCachePassTest, OnlyChangedFunctionsAreOptimized) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kTwoFunctionPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats, RunSimple(p1.get()));
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.stores, 2);
+
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto p2, ParsePackage(absl::StrReplaceAll(
+                   kTwoFunctionPackage, {{"sub(x, zero)", "sub(zero, x)"}})));
+  XLS_ASSERT_OK_AND_ASSIGN(stats, RunSimple(p2.get()));
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.stores, 1);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p2->GetFunction("f"));
+  EXPECT_EQ(f->return_value()->op(), Op::kParam);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * g, p2->GetFunction("g"));
+  EXPECT_NE(g->return_value()->op(), Op::kParam);
+}
+
+TEST_F(OptCachePassTest, OptionsArePartOfTheKey) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kTwoFunctionPackage));
+  XLS_ASSERT_OK(RunSimple(p1.get()).status());
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto p2, ParsePackage(kTwoFunctionPackage));
+  PassOptions options;
+  options.skip_passes = {"arith_simp"};
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats, RunSimple(p2.get(), options));
+  EXPECT_EQ(stats.hits, 0);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p2->GetFunction("f"));
+  EXPECT_EQ(f->return_value()->op(), Op::kAdd);
+}
+
+TEST_F(OptCachePassTest, ResultsAreNotStoredWithDeadline) {
+  XLS_ASSERT_OK_AND_ASSIGN(auto p, ParsePackage(kTwoFunctionPackage));
+  PassOptions options;
+  options.deadline = absl::InfiniteFuture();
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats, RunSimple(p.get(), options));
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.stores, 0);
+}
+
+TEST_F(OptCachePassTest, PartiallyUnrolledLoopIsNotStored) {
+  PassOptions options;
+  options.unroll_node_limit = 24;
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats,
+                           RunStandard(p1.get(), options));
+  // 'main' calls the unrolled body added by the pipeline, so it is not stored.
+  EXPECT_EQ(stats.stores, 0);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main1, p1->GetFunction("main"));
+  ASSERT_TRUE(main1->return_value()->Is<CountedFor>());
+  EXPECT_THAT(main1->return_value()->As<CountedFor>()->body()->name(),
+              ::testing::HasSubstr("__unrolled_"));
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto p2, ParsePackage(kLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(stats, RunStandard(p2.get(), options));
+  EXPECT_EQ(stats.hits, 0);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main2, p2->GetFunction("main"));
+  EXPECT_EQ(FunctionContentHash(main2), FunctionContentHash(main1));
+}
+
+TEST_F(OptCachePassTest, SpecializedLoopBodyIsNotStored) {
+  // The loop is left rolled, so 'main' keeps calling the specialized body.
+  PassOptions options;
+  options.unroll_node_limit = 2;
+  XLS_ASSERT_OK_AND_ASSIGN(auto p1, ParsePackage(kSpecializedLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(OptCacheStats stats,
+                           RunStandard(p1.get(), options));
+  EXPECT_EQ(stats.stores, 0);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main1, p1->GetFunction("main"));
+  ASSERT_TRUE(main1->return_value()->Is<CountedFor>());
+  EXPECT_THAT(main1->return_value()->As<CountedFor>()->body()->name(),
+              ::testing::HasSubstr("__spec_"));
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto p2, ParsePackage(kSpecializedLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(stats, RunStandard(p2.get(), options));
+  EXPECT_EQ(stats.hits, 0);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * main2, p2->GetFunction("main"));
+  EXPECT_EQ(FunctionContentHash(main2), FunctionContentHash(main1));
+}
+
+}  // namespace
+}  // namespace xls
@@ -0,0 +1,56 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/pass_base.h"
+
+#include <sys/resource.h>
+
+namespace xls {
+
+IrSnapshot TakeIrSnapshot(Package* package) {
+  IrSnapshot snapshot;
+  for (const std::unique_ptr<Function>& f : package->functions()) {
+    snapshot.node_count += f->node_count();
+    snapshot.function_fingerprints[f->name()] = f->Fingerprint();
+  }
+  return snapshot;
+}
+
+int64 CountChangedFunctions(const IrSnapshot& before,
+                            const IrSnapshot& after) {
+  int64 count = 0;
+  for (const auto& pair : after.function_fingerprints) {
+    auto it = before.function_fingerprints.find(pair.first);
+    if (it == before.function_fingerprints.end() || it->second != pair.second) {
+      ++count;
+    }
+  }
+  for (const auto& pair : before.function_fingerprints) {
+    if (!after.function_fingerprints.contains(pair.first)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+int64 GetPeakRssBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  // ru_maxrss is in kilobytes on Linux.
+  return static_cast<int64>(usage.ru_maxrss) * 1024;
+}
+
+}  // namespace xls
@@ -24,10 +24,13 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "xls/common/file/filesystem.h"
 #include "xls/common/logging/log_lines.h"
 #include "xls/common/logging/logging.h"
@@ -35,6 +38,7 @@
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
 #include "xls/ir/package.h"
+#include "xls/passes/query_engine_cache.h"
 
 namespace xls {
 
@@ -42,6 +46,9 @@ namespace xls {
 // pass pipelines. The base classes are templated allowing polymorphism of the
 // data types the pass operates on.
 
+// The highest optimization level (see PassOptions::opt_level).
+constexpr int64 kMaxOptLevel = 3;
+
 // Options data structure passed to each pass run invocation. This data
 // structure is passed by const reference to PassBase::Run and should contain
 // options which affect how passes are run.
@@ -57,6 +64,49 @@ struct PassOptions {
   // both run_only_passes and skip_passes are present, then only passes which
   // are present in run_only_passes and not present in skip_passes will be run.
   std::vector<std::string> skip_passes;
+
+  // The number of threads passes may use to process the functions of a
+  // package concurrently (see FunctionPass); zero means one per CPU. The
+  // resulting IR does not depend on this value.
+  int64 num_threads = 1;
+
+  // Whether to record the profiling fields of each PassInvocation. This
+  // summarizes the IR before and after every pass, so slows down compilation.
+  bool profile_passes = false;
+
+  // The optimization effort, from 0 to kMaxOptLevel. Expensive passes scale
+  // their analysis limits with the level.
+  int64 opt_level = kMaxOptLevel;
+
+  // If present, optimizations stop when this time is reached, leaving the IR
+  // correct but less optimized: fixed-point passes stop iterating and
+  // expensive passes return early. Transformations which later stages require,
+  // such as unrolling and inlining, still run. The resulting IR depends on how
+  // quickly the passes run.
+  absl::optional<absl::Time> deadline;
+
+  // If present, passes which grow the IR, such as unrolling, fail with a
+  // ResourceExhausted error rather than grow a function beyond this many
+  // nodes.
+  absl::optional<int64> node_budget;
+
+  // If present, loops whose full unrolling would add more than this many nodes
+  // are only partially unrolled (see UnrollPass).
+  absl::optional<int64> unroll_node_limit;
+
+  // The names of the body functions of loops which are not unrolled, for
+  // example because they are to be generated as sequential modules (see
+  // verilog::ToSequentialModuleText).
+  std::vector<std::string> rolled_loop_bodies;
+
+  // If present, the maximum number of iterations of each fixed-point compound
+  // pass.
+  absl::optional<int64> max_fixed_point_iterations;
+
+  // Returns whether the deadline has been reached.
+  bool DeadlineExceeded() const {
+    return deadline.has_value() && absl::Now() >= *deadline;
+  }
 };
 
 // An object containing information about the invocation of a pass (single call
@@ -70,6 +120,107 @@ struct PassInvocation {
 
   // The run duration of the pass.
   absl::Duration run_duration;
+
+  // The short names of the compound passes enclosing the invocation, outermost
+  // first. Each iteration of a fixed-point compound pass adds an element of the
+  // form "iteration_<n>" after the name of the pass, counting from zero.
+  std::vector<std::string> path;
+
+  // When the pass started running.
+  absl::Time start_time;
+
+  // The following are only recorded if PassOptions::profile_passes is set.
+  // The number of nodes in the IR before and after the pass.
+  int64 node_count_before = 0;
+  int64 node_count_after = 0;
+
+  // The number of functions whose nodes or edges the pass changed, added or
+  // removed.
+  int64 functions_changed = 0;
+
+  // The growth of the peak resident set size of the process during the pass.
+  int64 peak_rss_delta_bytes = 0;
+
+  // The time spent building or updating query engines via the
+  // QueryEngineCache; the rest of run_duration is spent in the pass itself.
+  absl::Duration query_engine_duration;
+};
+
+// A summary of the IR taken before and after each pass when profiling passes.
+// The IR type of a compound pass must have a TakeIrSnapshot() overload to be
+// profiled.
+struct IrSnapshot {
+  int64 node_count = 0;
+
+  // The fingerprint of each function, keyed by function name.
+  absl::flat_hash_map<std::string, uint64> function_fingerprints;
+};
+
+IrSnapshot TakeIrSnapshot(Package* package);
+
+// Returns the number of functions which differ between the two snapshots,
+// including functions only present in one of them.
+int64 CountChangedFunctions(const IrSnapshot& before, const IrSnapshot& after);
+
+// Returns the peak resident set size of the process so far.
+int64 GetPeakRssBytes();
+
+// Statistics of the persistent cache of optimized functions (see
+// OptCachePass).
+struct OptCacheStats {
+  // The number of functions restored from the cache.
+  int64 hits = 0;
+
+  // The number of functions which were optimized, either because they were not
+  // in the cache or because a function which was optimized calls them.
+  int64 misses = 0;
+
+  // The number of entries written to the cache.
+  int64 stores = 0;
+};
+
+// How UnrollPass handled a loop.
+struct UnrollDecision {
+  enum class Kind {
+    kFull,
+    // The loop was replaced by a loop doing 'factor' iterations of the
+    // original loop per trip, followed by the remaining iterations.
+    kPartial,
+    kRolled,
+  };
+
+  // The function containing the loop and the name of the loop node.
+  std::string function;
+  std::string loop;
+
+  int64 trip_count;
+  Kind kind;
+  int64 factor = 1;
+};
+
+// A specialization of a function for a frequent value of one of its nodes by
+// ProfileGuidedSpecializationPass.
+struct ProfileSpecialization {
+  // The function, the name of the parameter or node specialized and the value
+  // it was specialized for.
+  std::string function;
+  std::string node;
+  std::string value;
+
+  // The fraction of the profiled samples in which the node had the value.
+  double hit_fraction;
+
+  // The number of bits computed by the nodes which depend on the specialized
+  // node, and how many of them need no logic in the specialized copy.
+  int64 cone_bit_count;
+  int64 known_bit_count;
+
+  // The expected number of gates per evaluation which are not exercised: the
+  // bits which need no logic in the specialized copy, weighted by how often
+  // the copy is taken.
+  double expected_gate_savings() const {
+    return hit_fraction * known_bit_count;
+  }
 };
 
 // A object to which metadata may be written in each pass invocation. This data
@@ -77,16 +228,37 @@ struct PassInvocation {
 struct PassResults {
   // This vector contains and entry for each invocation of each pass.
   std::vector<PassInvocation> invocations;
+
+  // The short names of the compound passes currently running, outermost first
+  // (see PassInvocation::path).
+  std::vector<std::string> compound_pass_path;
+
+  // The query engines of the functions in the IR, shared by all passes.
+  QueryEngineCache query_engine_cache;
+
+  // The names of the functions which function passes leave alone, because
+  // their optimized form is restored from the cache afterwards.
+  absl::flat_hash_set<std::string> frozen_functions;
+
+  OptCacheStats opt_cache_stats;
+
+  // The decisions of UnrollPass for each loop it visited, in order.
+  std::vector<UnrollDecision> unroll_decisions;
+
+  // The specializations made by ProfileGuidedSpecializationPass, in order.
+  std::vector<ProfileSpecialization> profile_specializations;
 };
 
 // Base class for all compiler passes. Template parameters:
 //
 //   IrT : The data type that the pass operates on (e.g., xls::Package). The
 //     type should define 'DumpIr' and 'name' methods used for dumping and
-//     logging in compound passes. A pass which strictly operate on the XLS IR
-//     may use the xls::Package type as the IrT template argument. Passes which
-//     operate on the IR and a schedule may be instantiated on a data structure
-//     containing both an xls::Package and a schedule.
+//     logging in compound passes, and a 'Fingerprint' method used to check
+//     whether passes changed the IR in debug builds. A pass which strictly
+//     operate on the XLS IR may use the xls::Package type as the IrT template
+//     argument. Passes which operate on the IR and a schedule may be
+//     instantiated on a data structure containing both an xls::Package and a
+//     schedule.
 //
 //   OptionsT : Options type passed as an immutable object to each invocation of
 //     PassBase::Run. This type should be derived from PassOptions because
@@ -243,12 +415,32 @@ class FixedPointCompoundPassBase
           invariant_checkers) const override {
     bool local_changed = true;
     bool global_changed = false;
-    while (local_changed) {
+    // The position of this pass's name in the paths of the invocations of the
+    // passes it contains.
+    int64 depth = results->compound_pass_path.size();
+    for (int64 iteration = 0; local_changed; ++iteration) {
+      if (options.max_fixed_point_iterations.has_value() &&
+          iteration >= *options.max_fixed_point_iterations) {
+        XLS_VLOG(1) << "Fixed-point pass " << this->short_name()
+                    << " stopped after " << iteration << " iterations";
+        break;
+      }
+      if (iteration > 0 && options.DeadlineExceeded()) {
+        XLS_VLOG(1) << "Fixed-point pass " << this->short_name()
+                    << " stopped at the deadline";
+        break;
+      }
+      int64 first_invocation = results->invocations.size();
       XLS_ASSIGN_OR_RETURN(
           local_changed,
           (CompoundPassBase<IrT, OptionsT, ResultsT>::RunInternal(
               ir, options, results, top_level_name, invariant_checkers)));
       global_changed = global_changed || local_changed;
+      for (int64 i = first_invocation; i < results->invocations.size(); ++i) {
+        std::vector<std::string>& path = results->invocations[i].path;
+        path.insert(path.begin() + depth + 1,
+                    absl::StrCat("iteration_", iteration));
+      }
     }
     return global_changed;
   }
@@ -284,6 +476,12 @@ xabsl::StatusOr<bool> CompoundPassBase<IrT, OptionsT, ResultsT>::RunInternal(
   XLS_RETURN_IF_ERROR(run_invariant_checkers(
       absl::StrCat("start of compound pass '", this->long_name(), "'")));
 
+  results->compound_pass_path.push_back(this->short_name());
+  struct PathPopper {
+    ~PathPopper() { path->pop_back(); }
+    std::vector<std::string>* path;
+  } path_popper{&results->compound_pass_path};
+
   bool changed = false;
   for (const auto& pass : passes_) {
     XLS_VLOG(1) << absl::StreamFormat("Running %s (%s) pass on package %s",
@@ -309,10 +507,20 @@ xabsl::StatusOr<bool> CompoundPassBase<IrT, OptionsT, ResultsT>::RunInternal(
     }
 
 #ifdef DEBUG
-    // Verify that the IR should change iff Run returns true. This is slow, so
-    // do not check it in optimized builds.
-    std::string ir_before = ir->DumpIr();
+    // Verify that the IR should change iff Run returns true. Computing the
+    // fingerprint is cheap, but only dump the IR if the check fails.
+    uint64 fingerprint_before = ir->Fingerprint();
 #endif
+    bool profile = options.profile_passes && !pass->IsCompound();
+    IrSnapshot snapshot_before;
+    int64 peak_rss_before = 0;
+    absl::Duration query_engine_time_before;
+    if (profile) {
+      snapshot_before = TakeIrSnapshot(ir);
+      peak_rss_before = GetPeakRssBytes();
+      query_engine_time_before =
+          results->query_engine_cache.stats().total_duration();
+    }
     absl::Time start = absl::Now();
     bool pass_changed;
     if (pass->IsCompound()) {
@@ -325,19 +533,19 @@ xabsl::StatusOr<bool> CompoundPassBase<IrT, OptionsT, ResultsT>::RunInternal(
     }
     absl::Duration duration = absl::Now() - start;
 #ifdef DEBUG
-    std::string ir_after = ir->DumpIr();
+    uint64 fingerprint_after = ir->Fingerprint();
     if (pass_changed) {
-      if (ir_before == ir_after) {
+      if (fingerprint_before == fingerprint_after) {
         return absl::InternalError(absl::StrFormat(
             "Pass %s indicated IR changed, but IR is unchanged:\n\n%s",
-            pass->short_name(), ir_before));
+            pass->short_name(), ir->DumpIr()));
       }
     } else {
-      if (ir_before != ir_after) {
+      if (fingerprint_before != fingerprint_after) {
         return absl::InternalError(
             absl::StrFormat("Pass %s indicated IR unchanged, but IR is "
-                            "changed:\n\n[Before]\n%s  !=\n[after]\n%s",
-                            pass->short_name(), ir_before, ir_after));
+                            "changed:\n\n[After]\n%s",
+                            pass->short_name(), ir->DumpIr()));
       }
     }
 #endif
@@ -345,8 +553,21 @@ xabsl::StatusOr<bool> CompoundPassBase<IrT, OptionsT, ResultsT>::RunInternal(
     XLS_VLOG(1) << "Pass " << pass->short_name()
                 << (pass_changed ? " changed IR" : " did not change IR");
     if (!pass->IsCompound()) {
-      results->invocations.push_back(
-          {pass->short_name(), pass_changed, duration});
+      PassInvocation invocation{pass->short_name(), pass_changed, duration};
+      invocation.path = results->compound_pass_path;
+      invocation.start_time = start;
+      if (profile) {
+        IrSnapshot snapshot_after = TakeIrSnapshot(ir);
+        invocation.node_count_before = snapshot_before.node_count;
+        invocation.node_count_after = snapshot_after.node_count;
+        invocation.functions_changed =
+            CountChangedFunctions(snapshot_before, snapshot_after);
+        invocation.peak_rss_delta_bytes = GetPeakRssBytes() - peak_rss_before;
+        invocation.query_engine_duration =
+            results->query_engine_cache.stats().total_duration() -
+            query_engine_time_before;
+      }
+      results->invocations.push_back(std::move(invocation));
     }
     if (!options.ir_dump_path.empty()) {
       XLS_RETURN_IF_ERROR(DumpIr(options.ir_dump_path, ir, top_level_name,
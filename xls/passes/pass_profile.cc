@@ -0,0 +1,126 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/pass_profile.h"
+
+#include <map>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/time.h"
+
+namespace xls {
+namespace {
+
+// Returns whether the paths of the two invocations agree up to and including
+// the element at 'depth'.
+bool SamePrefix(const PassInvocation& a, const PassInvocation& b,
+                int64 depth) {
+  if (a.path.size() <= depth || b.path.size() <= depth) {
+    return false;
+  }
+  for (int64 i = 0; i <= depth; ++i) {
+    if (a.path[i] != b.path[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string JsonString(absl::string_view s) {
+  std::string result = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      absl::StrAppend(&result, "\\", std::string(1, c));
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppendFormat(&result, "\\u%04x", static_cast<int>(c));
+    } else {
+      result.push_back(c);
+    }
+  }
+  result.push_back('"');
+  return result;
+}
+
+std::string CompleteEvent(absl::string_view name, absl::string_view category,
+                          absl::Time origin, absl::Time start,
+                          absl::Duration duration, absl::string_view args) {
+  return absl::StrFormat(
+      "{\"name\": %s, \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, "
+      "\"ts\": %d, \"dur\": %d, \"args\": {%s}}",
+      JsonString(name), category, absl::ToInt64Microseconds(start - origin),
+      absl::ToInt64Microseconds(duration), args);
+}
+
+}  // namespace
+
+std::string PassInvocationsToChromeTrace(
+    absl::Span<const PassInvocation> invocations) {
+  std::vector<std::string> events;
+  absl::Time origin =
+      invocations.empty() ? absl::UnixEpoch() : invocations.front().start_time;
+  for (int64 i = 0; i < invocations.size(); ++i) {
+    const PassInvocation& invocation = invocations[i];
+    // Emit an event for each enclosing compound pass which starts here,
+    // spanning the run of consecutive invocations it encloses.
+    for (int64 depth = 0; depth < invocation.path.size(); ++depth) {
+      if (i > 0 && SamePrefix(invocations[i - 1], invocation, depth)) {
+        continue;
+      }
+      int64 last = i;
+      while (last + 1 < invocations.size() &&
+             SamePrefix(invocations[last + 1], invocation, depth)) {
+        ++last;
+      }
+      const PassInvocation& last_invocation = invocations[last];
+      events.push_back(CompleteEvent(
+          invocation.path[depth], "compound", origin, invocation.start_time,
+          last_invocation.start_time + last_invocation.run_duration -
+              invocation.start_time,
+          ""));
+    }
+    std::string args = absl::StrFormat(
+        "\"changed\": %s, \"node_count_before\": %d, \"node_count_after\": %d, "
+        "\"functions_changed\": %d, \"peak_rss_delta_bytes\": %d, "
+        "\"query_engine_us\": %d",
+        invocation.ir_changed ? "true" : "false", invocation.node_count_before,
+        invocation.node_count_after, invocation.functions_changed,
+        invocation.peak_rss_delta_bytes,
+        absl::ToInt64Microseconds(invocation.query_engine_duration));
+    events.push_back(CompleteEvent(invocation.pass_name, "pass", origin,
+                                   invocation.start_time,
+                                   invocation.run_duration, args));
+  }
+  return absl::StrCat("{\"traceEvents\": [\n  ",
+                      absl::StrJoin(events, ",\n  "), "\n]}\n");
+}
+
+std::string PassInvocationsToFoldedStacks(
+    absl::Span<const PassInvocation> invocations) {
+  std::map<std::string, int64> stack_micros;
+  for (const PassInvocation& invocation : invocations) {
+    std::string stack = absl::StrJoin(invocation.path, ";");
+    absl::StrAppend(&stack, stack.empty() ? "" : ";", invocation.pass_name);
+    stack_micros[stack] += absl::ToInt64Microseconds(invocation.run_duration);
+  }
+  std::string result;
+  for (const auto& pair : stack_micros) {
+    absl::StrAppend(&result, pair.first, " ", pair.second, "\n");
+  }
+  return result;
+}
+
+}  // namespace xls
@@ -0,0 +1,42 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_PASS_PROFILE_H_
+#define XLS_PASSES_PASS_PROFILE_H_
+
+#include <string>
+
+#include "absl/types/span.h"
+#include "xls/passes/pass_base.h"
+
+namespace xls {
+
+// Returns the pass invocations in the Chrome trace event format, viewable in
+// chrome://tracing or Perfetto. Each invocation is a complete event whose
+// arguments are its profiling fields; the compound passes enclosing the
+// invocations (see PassInvocation::path) are events spanning their contents.
+std::string PassInvocationsToChromeTrace(
+    absl::Span<const PassInvocation> invocations);
+
+// Returns the run time of the pass invocations in microseconds in the folded
+// stack format: one line per distinct path of the form
+// "ir;simp;iteration_0;const_fold 1234". This is the input format of
+// flamegraph.pl and can be imported by pprof-compatible viewers such as
+// speedscope.
+std::string PassInvocationsToFoldedStacks(
+    absl::Span<const PassInvocation> invocations);
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_PASS_PROFILE_H_
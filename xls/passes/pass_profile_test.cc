@@ -0,0 +1,113 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/pass_profile.h"
+
+#include <algorithm>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/package.h"
+#include "xls/passes/constant_folding_pass.h"
+#include "xls/passes/dce_pass.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+const char kPackage[] = R"(
+package profiled
+
+fn folded() -> bits[8] {
+  literal.1: bits[8] = literal(value=1)
+  literal.2: bits[8] = literal(value=2)
+  ret add.3: bits[8] = add(literal.1, literal.2)
+}
+
+fn unchanged(x: bits[8]) -> bits[8] {
+  ret neg.4: bits[8] = neg(x)
+}
+)";
+
+class PassProfileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    XLS_ASSERT_OK_AND_ASSIGN(package_, Parser::ParsePackage(kPackage));
+    CompoundPass top("top", "Top level pass manager");
+    auto* simp = top.Add<FixedPointCompoundPass>("simp", "Simplification");
+    simp->Add<ConstantFoldingPass>();
+    simp->Add<DeadCodeEliminationPass>();
+    PassOptions options;
+    options.profile_passes = true;
+    XLS_ASSERT_OK(top.Run(package_.get(), options, &results_).status());
+  }
+
+  std::unique_ptr<Package> package_;
+  PassResults results_;
+};
+
+TEST_F(PassProfileTest, InvocationsAreProfiled) {
+  // The first iteration folds and removes the dead literals, the second
+  // changes nothing.
+  ASSERT_EQ(results_.invocations.size(), 4);
+  const PassInvocation& fold = results_.invocations[0];
+  EXPECT_EQ(fold.pass_name, "const_fold");
+  EXPECT_THAT(fold.path, ElementsAre("top", "simp", "iteration_0"));
+  EXPECT_EQ(fold.node_count_before, 5);
+  EXPECT_EQ(fold.node_count_after, 6);
+  EXPECT_EQ(fold.functions_changed, 1);
+
+  const PassInvocation& dce = results_.invocations[1];
+  EXPECT_EQ(dce.pass_name, "dce");
+  EXPECT_EQ(dce.node_count_after, 3);
+  EXPECT_EQ(dce.functions_changed, 1);
+
+  const PassInvocation& last = results_.invocations[3];
+  EXPECT_THAT(last.path, ElementsAre("top", "simp", "iteration_1"));
+  EXPECT_FALSE(last.ir_changed);
+  EXPECT_EQ(last.functions_changed, 0);
+  EXPECT_GE(last.peak_rss_delta_bytes, 0);
+}
+
+TEST_F(PassProfileTest, ChromeTrace) {
+  std::string trace = PassInvocationsToChromeTrace(results_.invocations);
+  EXPECT_THAT(trace, HasSubstr("\"traceEvents\""));
+  EXPECT_THAT(trace, HasSubstr("\"name\": \"top\", \"cat\": \"compound\""));
+  EXPECT_THAT(trace, HasSubstr("\"name\": \"iteration_1\""));
+  EXPECT_THAT(trace, HasSubstr("\"name\": \"dce\", \"cat\": \"pass\""));
+  EXPECT_THAT(trace, HasSubstr("\"node_count_before\": 5"));
+  // One event for each of the four invocations and for each of "top", "simp",
+  // "iteration_0" and "iteration_1".
+  int64 event_count = 0;
+  for (size_t pos = trace.find("\"ph\""); pos != std::string::npos;
+       pos = trace.find("\"ph\"", pos + 1)) {
+    ++event_count;
+  }
+  EXPECT_EQ(event_count, 8);
+}
+
+TEST_F(PassProfileTest, FoldedStacks) {
+  std::string stacks = PassInvocationsToFoldedStacks(results_.invocations);
+  EXPECT_THAT(stacks, HasSubstr("top;simp;iteration_0;const_fold "));
+  EXPECT_THAT(stacks, HasSubstr("top;simp;iteration_1;dce "));
+  EXPECT_EQ(std::count(stacks.begin(), stacks.end(), '\n'), 4);
+}
+
+}  // namespace
+}  // namespace xls
@@ -14,21 +14,105 @@
 
 #include "xls/passes/passes.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "absl/base/internal/sysinfo.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "xls/common/logging/logging.h"
 #include "xls/common/status/status_macros.h"
 
 namespace xls {
 
 xabsl::StatusOr<bool> FunctionPass::Run(Package* p, const PassOptions& options,
                                         PassResults* results) const {
+  int64 num_threads = options.num_threads == 0
+                          ? absl::base_internal::NumCPUs()
+                          : options.num_threads;
+  num_threads = std::min<int64>(num_threads, p->functions().size());
+  if (num_threads > 1 && IsFunctionLocal()) {
+    return RunConcurrently(p, options, results, num_threads);
+  }
+
+  // Passes which are not function-local may add functions to the package,
+  // which are then processed as well.
   bool changed = false;
-  for (auto& f : p->functions()) {
+  for (int64 i = 0; i < p->functions().size(); ++i) {
+    Function* f = p->functions()[i].get();
+    if (results->frozen_functions.contains(f->name())) {
+      continue;
+    }
     XLS_ASSIGN_OR_RETURN(bool function_changed,
-                         RunOnFunction(f.get(), options, results));
+                         RunOnFunction(f, options, results));
     changed |= function_changed;
   }
   return changed;
 }
 
+int64 BddMintermLimit(Function* f, const PassOptions& options) {
+  // The limits at optimization levels 0 to 3.
+  constexpr int64 kLimits[] = {64, 256, 1024, 4096};
+  // Below the maximum level, functions larger than this get a quarter of the
+  // limit. The maximum level keeps the full limit for all functions.
+  constexpr int64 kLargeFunctionNodeCount = 10000;
+  int64 opt_level =
+      std::max<int64>(0, std::min<int64>(options.opt_level, kMaxOptLevel));
+  int64 limit = kLimits[opt_level];
+  if (opt_level < kMaxOptLevel && f->node_count() > kLargeFunctionNodeCount) {
+    limit /= 4;
+  }
+  return std::max<int64>(limit, 1);
+}
+
+xabsl::StatusOr<bool> FunctionPass::RunConcurrently(
+    Package* p, const PassOptions& options, PassResults* results,
+    int64 num_threads) const {
+  XLS_VLOG(2) << absl::StreamFormat(
+      "Running %s on %d functions with %d threads", short_name(),
+      p->functions().size(), num_threads);
+  std::vector<Function*> functions;
+  for (auto& f : p->functions()) {
+    if (!results->frozen_functions.contains(f->name())) {
+      functions.push_back(f.get());
+    }
+  }
+
+  // New nodes are numbered from disjoint private ranges while the functions
+  // are processed, and renumbered into the package afterwards.
+  constexpr int64 kLocalNodeIdRangeSize = int64{1} << 32;
+  for (int64 i = 0; i < functions.size(); ++i) {
+    functions[i]->BeginLocalNodeIds(p->next_node_id() +
+                                    i * kLocalNodeIdRangeSize);
+  }
+
+  std::vector<xabsl::StatusOr<bool>> function_changed(functions.size(), false);
+  std::atomic<int64> next_function(0);
+  auto worker = [&]() {
+    for (int64 i = next_function.fetch_add(1); i < functions.size();
+         i = next_function.fetch_add(1)) {
+      function_changed[i] = RunOnFunction(functions[i], options, results);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int64 i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (Function* f : functions) {
+    f->EndLocalNodeIds();
+  }
+  bool changed = false;
+  for (const xabsl::StatusOr<bool>& f_changed : function_changed) {
+    XLS_RETURN_IF_ERROR(f_changed.status());
+    changed |= f_changed.value();
+  }
+  return changed;
+}
+
 }  // namespace xls
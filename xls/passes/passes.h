@@ -50,11 +50,32 @@ class FunctionPass : public Pass {
                                               const PassOptions& options,
                                               PassResults* results) const = 0;
 
-  // Iterates over each function in the package calling RunOnFunction.
+  // Returns whether RunOnFunction only reads and modifies the given function
+  // (plus the package's types and the function's query engines in "results"),
+  // and not any other function or part of "results". If so, it may be run on
+  // several functions concurrently.
+  virtual bool IsFunctionLocal() const { return true; }
+
+  // Iterates over each function in the package calling RunOnFunction, skipping
+  // the functions in PassResults::frozen_functions. If the pass is
+  // function-local and options.num_threads allows, functions are processed
+  // concurrently; the result is the same as processing them one at a time in
+  // package order, including the ids of any new nodes.
   xabsl::StatusOr<bool> Run(Package* p, const PassOptions& options,
                             PassResults* results) const override;
+
+ private:
+  xabsl::StatusOr<bool> RunConcurrently(Package* p, const PassOptions& options,
+                                        PassResults* results,
+                                        int64 num_threads) const;
 };
 
+// Returns the minterm limit for BDD query engines used by passes on the given
+// function. The limit grows with the optimization level. Below the maximum
+// level it also shrinks for large functions, whose BDDs are expensive to build;
+// the maximum level uses the limit of the previous pipeline for all functions.
+int64 BddMintermLimit(Function* f, const PassOptions& options);
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_PASSES_H_
@@ -28,6 +28,7 @@
 #include "xls/ir/ir_parser.h"
 #include "xls/ir/package.h"
 #include "xls/ir/type.h"
+#include "xls/ir/verifier.h"
 
 namespace xls {
 namespace {
@@ -395,5 +396,75 @@ TEST(PassesTest, RunOnlyAndSkipPassesOption) {
   }
 }
 
+// Function-local pass which adds a number of literals depending on the function
+// to each function, deleting every other one.
+class LiteralAdderPass : public FunctionPass {
+ public:
+  LiteralAdderPass() : FunctionPass("literal_adder", "Adds literals") {}
+
+  xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
+                                      PassResults* results) const override {
+    for (int64 i = 0; i < 10 * f->params().size(); ++i) {
+      XLS_ASSIGN_OR_RETURN(Literal * literal,
+                           f->MakeNode<Literal>(absl::nullopt,
+                                                Value(UBits(i, 32))));
+      if (i % 2 == 1) {
+        XLS_RETURN_IF_ERROR(f->RemoveNode(literal));
+      }
+    }
+    return f->params().size() > 0;
+  }
+};
+
+TEST(PassesTest, ConcurrentFunctionPassMatchesSerial) {
+  auto make_package = []() {
+    auto p = absl::make_unique<Package>("p");
+    for (int64 i = 0; i < 16; ++i) {
+      FunctionBuilder b(absl::StrFormat("f%d", i), p.get());
+      BValue sum = b.Literal(UBits(0, 32));
+      for (int64 j = 0; j < i % 5; ++j) {
+        sum = b.Add(sum,
+                    b.Param(absl::StrFormat("x%d", j), p->GetBitsType(32)));
+      }
+      XLS_CHECK_OK(b.BuildWithReturnValue(sum).status());
+    }
+    return p;
+  };
+
+  std::unique_ptr<Package> serial = make_package();
+  PassOptions serial_options;
+  PassResults results;
+  EXPECT_THAT(LiteralAdderPass().Run(serial.get(), serial_options, &results),
+              IsOkAndHolds(true));
+  XLS_ASSERT_OK(Verify(serial.get()));
+
+  for (int64 num_threads : {0, 2, 3, 16}) {
+    std::unique_ptr<Package> concurrent = make_package();
+    PassOptions options;
+    options.num_threads = num_threads;
+    EXPECT_THAT(LiteralAdderPass().Run(concurrent.get(), options, &results),
+                IsOkAndHolds(true));
+    XLS_ASSERT_OK(Verify(concurrent.get()));
+    EXPECT_EQ(concurrent->DumpIr(), serial->DumpIr());
+    EXPECT_EQ(concurrent->next_node_id(), serial->next_node_id());
+  }
+}
+
+TEST(PassesTest, FixedPointIterationLimit) {
+  // The pass always changes the IR, so only the limit stops the iteration.
+  Package p("p");
+  FunctionBuilder b("f", &p);
+  b.Param("x", p.GetBitsType(32));
+  XLS_ASSERT_OK(b.Build().status());
+
+  FixedPointCompoundPass fixed_point("fixed_point", "Fixed point");
+  fixed_point.Add<LiteralAdderPass>();
+  PassOptions options;
+  options.max_fixed_point_iterations = 3;
+  PassResults results;
+  EXPECT_THAT(fixed_point.Run(&p, options, &results), IsOkAndHolds(true));
+  EXPECT_EQ(results.invocations.size(), 3);
+}
+
 }  // namespace
 }  // namespace xls
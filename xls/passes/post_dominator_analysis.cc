@@ -15,120 +15,204 @@
 #include "xls/passes/post_dominator_analysis.h"
 
 #include <algorithm>
-#include <cstdio>
-#include <queue>
 
 #include "absl/algorithm/container.h"
-#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
-#include "absl/meta/type_traits.h"
-#include "absl/status/status.h"
 #include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
 #include "xls/ir/node_iterator.h"
 
 namespace xls {
+namespace {
+
+// Returns the nodes ordered by id.
+std::vector<Node*> SortedById(std::vector<Node*> nodes) {
+  std::sort(nodes.begin(), nodes.end(),
+            [](Node* a, Node* b) { return a->id() < b->id(); });
+  return nodes;
+}
+
+}  // namespace
 
 /* static */ xabsl::StatusOr<std::unique_ptr<PostDominatorAnalysis>>
 PostDominatorAnalysis::Run(Function* f) {
-  auto analysis = absl::WrapUnique(new PostDominatorAnalysis(f));
+  auto analysis = absl::make_unique<PostDominatorAnalysis>();
+  XLS_RETURN_IF_ERROR(analysis->Update(f).status());
+  return std::move(analysis);
+}
 
-  // Intialize data structs.
-  analysis->PopulateReturnReachingNodes();
-  for (Node* current_node : f->nodes()) {
-    analysis->post_dominator_to_dominated_nodes_[current_node] = {};
-    analysis->dominated_node_to_post_dominators_[current_node] = {};
-  }
-  Node* return_node = f->return_value();
-
-  // Find post-dominators of all nodes.
-  // Note: We assume there are no backwards edges in the graph,
-  // making it safe to just iterate over the nodes once in reverse
-  // topological order.
-  for (Node* dominated_node : ReverseTopoSort(f)) {
-    absl::flat_hash_set<Node*>& node_post_dominators =
-        analysis->dominated_node_to_post_dominators_.at(dominated_node);
-    if (dominated_node == return_node) {
-      analysis->dominated_node_to_post_dominators_[return_node] = {return_node};
-    } else if (!dominated_node->users().empty()) {
-      // Calculate post-dominators of dominated_node.
-      // new_post_dominators = union(dominated_node,
-      // intersection(post-dominators of dominated_node users / consumers))
-      const absl::flat_hash_set<Node*>& user_post_dominators =
-          analysis->dominated_node_to_post_dominators_.at(
-              dominated_node->users().front());
-      node_post_dominators.insert(user_post_dominators.begin(),
-                                  user_post_dominators.end());
-
-      // Note: No native intersection operation for absl::flat_hash_set
-      for (const auto* user_node_itr =
-               std::next(dominated_node->users().begin());
-           user_node_itr != dominated_node->users().end(); ++user_node_itr) {
-        absl::erase_if(node_post_dominators, [&](const Node* node) {
-          return !analysis->NodeIsPostDominatedBy(*user_node_itr, node);
-        });
+xabsl::StatusOr<int64> PostDominatorAnalysis::Update(Function* f) {
+  absl::flat_hash_map<const Node*, NodeState> old_states =
+      std::move(node_states_);
+  node_states_.clear();
+  nodes_.clear();
+  node_indices_.clear();
+  parents_.clear();
+  post_dominators_.clear();
+  post_dominated_nodes_.clear();
+
+  // The nodes whose post-dominators may differ from those of the last update.
+  // A node is post-dominated by its immediate post-dominator and that node's
+  // post-dominators, so a change propagates to every node post-dominated by a
+  // changed node. These are visited later, as are the operands of a node.
+  absl::flat_hash_set<const Node*> changed;
+  int64 recomputed_count = 0;
+  for (Node* node : ReverseTopoSort(f)) {
+    int64 index = nodes_.size();
+    nodes_.push_back(node);
+    node_indices_[node] = index;
+
+    std::vector<int64> user_ids;
+    user_ids.reserve(node->users().size());
+    for (Node* user : node->users()) {
+      user_ids.push_back(user->id());
+    }
+    absl::c_sort(user_ids);
+    bool is_return_value = node == f->return_value();
+    auto it = old_states.find(node);
+    bool is_same_node = it != old_states.end() && it->second.id == node->id();
+    if (is_same_node && it->second.user_ids == user_ids &&
+        it->second.is_return_value == is_return_value &&
+        absl::c_none_of(node->users(),
+                        [&](Node* u) { return changed.contains(u); })) {
+      Node* post_dominator = it->second.immediate_post_dominator;
+      parents_.push_back(post_dominator == nullptr
+                             ? -1
+                             : node_indices_.at(post_dominator));
+      node_states_[node] = std::move(it->second);
+      continue;
+    }
+
+    // The immediate post-dominator is the nearest common ancestor of the users
+    // which reach the return value. Ancestors have lower indices.
+    bool reaches_return_value = is_return_value;
+    int64 parent = -1;
+    if (!is_return_value) {
+      for (Node* user : node->users()) {
+        if (!node_states_.at(user).reaches_return_value) {
+          continue;
+        }
+        int64 user_index = node_indices_.at(user);
+        if (!reaches_return_value) {
+          reaches_return_value = true;
+          parent = user_index;
+          continue;
+        }
+        while (parent != user_index) {
+          if (parent > user_index) {
+            parent = parents_[parent];
+          } else {
+            user_index = parents_[user_index];
+          }
+          XLS_RET_CHECK(parent >= 0 && user_index >= 0);
+        }
       }
-      node_post_dominators.insert(dominated_node);
-    } else {
-      // For userless nodes, we temporarily add all nodes as postdominaters.
-      // This way, nodes which feed both the userless node and a non-userless
-      // node only have their post-dominators set by the non-userless node.
-      node_post_dominators.insert(f->nodes().begin(), f->nodes().end());
     }
-  }
+    ++recomputed_count;
 
-  // Handle non-return-reaching nodes.
-  for (auto* node : f->nodes()) {
-    if (!analysis->return_reaching_nodes_.contains(node)) {
-      analysis->dominated_node_to_post_dominators_[node] = {node};
+    Node* post_dominator = parent < 0 ? nullptr : nodes_[parent];
+    int64 post_dominator_id =
+        post_dominator == nullptr ? -1 : post_dominator->id();
+    if (!is_same_node ||
+        it->second.reaches_return_value != reaches_return_value ||
+        it->second.immediate_post_dominator_id != post_dominator_id ||
+        changed.contains(post_dominator)) {
+      changed.insert(node);
     }
+    parents_.push_back(parent);
+    node_states_[node] = {node->id(),           std::move(user_ids),
+                          is_return_value,      reaches_return_value,
+                          post_dominator,       post_dominator_id};
   }
 
-  // Enable look-up in both directions (dominated <-> dominator).
-  for (auto& [dominated_node, all_post_dominators] :
-       analysis->dominated_node_to_post_dominators_) {
-    for (const Node* post_dominator : all_post_dominators) {
-      analysis->post_dominator_to_dominated_nodes_.at(post_dominator)
-          .insert(dominated_node);
+  NumberTree();
+  return recomputed_count;
+}
+
+void PostDominatorAnalysis::NumberTree() {
+  // Lay out the children of each node contiguously, then traverse the tree
+  // from the nodes without a post-dominator.
+  int64 node_count = nodes_.size();
+  std::vector<int64> child_starts(node_count + 1, 0);
+  for (int64 parent : parents_) {
+    if (parent >= 0) {
+      ++child_starts[parent + 1];
+    }
+  }
+  for (int64 i = 0; i < node_count; ++i) {
+    child_starts[i + 1] += child_starts[i];
+  }
+  std::vector<int64> children(child_starts[node_count]);
+  std::vector<int64> next_child(child_starts.begin(), child_starts.end() - 1);
+  for (int64 i = 0; i < node_count; ++i) {
+    if (parents_[i] >= 0) {
+      children[next_child[parents_[i]]++] = i;
     }
   }
 
-  // Order nodes.
-  auto generate_ordered_by_id_nodes =
-      [](const absl::flat_hash_map<Node*, absl::flat_hash_set<Node*>>&
-             node_to_node_set,
-         absl::flat_hash_map<Node*, std::vector<Node*>>* node_to_node_vect) {
-        for (auto& [base_node, node_set] : node_to_node_set) {
-          auto& node_vect = (*node_to_node_vect)[base_node];
-          node_vect.insert(node_vect.begin(), node_set.begin(), node_set.end());
-          std::sort(node_vect.begin(), node_vect.end(),
-                    [](Node* a, Node* b) { return a->id() < b->id(); });
-        }
-      };
-  XLS_RET_CHECK(
-      analysis->dominated_node_to_post_dominators_ordered_by_id_.empty());
-  XLS_RET_CHECK(
-      analysis->post_dominator_to_dominated_nodes_ordered_by_id_.empty());
-  generate_ordered_by_id_nodes(
-      analysis->dominated_node_to_post_dominators_,
-      &analysis->dominated_node_to_post_dominators_ordered_by_id_);
-  generate_ordered_by_id_nodes(
-      analysis->post_dominator_to_dominated_nodes_,
-      &analysis->post_dominator_to_dominated_nodes_ordered_by_id_);
+  preorder_.clear();
+  preorder_.reserve(node_count);
+  preorder_positions_.assign(node_count, 0);
+  subtree_ends_.assign(node_count, 0);
+  std::vector<int64> stack;
+  for (int64 root = 0; root < node_count; ++root) {
+    if (parents_[root] >= 0) {
+      continue;
+    }
+    stack.push_back(root);
+    while (!stack.empty()) {
+      int64 index = stack.back();
+      stack.pop_back();
+      preorder_positions_[index] = preorder_.size();
+      preorder_.push_back(index);
+      for (int64 i = child_starts[index]; i < child_starts[index + 1]; ++i) {
+        stack.push_back(children[i]);
+      }
+    }
+  }
+  // A node's subtree ends where the subtree of its last descendant in preorder
+  // ends; children follow their parents, so visit the preorder backwards.
+  for (int64 position = node_count - 1; position >= 0; --position) {
+    int64 index = preorder_[position];
+    subtree_ends_[index] = std::max(subtree_ends_[index], position + 1);
+    if (parents_[index] >= 0) {
+      subtree_ends_[parents_[index]] =
+          std::max(subtree_ends_[parents_[index]], subtree_ends_[index]);
+    }
+  }
+}
 
-  return std::move(analysis);
+absl::Span<Node* const> PostDominatorAnalysis::GetPostDominatorsOfNode(
+    const Node* node) {
+  auto it = post_dominators_.find(node);
+  if (it == post_dominators_.end()) {
+    std::vector<Node*> post_dominators;
+    for (int64 index = node_indices_.at(node); index >= 0;
+         index = parents_[index]) {
+      post_dominators.push_back(nodes_[index]);
+    }
+    it = post_dominators_.emplace(node, SortedById(std::move(post_dominators)))
+             .first;
+  }
+  return it->second;
 }
 
-void PostDominatorAnalysis::PopulateReturnReachingNodes() {
-  return_reaching_nodes_.insert(func_->return_value());
-  for (const Node* node : ReverseTopoSort(func_)) {
-    if (std::any_of(node->users().begin(), node->users().end(),
-                    [&](Node* user) {
-                      return return_reaching_nodes_.contains(user);
-                    })) {
-      return_reaching_nodes_.insert(node);
+absl::Span<Node* const> PostDominatorAnalysis::GetNodesPostDominatedByNode(
+    const Node* node) {
+  auto it = post_dominated_nodes_.find(node);
+  if (it == post_dominated_nodes_.end()) {
+    int64 index = node_indices_.at(node);
+    std::vector<Node*> post_dominated;
+    for (int64 position = preorder_positions_[index];
+         position < subtree_ends_[index]; ++position) {
+      post_dominated.push_back(nodes_[preorder_[position]]);
     }
+    it = post_dominated_nodes_
+             .emplace(node, SortedById(std::move(post_dominated)))
+             .first;
   }
+  return it->second;
 }
 
 }  // namespace xls
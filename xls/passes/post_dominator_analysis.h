@@ -15,8 +15,12 @@
 #ifndef XLS_PASSES_POSTDOMINATOR_FUNCTION_H_
 #define XLS_PASSES_POSTDOMINATOR_FUNCTION_H_
 
-#include "absl/container/flat_hash_set.h"
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/types/span.h"
+#include "xls/common/integral_types.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
 #include "xls/ir/node.h"
@@ -24,53 +28,104 @@
 namespace xls {
 
 // A class for post-dominator analysis of the IR instructions in a function.
+//
+// A node is post-dominated by the nodes through which every path from it to
+// the return value passes. Paths to nodes which do not reach the return value
+// are ignored, and such nodes are post-dominated only by themselves. As the
+// function is acyclic, the immediate post-dominator of a node is the nearest
+// common ancestor of its users in the post-dominator tree, so the tree is
+// built in a single pass over the nodes in reverse topological order. The
+// nodes are numbered densely in that order and the tree is held as an array
+// of parent indices plus a preorder interval per node, so post-dominance
+// queries take constant time and memory is linear in the number of nodes.
 class PostDominatorAnalysis {
  public:
   // Performs post-dominator analysis on the function and returns the result.
   static xabsl::StatusOr<std::unique_ptr<PostDominatorAnalysis>> Run(
       Function* f);
 
-  // Returns the nodes that post-dominate this node.
-  absl::Span<Node* const> GetPostDominatorsOfNode(const Node* node) {
-    return dominated_node_to_post_dominators_ordered_by_id_.at(node);
+  // Creates an empty analysis; Update() must be called before any query.
+  PostDominatorAnalysis() = default;
+
+  // Brings the analysis up to date with the current state of 'f', which must
+  // be the function the analysis was created for. Only nodes which were added
+  // or whose users changed since the last update, and the nodes whose
+  // post-dominators changed as a result, have their immediate post-dominator
+  // recomputed; the result is the same as that of running the analysis from
+  // scratch. Returns the number of nodes recomputed.
+  xabsl::StatusOr<int64> Update(Function* f);
+
+  // Returns the nearest node other than this node which post-dominates it, or
+  // nullptr if there is none (i.e., for the return value and the nodes which
+  // do not reach it).
+  Node* GetImmediatePostDominator(const Node* node) const {
+    int64 parent = parents_.at(node_indices_.at(node));
+    return parent < 0 ? nullptr : nodes_[parent];
   }
-  // Returns the nodes that are post-dominated by this node.
-  absl::Span<Node* const> GetNodesPostDominatedByNode(const Node* node) {
-    return post_dominator_to_dominated_nodes_ordered_by_id_.at(node);
+
+  // Returns true if the return value is reachable from 'node'.
+  bool ReachesReturnValue(const Node* node) const {
+    return node_states_.at(node).reaches_return_value;
   }
+
+  // Returns the nodes that post-dominate this node.
+  absl::Span<Node* const> GetPostDominatorsOfNode(const Node* node);
+  // Returns the nodes that are post-dominated by this node.
+  absl::Span<Node* const> GetNodesPostDominatedByNode(const Node* node);
   // Returns true if 'node' is post-dominated by 'post_dominator'.
-  bool NodeIsPostDominatedBy(const Node* node, const Node* post_dominator) {
-    return dominated_node_to_post_dominators_.at(node).contains(post_dominator);
+  bool NodeIsPostDominatedBy(const Node* node,
+                             const Node* post_dominator) const {
+    return NodePostDominates(post_dominator, node);
   }
   // Returns true if 'node' post_dominates 'post_dominated'.
-  bool NodePostDominates(const Node* node, const Node* post_dominated) {
-    return post_dominator_to_dominated_nodes_.at(node).contains(post_dominated);
+  bool NodePostDominates(const Node* node, const Node* post_dominated) const {
+    int64 index = node_indices_.at(node);
+    int64 position = preorder_positions_[node_indices_.at(post_dominated)];
+    return preorder_positions_[index] <= position &&
+           position < subtree_ends_[index];
   }
 
  private:
-  explicit PostDominatorAnalysis(Function* f) : func_(f) {}
+  // The state of a node as of the last update.
+  struct NodeState {
+    // Node ids are never reused, so these identify the node, its users and its
+    // immediate post-dominator even if a node is deleted and another is
+    // allocated at the same address.
+    int64 id;
+    std::vector<int64> user_ids;
+    bool is_return_value;
+
+    bool reaches_return_value;
+    Node* immediate_post_dominator;
+    int64 immediate_post_dominator_id;
+  };
+
+  // Numbers the nodes of the post-dominator tree in preorder.
+  void NumberTree();
 
-  // Adds to return_reaching_nodes_ all nodes from which the return
-  // node is reachable.
-  void PopulateReturnReachingNodes();
+  absl::flat_hash_map<const Node*, NodeState> node_states_;
 
-  Function* func_;
+  // The nodes in reverse topological order, which numbers every node after
+  // its post-dominators, and the index of each node in that order.
+  std::vector<Node*> nodes_;
+  absl::flat_hash_map<const Node*, int64> node_indices_;
 
-  // Maps from a node to all nodes that post-dominate the node.
-  absl::flat_hash_map<Node*, absl::flat_hash_set<Node*>>
-      dominated_node_to_post_dominators_;
-  absl::flat_hash_map<Node*, std::vector<Node*>>
-      dominated_node_to_post_dominators_ordered_by_id_;
+  // The index of the immediate post-dominator of each node, or -1 if it has
+  // none.
+  std::vector<int64> parents_;
 
-  // Maps from a node to all nodes that are post-dominated by the node.
-  absl::flat_hash_map<Node*, absl::flat_hash_set<Node*>>
-      post_dominator_to_dominated_nodes_;
-  absl::flat_hash_map<Node*, std::vector<Node*>>
-      post_dominator_to_dominated_nodes_ordered_by_id_;
+  // The position of each node in a preorder traversal of the post-dominator
+  // tree, and the position just past the nodes it post-dominates, which are
+  // exactly the positions following its own.
+  std::vector<int64> preorder_;
+  std::vector<int64> preorder_positions_;
+  std::vector<int64> subtree_ends_;
 
-  // Contains all nodes from which the return node is reachable (i.e. the nodes
-  // output is input to the return node or another node in the set).
-  absl::flat_hash_set<const Node*> return_reaching_nodes_;
+  // The results of GetPostDominatorsOfNode() and
+  // GetNodesPostDominatedByNode(), ordered by id, computed on demand and
+  // dropped on update.
+  absl::flat_hash_map<const Node*, std::vector<Node*>> post_dominators_;
+  absl::flat_hash_map<const Node*, std::vector<Node*>> post_dominated_nodes_;
 };
 
 }  // namespace xls
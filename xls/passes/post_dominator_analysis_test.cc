@@ -14,18 +14,42 @@
 
 #include "xls/passes/post_dominator_analysis.h"
 
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "xls/common/status/matchers.h"
 #include "xls/ir/function_builder.h"
 #include "xls/ir/ir_test_base.h"
+#include "xls/ir/nodes.h"
 
 namespace xls {
 namespace {
 
+using status_testing::IsOkAndHolds;
 using ::testing::ElementsAre;
 
-class PostDominatorAnalysisTest : public IrTestBase {};
+class PostDominatorAnalysisTest : public IrTestBase {
+ protected:
+  // Expects the analysis to agree with an analysis built from scratch.
+  void ExpectMatchesFreshAnalysis(Function* f,
+                                  const PostDominatorAnalysis& analysis) {
+    XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<PostDominatorAnalysis> fresh,
+                             PostDominatorAnalysis::Run(f));
+    for (Node* a : f->nodes()) {
+      EXPECT_EQ(analysis.GetImmediatePostDominator(a),
+                fresh->GetImmediatePostDominator(a))
+          << a->GetName();
+      EXPECT_EQ(analysis.ReachesReturnValue(a), fresh->ReachesReturnValue(a))
+          << a->GetName();
+      for (Node* b : f->nodes()) {
+        EXPECT_EQ(analysis.NodePostDominates(a, b),
+                  fresh->NodePostDominates(a, b))
+            << a->GetName() << " " << b->GetName();
+      }
+    }
+  }
+};
 
 TEST_F(PostDominatorAnalysisTest, Simple) {
   auto p = CreatePackage();
@@ -220,5 +244,75 @@ TEST_F(PostDominatorAnalysisTest, DisconnectedNode) {
               ElementsAre(x.node(), z.node()));
 }
 
+TEST_F(PostDominatorAnalysisTest, ImmediatePostDominators) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(1));
+  BValue y = fb.Param("y", p->GetBitsType(1));
+  BValue a = fb.Not(x);
+  BValue b = fb.And(x, y);
+  BValue dangling = fb.Not(b);
+  BValue c = fb.Or(a, b);
+
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.BuildWithReturnValue(c));
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<PostDominatorAnalysis> analysis,
+                           PostDominatorAnalysis::Run(f));
+
+  EXPECT_EQ(analysis->GetImmediatePostDominator(x.node()), c.node());
+  EXPECT_EQ(analysis->GetImmediatePostDominator(y.node()), b.node());
+  EXPECT_EQ(analysis->GetImmediatePostDominator(a.node()), c.node());
+  EXPECT_EQ(analysis->GetImmediatePostDominator(b.node()), c.node());
+  EXPECT_EQ(analysis->GetImmediatePostDominator(c.node()), nullptr);
+  EXPECT_EQ(analysis->GetImmediatePostDominator(dangling.node()), nullptr);
+  EXPECT_TRUE(analysis->ReachesReturnValue(y.node()));
+  EXPECT_FALSE(analysis->ReachesReturnValue(dangling.node()));
+  EXPECT_TRUE(analysis->NodePostDominates(c.node(), y.node()));
+  EXPECT_FALSE(analysis->NodePostDominates(dangling.node(), b.node()));
+}
+
+TEST_F(PostDominatorAnalysisTest, IncrementalUpdate) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  std::vector<BValue> chain = {x};
+  for (int64 i = 0; i < 20; ++i) {
+    chain.push_back(fb.Add(chain.back(), y));
+  }
+  BValue side = fb.Not(chain[5]);
+  BValue ret = fb.Xor(chain.back(), side);
+
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.BuildWithReturnValue(ret));
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<PostDominatorAnalysis> analysis,
+                           PostDominatorAnalysis::Run(f));
+  EXPECT_EQ(analysis->GetImmediatePostDominator(chain[5].node()),
+            ret.node());
+  EXPECT_THAT(analysis->Update(f), IsOkAndHolds(0));
+
+  // Rerouting the side path to the end of the chain only changes the
+  // post-dominators of the nodes of the chain which it bypassed.
+  XLS_ASSERT_OK(side.node()->ReplaceOperandNumber(0, chain[19].node()));
+  XLS_ASSERT_OK_AND_ASSIGN(int64 recomputed_count, analysis->Update(f));
+  EXPECT_LT(recomputed_count, f->node_count());
+  EXPECT_EQ(analysis->GetImmediatePostDominator(chain[5].node()),
+            chain[6].node());
+  ExpectMatchesFreshAnalysis(f, *analysis);
+
+  // Replace a node of the chain with a new node and leave the old one dangling.
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Node * sub, f->MakeNode<BinOp>(/*loc=*/absl::nullopt, chain[9].node(),
+                                     y.node(), Op::kSub));
+  XLS_ASSERT_OK(chain[11].node()->ReplaceOperandNumber(0, sub));
+  XLS_ASSERT_OK(analysis->Update(f).status());
+  EXPECT_FALSE(analysis->ReachesReturnValue(chain[10].node()));
+  EXPECT_EQ(analysis->GetImmediatePostDominator(chain[9].node()), sub);
+  ExpectMatchesFreshAnalysis(f, *analysis);
+
+  // Remove the dangling node.
+  XLS_ASSERT_OK(f->RemoveNode(chain[10].node()));
+  XLS_ASSERT_OK(analysis->Update(f).status());
+  ExpectMatchesFreshAnalysis(f, *analysis);
+}
+
 }  // namespace
 }  // namespace xls
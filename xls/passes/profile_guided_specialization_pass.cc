@@ -0,0 +1,307 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/profile_guided_specialization_pass.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/ternary.h"
+#include "xls/passes/ternary_query_engine.h"
+#include "xls/passes/value_profile.h"
+
+namespace xls {
+namespace {
+
+// A node and a value it frequently holds.
+struct Candidate {
+  Node* node;
+  Value value;
+  double hit_fraction;
+};
+
+// Returns the candidates for specializing the function according to its
+// profile, most frequent first.
+xabsl::StatusOr<std::vector<Candidate>> GetCandidates(
+    Function* f, const FunctionProfileProto& profile,
+    double min_hit_fraction) {
+  std::vector<Candidate> candidates;
+  if (profile.sample_count() == 0) {
+    return candidates;
+  }
+  // Entries which are malformed or do not match the function (e.g., from a
+  // stale profile) are skipped rather than failing the optimization.
+  auto find_node = [&](const std::string& name) -> Node* {
+    xabsl::StatusOr<Node*> node = f->GetNode(name);
+    if (!node.ok()) {
+      XLS_VLOG(1) << "Skipping profile entry for " << f->name() << ": "
+                  << node.status();
+      return nullptr;
+    }
+    return node.value();
+  };
+  // The nodes which held the same value in every sample.
+  absl::flat_hash_set<Node*> constant_nodes;
+  for (const ParamProfileProto& param_profile : profile.params()) {
+    Node* param = find_node(param_profile.name());
+    if (param == nullptr || !param->GetType()->IsBits() ||
+        param_profile.values().empty()) {
+      continue;
+    }
+    const ValueCountProto& hottest = param_profile.values(0);
+    double hit_fraction =
+        static_cast<double>(hottest.count()) / profile.sample_count();
+    if (hit_fraction < min_hit_fraction) {
+      continue;
+    }
+    xabsl::StatusOr<Value> parsed = Parser::ParseTypedValue(hottest.value());
+    if (!parsed.ok()) {
+      XLS_VLOG(1) << "Skipping profile entry for " << f->name() << ": "
+                  << parsed.status();
+      continue;
+    }
+    const Value& value = parsed.value();
+    if (!value.IsBits() ||
+        value.bits().bit_count() != param->BitCountOrDie()) {
+      XLS_VLOG(1) << "Skipping profile entry for " << f->name()
+                  << ": mismatched value " << hottest.value() << " for "
+                  << param->GetName();
+      continue;
+    }
+    candidates.push_back({param, value, hit_fraction});
+    if (hottest.count() == profile.sample_count()) {
+      constant_nodes.insert(param);
+    }
+  }
+
+  absl::flat_hash_map<Node*, Bits> node_values;
+  for (const NodeProfileProto& node_profile : profile.nodes()) {
+    Node* node = find_node(node_profile.name());
+    if (node == nullptr) {
+      continue;
+    }
+    xabsl::StatusOr<TernaryVector> parsed =
+        StringToTernaryVector(node_profile.ternary());
+    if (!parsed.ok()) {
+      XLS_VLOG(1) << "Skipping profile entry for " << f->name() << ": "
+                  << parsed.status();
+      continue;
+    }
+    const TernaryVector& ternary = parsed.value();
+    if (!node->GetType()->IsBits() ||
+        ternary.size() != node->BitCountOrDie() ||
+        !absl::c_all_of(ternary, ternary_ops::IsKnown)) {
+      continue;
+    }
+    absl::InlinedVector<bool, 64> bits;
+    for (TernaryValue bit : ternary) {
+      bits.push_back(bit == TernaryValue::kKnownOne);
+    }
+    node_values[node] = Bits(bits);
+    constant_nodes.insert(node);
+  }
+  // Only the nodes where constant values originate are candidates; the nodes
+  // computed from them are folded by the same specialization.
+  for (Node* node : TopoSort(f)) {
+    auto it = node_values.find(node);
+    if (it == node_values.end() || node->Is<Param>() || node->Is<Literal>() ||
+        absl::c_all_of(node->operands(), [&](Node* operand) {
+          return operand->Is<Literal>() || constant_nodes.contains(operand);
+        })) {
+      continue;
+    }
+    candidates.push_back({node, Value(it->second), /*hit_fraction=*/1.0});
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate& a, const Candidate& b) {
+                     return a.hit_fraction > b.hit_fraction;
+                   });
+  return candidates;
+}
+
+// A copy of the nodes which depend on a candidate, with the candidate replaced
+// by a literal of its value.
+struct SpecializedCone {
+  // The copies in topological order, starting with the literal.
+  std::vector<Node*> nodes;
+
+  // The copy of the return value.
+  Node* return_value;
+};
+
+// Copies the nodes which depend on the candidate. Returns nullopt if the
+// return value does not depend on the candidate or a dependent node has side
+// effects.
+xabsl::StatusOr<absl::optional<SpecializedCone>> CopyCone(
+    Function* f, const Candidate& candidate) {
+  std::vector<Node*> cone;
+  absl::flat_hash_set<Node*> in_cone = {candidate.node};
+  for (Node* node : TopoSort(f)) {
+    if (node == candidate.node ||
+        absl::c_none_of(node->operands(), [&](Node* operand) {
+          return in_cone.contains(operand);
+        })) {
+      continue;
+    }
+    if (node->op() == Op::kChannelSend || node->op() == Op::kChannelReceive) {
+      return absl::nullopt;
+    }
+    in_cone.insert(node);
+    cone.push_back(node);
+  }
+  if (f->return_value() == candidate.node ||
+      !in_cone.contains(f->return_value())) {
+    return absl::nullopt;
+  }
+
+  SpecializedCone result;
+  absl::flat_hash_map<Node*, Node*> copies;
+  XLS_ASSIGN_OR_RETURN(
+      Node * literal,
+      f->MakeNode<Literal>(candidate.node->loc(), candidate.value));
+  copies[candidate.node] = literal;
+  result.nodes.push_back(literal);
+  for (Node* node : cone) {
+    std::vector<Node*> operands;
+    for (Node* operand : node->operands()) {
+      auto it = copies.find(operand);
+      operands.push_back(it == copies.end() ? operand : it->second);
+    }
+    XLS_ASSIGN_OR_RETURN(Node * copy, node->Clone(operands, f));
+    copies[node] = copy;
+    result.nodes.push_back(copy);
+  }
+  result.return_value = copies.at(f->return_value());
+  return result;
+}
+
+// Removes the copied nodes, which must have no other users.
+absl::Status RemoveCone(Function* f, const SpecializedCone& cone) {
+  for (auto it = cone.nodes.rbegin(); it != cone.nodes.rend(); ++it) {
+    XLS_RETURN_IF_ERROR(f->RemoveNode(*it));
+  }
+  return absl::OkStatus();
+}
+
+// Counts the bits of the copied nodes and those which ternary analysis finds
+// to need no logic: constant bits, and all bits of selects whose selector is
+// constant.
+absl::Status CountKnownBits(Function* f, const SpecializedCone& cone,
+                            ProfileSpecialization* specialization) {
+  XLS_ASSIGN_OR_RETURN(std::unique_ptr<TernaryQueryEngine> query_engine,
+                       TernaryQueryEngine::Run(f));
+  for (int64 i = 1; i < cone.nodes.size(); ++i) {
+    Node* node = cone.nodes[i];
+    if (!node->GetType()->IsBits()) {
+      continue;
+    }
+    specialization->cone_bit_count += node->BitCountOrDie();
+    if (node->Is<Select>() &&
+        query_engine->AllBitsKnown(node->As<Select>()->selector())) {
+      specialization->known_bit_count += node->BitCountOrDie();
+    } else {
+      specialization->known_bit_count +=
+          query_engine->GetKnownBits(node).PopCount();
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+xabsl::StatusOr<bool> ProfileGuidedSpecializationPass::RunOnFunction(
+    Function* f, const PassOptions& options, PassResults* results) const {
+  const FunctionProfileProto* profile =
+      FindFunctionProfile(profile_, f->name());
+  if (profile == nullptr) {
+    return false;
+  }
+  XLS_ASSIGN_OR_RETURN(std::vector<Candidate> candidates,
+                       GetCandidates(f, *profile, min_hit_fraction_));
+  if (candidates.size() > max_candidates_) {
+    candidates.resize(max_candidates_);
+  }
+
+  // Each candidate is tried by copying its cone and analyzing the copy, which
+  // is then removed; the best candidate is copied again.
+  absl::optional<ProfileSpecialization> best;
+  const Candidate* best_candidate = nullptr;
+  for (const Candidate& candidate : candidates) {
+    XLS_ASSIGN_OR_RETURN(absl::optional<SpecializedCone> cone,
+                         CopyCone(f, candidate));
+    if (!cone.has_value()) {
+      continue;
+    }
+    ProfileSpecialization specialization{
+        f->name(),
+        candidate.node->GetName(),
+        candidate.value.ToString(FormatPreference::kHex),
+        candidate.hit_fraction,
+        /*cone_bit_count=*/0,
+        /*known_bit_count=*/0};
+    XLS_RETURN_IF_ERROR(CountKnownBits(f, *cone, &specialization));
+    XLS_RETURN_IF_ERROR(RemoveCone(f, *cone));
+    XLS_VLOG(2) << absl::StreamFormat(
+        "Specializing %s for %s == %s: %d of %d bits constant, hit fraction "
+        "%.3f",
+        f->name(), specialization.node, specialization.value,
+        specialization.known_bit_count, specialization.cone_bit_count,
+        specialization.hit_fraction);
+    if (specialization.known_bit_count == 0 ||
+        specialization.known_bit_count <
+            min_known_fraction_ * specialization.cone_bit_count) {
+      continue;
+    }
+    if (!best.has_value() || specialization.expected_gate_savings() >
+                                 best->expected_gate_savings()) {
+      best = specialization;
+      best_candidate = &candidate;
+    }
+  }
+  if (!best.has_value()) {
+    return false;
+  }
+
+  XLS_ASSIGN_OR_RETURN(absl::optional<SpecializedCone> cone,
+                       CopyCone(f, *best_candidate));
+  XLS_RET_CHECK(cone.has_value());
+  Node* return_value = f->return_value();
+  XLS_ASSIGN_OR_RETURN(
+      Node * is_hot,
+      f->MakeNode<CompareOp>(return_value->loc(), best_candidate->node,
+                             cone->nodes.front(), Op::kEq));
+  XLS_ASSIGN_OR_RETURN(
+      Node * select,
+      f->MakeNode<Select>(return_value->loc(), is_hot,
+                          std::vector<Node*>{return_value, cone->return_value},
+                          /*default_value=*/absl::nullopt));
+  f->set_return_value(select);
+  results->profile_specializations.push_back(*best);
+  return true;
+}
+
+}  // namespace xls
@@ -0,0 +1,75 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_PROFILE_GUIDED_SPECIALIZATION_PASS_H_
+#define XLS_PASSES_PROFILE_GUIDED_SPECIALIZATION_PASS_H_
+
+#include <utility>
+
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/passes/passes.h"
+#include "xls/passes/value_profile.pb.h"
+
+namespace xls {
+
+// Specializes functions for the values they usually compute, according to a
+// profile recorded over a trace of inputs (see ValueProfiler). The candidates
+// are the parameters which hold one value in at least 'min_hit_fraction' of
+// the samples, and the nodes which held the same value in every sample
+// although their operands did not, e.g. a mode field of a configuration
+// parameter.
+//
+// The nodes depending on a candidate are copied with the candidate replaced by
+// its frequent value, and the return value becomes a select between the copy,
+// when the candidate has that value, and the original logic, which later
+// passes fold. Ternary analysis estimates which bits of the copy need no logic
+// because they are constant or pass through a select with a constant selector;
+// a candidate is only used if at least 'min_known_fraction' of them do, and
+// of the first 'max_candidates' candidates the one with the largest expected
+// gate savings is used. Each function is specialized at most once, and the
+// specializations are recorded in PassResults::profile_specializations.
+//
+// Nodes are matched to the profile by name, so the pass must run on the IR the
+// profile was recorded for, before any other pass.
+class ProfileGuidedSpecializationPass : public FunctionPass {
+ public:
+  explicit ProfileGuidedSpecializationPass(ValueProfileProto profile,
+                                           double min_hit_fraction = 0.9,
+                                           double min_known_fraction = 0.5,
+                                           int64 max_candidates = 8)
+      : FunctionPass("pgo_spec", "Profile-guided specialization"),
+        profile_(std::move(profile)),
+        min_hit_fraction_(min_hit_fraction),
+        min_known_fraction_(min_known_fraction),
+        max_candidates_(max_candidates) {}
+  ~ProfileGuidedSpecializationPass() override {}
+
+  xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
+                                      PassResults* results) const override;
+
+  // Records the specializations in "results".
+  bool IsFunctionLocal() const override { return false; }
+
+ private:
+  ValueProfileProto profile_;
+  double min_hit_fraction_;
+  double min_known_fraction_;
+  int64 max_candidates_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_PROFILE_GUIDED_SPECIALIZATION_PASS_H_
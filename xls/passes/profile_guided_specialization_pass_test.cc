@@ -0,0 +1,231 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/profile_guided_specialization_pass.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ir_matcher.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/passes/value_profile.h"
+
+namespace m = ::xls::op_matchers;
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+class ProfileGuidedSpecializationPassTest : public IrTestBase {
+ protected:
+  // Returns a profile in which "param" of "f" had "value" in "count" of
+  // "sample_count" samples.
+  ValueProfileProto ParamProfile(Function* f, absl::string_view param,
+                                 const Value& value, int64 count,
+                                 int64 sample_count) {
+    ValueProfileProto profile;
+    FunctionProfileProto* function = profile.add_functions();
+    function->set_function(f->name());
+    function->set_sample_count(sample_count);
+    ParamProfileProto* param_profile = function->add_params();
+    param_profile->set_name(std::string(param));
+    ValueCountProto* value_count = param_profile->add_values();
+    value_count->set_value(value.ToString(FormatPreference::kHex));
+    value_count->set_count(count);
+    param_profile->set_other_count(sample_count - count);
+    return profile;
+  }
+
+  // Expects the function to compute the expected results for the arguments.
+  void ExpectUnchangedResults(Function* f,
+                              absl::Span<const std::vector<Value>> args_list,
+                              absl::Span<const Value> expected) {
+    for (int64 i = 0; i < args_list.size(); ++i) {
+      EXPECT_THAT(ir_interpreter::Run(f, args_list[i]),
+                  IsOkAndHolds(expected[i]));
+    }
+  }
+
+  // Returns argument lists covering the modes and a few values of "x".
+  std::vector<std::vector<Value>> ArgsList() {
+    std::vector<std::vector<Value>> args_list;
+    for (int64 mode = 0; mode < 4; ++mode) {
+      for (int64 x : {0, 1, 0x7f, 0xff}) {
+        args_list.push_back({Value(UBits(mode, 2)), Value(UBits(x, 8))});
+      }
+    }
+    return args_list;
+  }
+};
+
+TEST_F(ProfileGuidedSpecializationPassTest, SpecializesHotParam) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue mode = fb.Param("mode", p->GetBitsType(2));
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Select(mode, {fb.Add(x, fb.Literal(UBits(1, 8))),
+                   fb.UMul(x, fb.Literal(UBits(3, 8))),
+                   fb.Subtract(x, fb.Literal(UBits(1, 8))), fb.Not(x)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  std::vector<std::vector<Value>> args_list = ArgsList();
+  std::vector<Value> expected;
+  for (const std::vector<Value>& args : args_list) {
+    XLS_ASSERT_OK_AND_ASSIGN(Value result, ir_interpreter::Run(f, args));
+    expected.push_back(result);
+  }
+
+  // The cases do not depend on the mode, so are shared by both selects.
+  std::vector<::testing::Matcher<const Node*>> cases = {m::Add(), m::UMul(),
+                                                        m::Sub(), m::Not()};
+  PassResults results;
+  ProfileGuidedSpecializationPass pass(
+      ParamProfile(f, "mode", Value(UBits(2, 2)), 95, 100));
+  EXPECT_THAT(pass.RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(true));
+  EXPECT_THAT(f->return_value(),
+              m::Select(m::Eq(m::Param("mode"), m::Literal(2)),
+                        {m::Select(m::Param("mode"), cases),
+                         m::Select(m::Literal(2), cases)}));
+  ASSERT_EQ(results.profile_specializations.size(), 1);
+  const ProfileSpecialization& specialization =
+      results.profile_specializations[0];
+  EXPECT_EQ(specialization.node, "mode");
+  EXPECT_EQ(specialization.hit_fraction, 0.95);
+  EXPECT_EQ(specialization.cone_bit_count, 8);
+  EXPECT_EQ(specialization.known_bit_count, 8);
+  EXPECT_DOUBLE_EQ(specialization.expected_gate_savings(), 0.95 * 8);
+  ExpectUnchangedResults(f, args_list, expected);
+}
+
+TEST_F(ProfileGuidedSpecializationPassTest, ColdParamIsNotSpecialized) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue mode = fb.Param("mode", p->GetBitsType(2));
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Select(mode, {x, fb.Not(x), fb.Neg(x), x});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  PassResults results;
+  ProfileGuidedSpecializationPass pass(
+      ParamProfile(f, "mode", Value(UBits(0, 2)), 50, 100));
+  EXPECT_THAT(pass.RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(false));
+  EXPECT_TRUE(results.profile_specializations.empty());
+  EXPECT_THAT(f->return_value(),
+              m::Select(m::Param("mode"), {m::Param("x"), m::Not(), m::Neg(),
+                                           m::Param("x")}));
+}
+
+TEST_F(ProfileGuidedSpecializationPassTest, SpecializesConstantNode) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue config = fb.Param("config", p->GetBitsType(8));
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue mode = fb.BitSlice(config, /*start=*/0, /*width=*/2);
+  fb.Select(mode, {fb.Add(x, config), fb.Subtract(x, config), fb.Not(x),
+                   fb.Neg(x)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  // The mode bits of the configuration are always one although the other
+  // bits vary.
+  ValueProfiler profiler(f);
+  for (int64 i = 0; i < 8; ++i) {
+    XLS_ASSERT_OK(profiler
+                      .Run({Value(UBits(0x01 + 4 * i, 8)),
+                            Value(UBits(3 * i, 8))})
+                      .status());
+  }
+  ValueProfileProto profile;
+  *profile.add_functions() = profiler.ToProto();
+
+  PassResults results;
+  ProfileGuidedSpecializationPass pass(profile);
+  EXPECT_THAT(pass.RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(true));
+  ASSERT_EQ(results.profile_specializations.size(), 1);
+  EXPECT_EQ(results.profile_specializations[0].node, mode.node()->GetName());
+  EXPECT_EQ(results.profile_specializations[0].hit_fraction, 1.0);
+  std::vector<::testing::Matcher<const Node*>> cases = {m::Add(), m::Sub(),
+                                                        m::Not(), m::Neg()};
+  EXPECT_THAT(f->return_value(),
+              m::Select(m::Eq(m::BitSlice(), m::Literal(1)),
+                        {m::Select(m::BitSlice(), cases),
+                         m::Select(m::Literal(1), cases)}));
+}
+
+TEST_F(ProfileGuidedSpecializationPassTest, StaleProfileEntriesAreSkipped) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue mode = fb.Param("mode", p->GetBitsType(2));
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Select(mode, {x, fb.Not(x), fb.Neg(x), x});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  // Besides the hot mode, the profile names a parameter and a node which do
+  // not exist and has a value of the wrong width for "x".
+  ValueProfileProto profile =
+      ParamProfile(f, "mode", Value(UBits(1, 2)), 100, 100);
+  FunctionProfileProto* function = profile.mutable_functions(0);
+  ParamProfileProto* missing_param = function->add_params();
+  missing_param->set_name("y");
+  ValueCountProto* missing_value = missing_param->add_values();
+  missing_value->set_value("bits[8]:0x0");
+  missing_value->set_count(100);
+  ParamProfileProto* mismatched_param = function->add_params();
+  mismatched_param->set_name("x");
+  ValueCountProto* mismatched_value = mismatched_param->add_values();
+  mismatched_value->set_value("bits[4]:0x0");
+  mismatched_value->set_count(100);
+  NodeProfileProto* missing_node = function->add_nodes();
+  missing_node->set_name("not_a_node.1234");
+  missing_node->set_ternary("0b1");
+  // Malformed values and ternary strings are skipped as well.
+  ParamProfileProto* malformed_param = function->add_params();
+  malformed_param->set_name("x");
+  ValueCountProto* malformed_value = malformed_param->add_values();
+  malformed_value->set_value("not a value");
+  malformed_value->set_count(100);
+  NodeProfileProto* malformed_node = function->add_nodes();
+  malformed_node->set_name("x");
+  malformed_node->set_ternary("1X0");
+
+  PassResults results;
+  ProfileGuidedSpecializationPass pass(profile);
+  EXPECT_THAT(pass.RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(true));
+  ASSERT_EQ(results.profile_specializations.size(), 1);
+  EXPECT_EQ(results.profile_specializations[0].node, "mode");
+}
+
+TEST_F(ProfileGuidedSpecializationPassTest, FunctionWithoutProfile) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue mode = fb.Param("mode", p->GetBitsType(1));
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Select(mode, {x, fb.Not(x)});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  PassResults results;
+  ProfileGuidedSpecializationPass pass((ValueProfileProto()));
+  EXPECT_THAT(pass.RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace xls
@@ -0,0 +1,156 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/query_engine_cache.h"
+
+#include "absl/memory/memory.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/node.h"
+
+namespace xls {
+namespace {
+
+// Returns the signature of the function (see BddEntry::signature).
+std::vector<int64> FunctionSignature(Function* f) {
+  std::vector<int64> signature;
+  for (Node* node : f->nodes()) {
+    signature.push_back(node->id());
+    signature.push_back(node->operand_count());
+    for (Node* operand : node->operands()) {
+      signature.push_back(operand->id());
+    }
+  }
+  return signature;
+}
+
+}  // namespace
+
+QueryEngineCache::FunctionEntry* QueryEngineCache::GetEntry(Function* f) {
+  absl::MutexLock lock(&mutex_);
+  std::unique_ptr<FunctionEntry>& entry = entries_[f];
+  if (entry == nullptr) {
+    entry = absl::make_unique<FunctionEntry>();
+  }
+  return entry.get();
+}
+
+xabsl::StatusOr<TernaryQueryEngine*> QueryEngineCache::GetTernaryQueryEngine(
+    Function* f) {
+  FunctionEntry* entry = GetEntry(f);
+  if (entry->ternary == nullptr) {
+    entry->ternary = absl::make_unique<TernaryQueryEngine>();
+  }
+  absl::Time start = absl::Now();
+  XLS_ASSIGN_OR_RETURN(int64 evaluated_count, entry->ternary->Update(f));
+  absl::Duration duration = absl::Now() - start;
+  absl::MutexLock lock(&mutex_);
+  stats_.ternary_nodes_evaluated += evaluated_count;
+  stats_.ternary_duration += duration;
+  return entry->ternary.get();
+}
+
+xabsl::StatusOr<PostDominatorAnalysis*>
+QueryEngineCache::GetPostDominatorAnalysis(Function* f) {
+  FunctionEntry* entry = GetEntry(f);
+  if (entry->post_dominator == nullptr) {
+    entry->post_dominator = absl::make_unique<PostDominatorAnalysis>();
+  }
+  absl::Time start = absl::Now();
+  XLS_ASSIGN_OR_RETURN(int64 evaluated_count,
+                       entry->post_dominator->Update(f));
+  absl::Duration duration = absl::Now() - start;
+  absl::MutexLock lock(&mutex_);
+  stats_.post_dominator_nodes_evaluated += evaluated_count;
+  stats_.post_dominator_duration += duration;
+  return entry->post_dominator.get();
+}
+
+xabsl::StatusOr<RangeQueryEngine*> QueryEngineCache::GetRangeQueryEngine(
+    Function* f) {
+  std::vector<int64> signature = FunctionSignature(f);
+  FunctionEntry* entry = GetEntry(f);
+  if (entry->range != nullptr && entry->range_signature == signature) {
+    absl::MutexLock lock(&mutex_);
+    ++stats_.range_hits;
+    return entry->range.get();
+  }
+
+  XLS_ASSIGN_OR_RETURN(TernaryQueryEngine * ternary, GetTernaryQueryEngine(f));
+  absl::Time start = absl::Now();
+  XLS_ASSIGN_OR_RETURN(entry->range, RangeQueryEngine::Run(f, ternary));
+  absl::Duration duration = absl::Now() - start;
+  entry->range_signature = std::move(signature);
+  absl::MutexLock lock(&mutex_);
+  ++stats_.range_misses;
+  stats_.range_duration += duration;
+  return entry->range.get();
+}
+
+xabsl::StatusOr<BddQueryEngine*> QueryEngineCache::GetBddQueryEngine(
+    Function* f, int64 minterm_limit,
+    absl::Span<const Op> do_not_evaluate_ops, int64 num_threads) {
+  FunctionEntry* entry = GetEntry(f);
+  std::vector<int64> signature = FunctionSignature(f);
+  BddEntry* bdd_entry = nullptr;
+  for (BddEntry& e : entry->bdds) {
+    if (e.minterm_limit == minterm_limit &&
+        absl::MakeConstSpan(e.do_not_evaluate_ops) == do_not_evaluate_ops) {
+      bdd_entry = &e;
+      break;
+    }
+  }
+  if (bdd_entry != nullptr && bdd_entry->signature == signature) {
+    absl::MutexLock lock(&mutex_);
+    ++stats_.bdd_hits;
+    return bdd_entry->engine.get();
+  }
+
+  absl::Time start = absl::Now();
+  XLS_ASSIGN_OR_RETURN(
+      std::unique_ptr<BddQueryEngine> engine,
+      BddQueryEngine::Run(f, minterm_limit, do_not_evaluate_ops, num_threads));
+  absl::Duration duration = absl::Now() - start;
+  if (bdd_entry == nullptr) {
+    entry->bdds.push_back(
+        {minterm_limit,
+         std::vector<Op>(do_not_evaluate_ops.begin(),
+                         do_not_evaluate_ops.end()),
+         {},
+         nullptr});
+    bdd_entry = &entry->bdds.back();
+  }
+  bdd_entry->signature = std::move(signature);
+  bdd_entry->engine = std::move(engine);
+  absl::MutexLock lock(&mutex_);
+  ++stats_.bdd_misses;
+  stats_.bdd_duration += duration;
+  return bdd_entry->engine.get();
+}
+
+void QueryEngineCache::Invalidate(Function* f) {
+  absl::MutexLock lock(&mutex_);
+  entries_.erase(f);
+}
+
+bool QueryEngineCache::Contains(Function* f) const {
+  absl::MutexLock lock(&mutex_);
+  return entries_.contains(f);
+}
+
+QueryEngineCache::Stats QueryEngineCache::stats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+}  // namespace xls
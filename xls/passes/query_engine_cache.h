@@ -0,0 +1,146 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_QUERY_ENGINE_CACHE_H_
+#define XLS_PASSES_QUERY_ENGINE_CACHE_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/op.h"
+#include "xls/passes/bdd_query_engine.h"
+#include "xls/passes/post_dominator_analysis.h"
+#include "xls/passes/range_query_engine.h"
+#include "xls/passes/ternary_query_engine.h"
+
+namespace xls {
+
+// Holds the query engines and analyses built for the functions of a package so
+// passes can share them rather than each analyzing the function from scratch.
+// The cache need not be told about changes to the IR: each engine is checked
+// against the current state of its function when it is requested.
+//
+// The cache may be used concurrently for different functions, but the engines
+// of one function must only be requested by one thread at a time.
+class QueryEngineCache {
+ public:
+  // Counts of the work done by the cache.
+  struct Stats {
+    // Number of nodes evaluated by the ternary query engines.
+    int64 ternary_nodes_evaluated = 0;
+
+    // Number of nodes whose immediate post-dominator was computed.
+    int64 post_dominator_nodes_evaluated = 0;
+
+    // Number of range and BDD query engines reused and built.
+    int64 range_hits = 0;
+    int64 range_misses = 0;
+    int64 bdd_hits = 0;
+    int64 bdd_misses = 0;
+
+    // Time spent updating ternary query engines and post-dominator analyses
+    // and building range and BDD query engines.
+    absl::Duration ternary_duration;
+    absl::Duration post_dominator_duration;
+    absl::Duration range_duration;
+    absl::Duration bdd_duration;
+
+    absl::Duration total_duration() const {
+      return ternary_duration + post_dominator_duration + range_duration +
+             bdd_duration;
+    }
+  };
+
+  // Returns a ternary query engine for the current state of "f". A cached
+  // engine is updated incrementally (see TernaryQueryEngine::Update()). The
+  // engine remains valid until the next request for an engine of "f".
+  xabsl::StatusOr<TernaryQueryEngine*> GetTernaryQueryEngine(Function* f);
+
+  // Returns a post-dominator analysis of the current state of "f". A cached
+  // analysis is updated incrementally (see PostDominatorAnalysis::Update()).
+  // The analysis remains valid until the next request for a post-dominator
+  // analysis of "f".
+  xabsl::StatusOr<PostDominatorAnalysis*> GetPostDominatorAnalysis(
+      Function* f);
+
+  // Returns a range query engine for the current state of "f", built on the
+  // ternary query engine of "f". A cached engine is reused under the same
+  // condition as BDD query engines. The engine remains valid until the next
+  // request for an engine of "f".
+  xabsl::StatusOr<RangeQueryEngine*> GetRangeQueryEngine(Function* f);
+
+  // Returns a BDD query engine built with the given arguments (see
+  // BddQueryEngine::Run()) for the current state of "f". A cached engine is
+  // only reused if no node of "f" has been added, removed or had its operands
+  // replaced since it was built. The engine remains valid until the next
+  // request for an engine of "f". "num_threads" only affects how quickly the
+  // engine is built, so engines built with other thread counts are reused.
+  xabsl::StatusOr<BddQueryEngine*> GetBddQueryEngine(
+      Function* f, int64 minterm_limit,
+      absl::Span<const Op> do_not_evaluate_ops = {}, int64 num_threads = 1);
+
+  // Drops the engines of the given function. Must be called before the
+  // function is deleted: this releases their memory, and entries are keyed by
+  // address, so a function later allocated at the same address would otherwise
+  // be matched.
+  void Invalidate(Function* f);
+
+  // Returns whether any engine or analysis of "f" is cached.
+  bool Contains(Function* f) const;
+
+  Stats stats() const;
+
+ private:
+  struct BddEntry {
+    int64 minterm_limit;
+    std::vector<Op> do_not_evaluate_ops;
+
+    // The ids of the nodes of the function the engine was built for, each
+    // followed by its operand count and the ids of its operands.
+    std::vector<int64> signature;
+
+    std::unique_ptr<BddQueryEngine> engine;
+  };
+
+  struct FunctionEntry {
+    std::unique_ptr<TernaryQueryEngine> ternary;
+    std::unique_ptr<PostDominatorAnalysis> post_dominator;
+
+    // The signature of the function the range engine was built for.
+    std::vector<int64> range_signature;
+    std::unique_ptr<RangeQueryEngine> range;
+
+    std::vector<BddEntry> bdds;
+  };
+
+  // Returns the entry for the given function, creating it if necessary.
+  FunctionEntry* GetEntry(Function* f);
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<Function*, std::unique_ptr<FunctionEntry>> entries_
+      ABSL_GUARDED_BY(mutex_);
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_QUERY_ENGINE_CACHE_H_
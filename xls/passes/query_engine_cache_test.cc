@@ -0,0 +1,164 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/query_engine_cache.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+#include "xls/passes/narrowing_pass.h"
+#include "xls/passes/pass_base.h"
+#include "xls/passes/strength_reduction_pass.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+class QueryEngineCacheTest : public IrTestBase {};
+
+TEST_F(QueryEngineCacheTest, TernaryQueryEngineIsUpdated) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue masked = fb.And(x, fb.Literal(UBits(0x0f, 8)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  QueryEngineCache cache;
+  XLS_ASSERT_OK_AND_ASSIGN(TernaryQueryEngine * engine,
+                           cache.GetTernaryQueryEngine(f));
+  EXPECT_EQ(engine->ToString(masked.node()), "0b0000_XXXX");
+  EXPECT_EQ(cache.stats().ternary_nodes_evaluated, 3);
+  EXPECT_THAT(cache.GetTernaryQueryEngine(f), IsOkAndHolds(engine));
+  EXPECT_EQ(cache.stats().ternary_nodes_evaluated, 3);
+
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Node * mask,
+      f->MakeNode<Literal>(/*loc=*/absl::nullopt, Value(UBits(0x03, 8))));
+  XLS_ASSERT_OK(masked.node()->ReplaceOperandNumber(1, mask));
+  XLS_ASSERT_OK_AND_ASSIGN(engine, cache.GetTernaryQueryEngine(f));
+  EXPECT_EQ(engine->ToString(masked.node()), "0b0000_00XX");
+  EXPECT_EQ(cache.stats().ternary_nodes_evaluated, 5);
+}
+
+TEST_F(QueryEngineCacheTest, PostDominatorAnalysisIsUpdated) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  BValue a = fb.Not(x);
+  BValue b = fb.Negate(x);
+  fb.Add(fb.And(a, y), b);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  QueryEngineCache cache;
+  XLS_ASSERT_OK_AND_ASSIGN(PostDominatorAnalysis * analysis,
+                           cache.GetPostDominatorAnalysis(f));
+  EXPECT_EQ(analysis->GetImmediatePostDominator(x.node()),
+            f->return_value());
+  EXPECT_EQ(cache.stats().post_dominator_nodes_evaluated, f->node_count());
+  EXPECT_THAT(cache.GetPostDominatorAnalysis(f), IsOkAndHolds(analysis));
+  EXPECT_EQ(cache.stats().post_dominator_nodes_evaluated, f->node_count());
+
+  // Only "x" and the nodes whose users changed are recomputed.
+  XLS_ASSERT_OK(b.node()->ReplaceOperandNumber(0, a.node()));
+  XLS_ASSERT_OK_AND_ASSIGN(analysis, cache.GetPostDominatorAnalysis(f));
+  EXPECT_EQ(analysis->GetImmediatePostDominator(x.node()), a.node());
+  EXPECT_EQ(cache.stats().post_dominator_nodes_evaluated,
+            f->node_count() + 2);
+}
+
+TEST_F(QueryEngineCacheTest, BddQueryEngineIsRebuiltAfterChange) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  BValue sum = fb.Add(x, y);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  QueryEngineCache cache;
+  XLS_ASSERT_OK_AND_ASSIGN(BddQueryEngine * engine,
+                           cache.GetBddQueryEngine(f, /*minterm_limit=*/4096));
+  EXPECT_THAT(cache.GetBddQueryEngine(f, /*minterm_limit=*/4096),
+              IsOkAndHolds(engine));
+  EXPECT_EQ(cache.stats().bdd_hits, 1);
+  EXPECT_EQ(cache.stats().bdd_misses, 1);
+
+  // Engines built with different arguments are cached separately.
+  XLS_ASSERT_OK_AND_ASSIGN(
+      BddQueryEngine * other_engine,
+      cache.GetBddQueryEngine(f, /*minterm_limit=*/4096, {Op::kAdd}));
+  EXPECT_NE(other_engine, engine);
+  EXPECT_EQ(cache.stats().bdd_misses, 2);
+
+  XLS_ASSERT_OK(sum.node()->ReplaceOperandNumber(1, x.node()));
+  XLS_ASSERT_OK_AND_ASSIGN(engine,
+                           cache.GetBddQueryEngine(f, /*minterm_limit=*/4096));
+  EXPECT_TRUE(engine->IsTracked(sum.node()));
+  EXPECT_EQ(cache.stats().bdd_hits, 1);
+  EXPECT_EQ(cache.stats().bdd_misses, 3);
+
+  cache.Invalidate(f);
+  XLS_ASSERT_OK(cache.GetBddQueryEngine(f, /*minterm_limit=*/4096).status());
+  EXPECT_EQ(cache.stats().bdd_misses, 4);
+}
+
+TEST_F(QueryEngineCacheTest, RangeQueryEngineIsRebuiltAfterChange) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.ZeroExtend(fb.Param("x", p->GetBitsType(4)), 8);
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  BValue sum = fb.Add(x, fb.Literal(UBits(1, 8)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  QueryEngineCache cache;
+  XLS_ASSERT_OK_AND_ASSIGN(RangeQueryEngine * engine,
+                           cache.GetRangeQueryEngine(f));
+  EXPECT_EQ(engine->ToString(sum.node()), "0b000X_XXXX");
+  EXPECT_THAT(cache.GetRangeQueryEngine(f), IsOkAndHolds(engine));
+  EXPECT_EQ(cache.stats().range_hits, 1);
+  EXPECT_EQ(cache.stats().range_misses, 1);
+
+  XLS_ASSERT_OK(sum.node()->ReplaceOperandNumber(0, y.node()));
+  XLS_ASSERT_OK_AND_ASSIGN(engine, cache.GetRangeQueryEngine(f));
+  EXPECT_EQ(engine->ToString(sum.node()), "0bXXXX_XXXX");
+  EXPECT_EQ(cache.stats().range_misses, 2);
+}
+
+TEST_F(QueryEngineCacheTest, PassesShareTernaryQueryEngine) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue y = fb.Param("y", p->GetBitsType(8));
+  fb.UMul(fb.Xor(x, y), fb.Not(y));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  // Neither pass changes the function, so it is only analyzed once.
+  PassResults results;
+  EXPECT_THAT(NarrowingPass().RunOnFunction(f, PassOptions(), &results),
+              IsOkAndHolds(false));
+  EXPECT_THAT(
+      StrengthReductionPass(/*split_ops=*/true)
+          .RunOnFunction(f, PassOptions(), &results),
+      IsOkAndHolds(false));
+  EXPECT_EQ(results.query_engine_cache.stats().ternary_nodes_evaluated,
+            f->node_count());
+}
+
+}  // namespace
+}  // namespace xls
@@ -0,0 +1,709 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/range_query_engine.h"
+
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/bits_ops.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/nodes.h"
+
+namespace xls {
+namespace {
+
+// The unsigned and signed ranges of a node.
+struct Ranges {
+  Interval unsigned_range;
+  Interval signed_range;
+};
+
+bool LessThan(const Bits& a, const Bits& b, bool is_signed) {
+  return is_signed ? bits_ops::SLessThan(a, b) : bits_ops::ULessThan(a, b);
+}
+
+const Bits& Min(const Bits& a, const Bits& b, bool is_signed) {
+  return LessThan(b, a, is_signed) ? b : a;
+}
+
+const Bits& Max(const Bits& a, const Bits& b, bool is_signed) {
+  return LessThan(a, b, is_signed) ? b : a;
+}
+
+Interval FullUnsigned(int64 bit_count) {
+  return Interval{UBits(0, bit_count), Bits::AllOnes(bit_count)};
+}
+
+Interval FullSigned(int64 bit_count) {
+  if (bit_count == 0) {
+    return Interval{Bits(), Bits()};
+  }
+  return Interval{Bits::MinSigned(bit_count), Bits::MaxSigned(bit_count)};
+}
+
+Interval Full(int64 bit_count, bool is_signed) {
+  return is_signed ? FullSigned(bit_count) : FullUnsigned(bit_count);
+}
+
+// Returns the values in both intervals, or nullopt if there are none.
+absl::optional<Interval> Intersect(const Interval& a, const Interval& b,
+                                   bool is_signed) {
+  const Bits& lower = Max(a.lower, b.lower, is_signed);
+  const Bits& upper = Min(a.upper, b.upper, is_signed);
+  if (LessThan(upper, lower, is_signed)) {
+    return absl::nullopt;
+  }
+  return Interval{lower, upper};
+}
+
+Interval Hull(const Interval& a, const Interval& b, bool is_signed) {
+  return Interval{Min(a.lower, b.lower, is_signed),
+                  Max(a.upper, b.upper, is_signed)};
+}
+
+// Returns the ranges of a node given its unsigned and signed range. An
+// interval whose bounds have the same most significant bit contains values of
+// one sign only, which are ordered the same way whether they are compared as
+// signed or unsigned numbers, so such an interval tightens the other range.
+Ranges MakeRanges(const Interval& unsigned_range,
+                  const Interval& signed_range) {
+  Ranges ranges{unsigned_range, signed_range};
+  if (unsigned_range.lower.msb() == unsigned_range.upper.msb()) {
+    if (absl::optional<Interval> s =
+            Intersect(ranges.signed_range, unsigned_range, true)) {
+      ranges.signed_range = *s;
+    }
+  }
+  if (signed_range.lower.msb() == signed_range.upper.msb()) {
+    if (absl::optional<Interval> u =
+            Intersect(ranges.unsigned_range, signed_range, false)) {
+      ranges.unsigned_range = *u;
+    }
+  }
+  return ranges;
+}
+
+Ranges FromUnsigned(const Interval& unsigned_range) {
+  return MakeRanges(unsigned_range,
+                    FullSigned(unsigned_range.lower.bit_count()));
+}
+
+Ranges FromSigned(const Interval& signed_range) {
+  return MakeRanges(FullUnsigned(signed_range.lower.bit_count()),
+                    signed_range);
+}
+
+Ranges Point(const Bits& value) {
+  return Ranges{Interval{value, value}, Interval{value, value}};
+}
+
+Ranges Unknown(int64 bit_count) {
+  return Ranges{FullUnsigned(bit_count), FullSigned(bit_count)};
+}
+
+// Returns the ranges of the given ternary value.
+Ranges FromKnownBits(const Bits& known, const Bits& values) {
+  int64 bit_count = known.bit_count();
+  Bits unknown = bits_ops::Not(known);
+  Bits known_values = bits_ops::And(known, values);
+  Interval unsigned_range{known_values, bits_ops::Or(known_values, unknown)};
+  if (bit_count == 0 || known.msb()) {
+    return Ranges{unsigned_range, unsigned_range};
+  }
+  // The sign bit is unknown: the smallest value is negative and the largest
+  // non-negative.
+  Bits sign = Bits::PowerOfTwo(bit_count - 1, bit_count);
+  return Ranges{unsigned_range,
+                Interval{bits_ops::Or(unsigned_range.lower, sign),
+                         bits_ops::And(unsigned_range.upper,
+                                       bits_ops::Not(sign))}};
+}
+
+// Returns whether the value fits in 'bit_count' bits as a signed
+// (respectively unsigned) number.
+bool Fits(const Bits& value, int64 bit_count, bool is_signed) {
+  return is_signed ? value.FitsInNBitsSigned(bit_count)
+                   : value.FitsInNBitsUnsigned(bit_count);
+}
+
+Bits Extend(const Bits& value, int64 bit_count, bool is_signed) {
+  return is_signed ? bits_ops::SignExtend(value, bit_count)
+                   : bits_ops::ZeroExtend(value, bit_count);
+}
+
+// Returns the interval [lower, upper], computed exactly in a wider type, at
+// the given width, or the full range if it does not fit.
+Interval Truncate(const Bits& lower, const Bits& upper, int64 bit_count,
+                  bool is_signed) {
+  if (upper.bit_count() <= bit_count) {
+    return Interval{Extend(lower, bit_count, is_signed),
+                    Extend(upper, bit_count, is_signed)};
+  }
+  if (Fits(lower, bit_count, is_signed) && Fits(upper, bit_count, is_signed)) {
+    return Interval{lower.Slice(0, bit_count), upper.Slice(0, bit_count)};
+  }
+  return Full(bit_count, is_signed);
+}
+
+Interval AddIntervals(const Interval& a, const Interval& b, bool is_signed) {
+  int64 bit_count = a.lower.bit_count();
+  auto add = [&](const Bits& x, const Bits& y) {
+    return bits_ops::Add(Extend(x, bit_count + 1, is_signed),
+                         Extend(y, bit_count + 1, is_signed));
+  };
+  return Truncate(add(a.lower, b.lower), add(a.upper, b.upper), bit_count,
+                  is_signed);
+}
+
+Interval SubIntervals(const Interval& a, const Interval& b, bool is_signed) {
+  int64 bit_count = a.lower.bit_count();
+  if (!is_signed) {
+    // Exact unless the difference may be negative.
+    if (bits_ops::ULessThan(a.lower, b.upper)) {
+      return FullUnsigned(bit_count);
+    }
+    return Interval{bits_ops::Sub(a.lower, b.upper),
+                    bits_ops::Sub(a.upper, b.lower)};
+  }
+  auto sub = [&](const Bits& x, const Bits& y) {
+    return bits_ops::Sub(bits_ops::SignExtend(x, bit_count + 1),
+                         bits_ops::SignExtend(y, bit_count + 1));
+  };
+  return Truncate(sub(a.lower, b.upper), sub(a.upper, b.lower), bit_count,
+                  /*is_signed=*/true);
+}
+
+Interval MulIntervals(const Interval& a, const Interval& b, int64 bit_count,
+                      bool is_signed) {
+  if (!is_signed) {
+    return Truncate(bits_ops::UMul(a.lower, b.lower),
+                    bits_ops::UMul(a.upper, b.upper), bit_count,
+                    /*is_signed=*/false);
+  }
+  std::vector<Bits> products = {
+      bits_ops::SMul(a.lower, b.lower), bits_ops::SMul(a.lower, b.upper),
+      bits_ops::SMul(a.upper, b.lower), bits_ops::SMul(a.upper, b.upper)};
+  Bits lower = products[0];
+  Bits upper = products[0];
+  for (const Bits& product : products) {
+    lower = Min(lower, product, /*is_signed=*/true);
+    upper = Max(upper, product, /*is_signed=*/true);
+  }
+  return Truncate(lower, upper, bit_count, /*is_signed=*/true);
+}
+
+// Returns the shift amount as an integer, saturated at 'bit_count'.
+int64 ShiftAmount(const Bits& amount, int64 bit_count) {
+  if (!amount.FitsInUint64() ||
+      amount.ToUint64().value() >= static_cast<uint64>(bit_count)) {
+    return bit_count;
+  }
+  return amount.ToUint64().value();
+}
+
+Op CompareOpCommuted(Op op) {
+  switch (op) {
+    case Op::kSGe:
+      return Op::kSLe;
+    case Op::kUGe:
+      return Op::kULe;
+    case Op::kSGt:
+      return Op::kSLt;
+    case Op::kUGt:
+      return Op::kULt;
+    case Op::kSLe:
+      return Op::kSGe;
+    case Op::kULe:
+      return Op::kUGe;
+    case Op::kSLt:
+      return Op::kSGt;
+    case Op::kULt:
+      return Op::kUGt;
+    default:
+      return op;
+  }
+}
+
+Op CompareOpInverse(Op op) {
+  switch (op) {
+    case Op::kEq:
+      return Op::kNe;
+    case Op::kNe:
+      return Op::kEq;
+    case Op::kSGe:
+      return Op::kSLt;
+    case Op::kUGe:
+      return Op::kULt;
+    case Op::kSGt:
+      return Op::kSLe;
+    case Op::kUGt:
+      return Op::kULe;
+    case Op::kSLe:
+      return Op::kSGt;
+    case Op::kULe:
+      return Op::kUGt;
+    case Op::kSLt:
+      return Op::kSGe;
+    case Op::kULt:
+      return Op::kUGe;
+    default:
+      XLS_LOG(FATAL) << "Op is not comparison: " << OpToString(op);
+  }
+}
+
+// Returns the result of the given comparison if the ranges of the operands
+// decide it.
+absl::optional<bool> Compare(Op op, const Ranges& lhs, const Ranges& rhs) {
+  switch (op) {
+    case Op::kEq:
+    case Op::kNe: {
+      const Interval& a = lhs.unsigned_range;
+      const Interval& b = rhs.unsigned_range;
+      if (a.IsPoint() && b.IsPoint()) {
+        return (a.lower == b.lower) == (op == Op::kEq);
+      }
+      if (!Intersect(a, b, false).has_value() ||
+          !Intersect(lhs.signed_range, rhs.signed_range, true).has_value()) {
+        return op == Op::kNe;
+      }
+      return absl::nullopt;
+    }
+    case Op::kUGe:
+    case Op::kUGt:
+    case Op::kSGe:
+    case Op::kSGt:
+      return Compare(CompareOpCommuted(op), rhs, lhs);
+    case Op::kULt:
+    case Op::kULe:
+    case Op::kSLt:
+    case Op::kSLe: {
+      bool is_signed = op == Op::kSLt || op == Op::kSLe;
+      bool or_equal = op == Op::kULe || op == Op::kSLe;
+      const Interval& a = is_signed ? lhs.signed_range : lhs.unsigned_range;
+      const Interval& b = is_signed ? rhs.signed_range : rhs.unsigned_range;
+      // a < b holds if a.upper < b.lower and fails if b.upper <= a.lower.
+      if (LessThan(a.upper, b.lower, is_signed) ||
+          (or_equal && a.upper == b.lower)) {
+        return true;
+      }
+      if (LessThan(b.upper, a.lower, is_signed) ||
+          (!or_equal && b.upper == a.lower)) {
+        return false;
+      }
+      return absl::nullopt;
+    }
+    default:
+      XLS_LOG(FATAL) << "Op is not comparison: " << OpToString(op);
+  }
+}
+
+// Returns the ranges of 'x' given that "x op literal" holds, or nullopt if it
+// cannot hold.
+absl::optional<Ranges> RefineByComparison(const Ranges& x, Op op,
+                                          const Bits& literal) {
+  int64 bit_count = literal.bit_count();
+  bool is_signed =
+      op == Op::kSLt || op == Op::kSLe || op == Op::kSGt || op == Op::kSGe;
+  Interval full = Full(bit_count, is_signed);
+  Bits one = UBits(1, bit_count);
+  absl::optional<Interval> constraint;
+  switch (op) {
+    case Op::kEq:
+      constraint = Interval{literal, literal};
+      break;
+    case Op::kULt:
+    case Op::kSLt:
+      if (literal != full.lower) {
+        constraint = Interval{full.lower, bits_ops::Sub(literal, one)};
+      }
+      break;
+    case Op::kULe:
+    case Op::kSLe:
+      constraint = Interval{full.lower, literal};
+      break;
+    case Op::kUGt:
+    case Op::kSGt:
+      if (literal != full.upper) {
+        constraint = Interval{bits_ops::Add(literal, one), full.upper};
+      }
+      break;
+    case Op::kUGe:
+    case Op::kSGe:
+      constraint = Interval{literal, full.upper};
+      break;
+    default:
+      // Disequality excludes a single value, which is not an interval.
+      return x;
+  }
+  if (!constraint.has_value()) {
+    return absl::nullopt;
+  }
+  absl::optional<Interval> unsigned_range = x.unsigned_range;
+  absl::optional<Interval> signed_range = x.signed_range;
+  if (is_signed || op == Op::kEq) {
+    signed_range = Intersect(x.signed_range, *constraint, true);
+  }
+  if (!is_signed) {
+    unsigned_range = Intersect(x.unsigned_range, *constraint, false);
+  }
+  if (!unsigned_range.has_value() || !signed_range.has_value()) {
+    return absl::nullopt;
+  }
+  return MakeRanges(*unsigned_range, *signed_range);
+}
+
+bool IsComparison(Op op) {
+  switch (op) {
+    case Op::kEq:
+    case Op::kNe:
+    case Op::kULt:
+    case Op::kULe:
+    case Op::kUGt:
+    case Op::kUGe:
+    case Op::kSLt:
+    case Op::kSLe:
+    case Op::kSGt:
+    case Op::kSGe:
+      return true;
+    default:
+      return false;
+  }
+}
+
+class RangePropagator {
+ public:
+  // Computes the ranges of the given node from those of its operands.
+  Ranges Propagate(Node* node);
+
+  absl::flat_hash_map<Node*, Ranges>& ranges() { return ranges_; }
+
+ private:
+  const Ranges& Get(Node* node) const { return ranges_.at(node); }
+  const Interval& GetUnsigned(Node* node) const {
+    return Get(node).unsigned_range;
+  }
+
+  Ranges PropagateSelect(Select* select);
+
+  // Returns the ranges of the given case of the select if the select chooses
+  // it, or nullopt if the select never chooses it.
+  absl::optional<Ranges> CaseRanges(Select* select, int64 case_index);
+
+  absl::flat_hash_map<Node*, Ranges> ranges_;
+};
+
+absl::optional<Ranges> RangePropagator::CaseRanges(Select* select,
+                                                   int64 case_index) {
+  Node* selector = select->selector();
+  Node* value = case_index < select->cases().size()
+                    ? select->cases()[case_index]
+                    : *select->default_value();
+  const Interval& selector_range = GetUnsigned(selector);
+  bool is_default = case_index == select->cases().size();
+  if (bits_ops::UGreaterThan(selector_range.lower, case_index) ||
+      (!is_default && bits_ops::ULessThan(selector_range.upper, case_index))) {
+    return absl::nullopt;
+  }
+  // A case of a two-way select on a comparison of a literal with the case
+  // is only chosen if the comparison has the corresponding result, e.g.,
+  // "x" in sel(ult(x, 100), cases=[100, x]) is less than 100.
+  if (select->cases().size() != 2 || is_default ||
+      !IsComparison(selector->op())) {
+    return Get(value);
+  }
+  bool result = case_index == 1;
+  for (int64 i = 0; i < 2; ++i) {
+    if (selector->operand(i) != value ||
+        !selector->operand(1 - i)->Is<Literal>()) {
+      continue;
+    }
+    Op op = i == 0 ? selector->op() : CompareOpCommuted(selector->op());
+    if (!result) {
+      op = CompareOpInverse(op);
+    }
+    return RefineByComparison(
+        Get(value), op,
+        selector->operand(1 - i)->As<Literal>()->value().bits());
+  }
+  return Get(value);
+}
+
+Ranges RangePropagator::PropagateSelect(Select* select) {
+  absl::optional<Ranges> result;
+  int64 case_count =
+      select->cases().size() + (select->default_value().has_value() ? 1 : 0);
+  for (int64 i = 0; i < case_count; ++i) {
+    absl::optional<Ranges> case_ranges = CaseRanges(select, i);
+    if (!case_ranges.has_value()) {
+      continue;
+    }
+    if (!result.has_value()) {
+      result = case_ranges;
+      continue;
+    }
+    result = Ranges{
+        Hull(result->unsigned_range, case_ranges->unsigned_range, false),
+        Hull(result->signed_range, case_ranges->signed_range, true)};
+  }
+  if (!result.has_value()) {
+    // The selector is out of range for every case, which cannot happen.
+    return Unknown(select->BitCountOrDie());
+  }
+  return *result;
+}
+
+Ranges RangePropagator::Propagate(Node* node) {
+  int64 bit_count = node->BitCountOrDie();
+  if (bit_count == 0) {
+    return Point(Bits());
+  }
+  for (Node* operand : node->operands()) {
+    if (!operand->GetType()->IsBits() || operand->BitCountOrDie() == 0) {
+      return Unknown(bit_count);
+    }
+  }
+  switch (node->op()) {
+    case Op::kLiteral:
+      return Point(node->As<Literal>()->value().bits());
+    case Op::kIdentity:
+      return Get(node->operand(0));
+    case Op::kNot: {
+      const Ranges& x = Get(node->operand(0));
+      // Bitwise negation is -x - 1, which reverses both orders.
+      return Ranges{Interval{bits_ops::Not(x.unsigned_range.upper),
+                             bits_ops::Not(x.unsigned_range.lower)},
+                    Interval{bits_ops::Not(x.signed_range.upper),
+                             bits_ops::Not(x.signed_range.lower)}};
+    }
+    case Op::kNeg: {
+      const Ranges& x = Get(node->operand(0));
+      Interval unsigned_range = FullUnsigned(bit_count);
+      if (!x.unsigned_range.lower.IsAllZeros()) {
+        unsigned_range = Interval{bits_ops::Negate(x.unsigned_range.upper),
+                                  bits_ops::Negate(x.unsigned_range.lower)};
+      } else if (x.unsigned_range.IsPoint()) {
+        unsigned_range = x.unsigned_range;
+      }
+      Interval signed_range = FullSigned(bit_count);
+      if (x.signed_range.lower != Bits::MinSigned(bit_count)) {
+        signed_range = Interval{bits_ops::Negate(x.signed_range.upper),
+                                bits_ops::Negate(x.signed_range.lower)};
+      }
+      return MakeRanges(unsigned_range, signed_range);
+    }
+    case Op::kAdd:
+    case Op::kSub: {
+      const Ranges& a = Get(node->operand(0));
+      const Ranges& b = Get(node->operand(1));
+      auto apply = node->op() == Op::kAdd ? AddIntervals : SubIntervals;
+      return MakeRanges(apply(a.unsigned_range, b.unsigned_range, false),
+                        apply(a.signed_range, b.signed_range, true));
+    }
+    case Op::kUMul:
+      return FromUnsigned(MulIntervals(GetUnsigned(node->operand(0)),
+                                       GetUnsigned(node->operand(1)),
+                                       bit_count, /*is_signed=*/false));
+    case Op::kSMul:
+      return FromSigned(MulIntervals(Get(node->operand(0)).signed_range,
+                                     Get(node->operand(1)).signed_range,
+                                     bit_count, /*is_signed=*/true));
+    case Op::kUDiv: {
+      // Division by zero yields all ones, the largest value, so the quotient
+      // grows with the dividend and shrinks with the divisor.
+      const Interval& a = GetUnsigned(node->operand(0));
+      const Interval& b = GetUnsigned(node->operand(1));
+      return FromUnsigned(Interval{bits_ops::UDiv(a.lower, b.upper),
+                                   bits_ops::UDiv(a.upper, b.lower)});
+    }
+    case Op::kZeroExt: {
+      const Interval& x = GetUnsigned(node->operand(0));
+      return FromUnsigned(Interval{bits_ops::ZeroExtend(x.lower, bit_count),
+                                   bits_ops::ZeroExtend(x.upper, bit_count)});
+    }
+    case Op::kSignExt: {
+      const Interval& x = Get(node->operand(0)).signed_range;
+      return FromSigned(Interval{bits_ops::SignExtend(x.lower, bit_count),
+                                 bits_ops::SignExtend(x.upper, bit_count)});
+    }
+    case Op::kConcat: {
+      std::vector<Bits> lowers;
+      std::vector<Bits> uppers;
+      for (Node* operand : node->operands()) {
+        lowers.push_back(GetUnsigned(operand).lower);
+        uppers.push_back(GetUnsigned(operand).upper);
+      }
+      return FromUnsigned(
+          Interval{bits_ops::Concat(lowers), bits_ops::Concat(uppers)});
+    }
+    case Op::kBitSlice: {
+      // If all values share the bits above the slice, the slice grows with
+      // the value.
+      BitSlice* slice = node->As<BitSlice>();
+      const Interval& x = GetUnsigned(node->operand(0));
+      int64 end = slice->start() + slice->width();
+      int64 high_bit_count = x.lower.bit_count() - end;
+      if (x.lower.Slice(end, high_bit_count) !=
+          x.upper.Slice(end, high_bit_count)) {
+        return Unknown(bit_count);
+      }
+      return FromUnsigned(Interval{x.lower.Slice(slice->start(), bit_count),
+                                   x.upper.Slice(slice->start(), bit_count)});
+    }
+    case Op::kShrl: {
+      const Interval& x = GetUnsigned(node->operand(0));
+      const Interval& amount = GetUnsigned(node->operand(1));
+      return FromUnsigned(Interval{
+          bits_ops::ShiftRightLogical(x.lower,
+                                      ShiftAmount(amount.upper, bit_count)),
+          bits_ops::ShiftRightLogical(x.upper,
+                                      ShiftAmount(amount.lower, bit_count))});
+    }
+    case Op::kShll: {
+      // Exact if no bit of the largest value is shifted out.
+      const Interval& x = GetUnsigned(node->operand(0));
+      const Interval& amount = GetUnsigned(node->operand(1));
+      int64 max_amount = ShiftAmount(amount.upper, bit_count);
+      if (x.upper.CountLeadingZeros() < max_amount) {
+        return Unknown(bit_count);
+      }
+      return FromUnsigned(Interval{
+          bits_ops::ShiftLeftLogical(x.lower,
+                                     ShiftAmount(amount.lower, bit_count)),
+          bits_ops::ShiftLeftLogical(x.upper, max_amount)});
+    }
+    case Op::kAnd: {
+      Bits upper = Bits::AllOnes(bit_count);
+      for (Node* operand : node->operands()) {
+        upper = Min(upper, GetUnsigned(operand).upper, false);
+      }
+      return FromUnsigned(Interval{UBits(0, bit_count), upper});
+    }
+    case Op::kOr: {
+      Bits lower = UBits(0, bit_count);
+      int64 leading_zeros = bit_count;
+      for (Node* operand : node->operands()) {
+        lower = Max(lower, GetUnsigned(operand).lower, false);
+        leading_zeros = std::min(
+            leading_zeros, GetUnsigned(operand).upper.CountLeadingZeros());
+      }
+      return FromUnsigned(Interval{
+          lower,
+          bits_ops::ZeroExtend(Bits::AllOnes(bit_count - leading_zeros),
+                               bit_count)});
+    }
+    case Op::kSel:
+      return PropagateSelect(node->As<Select>());
+    default:
+      break;
+  }
+  if (IsComparison(node->op())) {
+    absl::optional<bool> result = Compare(node->op(), Get(node->operand(0)),
+                                          Get(node->operand(1)));
+    return result.has_value() ? Point(UBits(*result ? 1 : 0, 1))
+                              : Unknown(1);
+  }
+  return Unknown(bit_count);
+}
+
+// Returns a mask of the leading bits shared by the bounds of the interval,
+// which all values in the interval share as well. This holds for signed
+// intervals too, as flipping the sign bit maps them to unsigned intervals.
+Bits CommonLeadingBits(const Interval& interval) {
+  int64 bit_count = interval.lower.bit_count();
+  int64 common_count =
+      bits_ops::Xor(interval.lower, interval.upper).CountLeadingZeros();
+  return bits_ops::Concat({Bits::AllOnes(common_count),
+                           UBits(0, bit_count - common_count)});
+}
+
+}  // namespace
+
+/* static */
+xabsl::StatusOr<std::unique_ptr<RangeQueryEngine>> RangeQueryEngine::Run(
+    Function* f, const TernaryQueryEngine* ternary) {
+  auto engine = absl::make_unique<RangeQueryEngine>();
+  RangePropagator propagator;
+  for (Node* node : TopoSort(f)) {
+    if (!node->GetType()->IsBits()) {
+      continue;
+    }
+    Ranges ranges = propagator.Propagate(node);
+    Bits known = Bits(node->BitCountOrDie());
+    Bits values = Bits(node->BitCountOrDie());
+    if (ternary != nullptr && ternary->IsTracked(node)) {
+      known = ternary->GetKnownBits(node);
+      values = bits_ops::And(known, ternary->GetKnownBitsValues(node));
+      Ranges from_bits = FromKnownBits(known, values);
+      // Both analyses are sound, so the ranges always intersect.
+      absl::optional<Interval> unsigned_range =
+          Intersect(ranges.unsigned_range, from_bits.unsigned_range, false);
+      absl::optional<Interval> signed_range =
+          Intersect(ranges.signed_range, from_bits.signed_range, true);
+      XLS_RET_CHECK(unsigned_range.has_value() && signed_range.has_value())
+          << "Inconsistent ranges for " << node->ToString();
+      ranges = MakeRanges(*unsigned_range, *signed_range);
+    }
+    for (const Interval& interval :
+         {ranges.unsigned_range, ranges.signed_range}) {
+      Bits common = CommonLeadingBits(interval);
+      values = bits_ops::Or(
+          values, bits_ops::And(bits_ops::And(common, bits_ops::Not(known)),
+                                interval.lower));
+      known = bits_ops::Or(known, common);
+    }
+    engine->known_bits_[node] = std::move(known);
+    engine->bits_values_[node] = std::move(values);
+    engine->unsigned_ranges_[node] = ranges.unsigned_range;
+    engine->signed_ranges_[node] = ranges.signed_range;
+    propagator.ranges()[node] = std::move(ranges);
+  }
+  return std::move(engine);
+}
+
+bool RangeQueryEngine::AtMostOneTrue(
+    absl::Span<BitLocation const> bits) const {
+  int64 maybe_one_count = 0;
+  for (const BitLocation& location : bits) {
+    if (!IsKnown(location) || IsOne(location)) {
+      maybe_one_count++;
+    }
+  }
+  return maybe_one_count <= 1;
+}
+
+bool RangeQueryEngine::AtLeastOneTrue(
+    absl::Span<BitLocation const> bits) const {
+  for (const BitLocation& location : bits) {
+    if (IsOne(location)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RangeQueryEngine::KnownEquals(const BitLocation& a,
+                                   const BitLocation& b) const {
+  return IsKnown(a) && IsKnown(b) && IsOne(a) == IsOne(b);
+}
+
+bool RangeQueryEngine::KnownNotEquals(const BitLocation& a,
+                                      const BitLocation& b) const {
+  return IsKnown(a) && IsKnown(b) && IsOne(a) != IsOne(b);
+}
+
+}  // namespace xls
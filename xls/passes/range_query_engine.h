@@ -0,0 +1,105 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_RANGE_QUERY_ENGINE_H_
+#define XLS_PASSES_RANGE_QUERY_ENGINE_H_
+
+#include <memory>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/optional.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function.h"
+#include "xls/passes/query_engine.h"
+#include "xls/passes/ternary_query_engine.h"
+
+namespace xls {
+
+// An inclusive range [lower, upper] of the values of a bits-typed node. Both
+// bounds have the width of the node. Depending on the context the bounds are
+// compared as unsigned or as two's complement signed numbers.
+struct Interval {
+  Bits lower;
+  Bits upper;
+
+  bool IsPoint() const { return lower == upper; }
+};
+
+// A query engine which tracks the unsigned and signed range of the values of
+// each bits-typed node by propagating intervals forward through the function.
+// Unlike the ternary query engine, it captures facts about arithmetic such as
+// "x + 1 is at most 100 if x is at most 99", where the carry chain makes every
+// bit of the result unknown. Selects whose selector compares one of the cases
+// to a literal (e.g., the clamp sel(ult(x, 100), cases=[100, x])) refine the
+// range of that case. The ranges are combined with the facts of a ternary
+// query engine in both directions, and the bits shared by all values of a
+// range are reported as known bits.
+//
+// Bit relationships are answered as the ternary query engine does: only from
+// the known bit values.
+class RangeQueryEngine : public QueryEngine {
+ public:
+  // Analyzes 'f'. If 'ternary' is given, it must be up to date with 'f' and
+  // its known bits are used to tighten the ranges.
+  static xabsl::StatusOr<std::unique_ptr<RangeQueryEngine>> Run(
+      Function* f, const TernaryQueryEngine* ternary = nullptr);
+
+  bool IsTracked(Node* node) const override {
+    return known_bits_.contains(node);
+  }
+
+  const Bits& GetKnownBits(Node* node) const override {
+    return known_bits_.at(node);
+  }
+  const Bits& GetKnownBitsValues(Node* node) const override {
+    return bits_values_.at(node);
+  }
+
+  // Returns the range of the values of 'node' as unsigned or signed numbers.
+  // 'node' must be tracked.
+  const Interval& GetUnsignedRange(Node* node) const {
+    return unsigned_ranges_.at(node);
+  }
+  const Interval& GetSignedRange(Node* node) const {
+    return signed_ranges_.at(node);
+  }
+
+  bool AtMostOneTrue(absl::Span<BitLocation const> bits) const override;
+  bool AtLeastOneTrue(absl::Span<BitLocation const> bits) const override;
+  bool KnownEquals(const BitLocation& a, const BitLocation& b) const override;
+  bool KnownNotEquals(const BitLocation& a,
+                      const BitLocation& b) const override;
+
+  // Ranges provide no information about bit implications.
+  bool Implies(const BitLocation& a, const BitLocation& b) const override {
+    return false;
+  }
+  absl::optional<Bits> ImpliedNodeValue(
+      absl::Span<const std::pair<BitLocation, bool>> predicate_bit_values,
+      Node* node) const override {
+    return absl::nullopt;
+  }
+
+ private:
+  absl::flat_hash_map<Node*, Interval> unsigned_ranges_;
+  absl::flat_hash_map<Node*, Interval> signed_ranges_;
+  absl::flat_hash_map<Node*, Bits> known_bits_;
+  absl::flat_hash_map<Node*, Bits> bits_values_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_RANGE_QUERY_ENGINE_H_
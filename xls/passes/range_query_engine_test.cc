@@ -0,0 +1,212 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/range_query_engine.h"
+
+#include <memory>
+#include <random>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/random/random.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/bits_ops.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+#include "xls/ir/value.h"
+#include "xls/passes/ternary_query_engine.h"
+
+namespace xls {
+namespace {
+
+class RangeQueryEngineTest : public IrTestBase {
+ protected:
+  void ExpectUnsignedRange(const RangeQueryEngine& engine, BValue node,
+                           uint64 lower, uint64 upper) {
+    const Interval& range = engine.GetUnsignedRange(node.node());
+    int64 bit_count = node.BitCountOrDie();
+    EXPECT_EQ(range.lower, UBits(lower, bit_count)) << node.ToString();
+    EXPECT_EQ(range.upper, UBits(upper, bit_count)) << node.ToString();
+  }
+
+  void ExpectSignedRange(const RangeQueryEngine& engine, BValue node,
+                         int64 lower, int64 upper) {
+    const Interval& range = engine.GetSignedRange(node.node());
+    int64 bit_count = node.BitCountOrDie();
+    EXPECT_EQ(range.lower, SBits(lower, bit_count)) << node.ToString();
+    EXPECT_EQ(range.upper, SBits(upper, bit_count)) << node.ToString();
+  }
+};
+
+TEST_F(RangeQueryEngineTest, ClampedIncrement) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  BValue limit = fb.Literal(UBits(100, 32));
+  BValue clamped = fb.Select(fb.ULt(x, limit), {limit, x});
+  BValue incremented = fb.Add(clamped, fb.Literal(UBits(1, 32)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<RangeQueryEngine> engine,
+                           RangeQueryEngine::Run(f));
+
+  ExpectUnsignedRange(*engine, x, 0, 0xffffffff);
+  ExpectUnsignedRange(*engine, clamped, 0, 100);
+  ExpectUnsignedRange(*engine, incremented, 1, 101);
+  ExpectSignedRange(*engine, incremented, 1, 101);
+  // The carry chain makes every bit of the sum unknown to ternary logic, but
+  // a value of at most 101 has 25 leading zeros.
+  EXPECT_EQ(engine->ToString(incremented.node()),
+            "0b0000_0000_0000_0000_0000_0000_0XXX_XXXX");
+}
+
+TEST_F(RangeQueryEngineTest, Arithmetic) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.ZeroExtend(fb.Param("x", p->GetBitsType(8)), 16);
+  BValue y = fb.ZeroExtend(fb.Param("y", p->GetBitsType(4)), 16);
+  BValue product = fb.UMul(x, y);
+  BValue difference = fb.Subtract(fb.Literal(UBits(1000, 16)), x);
+  BValue quotient = fb.UDiv(x, fb.Add(y, fb.Literal(UBits(1, 16))));
+  BValue negated = fb.Negate(fb.SignExtend(fb.Param("z", p->GetBitsType(4)),
+                                           16));
+  BValue signed_product = fb.SMul(negated, fb.Literal(SBits(-3, 16)));
+  BValue shifted = fb.Shll(y, fb.Literal(UBits(4, 16)));
+  BValue sliced = fb.BitSlice(product, /*start=*/4, /*width=*/8);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<RangeQueryEngine> engine,
+                           RangeQueryEngine::Run(f));
+
+  ExpectUnsignedRange(*engine, product, 0, 255 * 15);
+  ExpectUnsignedRange(*engine, difference, 1000 - 255, 1000);
+  ExpectUnsignedRange(*engine, quotient, 0, 255);
+  ExpectSignedRange(*engine, negated, -7, 8);
+  ExpectSignedRange(*engine, signed_product, -24, 21);
+  ExpectUnsignedRange(*engine, shifted, 0, 15 << 4);
+  // The bits of the product above the slice are zero.
+  ExpectUnsignedRange(*engine, sliced, 0, (255 * 15) >> 4);
+}
+
+TEST_F(RangeQueryEngineTest, ComparisonsDecidedByRanges) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.SignExtend(fb.Param("x", p->GetBitsType(4)), 8);
+  BValue sum = fb.Add(x, fb.Literal(UBits(3, 8)));
+  BValue lt = fb.SLt(sum, fb.Literal(UBits(11, 8)));
+  BValue ge = fb.SGe(sum, fb.Literal(SBits(-5, 8)));
+  BValue eq = fb.Eq(sum, fb.Literal(UBits(20, 8)));
+  BValue ult = fb.ULt(sum, fb.Literal(UBits(5, 8)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<RangeQueryEngine> engine,
+                           RangeQueryEngine::Run(f));
+
+  ExpectSignedRange(*engine, sum, -5, 10);
+  EXPECT_TRUE(engine->IsAllOnes(lt.node()));
+  EXPECT_TRUE(engine->IsAllOnes(ge.node()));
+  EXPECT_TRUE(engine->IsAllZeros(eq.node()));
+  // The sum may be negative, i.e., a large unsigned number.
+  EXPECT_FALSE(engine->AllBitsKnown(ult.node()));
+}
+
+TEST_F(RangeQueryEngineTest, UsesTernaryKnownBits) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  // Ranges are not propagated through xor, but its known bits are.
+  BValue x = fb.Xor(fb.And(fb.Param("x", p->GetBitsType(8)),
+                           fb.Literal(UBits(0x0f, 8))),
+                    fb.Literal(UBits(0x30, 8)));
+  BValue sum = fb.Add(x, fb.Literal(UBits(1, 8)));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TernaryQueryEngine> ternary,
+                           TernaryQueryEngine::Run(f));
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<RangeQueryEngine> engine,
+                           RangeQueryEngine::Run(f, ternary.get()));
+
+  EXPECT_EQ(engine->ToString(x.node()), "0b0011_XXXX");
+  ExpectUnsignedRange(*engine, x, 0x30, 0x3f);
+  ExpectUnsignedRange(*engine, sum, 0x31, 0x40);
+  EXPECT_EQ(engine->ToString(sum.node()), "0b0XXX_XXXX");
+}
+
+// The values computed by the function are always within the ranges and agree
+// with the known bits.
+TEST_F(RangeQueryEngineTest, RandomValuesAreInRange) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue a = fb.Param("a", p->GetBitsType(6));
+  BValue b = fb.Param("b", p->GetBitsType(8));
+  std::vector<BValue> values;
+  auto add = [&](BValue v) {
+    values.push_back(v);
+    return v;
+  };
+  BValue wide_a = add(fb.ZeroExtend(a, 8));
+  BValue signed_a = add(fb.SignExtend(a, 8));
+  BValue clamped =
+      add(fb.Select(fb.SGt(b, fb.Literal(SBits(-20, 8))),
+                    {fb.Literal(SBits(-20, 8)), b}));
+  BValue sum = add(fb.Add(signed_a, clamped));
+  add(fb.Subtract(sum, wide_a));
+  add(fb.Negate(clamped));
+  add(fb.Not(sum));
+  add(fb.UMul(wide_a, b, /*result_width=*/12));
+  add(fb.SMul(signed_a, clamped, /*result_width=*/16));
+  add(fb.SMul(signed_a, clamped, /*result_width=*/10));
+  add(fb.UDiv(b, wide_a));
+  add(fb.Shrl(b, fb.BitSlice(a, 0, 3)));
+  add(fb.Shll(fb.BitSlice(a, 0, 3), fb.BitSlice(b, 0, 2)));
+  add(fb.Concat({fb.BitSlice(a, 4, 2), clamped}));
+  add(fb.BitSlice(sum, 2, 5));
+  add(fb.And(b, wide_a));
+  add(fb.Or(b, wide_a));
+  add(fb.Select(fb.BitSlice(b, 0, 2), {a, fb.Literal(UBits(7, 6))},
+                /*default_value=*/fb.Literal(UBits(9, 6))));
+  add(fb.ULt(sum, wide_a));
+  add(fb.SLe(clamped, signed_a));
+  fb.Tuple(values);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TernaryQueryEngine> ternary,
+                           TernaryQueryEngine::Run(f));
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<RangeQueryEngine> engine,
+                           RangeQueryEngine::Run(f, ternary.get()));
+
+  std::minstd_rand random;
+  for (int64 sample = 0; sample < 256; ++sample) {
+    std::vector<Value> args = {
+        Value(UBits(absl::Uniform<uint64>(random, 0, 1 << 6), 6)),
+        Value(UBits(absl::Uniform<uint64>(random, 0, 1 << 8), 8))};
+    XLS_ASSERT_OK_AND_ASSIGN(Value result, ir_interpreter::Run(f, args));
+    for (int64 i = 0; i < values.size(); ++i) {
+      Node* node = values[i].node();
+      const Bits& value = result.element(i).bits();
+      const Interval& u = engine->GetUnsignedRange(node);
+      const Interval& s = engine->GetSignedRange(node);
+      EXPECT_TRUE(bits_ops::ULessThanOrEqual(u.lower, value) &&
+                  bits_ops::ULessThanOrEqual(value, u.upper))
+          << node->ToString() << " = " << value.ToString();
+      EXPECT_TRUE(bits_ops::SLessThanOrEqual(s.lower, value) &&
+                  bits_ops::SLessThanOrEqual(value, s.upper))
+          << node->ToString() << " = " << value.ToString();
+      const Bits& known = engine->GetKnownBits(node);
+      EXPECT_EQ(bits_ops::And(value, known), engine->GetKnownBitsValues(node))
+          << node->ToString() << " = " << value.ToString();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace xls
@@ -0,0 +1,230 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/sat_sweeping_pass.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
+#include "xls/common/logging/log_lines.h"
+#include "xls/common/logging/logging.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/bit_parallel_simulator.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/nodes.h"
+#include "xls/ir/value.h"
+#include "xls/passes/bdd_cse_pass.h"
+#include "xls/solvers/z3_ir_translator.h"
+#include "xls/solvers/z3_utils.h"
+#include "../z3/src/api/z3.h"
+
+namespace xls {
+namespace {
+
+// The maximum number of nodes with the same simulated values which a node is
+// compared against with the solver.
+constexpr int64 kMaxCandidatesPerNode = 4;
+
+// Returns the value of the node if it has the same value on every simulated
+// input.
+absl::optional<Bits> ConstantValue(Node* node,
+                                   const std::vector<uint64>& signature) {
+  int64 bit_count = node->BitCountOrDie();
+  absl::InlinedVector<bool, 64> bits(bit_count);
+  for (int64 i = 0; i < signature.size(); ++i) {
+    uint64 word = signature[i];
+    if (word != 0 && word != ~uint64{0}) {
+      return absl::nullopt;
+    }
+    int64 bit_index = i % bit_count;
+    if (i < bit_count) {
+      bits[bit_index] = word != 0;
+    } else if (bits[bit_index] != (word != 0)) {
+      return absl::nullopt;
+    }
+  }
+  return Bits(bits);
+}
+
+// Proves with Z3 that nodes of a function are equal to other nodes or to
+// constants on every input.
+class EquivalenceProver {
+ public:
+  static xabsl::StatusOr<std::unique_ptr<EquivalenceProver>> Create(
+      Function* f, int64 resource_limit) {
+    XLS_ASSIGN_OR_RETURN(
+        std::unique_ptr<solvers::z3::IrTranslator> translator,
+        solvers::z3::IrTranslator::CreateAndTranslate(f));
+    return absl::WrapUnique(
+        new EquivalenceProver(std::move(translator), resource_limit));
+  }
+
+  ~EquivalenceProver() { Z3_solver_dec_ref(ctx(), solver_); }
+
+  bool ProveEqual(Node* a, Node* b) {
+    return Prove(a, translator_->GetTranslation(b));
+  }
+
+  bool ProveConstant(Node* node, const Bits& value) {
+    // Z3 takes the bits of the numeral starting with the least significant.
+    absl::InlinedVector<bool, 64> bits(value.bit_count());
+    for (int64 i = 0; i < value.bit_count(); ++i) {
+      bits[i] = value.Get(i);
+    }
+    return Prove(node,
+                 Z3_mk_bv_numeral(ctx(), value.bit_count(), bits.data()));
+  }
+
+ private:
+  EquivalenceProver(std::unique_ptr<solvers::z3::IrTranslator> translator,
+                    int64 resource_limit)
+      : translator_(std::move(translator)),
+        solver_(solvers::z3::CreateSolver(translator_->ctx(),
+                                          /*num_threads=*/1)) {
+    // Bound each check by Z3's deterministic resource counter rather than by
+    // wall-clock time, so the result does not depend on machine load.
+    Z3_params params = Z3_mk_params(ctx());
+    Z3_params_inc_ref(ctx(), params);
+    Z3_params_set_uint(ctx(), params, Z3_mk_string_symbol(ctx(), "rlimit"),
+                       resource_limit);
+    Z3_solver_set_params(ctx(), solver_, params);
+    Z3_params_dec_ref(ctx(), params);
+  }
+
+  Z3_context ctx() const { return translator_->ctx(); }
+
+  // Returns whether the node always has the given value. Queries which exceed
+  // the resource limit are not proven.
+  bool Prove(Node* node, Z3_ast value) {
+    Z3_solver_reset(ctx(), solver_);
+    Z3_solver_assert(
+        ctx(), solver_,
+        Z3_mk_not(ctx(), Z3_mk_eq(ctx(), translator_->GetTranslation(node),
+                                  value)));
+    return Z3_solver_check(ctx(), solver_) == Z3_L_FALSE;
+  }
+
+  std::unique_ptr<solvers::z3::IrTranslator> translator_;
+  Z3_solver solver_;
+};
+
+}  // namespace
+
+xabsl::StatusOr<bool> SatSweepingPass::RunOnFunction(
+    Function* f, const PassOptions& options, PassResults* results) const {
+  XLS_VLOG(2) << "Running SAT sweeping on function " << f->name();
+  XLS_VLOG(3) << "Before:";
+  XLS_VLOG_LINES(3, f->DumpIr());
+
+  if (options.DeadlineExceeded()) {
+    return false;
+  }
+  BitParallelSimulator simulator(f);
+  for (int64 round = 0; round < simulation_rounds_; ++round) {
+    absl::Status status = simulator.RunRandom();
+    if (!status.ok()) {
+      XLS_VLOG(2) << "Cannot simulate " << f->name() << ": " << status;
+      return false;
+    }
+  }
+
+  // The function is translated when the first candidate is found, before it
+  // is changed. Merging equivalent nodes does not change the values of the
+  // other nodes, so the translation remains valid.
+  std::unique_ptr<EquivalenceProver> prover;
+  bool translation_failed = false;
+  auto get_prover = [&]() -> EquivalenceProver* {
+    if (prover == nullptr && !translation_failed) {
+      xabsl::StatusOr<std::unique_ptr<EquivalenceProver>> created =
+          EquivalenceProver::Create(f, query_resource_limit_);
+      if (created.ok()) {
+        prover = std::move(created).value();
+      } else {
+        XLS_VLOG(2) << "Cannot translate " << f->name()
+                    << " to Z3: " << created.status();
+        translation_failed = true;
+      }
+    }
+    return prover.get();
+  };
+
+  bool changed = false;
+  int64 proven_count = 0;
+  int64 refuted_count = 0;
+  absl::flat_hash_map<std::vector<uint64>, std::vector<Node*>> classes;
+  XLS_ASSIGN_OR_RETURN(std::vector<Node*> node_order, GetCseNodeOrder(f));
+  for (Node* node : node_order) {
+    if (options.DeadlineExceeded() || translation_failed) {
+      break;
+    }
+    if (!node->GetType()->IsBits() || node->BitCountOrDie() == 0 ||
+        node->Is<Literal>()) {
+      continue;
+    }
+    // The signatures remain valid as the function changes because the nodes
+    // are not simulated again.
+    const std::vector<uint64>& signature = simulator.GetSignature(node);
+    absl::optional<Bits> constant = ConstantValue(node, signature);
+    if (constant.has_value() && get_prover() != nullptr) {
+      if (prover->ProveConstant(node, *constant)) {
+        XLS_VLOG(4) << "Found constant value: " << node->ToString();
+        XLS_RETURN_IF_ERROR(
+            node->ReplaceUsesWithNew<Literal>(Value(*constant)).status());
+        changed = true;
+        ++proven_count;
+        continue;
+      }
+      ++refuted_count;
+    }
+
+    std::vector<Node*>& candidates = classes[signature];
+    bool replaced = false;
+    for (int64 i = 0; i < candidates.size() && i < kMaxCandidatesPerNode;
+         ++i) {
+      if (get_prover() == nullptr) {
+        break;
+      }
+      if (!prover->ProveEqual(node, candidates[i])) {
+        ++refuted_count;
+        continue;
+      }
+      XLS_VLOG(4) << "Found equivalent value:";
+      XLS_VLOG(4) << "  Node: " << node->ToString();
+      XLS_VLOG(4) << "  Replacement: " << candidates[i]->ToString();
+      XLS_ASSIGN_OR_RETURN(bool node_changed,
+                           node->ReplaceUsesWith(candidates[i]));
+      changed |= node_changed;
+      ++proven_count;
+      replaced = true;
+      break;
+    }
+    if (!replaced) {
+      candidates.push_back(node);
+    }
+  }
+  XLS_VLOG(2) << absl::StreamFormat(
+      "SAT sweeping %s: %d equivalences proven, %d refuted or out of resources",
+      f->name(), proven_count, refuted_count);
+
+  XLS_VLOG(3) << "After:";
+  XLS_VLOG_LINES(3, f->DumpIr());
+  return changed;
+}
+
+}  // namespace xls
@@ -0,0 +1,59 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_SAT_SWEEPING_PASS_H_
+#define XLS_PASSES_SAT_SWEEPING_PASS_H_
+
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/passes/passes.h"
+
+namespace xls {
+
+// Pass which commons equivalent expressions using random simulation and a
+// solver (SAT sweeping). The function is simulated on random inputs, 64 at a
+// time, and nodes which produce the same values on every input are candidates
+// for being equivalent, as are nodes which are constant on every input and
+// literals. Each candidate is proven or refuted by Z3 and the proven
+// equivalences are merged. Unlike BDD-based CSE, this is not limited by the
+// size of the BDDs, so it finds redundancies in wide arithmetic.
+//
+// Queries which exceed the resource limit are treated as refuted. The limit is
+// Z3's deterministic resource count ("rlimit") rather than wall-clock time, so
+// the result does not depend on machine load. Functions which cannot be
+// translated to Z3 (e.g., containing invokes) are left unchanged.
+class SatSweepingPass : public FunctionPass {
+ public:
+  // 'simulation_rounds' is the number of batches of 64 random inputs to
+  // simulate. 'query_resource_limit' bounds the Z3 resources spent on each
+  // query.
+  explicit SatSweepingPass(int64 simulation_rounds = 4,
+                           int64 query_resource_limit = 1000000)
+      : FunctionPass("sat_sweep", "SAT sweeping"),
+        simulation_rounds_(simulation_rounds),
+        query_resource_limit_(query_resource_limit) {}
+  ~SatSweepingPass() override {}
+
+  xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
+                                      PassResults* results) const override;
+
+ private:
+  int64 simulation_rounds_;
+  int64 query_resource_limit_;
+};
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_SAT_SWEEPING_PASS_H_
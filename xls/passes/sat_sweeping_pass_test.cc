@@ -0,0 +1,116 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/sat_sweeping_pass.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_matcher.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/passes/pass_base.h"
+
+namespace m = ::xls::op_matchers;
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+class SatSweepingPassTest : public IrTestBase {
+ protected:
+  SatSweepingPassTest() = default;
+
+  xabsl::StatusOr<bool> Run(Function* f) {
+    PassResults results;
+    return SatSweepingPass().RunOnFunction(f, PassOptions(), &results);
+  }
+};
+
+TEST_F(SatSweepingPassTest, EquivalentWideArithmetic) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(64));
+  BValue y = fb.Param("y", p->GetBitsType(64));
+  BValue one = fb.Literal(UBits(1, 64));
+  BValue doubled_sum = fb.Shll(fb.Add(x, y), one);
+  BValue sum_of_doubles = fb.Add(fb.Shll(x, one), fb.Shll(y, one));
+  fb.Tuple({doubled_sum, sum_of_doubles});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_EQ(f->return_value()->operand(0), f->return_value()->operand(1));
+}
+
+TEST_F(SatSweepingPassTest, SubtractionCancelsAddition) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  BValue y = fb.Param("y", p->GetBitsType(32));
+  fb.Subtract(fb.Add(x, y), y);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_THAT(f->return_value(), m::Param("x"));
+}
+
+TEST_F(SatSweepingPassTest, ConstantExpression) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  fb.Eq(fb.Add(x, fb.Literal(UBits(1, 32))), x);
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  EXPECT_THAT(Run(f), IsOkAndHolds(true));
+  EXPECT_THAT(f->return_value(), m::Literal(0));
+}
+
+TEST_F(SatSweepingPassTest, DifferentExpressions) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(32));
+  BValue y = fb.Param("y", p->GetBitsType(32));
+  // Differ only when x is 0x12345678, which random simulation is unlikely to
+  // hit.
+  BValue a = fb.Add(x, y);
+  BValue b = fb.Select(fb.Eq(x, fb.Literal(UBits(0x12345678, 32))),
+                       {a, fb.Literal(UBits(0, 32))});
+  fb.Tuple({a, b});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  EXPECT_THAT(Run(f), IsOkAndHolds(false));
+}
+
+TEST_F(SatSweepingPassTest, FunctionWithInvokeIsUnchanged) {
+  auto p = CreatePackage();
+  Function* callee;
+  {
+    FunctionBuilder fb("callee", p.get());
+    fb.Not(fb.Param("a", p->GetBitsType(8)));
+    XLS_ASSERT_OK_AND_ASSIGN(callee, fb.Build());
+  }
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue invoke = fb.Invoke({x}, callee);
+  fb.Tuple({invoke, fb.Not(fb.Not(x)), x});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  EXPECT_THAT(Run(f), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace xls
@@ -975,8 +975,9 @@ xabsl::StatusOr<bool> SelectSimplificationPass::RunOnFunction(
   XLS_VLOG(3) << "Before:";
   XLS_VLOG_LINES(3, func->DumpIr());
 
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<TernaryQueryEngine> query_engine,
-                       TernaryQueryEngine::Run(func));
+  XLS_ASSIGN_OR_RETURN(
+      TernaryQueryEngine * query_engine,
+      results->query_engine_cache.GetTernaryQueryEngine(func));
   bool changed = false;
   for (Node* node : TopoSort(func)) {
     XLS_ASSIGN_OR_RETURN(bool node_changed,
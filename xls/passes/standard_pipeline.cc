@@ -28,13 +28,17 @@
 #include "xls/passes/constant_folding_pass.h"
 #include "xls/passes/cse_pass.h"
 #include "xls/passes/dce_pass.h"
+#include "xls/passes/dead_bit_elimination_pass.h"
 #include "xls/passes/dfe_pass.h"
+#include "xls/passes/function_specialization_pass.h"
 #include "xls/passes/identity_removal_pass.h"
 #include "xls/passes/inlining_pass.h"
 #include "xls/passes/literal_uncommoning_pass.h"
 #include "xls/passes/map_inlining_pass.h"
 #include "xls/passes/narrowing_pass.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/reassociation_pass.h"
+#include "xls/passes/sat_sweeping_pass.h"
 #include "xls/passes/select_simplification_pass.h"
 #include "xls/passes/strength_reduction_pass.h"
 #include "xls/passes/tuple_simplification_pass.h"
@@ -49,27 +53,25 @@ class SimplificationPass : public FixedPointCompoundPass {
  public:
   explicit SimplificationPass(bool split_ops)
       : FixedPointCompoundPass("simp", "Simplification") {
-    Add<ConstantFoldingPass>();
-    Add<DeadCodeEliminationPass>();
-    Add<CanonicalizationPass>();
-    Add<DeadCodeEliminationPass>();
+    // The node-local simplifications are applied together by a worklist, so a
+    // change only causes the nodes around it to be revisited rather than
+    // another sweep of every pass over the whole function.
+    NodeRewritePass* local =
+        Add<NodeRewritePass>("local_simp", "Local simplifications");
+    local->Add<ConstantFoldingRule>();
+    local->Add<CanonicalizationRule>();
+    local->Add<ArithSimplificationRule>();
+    local->Add<BitSliceSimplificationRule>();
+    local->Add<ConcatSimplificationRule>();
+    local->Add<TupleSimplificationRule>();
+    local->Add<ArraySimplificationRule>();
     Add<SelectSimplificationPass>(split_ops);
     Add<DeadCodeEliminationPass>();
-    Add<ArithSimplificationPass>();
-    Add<DeadCodeEliminationPass>();
     Add<ReassociationPass>();
     Add<DeadCodeEliminationPass>();
-    Add<ConstantFoldingPass>();
-    Add<DeadCodeEliminationPass>();
-    Add<BitSliceSimplificationPass>();
-    Add<DeadCodeEliminationPass>();
-    Add<ConcatSimplificationPass>();
-    Add<DeadCodeEliminationPass>();
-    Add<TupleSimplificationPass>();
-    Add<DeadCodeEliminationPass>();
     Add<StrengthReductionPass>(split_ops);
     Add<DeadCodeEliminationPass>();
-    Add<ArraySimplificationPass>();
+    Add<DeadBitEliminationPass>();
     Add<DeadCodeEliminationPass>();
     Add<NarrowingPass>();
     Add<DeadCodeEliminationPass>();
@@ -79,29 +81,42 @@ class SimplificationPass : public FixedPointCompoundPass {
   }
 };
 
-std::unique_ptr<CompoundPass> CreateStandardPassPipeline() {
+std::unique_ptr<CompoundPass> CreateStandardPassPipeline(int64 opt_level) {
   auto top = absl::make_unique<CompoundPass>("ir", "Top level pass pipeline");
   top->AddInvariantChecker<VerifierChecker>();
 
   top->Add<DeadFunctionEliminationPass>();
   top->Add<DeadCodeEliminationPass>();
   top->Add<IdentityRemovalPass>();
-  top->Add<SimplificationPass>(/*split_ops=*/false);
+  if (opt_level >= 2) {
+    top->Add<SimplificationPass>(/*split_ops=*/false);
+    top->Add<FunctionSpecializationPass>();
+  }
   top->Add<UnrollPass>();
   top->Add<MapInliningPass>();
   top->Add<InliningPass>();
   top->Add<DeadFunctionEliminationPass>();
-  top->Add<BddSimplificationPass>(/*split_ops=*/false);
-  top->Add<DeadCodeEliminationPass>();
-  top->Add<BddCsePass>();
-  top->Add<DeadCodeEliminationPass>();
-  top->Add<SimplificationPass>(/*split_ops=*/false);
+  if (opt_level >= 2) {
+    top->Add<BddSimplificationPass>(/*split_ops=*/false);
+    top->Add<DeadCodeEliminationPass>();
+    top->Add<BddCsePass>();
+    top->Add<DeadCodeEliminationPass>();
+  }
+  if (opt_level >= 1) {
+    top->Add<SimplificationPass>(/*split_ops=*/false);
+  } else {
+    top->Add<DeadCodeEliminationPass>();
+  }
 
-  top->Add<BddSimplificationPass>(/*split_ops=*/true);
-  top->Add<DeadCodeEliminationPass>();
-  top->Add<BddCsePass>();
-  top->Add<DeadCodeEliminationPass>();
-  top->Add<SimplificationPass>(/*split_ops=*/true);
+  if (opt_level >= 3) {
+    top->Add<BddSimplificationPass>(/*split_ops=*/true);
+    top->Add<DeadCodeEliminationPass>();
+    top->Add<BddCsePass>();
+    top->Add<DeadCodeEliminationPass>();
+    top->Add<SatSweepingPass>();
+    top->Add<DeadCodeEliminationPass>();
+    top->Add<SimplificationPass>(/*split_ops=*/true);
+  }
   top->Add<LiteralUncommoningPass>();
   top->Add<DeadFunctionEliminationPass>();
   return top;
@@ -22,8 +22,22 @@
 namespace xls {
 
 // CreateStandardPassPipeline connects together the various optimization
-// and analysis passes in the order of execution.
-std::unique_ptr<CompoundPass> CreateStandardPassPipeline();
+// and analysis passes in the order of execution. The optimization level
+// selects the passes:
+//
+//   0: Only the transformations required by code generation (unrolling and
+//      inlining) and dead code elimination.
+//   1: Additionally, one round of simplification after inlining, without
+//      BDD-based passes. Intended for fast iteration.
+//   2: Additionally, simplification before unrolling and a round of BDD-based
+//      simplification and CSE.
+//   3: Additionally, a second round of BDD-based simplification which splits
+//      ops.
+//
+// The pipeline should be run with PassOptions::opt_level set to the same
+// level, which scales the limits of the expensive passes.
+std::unique_ptr<CompoundPass> CreateStandardPassPipeline(
+    int64 opt_level = kMaxOptLevel);
 
 // Creates and runs the standard pipeline on the given package with default
 // options.
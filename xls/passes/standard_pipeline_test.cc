@@ -37,6 +37,8 @@ namespace xls {
 namespace {
 
 using status_testing::IsOkAndHolds;
+using ::testing::Contains;
+using ::testing::Not;
 
 class StandardPipelineTest : public IrTestBase {
  protected:
@@ -272,5 +274,110 @@ TEST_F(StandardPipelineTest, LogicCombining) {
 }
 
 
+TEST_F(StandardPipelineTest, ConcurrentFunctionsMatchSerial) {
+  // Many independent functions which each simplify, and an entry function
+  // invoking all of them.
+  auto make_package = [this]() {
+    auto p = CreatePackage();
+    Type* u8 = p->GetBitsType(8);
+    std::vector<Function*> functions;
+    for (int64 i = 0; i < 12; ++i) {
+      FunctionBuilder b(absl::StrFormat("f%d", i), p.get());
+      BValue x = b.Param("x", u8);
+      BValue y = b.Param("y", u8);
+      BValue c = b.Literal(UBits(i, 8));
+      BValue diff = b.Subtract(b.Add(x, c), b.Literal(UBits(0, 8)));
+      BValue product = b.UMul(b.Negate(b.Negate(diff)), c);
+      xabsl::StatusOr<Function*> f = b.BuildWithReturnValue(b.Xor(product, y));
+      XLS_CHECK_OK(f.status());
+      functions.push_back(*f);
+    }
+    FunctionBuilder b("main", p.get());
+    BValue a = b.Param("a", u8);
+    BValue result = b.Param("b", u8);
+    for (Function* f : functions) {
+      result = b.Xor(result, b.Invoke({a, result}, f));
+    }
+    XLS_CHECK_OK(b.BuildWithReturnValue(result).status());
+    return p;
+  };
+
+  std::unique_ptr<Package> serial = make_package();
+  PassResults results;
+  ASSERT_THAT(CreateStandardPassPipeline()->Run(serial.get(), PassOptions(),
+                                                &results),
+              IsOkAndHolds(true));
+  for (int64 num_threads : {2, 5, 0}) {
+    std::unique_ptr<Package> concurrent = make_package();
+    PassOptions options;
+    options.num_threads = num_threads;
+    ASSERT_THAT(
+        CreateStandardPassPipeline()->Run(concurrent.get(), options, &results),
+        IsOkAndHolds(true));
+    EXPECT_EQ(concurrent->DumpIr(), serial->DumpIr());
+  }
+}
+
+TEST_F(StandardPipelineTest, OptLevels) {
+  // A loop whose body has a redundant double negation.
+  const char kPackage[] = R"(
+package opt_levels
+
+fn body(i: bits[4], accum: bits[8]) -> bits[8] {
+  neg.3: bits[8] = neg(accum)
+  neg.4: bits[8] = neg(neg.3)
+  zero_ext.5: bits[8] = zero_ext(i, new_bit_count=8)
+  ret add.6: bits[8] = add(neg.4, zero_ext.5)
+}
+
+fn main(x: bits[8]) -> bits[8] {
+  ret counted_for.7: bits[8] = counted_for(x, trip_count=4, stride=1, body=body)
+}
+)";
+  for (int64 opt_level = 0; opt_level <= kMaxOptLevel; ++opt_level) {
+    XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> p,
+                             Parser::ParsePackage(kPackage));
+    PassOptions options;
+    options.opt_level = opt_level;
+    PassResults results;
+    ASSERT_THAT(
+        CreateStandardPassPipeline(opt_level)->Run(p.get(), options, &results),
+        IsOkAndHolds(true));
+    // The loop is unrolled and inlined at every level, but only simplified at
+    // level 1 and above.
+    XLS_ASSERT_OK_AND_ASSIGN(Function * f, p->GetFunction("main"));
+    int64 neg_count = 0;
+    for (Node* node : f->nodes()) {
+      EXPECT_NE(node->op(), Op::kCountedFor);
+      EXPECT_NE(node->op(), Op::kInvoke);
+      neg_count += node->op() == Op::kNeg ? 1 : 0;
+    }
+    EXPECT_EQ(neg_count, opt_level == 0 ? 8 : 0) << "opt_level " << opt_level;
+  }
+}
+
+TEST_F(StandardPipelineTest, DeadlineStopsOptimization) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  fb.Negate(fb.Negate(x));
+  XLS_ASSERT_OK(fb.Build().status());
+
+  // Passes which lower the IR still run, but the simplification fixed point
+  // stops after one iteration and the BDD passes do nothing.
+  PassOptions options;
+  options.deadline = absl::Now();
+  PassResults results;
+  XLS_ASSERT_OK(
+      CreateStandardPassPipeline()->Run(p.get(), options, &results).status());
+  for (const PassInvocation& invocation : results.invocations) {
+    EXPECT_THAT(invocation.path, Not(Contains("iteration_1")));
+    if (invocation.pass_name == "bdd_simp" ||
+        invocation.pass_name == "bdd_cse") {
+      EXPECT_FALSE(invocation.ir_changed);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace xls
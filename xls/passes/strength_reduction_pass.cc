@@ -24,7 +24,7 @@
 #include "xls/ir/node_util.h"
 #include "xls/ir/nodes.h"
 #include "xls/passes/query_engine.h"
-#include "xls/passes/ternary_query_engine.h"
+#include "xls/passes/range_query_engine.h"
 
 namespace xls {
 namespace {
@@ -362,8 +362,8 @@ xabsl::StatusOr<bool> StrengthReduceNode(
 
 xabsl::StatusOr<bool> StrengthReductionPass::RunOnFunction(
     Function* f, const PassOptions& options, PassResults* results) const {
-  XLS_ASSIGN_OR_RETURN(std::unique_ptr<TernaryQueryEngine> query_engine,
-                       TernaryQueryEngine::Run(f));
+  XLS_ASSIGN_OR_RETURN(RangeQueryEngine * query_engine,
+                       results->query_engine_cache.GetRangeQueryEngine(f));
   XLS_ASSIGN_OR_RETURN(absl::flat_hash_set<Node*> reducible_adds,
                        FindReducibleAdds(f, *query_engine));
   // Note: because we introduce new nodes into the graph that were not present
@@ -16,6 +16,7 @@
 
 #include <limits>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/str_cat.h"
 #include "xls/common/status/status_macros.h"
@@ -50,40 +51,72 @@ Bits TernaryVectorToValueBits(const TernaryEvaluator::Vector& ternary_vector) {
 /* static */
 xabsl::StatusOr<std::unique_ptr<TernaryQueryEngine>> TernaryQueryEngine::Run(
     Function* f) {
+  auto engine = absl::make_unique<TernaryQueryEngine>();
+  XLS_RETURN_IF_ERROR(engine->Update(f).status());
+  return std::move(engine);
+}
+
+xabsl::StatusOr<int64> TernaryQueryEngine::Update(Function* f) {
   TernaryEvaluator evaluator;
-  absl::flat_hash_map<Node*, TernaryEvaluator::Vector> values;
+  absl::flat_hash_map<Node*, NodeState> old_states = std::move(node_states_);
+  node_states_.clear();
+
+  // The nodes whose value may differ from that of the last update.
+  absl::flat_hash_set<Node*> changed;
+  int64 evaluated_count = 0;
   for (Node* node : TopoSort(f)) {
+    // TODO(meheff): Handle types other than bits.
     if (!node->GetType()->IsBits()) {
       continue;
     }
+    std::vector<int64> operand_ids;
+    operand_ids.reserve(node->operand_count());
+    for (Node* operand : node->operands()) {
+      operand_ids.push_back(operand->id());
+    }
+    auto it = old_states.find(node);
+    bool is_same_node = it != old_states.end() && it->second.id == node->id();
+    if (is_same_node && it->second.operand_ids == operand_ids &&
+        std::none_of(node->operands().begin(), node->operands().end(),
+                     [&](Node* o) { return changed.contains(o); })) {
+      node_states_[node] = std::move(it->second);
+      continue;
+    }
+
     auto create_unknown_vector = [](Node* n) {
       return TernaryEvaluator::Vector(n->BitCountOrDie(),
                                       TernaryValue::kUnknown);
     };
+    TernaryEvaluator::Vector value;
     if (std::any_of(node->operands().begin(), node->operands().end(),
                     [](Node* o) { return !o->GetType()->IsBits(); })) {
-      values[node] = create_unknown_vector(node);
-      continue;
+      value = create_unknown_vector(node);
+    } else {
+      std::vector<TernaryEvaluator::Vector> operand_values;
+      for (Node* operand : node->operands()) {
+        operand_values.push_back(node_states_.at(operand).value);
+      }
+      XLS_ASSIGN_OR_RETURN(
+          value, AbstractEvaluate(node, operand_values, &evaluator,
+                                  /*default_handler=*/create_unknown_vector));
     }
-    std::vector<TernaryEvaluator::Vector> operand_values;
-    for (Node* operand : node->operands()) {
-      operand_values.push_back(values.at(operand));
+    ++evaluated_count;
+    if (!is_same_node || it->second.value != value) {
+      changed.insert(node);
     }
-    XLS_ASSIGN_OR_RETURN(
-        values[node],
-        AbstractEvaluate(node, operand_values, &evaluator,
-                         /*default_handler=*/create_unknown_vector));
+    known_bits_[node] = TernaryVectorToKnownBits(value);
+    bits_values_[node] = TernaryVectorToValueBits(value);
+    node_states_[node] = {node->id(), std::move(operand_ids), std::move(value)};
   }
 
-  auto engine = absl::make_unique<TernaryQueryEngine>();
-  for (Node* node : f->nodes()) {
-    // TODO(meheff): Handle types other than bits.
-    if (node->GetType()->IsBits()) {
-      engine->known_bits_[node] = TernaryVectorToKnownBits(values.at(node));
-      engine->bits_values_[node] = TernaryVectorToValueBits(values.at(node));
+  // Drop the information about nodes which have been removed.
+  for (const auto& [node, state] : old_states) {
+    if (!node_states_.contains(node)) {
+      known_bits_.erase(node);
+      bits_values_.erase(node);
     }
   }
-  return std::move(engine);
+  return evaluated_count;
 }
 
 bool TernaryQueryEngine::AtMostOneTrue(
@@ -15,12 +15,17 @@
 #ifndef XLS_PASSES_TERNARY_QUERY_ENGINE_H_
 #define XLS_PASSES_TERNARY_QUERY_ENGINE_H_
 
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/types/optional.h"
+#include "xls/common/integral_types.h"
 #include "xls/common/status/statusor.h"
 #include "xls/ir/bits.h"
 #include "xls/ir/function.h"
 #include "xls/ir/nodes.h"
 #include "xls/passes/query_engine.h"
+#include "xls/passes/ternary_logic.h"
 
 namespace xls {
 
@@ -33,6 +38,14 @@ class TernaryQueryEngine : public QueryEngine {
  public:
   static xabsl::StatusOr<std::unique_ptr<TernaryQueryEngine>> Run(Function* f);
 
+  // Brings the engine up to date with the current state of 'f', which must be
+  // the function the engine was created for. Only nodes which were added or
+  // whose operands were replaced since the last update, and the nodes in their
+  // fan-out whose operand values changed as a result, are re-evaluated; the
+  // result is the same as that of running the engine from scratch. Returns the
+  // number of nodes evaluated.
+  xabsl::StatusOr<int64> Update(Function* f);
+
   bool IsTracked(Node* node) const override {
     return known_bits_.contains(node);
   }
@@ -61,6 +74,18 @@ class TernaryQueryEngine : public QueryEngine {
   }
 
  private:
+  // The state of a node as of the last update.
+  struct NodeState {
+    // Node ids are never reused, so these identify the node and its operands
+    // even if a node is deleted and another is allocated at the same address.
+    int64 id;
+    std::vector<int64> operand_ids;
+
+    TernaryEvaluator::Vector value;
+  };
+
+  absl::flat_hash_map<Node*, NodeState> node_states_;
+
   // Holds which bits values are known for nodes in the function. A one in a bit
   // position indications the respective bit value in the respective node is
   // statically known.
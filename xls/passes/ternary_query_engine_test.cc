@@ -129,5 +129,46 @@ TEST_F(TernaryQueryEngineTest, Ne) {
   EXPECT_THAT(RunOnBinaryOp("0b011", "0b011", make_ne), IsOkAndHolds("0b0"));
 }
 
+TEST_F(TernaryQueryEngineTest, Update) {
+  Package p("test_package");
+  FunctionBuilder fb("f", &p);
+  BValue x = fb.Param("x", p.GetBitsType(8));
+  BValue masked = fb.And(x, fb.Literal(UBits(0x0f, 8)));
+  BValue top_bit = fb.Literal(UBits(0x80, 8));
+  BValue set = fb.Or(masked, top_bit);
+  BValue other = fb.Not(fb.Param("y", p.GetBitsType(8)));
+  fb.Concat({set, other});
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TernaryQueryEngine> engine,
+                           TernaryQueryEngine::Run(f));
+  EXPECT_EQ(engine->ToString(f->return_value()), "0b1000_XXXX_XXXX_XXXX");
+  EXPECT_THAT(engine->Update(f), IsOkAndHolds(0));
+
+  // Narrowing the mask changes the value of 'masked', 'set' and the concat.
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Node * narrow_mask,
+      f->MakeNode<Literal>(/*loc=*/absl::nullopt, Value(UBits(0x03, 8))));
+  XLS_ASSERT_OK(masked.node()->ReplaceOperandNumber(1, narrow_mask));
+  EXPECT_THAT(engine->Update(f), IsOkAndHolds(4));
+  EXPECT_EQ(engine->ToString(f->return_value()), "0b1000_00XX_XXXX_XXXX");
+
+  // Replacing a literal with an identical one changes no value, so the
+  // evaluation stops at its user.
+  XLS_ASSERT_OK_AND_ASSIGN(
+      Node * same_top_bit,
+      f->MakeNode<Literal>(/*loc=*/absl::nullopt, Value(UBits(0x80, 8))));
+  XLS_ASSERT_OK(set.node()->ReplaceOperandNumber(1, same_top_bit));
+  XLS_ASSERT_OK(f->RemoveNode(top_bit.node()));
+  EXPECT_THAT(engine->Update(f), IsOkAndHolds(2));
+  EXPECT_EQ(engine->ToString(f->return_value()), "0b1000_00XX_XXXX_XXXX");
+  EXPECT_TRUE(engine->IsTracked(same_top_bit));
+
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TernaryQueryEngine> fresh_engine,
+                           TernaryQueryEngine::Run(f));
+  for (Node* node : f->nodes()) {
+    EXPECT_EQ(engine->ToString(node), fresh_engine->ToString(node));
+  }
+}
+
 }  // namespace
 }  // namespace xls
@@ -21,10 +21,55 @@
 #include "xls/ir/nodes.h"
 
 namespace xls {
+namespace {
+
+// Replaces TupleIndex(Tuple(i{0}, i{1}, ..., i{N}), index=k) with i{k}.
+// Returns true if the IR was changed.
+xabsl::StatusOr<bool> SimplifyTupleIndex(TupleIndex* tuple_index) {
+  // Note: lhs of tuple index may not be a tuple *instruction*.
+  if (!tuple_index->operand(0)->Is<Tuple>()) {
+    return false;
+  }
+  Node* tuple_element = tuple_index->operand(0)->operand(tuple_index->index());
+  return tuple_index->ReplaceUsesWith(tuple_element);
+}
+
+// Replaces an in-bounds ArrayIndex with a literal index into an Array or
+// Literal with the respective element. Returns true if the IR was changed.
+xabsl::StatusOr<bool> SimplifyArrayIndex(ArrayIndex* array_index) {
+  if (!array_index->operand(1)->Is<Literal>()) {
+    return false;
+  }
+  Literal* rhs = array_index->operand(1)->As<Literal>();
+  if (!rhs->value().bits().FitsInUint64()) {
+    return false;
+  }
+  XLS_ASSIGN_OR_RETURN(uint64 index, rhs->value().bits().ToUint64());
+  if (index >= array_index->operand(0)->GetType()->AsArrayOrDie()->size()) {
+    // Punt on optimizing OOB accesses.
+    return false;
+  }
+  if (array_index->operand(0)->Is<Array>()) {
+    Array* array = array_index->operand(0)->As<Array>();
+    Node* array_element = array->operand(index);
+    return array_index->ReplaceUsesWith(array_element);
+  }
+  if (array_index->operand(0)->Is<Literal>()) {
+    Literal* array = array_index->operand(0)->As<Literal>();
+    XLS_RET_CHECK(array->GetType()->IsArray());
+    XLS_RET_CHECK_LT(index, array->value().size());
+    const Value& element = array->value().element(index);
+    XLS_RETURN_IF_ERROR(
+        array_index->ReplaceUsesWithNew<Literal>(element).status());
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
 
 xabsl::StatusOr<bool> TupleSimplificationPass::RunOnFunction(
     Function* f, const PassOptions& options, PassResults* results) const {
-  // Replace TupleIndex(Tuple(i{0}, i{1}, ..., i{N}), index=k) with i{k}
   bool changed = false;
   std::deque<absl::variant<TupleIndex*, ArrayIndex*>> worklist;
   for (Node* node : f->nodes()) {
@@ -39,54 +84,26 @@ xabsl::StatusOr<bool> TupleSimplificationPass::RunOnFunction(
     worklist.pop_front();
     if (absl::holds_alternative<TupleIndex*>(index)) {
       TupleIndex* tuple_index = absl::get<TupleIndex*>(index);
-      // Note: lhs of tuple index may not be a tuple *instruction*.
-      if (!tuple_index->operand(0)->Is<Tuple>()) {
-        continue;
-      }
-      Node* tuple_element =
-          tuple_index->operand(0)->operand(tuple_index->index());
-      XLS_ASSIGN_OR_RETURN(bool node_changed,
-                           tuple_index->ReplaceUsesWith(tuple_element));
+      XLS_ASSIGN_OR_RETURN(bool node_changed, SimplifyTupleIndex(tuple_index));
       changed |= node_changed;
 
       // Simplifying this tuple index instruction may expose opportunities for
       // more simplifications.
-      if (tuple_element->Is<Tuple>()) {
-        for (Node* user : tuple_element->users()) {
-          if (user->Is<TupleIndex>()) {
-            worklist.push_back(user->As<TupleIndex>());
+      if (tuple_index->operand(0)->Is<Tuple>()) {
+        Node* tuple_element =
+            tuple_index->operand(0)->operand(tuple_index->index());
+        if (tuple_element->Is<Tuple>()) {
+          for (Node* user : tuple_element->users()) {
+            if (user->Is<TupleIndex>()) {
+              worklist.push_back(user->As<TupleIndex>());
+            }
           }
         }
       }
     } else if (absl::holds_alternative<ArrayIndex*>(index)) {
-      ArrayIndex* array_index = absl::get<ArrayIndex*>(index);
-      if (!array_index->operand(1)->Is<Literal>()) {
-        continue;
-      }
-      Literal* rhs = array_index->operand(1)->As<Literal>();
-      if (!rhs->value().bits().FitsInUint64()) {
-        continue;
-      }
-      XLS_ASSIGN_OR_RETURN(uint64 index, rhs->value().bits().ToUint64());
-      if (index >= array_index->operand(0)->GetType()->AsArrayOrDie()->size()) {
-        // Punt on optimizing OOB accesses.
-        continue;
-      }
-      if (array_index->operand(0)->Is<Array>()) {
-        Array* array = array_index->operand(0)->As<Array>();
-        Node* array_element = array->operand(index);
-        XLS_ASSIGN_OR_RETURN(bool node_changed,
-                             array_index->ReplaceUsesWith(array_element));
-        changed |= node_changed;
-      } else if (array_index->operand(0)->Is<Literal>()) {
-        Literal* array = array_index->operand(0)->As<Literal>();
-        XLS_RET_CHECK(array->GetType()->IsArray());
-        XLS_RET_CHECK_LT(index, array->value().size());
-        const Value& element = array->value().element(index);
-        XLS_RETURN_IF_ERROR(
-            array_index->ReplaceUsesWithNew<Literal>(element).status());
-        changed = true;
-      }
+      XLS_ASSIGN_OR_RETURN(bool node_changed,
+                           SimplifyArrayIndex(absl::get<ArrayIndex*>(index)));
+      changed |= node_changed;
     } else {
       return absl::InternalError("Unknown index type in worklist.");
     }
@@ -95,4 +112,15 @@ xabsl::StatusOr<bool> TupleSimplificationPass::RunOnFunction(
   return changed;
 }
 
+bool TupleSimplificationRule::AppliesTo(Op op) const {
+  return op == Op::kTupleIndex || op == Op::kArrayIndex;
+}
+
+xabsl::StatusOr<bool> TupleSimplificationRule::Rewrite(Node* node) const {
+  if (node->Is<TupleIndex>()) {
+    return SimplifyTupleIndex(node->As<TupleIndex>());
+  }
+  return SimplifyArrayIndex(node->As<ArrayIndex>());
+}
+
 }  // namespace xls
@@ -17,6 +17,7 @@
 
 #include "xls/common/status/statusor.h"
 #include "xls/ir/function.h"
+#include "xls/passes/node_rewrite_pass.h"
 #include "xls/passes/passes.h"
 
 namespace xls {
@@ -33,6 +34,16 @@ class TupleSimplificationPass : public FunctionPass {
                                       PassResults* results) const override;
 };
 
+// Applies the simplifications of TupleSimplificationPass to a single node.
+class TupleSimplificationRule : public NodeRewriteRule {
+ public:
+  TupleSimplificationRule() : NodeRewriteRule("tuple_simp") {}
+
+  bool AppliesTo(Op op) const override;
+
+  xabsl::StatusOr<bool> Rewrite(Node* node) const override;
+};
+
 }  // namespace xls
 
 #endif  // XLS_PASSES_TUPLE_SIMPLIFICATION_PASS_H_
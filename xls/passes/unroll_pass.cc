@@ -14,23 +14,26 @@
 
 #include "xls/passes/unroll_pass.h"
 
+#include <string>
+#include <vector>
+
+#include "absl/algorithm/container.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/logging/logging.h"
 #include "xls/common/status/status_macros.h"
+#include "xls/ir/function_builder.h"
 #include "xls/ir/node_iterator.h"
 
 namespace xls {
 namespace {
 
-// Finds an "effectively used" (has users or is return value) counted for in the
-// function f, or returns nullptr if none is found.
-CountedFor* FindCountedFor(Function* f) {
-  for (Node* node : TopoSort(f)) {
-    if (node->Is<CountedFor>() &&
-        (node == f->return_value() || !node->users().empty())) {
-      return node->As<CountedFor>();
-    }
-  }
-  return nullptr;
+// Returns whether the node is an "effectively used" (has users or is return
+// value) counted for.
+bool IsUnrolledCountedFor(Node* node) {
+  return node->Is<CountedFor>() &&
+         (node == node->function()->return_value() ||
+          !node->users().empty());
 }
 
 // Unrolls the node "loop" by replacing it with a sequence of dependent
@@ -59,18 +62,121 @@ absl::Status UnrollCountedFor(CountedFor* loop, Function* f) {
   return f->RemoveNode(loop);
 }
 
+// Returns a function which does 'factor' iterations of the given loop body,
+// as the body of the loop partially unrolled by that factor. The first
+// parameter is the induction variable of the first of these iterations.
+xabsl::StatusOr<Function*> MakeUnrolledBody(Function* body, int64 stride,
+                                            int64 factor) {
+  Package* p = body->package();
+  std::string name = absl::StrFormat("%s__unrolled_%d", body->name(), factor);
+  for (int64 i = 1; p->GetFunction(name).ok(); ++i) {
+    name = absl::StrFormat("%s__unrolled_%d_%d", body->name(), factor, i);
+  }
+  FunctionBuilder fb(name, p);
+  std::vector<BValue> args;
+  for (Param* param : body->params()) {
+    args.push_back(fb.Param(param->name(), param->GetType()));
+  }
+  BValue iv = args[0];
+  int64 ivar_bit_count = iv.node()->BitCountOrDie();
+  for (int64 i = 0; i < factor; ++i) {
+    if (i > 0) {
+      args[0] = fb.Add(iv, fb.Literal(UBits(i * stride, ivar_bit_count)));
+    }
+    args[1] = fb.Invoke(args, body);
+  }
+  return fb.BuildWithReturnValue(args[1]);
+}
+
+// Replaces the loop by a loop doing 'factor' iterations per trip, followed by
+// invocations of the body for the remaining iterations.
+absl::Status PartiallyUnrollCountedFor(CountedFor* loop, int64 factor,
+                                       Function* f) {
+  XLS_ASSIGN_OR_RETURN(Function * body,
+                       MakeUnrolledBody(loop->body(), loop->stride(), factor));
+  int64 trip_count = loop->trip_count() / factor;
+  std::vector<Node*> invariant_args(loop->invariant_args().begin(),
+                                    loop->invariant_args().end());
+  XLS_ASSIGN_OR_RETURN(
+      Node * loop_carry,
+      f->MakeNode<CountedFor>(loop->loc(), loop->initial_value(),
+                              invariant_args, trip_count,
+                              loop->stride() * factor, body));
+  int64 ivar_bit_count = loop->body()->params()[0]->BitCountOrDie();
+  for (int64 trip = trip_count * factor; trip < loop->trip_count(); ++trip) {
+    XLS_ASSIGN_OR_RETURN(
+        Literal * iv_node,
+        f->MakeNode<Literal>(loop->loc(), Value(UBits(trip * loop->stride(),
+                                                      ivar_bit_count))));
+    std::vector<Node*> invoke_args = {iv_node, loop_carry};
+    invoke_args.insert(invoke_args.end(), invariant_args.begin(),
+                       invariant_args.end());
+    XLS_ASSIGN_OR_RETURN(
+        loop_carry,
+        f->MakeNode<Invoke>(loop->loc(), absl::MakeSpan(invoke_args),
+                            loop->body()));
+  }
+  XLS_RETURN_IF_ERROR(loop->ReplaceUsesWith(loop_carry).status());
+  return f->RemoveNode(loop);
+}
+
 }  // namespace
 
 xabsl::StatusOr<bool> UnrollPass::RunOnFunction(Function* f,
                                                 const PassOptions& options,
                                                 PassResults* results) const {
+  // Unrolling produces invokes rather than loops, so all the loops to unroll
+  // are known upfront.
+  std::vector<CountedFor*> loops;
+  for (Node* node : TopoSort(f)) {
+    if (IsUnrolledCountedFor(node)) {
+      loops.push_back(node->As<CountedFor>());
+    }
+  }
   bool changed = false;
-  while (true) {
-    CountedFor* loop = FindCountedFor(f);
-    if (loop == nullptr) {
-      break;
+  for (CountedFor* loop : loops) {
+    UnrollDecision decision{f->name(), loop->GetName(), loop->trip_count(),
+                            UnrollDecision::Kind::kFull};
+    int64 body_node_count = loop->body()->node_count();
+    int64 added_node_count = loop->trip_count() * body_node_count;
+    if (absl::c_linear_search(options.rolled_loop_bodies,
+                              loop->body()->name())) {
+      decision.kind = UnrollDecision::Kind::kRolled;
+    } else if (options.unroll_node_limit.has_value() &&
+               added_node_count > *options.unroll_node_limit) {
+      // Unroll as many iterations per trip as fit in the limit.
+      decision.factor = *options.unroll_node_limit / body_node_count;
+      decision.kind = decision.factor < 2 ? UnrollDecision::Kind::kRolled
+                                          : UnrollDecision::Kind::kPartial;
+      added_node_count =
+          (loop->trip_count() % decision.factor + 1) * body_node_count;
+    }
+    results->unroll_decisions.push_back(decision);
+    if (decision.kind == UnrollDecision::Kind::kRolled) {
+      XLS_VLOG(2) << absl::StreamFormat("Leaving %s in function %s rolled",
+                                        decision.loop, decision.function);
+      continue;
+    }
+
+    if (options.node_budget.has_value()) {
+      int64 unrolled_node_count = f->node_count() + added_node_count;
+      if (unrolled_node_count > *options.node_budget) {
+        return absl::ResourceExhaustedError(absl::StrFormat(
+            "Unrolling %s in function %s would grow the function to about %d "
+            "nodes, exceeding the node budget of %d",
+            loop->GetName(), f->name(), unrolled_node_count,
+            *options.node_budget));
+      }
+    }
+    if (decision.kind == UnrollDecision::Kind::kFull) {
+      XLS_RETURN_IF_ERROR(UnrollCountedFor(loop, f));
+    } else {
+      XLS_VLOG(2) << absl::StreamFormat(
+          "Unrolling %s in function %s by a factor of %d", decision.loop,
+          decision.function, decision.factor);
+      XLS_RETURN_IF_ERROR(
+          PartiallyUnrollCountedFor(loop, decision.factor, f));
     }
-    XLS_RETURN_IF_ERROR(UnrollCountedFor(loop, f));
     changed = true;
   }
   return changed;
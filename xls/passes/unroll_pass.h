@@ -21,12 +21,28 @@
 
 namespace xls {
 
+// Unrolls counted loops into a sequence of invocations of the loop body. If
+// PassOptions::node_budget is set, fails with a ResourceExhausted error rather
+// than unroll a loop which, once its body is inlined, would grow the function
+// beyond the budget.
+//
+// Loops whose bodies are in PassOptions::rolled_loop_bodies are left alone. If
+// PassOptions::unroll_node_limit is set, a loop whose unrolling would add more
+// nodes than the limit is instead unrolled by the largest factor which fits:
+// it is replaced by a loop over a new body function invoking the original
+// body that many times, followed by invocations for the remaining
+// iterations. Loops for which no factor of at least two fits are left rolled.
+// The decisions are recorded in PassResults::unroll_decisions.
 class UnrollPass : public FunctionPass {
  public:
   UnrollPass() : FunctionPass("loop_unroll", "Unroll counted loops") {}
 
   xabsl::StatusOr<bool> RunOnFunction(Function* f, const PassOptions& options,
                                       PassResults* results) const override;
+
+  // Creates nodes which invoke (and are verified against) loop bodies, and
+  // adds functions to the package.
+  bool IsFunctionLocal() const override { return false; }
 };
 
 }  // namespace xls
@@ -17,12 +17,16 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "xls/common/status/matchers.h"
+#include "xls/ir/ir_interpreter.h"
 #include "xls/ir/ir_parser.h"
+#include "xls/ir/nodes.h"
 #include "xls/passes/dce_pass.h"
 
 namespace xls {
 namespace {
 
+using ::testing::HasSubstr;
+
 TEST(UnrollPassTest, UnrollsCountedForWithInvariantArgsAndStride) {
   const std::string program = R"(
 package some_package
@@ -59,5 +63,118 @@ fn unrollable() -> bits[32] {
   EXPECT_EQ(expected, f->DumpIr());
 }
 
+TEST(UnrollPassTest, NodeBudgetExceeded) {
+  const std::string program = R"(
+package some_package
+
+fn body(i: bits[4], accum: bits[32]) -> bits[32] {
+  zero_ext.3: bits[32] = zero_ext(i, new_bit_count=32)
+  ret add.4: bits[32] = add(zero_ext.3, accum)
+}
+
+fn unrollable() -> bits[32] {
+  literal.1: bits[32] = literal(value=0)
+  ret counted_for.2: bits[32] = counted_for(literal.1, trip_count=10, stride=1, body=body)
+}
+)";
+
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> p,
+                           Parser::ParsePackage(program));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p->GetFunction("unrollable"));
+  PassResults results;
+  PassOptions options;
+  options.node_budget = 20;
+  EXPECT_THAT(UnrollPass().RunOnFunction(f, options, &results),
+              status_testing::StatusIs(absl::StatusCode::kResourceExhausted,
+                                       HasSubstr("node budget of 20")));
+  options.node_budget = 100;
+  EXPECT_THAT(UnrollPass().RunOnFunction(f, options, &results),
+              status_testing::IsOkAndHolds(true));
+}
+
+constexpr char kLoopPackage[] = R"(
+package some_package
+
+fn body(i: bits[8], accum: bits[32], x: bits[32]) -> bits[32] {
+  zero_ext.3: bits[32] = zero_ext(i, new_bit_count=32)
+  add.4: bits[32] = add(zero_ext.3, accum)
+  ret xor.5: bits[32] = xor(add.4, x)
+}
+
+fn unrollable(x: bits[32]) -> bits[32] {
+  literal.1: bits[32] = literal(value=0)
+  ret counted_for.2: bits[32] = counted_for(literal.1, trip_count=10, stride=3, body=body, invariant_args=[x])
+}
+)";
+
+TEST(UnrollPassTest, PartialUnroll) {
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> p,
+                           Parser::ParsePackage(kLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p->GetFunction("unrollable"));
+  std::vector<Value> args = {Value(UBits(0x1234, 32))};
+  XLS_ASSERT_OK_AND_ASSIGN(Value expected, ir_interpreter::Run(f, args));
+
+  // The body has 6 nodes, so 4 iterations fit in the limit.
+  PassResults results;
+  PassOptions options;
+  options.unroll_node_limit = 24;
+  EXPECT_THAT(UnrollPass().RunOnFunction(f, options, &results),
+              status_testing::IsOkAndHolds(true));
+  ASSERT_EQ(results.unroll_decisions.size(), 1);
+  EXPECT_EQ(results.unroll_decisions[0].loop, "counted_for.2");
+  EXPECT_EQ(results.unroll_decisions[0].kind,
+            UnrollDecision::Kind::kPartial);
+  EXPECT_EQ(results.unroll_decisions[0].factor, 4);
+
+  // Two trips of the new loop do 8 iterations, and the last 2 iterations are
+  // invocations of the original body.
+  int64 loop_count = 0;
+  int64 invoke_count = 0;
+  for (Node* node : f->nodes()) {
+    if (node->Is<CountedFor>()) {
+      ++loop_count;
+      EXPECT_EQ(node->As<CountedFor>()->trip_count(), 2);
+      EXPECT_EQ(node->As<CountedFor>()->stride(), 12);
+    } else if (node->Is<Invoke>()) {
+      ++invoke_count;
+    }
+  }
+  EXPECT_EQ(loop_count, 1);
+  EXPECT_EQ(invoke_count, 2);
+  EXPECT_THAT(ir_interpreter::Run(f, args),
+              status_testing::IsOkAndHolds(expected));
+
+  // The unrolled body is added after the loop's function, but must be dumped
+  // before it for the IR to parse.
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> reparsed,
+                           Parser::ParsePackage(p->DumpIr()));
+  EXPECT_EQ(reparsed->DumpIr(), p->DumpIr());
+  XLS_ASSERT_OK_AND_ASSIGN(Function * reparsed_f,
+                           reparsed->GetFunction("unrollable"));
+  EXPECT_THAT(ir_interpreter::Run(reparsed_f, args),
+              status_testing::IsOkAndHolds(expected));
+}
+
+TEST(UnrollPassTest, LoopsLeftRolled) {
+  XLS_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Package> p,
+                           Parser::ParsePackage(kLoopPackage));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, p->GetFunction("unrollable"));
+  for (bool rolled_body : {false, true}) {
+    PassResults results;
+    PassOptions options;
+    if (rolled_body) {
+      options.rolled_loop_bodies = {"body"};
+    } else {
+      // Not even two iterations fit in the limit.
+      options.unroll_node_limit = 11;
+    }
+    EXPECT_THAT(UnrollPass().RunOnFunction(f, options, &results),
+                status_testing::IsOkAndHolds(false));
+    ASSERT_EQ(results.unroll_decisions.size(), 1);
+    EXPECT_EQ(results.unroll_decisions[0].kind,
+              UnrollDecision::Kind::kRolled);
+  }
+}
+
 }  // namespace
 }  // namespace xls
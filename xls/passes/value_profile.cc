@@ -0,0 +1,97 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/value_profile.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/types/optional.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ternary.h"
+
+namespace xls {
+
+ValueProfiler::ValueProfiler(Function* f, int64 max_values_per_param)
+    : f_(f),
+      max_values_per_param_(max_values_per_param),
+      value_counts_(f->params().size()),
+      other_counts_(f->params().size(), 0) {}
+
+xabsl::StatusOr<Value> ValueProfiler::Run(absl::Span<const Value> args) {
+  XLS_RET_CHECK_EQ(args.size(), f_->params().size());
+  XLS_ASSIGN_OR_RETURN(Value result, ir_interpreter::Run(f_, args, &stats_));
+  ++sample_count_;
+  for (int64 i = 0; i < args.size(); ++i) {
+    std::string value = args[i].ToString(FormatPreference::kHex);
+    auto it = value_counts_[i].find(value);
+    if (it != value_counts_[i].end()) {
+      ++it->second;
+    } else if (value_counts_[i].size() < max_values_per_param_) {
+      value_counts_[i][value] = 1;
+    } else {
+      ++other_counts_[i];
+    }
+  }
+  return result;
+}
+
+FunctionProfileProto ValueProfiler::ToProto() const {
+  FunctionProfileProto proto;
+  proto.set_function(f_->name());
+  proto.set_sample_count(sample_count_);
+  for (int64 i = 0; i < f_->params().size(); ++i) {
+    ParamProfileProto* param = proto.add_params();
+    param->set_name(f_->params()[i]->GetName());
+    std::vector<std::pair<std::string, int64>> counts(
+        value_counts_[i].begin(), value_counts_[i].end());
+    std::sort(counts.begin(), counts.end(),
+              [](const auto& a, const auto& b) {
+                return a.second != b.second ? a.second > b.second
+                                            : a.first < b.first;
+              });
+    for (const auto& [value, count] : counts) {
+      ValueCountProto* value_count = param->add_values();
+      value_count->set_value(value);
+      value_count->set_count(count);
+    }
+    param->set_other_count(other_counts_[i]);
+  }
+  // The interpreter notes the bits of nodes by their string form, which is
+  // unique within the function.
+  for (Node* node : f_->nodes()) {
+    absl::optional<TernaryVector> bits = stats_.GetNodeBits(node->ToString());
+    if (!bits.has_value() || ternary_ops::AllUnknown(*bits)) {
+      continue;
+    }
+    NodeProfileProto* node_proto = proto.add_nodes();
+    node_proto->set_name(node->GetName());
+    node_proto->set_ternary(ToString(*bits));
+  }
+  return proto;
+}
+
+const FunctionProfileProto* FindFunctionProfile(
+    const ValueProfileProto& profile, absl::string_view function_name) {
+  for (const FunctionProfileProto& function : profile.functions()) {
+    if (function.function() == function_name) {
+      return &function;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace xls
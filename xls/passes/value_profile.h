@@ -0,0 +1,70 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_PASSES_VALUE_PROFILE_H_
+#define XLS_PASSES_VALUE_PROFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/function.h"
+#include "xls/ir/ir_interpreter_stats.h"
+#include "xls/ir/value.h"
+#include "xls/passes/value_profile.pb.h"
+
+namespace xls {
+
+// Records the values a function computes over a trace of inputs, for
+// profile-guided optimization (see ProfileGuidedSpecializationPass). Each
+// sample is evaluated with the IR interpreter; the profile holds the most
+// frequent values of each parameter and, via InterpreterStats, the bits of
+// each node which held the same value in every sample.
+class ValueProfiler {
+ public:
+  // At most 'max_values_per_param' distinct values are counted for each
+  // parameter; samples with other values are only counted in total.
+  explicit ValueProfiler(Function* f, int64 max_values_per_param = 16);
+
+  // Evaluates the function on the given arguments, records the sample and
+  // returns the result.
+  xabsl::StatusOr<Value> Run(absl::Span<const Value> args);
+
+  // Returns the profile of the samples recorded so far.
+  FunctionProfileProto ToProto() const;
+
+ private:
+  Function* f_;
+  int64 max_values_per_param_;
+  int64 sample_count_ = 0;
+  InterpreterStats stats_;
+
+  // The number of samples with each counted value of each parameter, keyed by
+  // the value as a typed IR value, and the number of other samples.
+  std::vector<absl::flat_hash_map<std::string, int64>> value_counts_;
+  std::vector<int64> other_counts_;
+};
+
+// Returns the profile of the function with the given name, or nullptr if
+// there is none.
+const FunctionProfileProto* FindFunctionProfile(
+    const ValueProfileProto& profile, absl::string_view function_name);
+
+}  // namespace xls
+
+#endif  // XLS_PASSES_VALUE_PROFILE_H_
@@ -0,0 +1,82 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/passes/value_profile.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/ternary.h"
+
+namespace xls {
+namespace {
+
+using status_testing::IsOkAndHolds;
+
+class ValueProfileTest : public IrTestBase {};
+
+TEST_F(ValueProfileTest, RecordsParamValuesAndConstantBits) {
+  auto p = CreatePackage();
+  FunctionBuilder fb(TestName(), p.get());
+  BValue x = fb.Param("x", p->GetBitsType(8));
+  BValue mode = fb.Param("mode", p->GetBitsType(2));
+  BValue masked = fb.And(x, fb.Literal(UBits(0xf0, 8)));
+  fb.Add(masked, fb.ZeroExtend(mode, 8));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * f, fb.Build());
+
+  ValueProfiler profiler(f, /*max_values_per_param=*/2);
+  for (int64 i = 1; i <= 3; ++i) {
+    EXPECT_THAT(
+        profiler.Run({Value(UBits(0x10 + i, 8)), Value(UBits(1, 2))}),
+        IsOkAndHolds(Value(UBits(0x11, 8))));
+  }
+  FunctionProfileProto profile = profiler.ToProto();
+  EXPECT_EQ(profile.function(), f->name());
+  EXPECT_EQ(profile.sample_count(), 3);
+
+  // Only the first two values of "x" are counted.
+  ASSERT_EQ(profile.params_size(), 2);
+  EXPECT_EQ(profile.params(0).name(), "x");
+  ASSERT_EQ(profile.params(0).values_size(), 2);
+  EXPECT_EQ(profile.params(0).values(0).value(),
+            Value(UBits(0x11, 8)).ToString(FormatPreference::kHex));
+  EXPECT_EQ(profile.params(0).values(0).count(), 1);
+  EXPECT_EQ(profile.params(0).other_count(), 1);
+  ASSERT_EQ(profile.params(1).values_size(), 1);
+  EXPECT_EQ(profile.params(1).values(0).value(),
+            Value(UBits(1, 2)).ToString(FormatPreference::kHex));
+  EXPECT_EQ(profile.params(1).values(0).count(), 3);
+  EXPECT_EQ(profile.params(1).other_count(), 0);
+
+  // The masked value is the same in every sample.
+  bool found_masked = false;
+  for (const NodeProfileProto& node : profile.nodes()) {
+    if (node.name() == masked.node()->GetName()) {
+      found_masked = true;
+      EXPECT_THAT(StringToTernaryVector(node.ternary()),
+                  IsOkAndHolds(ternary_ops::BitsToTernary(UBits(0x10, 8))));
+    }
+  }
+  EXPECT_TRUE(found_masked);
+
+  ValueProfileProto package_profile;
+  *package_profile.add_functions() = profile;
+  EXPECT_NE(FindFunctionProfile(package_profile, f->name()), nullptr);
+  EXPECT_EQ(FindFunctionProfile(package_profile, "other"), nullptr);
+}
+
+}  // namespace
+}  // namespace xls
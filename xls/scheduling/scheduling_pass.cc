@@ -17,6 +17,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "xls/common/fingerprint.h"
 
 namespace xls {
 
@@ -33,4 +34,15 @@ std::string SchedulingUnit::DumpIr() const {
   return out;
 }
 
+uint64 SchedulingUnit::Fingerprint() const {
+  // Schedules are not fingerprinted incrementally, so fall back to the text.
+  return FingerprintCombine(
+      package->Fingerprint(),
+      schedule.has_value() ? FingerprintString(schedule->ToString()) : 0);
+}
+
+IrSnapshot TakeIrSnapshot(SchedulingUnit* unit) {
+  return TakeIrSnapshot(unit->package);
+}
+
 }  // namespace xls
@@ -35,8 +35,12 @@ struct SchedulingUnit {
   // Methods required by CompoundPassBase.
   std::string DumpIr() const;
   std::string name() const { return package->name(); }
+  uint64 Fingerprint() const;
 };
 
+// Summarizes the package of the unit for profiling (see PassInvocation).
+IrSnapshot TakeIrSnapshot(SchedulingUnit* unit);
+
 // Options passed to each scheduling pass.
 struct SchedulingPassOptions : public PassOptions {
   // The options to use when creating and mutating the schedule.
@@ -0,0 +1,343 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/simulation/pipeline_simulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "xls/common/math_util.h"
+#include "xls/common/status/ret_check.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/ir/ir_parser.h"
+#include "xls/ir/node_iterator.h"
+#include "xls/ir/value_helpers.h"
+#include "xls/scheduling/extract_stage.h"
+
+namespace xls {
+namespace verilog {
+namespace {
+
+// Alignment of every value in the simulator's buffer. This is at least the
+// alignment LLVM assumes for any of the types the JIT loads from it.
+constexpr int64 kValueAlignment = 16;
+
+// Returns whether the value of the given node must be held in a pipeline
+// register at the end of the given cycle. This matches the criterion of
+// ToPipelineModuleText().
+bool IsLiveOutOfCycle(Node* node, int64 cycle,
+                      const PipelineSchedule& schedule) {
+  if (node == node->function()->return_value()) {
+    return true;
+  }
+  return std::any_of(node->users().begin(), node->users().end(),
+                     [&](Node* user) { return schedule.cycle(user) > cycle; });
+}
+
+}  // namespace
+
+PipelineSimulator::PipelineSimulator(std::unique_ptr<Package> package,
+                                     Function* function,
+                                     const PipelineOptions& options)
+    : package_(std::move(package)),
+      function_(function),
+      valid_control_(options.control().has_value() &&
+                     options.control()->has_valid()),
+      manual_control_(options.control().has_value() &&
+                      options.control()->has_manual()),
+      reset_(options.reset()) {}
+
+xabsl::StatusOr<std::unique_ptr<PipelineSimulator>> PipelineSimulator::Create(
+    Function* original_function, const PipelineSchedule& original_schedule,
+    const PipelineOptions& options) {
+  if (options.reset().has_value() && options.reset()->reset_data_path()) {
+    return absl::UnimplementedError(
+        "Reset of data path not supported for pipeline simulator.");
+  }
+  XLS_RET_CHECK_GT(original_schedule.length(), 0);
+
+  // The stage functions are extracted from a private copy of the package, so
+  // that any number of simulators can be created without touching the
+  // original.
+  XLS_ASSIGN_OR_RETURN(
+      std::unique_ptr<Package> package,
+      Parser::ParsePackage(original_function->package()->DumpIr()));
+  XLS_ASSIGN_OR_RETURN(Function * function,
+                       package->GetFunction(original_function->name()));
+  absl::flat_hash_map<std::string, Node*> original_nodes;
+  for (Node* node : original_function->nodes()) {
+    original_nodes[node->GetName()] = node;
+  }
+  ScheduleCycleMap cycle_map;
+  for (Node* node : function->nodes()) {
+    cycle_map[node] =
+        original_schedule.cycle(original_nodes.at(node->GetName()));
+  }
+  PipelineSchedule schedule(function, cycle_map, original_schedule.length());
+
+  auto simulator = absl::WrapUnique(
+      new PipelineSimulator(std::move(package), function, options));
+  Node* return_value = function->return_value();
+
+  for (int64 cycle = 0; cycle < schedule.length(); ++cycle) {
+    XLS_ASSIGN_OR_RETURN(Function * stage_function,
+                         ExtractStage(function, schedule, cycle));
+    Stage stage;
+    XLS_ASSIGN_OR_RETURN(stage.jit, LlvmIrJit::Create(stage_function));
+    simulator->stages_.push_back(std::move(stage));
+  }
+  // All stages agree on the native layout of the function's types.
+  LlvmTypeConverter* converter = simulator->stages_[0].jit->type_converter();
+
+  // Lay out the buffer. Pointers into it can only be formed once its size is
+  // known, so offsets are recorded along the way.
+  int64 buffer_size = 0;
+  auto allocate = [&](Type* type) {
+    int64 offset = RoundUpToNearest(buffer_size, kValueAlignment);
+    buffer_size = offset + converter->GetTypeByteSize(*type);
+    return offset;
+  };
+
+  // The location of each value available to the stage being laid out; these
+  // are either input ports or pipeline registers.
+  absl::flat_hash_map<Node*, int64> available;
+  for (Param* param : function->params()) {
+    simulator->zero_args_.push_back(ZeroOfType(param->GetType()));
+    simulator->input_layouts_.push_back(
+        converter->CreateTypeLayout(*param->GetType()));
+    simulator->input_offsets_.push_back(allocate(param->GetType()));
+    available[param] = simulator->input_offsets_.back();
+  }
+
+  // Adds a set of pipeline registers holding the given nodes, loaded from the
+  // given locations, and makes them the available values.
+  auto add_registers = [&](const std::vector<Node*>& nodes,
+                           const absl::flat_hash_map<Node*, int64>& sources) {
+    std::vector<Copy> loads;
+    absl::flat_hash_map<Node*, int64> registers;
+    for (Node* node : nodes) {
+      int64 size = converter->GetTypeByteSize(*node->GetType());
+      registers[node] = allocate(node->GetType());
+      if (size > 0) {
+        loads.push_back({registers[node], sources.at(node), size});
+      }
+    }
+    simulator->register_loads_.push_back(std::move(loads));
+    available = std::move(registers);
+  };
+
+  // As in ToPipelineModuleText(), inputs are only flopped if any of them has
+  // a nonzero width.
+  auto has_bits = [](Param* p) { return p->GetType()->GetFlatBitCount() > 0; };
+  if (options.flop_inputs() &&
+      std::any_of(function->params().begin(), function->params().end(),
+                  has_bits)) {
+    add_registers(std::vector<Node*>(function->params().begin(),
+                                     function->params().end()),
+                  available);
+  }
+
+  absl::flat_hash_map<std::string, Node*> nodes_by_name;
+  for (Node* node : function->nodes()) {
+    nodes_by_name[node->GetName()] = node;
+  }
+  std::vector<std::vector<int64>> arg_offsets(schedule.length());
+  std::vector<int64> result_offsets(schedule.length());
+  for (int64 cycle = 0; cycle < schedule.length(); ++cycle) {
+    Function* stage_function = simulator->stages_[cycle].jit->function();
+
+    // The parameters of a stage function are named after the nodes (in this
+    // stage, or live into it) they stand for.
+    for (Param* param : stage_function->params()) {
+      arg_offsets[cycle].push_back(
+          available.at(nodes_by_name.at(param->name())));
+    }
+
+    // Find the values the stage function returns, in the order in which
+    // ExtractStage() gathers them.
+    std::vector<Node*> stage_live_out;
+    for (Node* node : TopoSort(function)) {
+      if (schedule.cycle(node) == cycle &&
+          std::any_of(node->users().begin(), node->users().end(),
+                      [&](Node* user) {
+                        return schedule.cycle(user) > cycle;
+                      })) {
+        stage_live_out.push_back(node);
+      }
+    }
+    Type* result_type = stage_function->return_value()->GetType();
+    result_offsets[cycle] = allocate(result_type);
+    absl::flat_hash_map<Node*, int64> stage_values = available;
+    if (schedule.cycle(return_value) == cycle) {
+      // The stage function returns just the return value in this case.
+      if (std::any_of(stage_live_out.begin(), stage_live_out.end(),
+                      [&](Node* node) { return node != return_value; })) {
+        return absl::UnimplementedError(absl::StrFormat(
+            "Return value %s is scheduled in cycle %d, before other values "
+            "computed in that cycle are used",
+            return_value->GetName(), cycle));
+      }
+      stage_values[return_value] = result_offsets[cycle];
+    } else {
+      XLS_RET_CHECK(result_type->IsTuple());
+      TupleType* tuple_type = result_type->AsTupleOrDie();
+      XLS_RET_CHECK_EQ(tuple_type->size(), stage_live_out.size());
+      for (int64 i = 0; i < stage_live_out.size(); ++i) {
+        stage_values[stage_live_out[i]] =
+            result_offsets[cycle] +
+            converter->GetTupleElementByteOffset(*tuple_type, i);
+      }
+    }
+
+    if (cycle == schedule.length() - 1 && !options.flop_outputs()) {
+      available = std::move(stage_values);
+      break;
+    }
+    std::vector<Node*> registered;
+    for (Node* node : TopoSort(function)) {
+      if (schedule.cycle(node) <= cycle &&
+          IsLiveOutOfCycle(node, cycle, schedule)) {
+        registered.push_back(node);
+      }
+    }
+    add_registers(registered, stage_values);
+  }
+  simulator->output_layout_ =
+      converter->CreateTypeLayout(*return_value->GetType());
+  simulator->output_offset_ = available.at(return_value);
+
+  simulator->buffer_.resize(buffer_size);
+  uint8* base = simulator->buffer_.data();
+  XLS_RET_CHECK_EQ(reinterpret_cast<uintptr_t>(base) % kValueAlignment, 0);
+  for (int64 cycle = 0; cycle < schedule.length(); ++cycle) {
+    Stage& stage = simulator->stages_[cycle];
+    for (int64 offset : arg_offsets[cycle]) {
+      stage.args.push_back(base + offset);
+    }
+    stage.result = absl::MakeSpan(base + result_offsets[cycle],
+                                  stage.jit->GetReturnTypeSize());
+  }
+  simulator->valid_.resize(simulator->latency(), false);
+  return simulator;
+}
+
+xabsl::StatusOr<PipelineSimulator::CycleOutputs> PipelineSimulator::Cycle(
+    const CycleInputs& inputs) {
+  return RunCycle(inputs.args, inputs.valid, inputs.load_enable, inputs.reset);
+}
+
+absl::Status PipelineSimulator::Reset() {
+  if (!reset_.has_value()) {
+    return absl::InvalidArgumentError("Pipeline has no reset.");
+  }
+  return RunCycle(zero_args_, /*valid=*/false,
+                  /*load_enable=*/Bits(latency()), /*reset=*/true)
+      .status();
+}
+
+xabsl::StatusOr<PipelineSimulator::CycleOutputs> PipelineSimulator::RunCycle(
+    absl::Span<const Value> args, bool valid, const Bits& load_enable,
+    bool reset) {
+  if (args.size() != input_layouts_.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Expected %d arguments, got %d", input_layouts_.size(),
+                        args.size()));
+  }
+  for (int64 i = 0; i < args.size(); ++i) {
+    if (!ValueConformsToType(args[i], function_->param(i)->GetType())) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Argument %d (%s) is not of type %s", i, args[i].ToString(),
+          function_->param(i)->GetType()->ToString()));
+    }
+  }
+  if (manual_control_ && load_enable.bit_count() != latency()) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Expected %d load enable bits, got %d", latency(),
+        load_enable.bit_count()));
+  }
+  if (reset && !reset_.has_value()) {
+    return absl::InvalidArgumentError("Pipeline has no reset.");
+  }
+
+  uint8* base = buffer_.data();
+  for (int64 i = 0; i < args.size(); ++i) {
+    input_layouts_[i].ValueToNativeLayout(args[i], base + input_offsets_[i]);
+  }
+  if (reset && reset_->asynchronous()) {
+    std::fill(valid_.begin(), valid_.end(), false);
+  }
+
+  // Evaluate the combinational logic. Every stage reads only input ports and
+  // pipeline registers, so the stages are independent of each other.
+  for (Stage& stage : stages_) {
+    XLS_RETURN_IF_ERROR(
+        stage.jit->RunWithViews(absl::MakeSpan(stage.args), stage.result));
+  }
+  CycleOutputs outputs;
+  XLS_ASSIGN_OR_RETURN(
+      outputs.out, output_layout_->NativeLayoutToValue(base + output_offset_));
+  outputs.valid =
+      !valid_control_ || (valid_.empty() ? valid : valid_.back());
+
+  // Clock the registers. Going backwards through the pipeline, every set of
+  // registers is loaded before the set preceding it, whose current contents
+  // (and valid bit) it may read.
+  for (int64 i = latency() - 1; i >= 0; --i) {
+    bool previous_valid = i == 0 ? valid : valid_[i - 1];
+    bool load = true;
+    if (valid_control_) {
+      load = previous_valid;
+    } else if (manual_control_) {
+      load = load_enable.Get(i);
+    }
+    if (load) {
+      for (const Copy& copy : register_loads_[i]) {
+        std::memcpy(base + copy.destination, base + copy.source, copy.size);
+      }
+    }
+    if (valid_control_) {
+      valid_[i] = !reset && previous_valid;
+    }
+  }
+  return outputs;
+}
+
+xabsl::StatusOr<std::vector<Value>> PipelineSimulator::RunBatched(
+    absl::Span<const std::vector<Value>> arg_sets) {
+  if (reset_.has_value()) {
+    XLS_RETURN_IF_ERROR(Reset());
+  }
+  Bits load_enable = Bits::AllOnes(latency());
+  std::vector<Value> results;
+  results.reserve(arg_sets.size());
+  for (int64 cycle = 0; cycle < arg_sets.size() + latency(); ++cycle) {
+    bool flushing = cycle >= arg_sets.size();
+    XLS_ASSIGN_OR_RETURN(
+        CycleOutputs outputs,
+        RunCycle(flushing ? zero_args_ : arg_sets[cycle], /*valid=*/!flushing,
+                 load_enable, /*reset=*/false));
+    if (cycle >= latency()) {
+      XLS_RET_CHECK(outputs.valid);
+      results.push_back(std::move(outputs.out));
+    }
+  }
+  return results;
+}
+
+}  // namespace verilog
+}  // namespace xls
@@ -0,0 +1,159 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_SIMULATION_PIPELINE_SIMULATOR_H_
+#define XLS_SIMULATION_PIPELINE_SIMULATOR_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "xls/codegen/pipeline_generator.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/statusor.h"
+#include "xls/ir/bits.h"
+#include "xls/ir/function.h"
+#include "xls/ir/llvm_ir_jit.h"
+#include "xls/ir/llvm_type_layout.h"
+#include "xls/ir/package.h"
+#include "xls/ir/value.h"
+#include "xls/scheduling/pipeline_schedule.h"
+
+namespace xls {
+namespace verilog {
+
+// Cycle-accurate simulator of the pipelined module which ToPipelineModuleText()
+// generates for a function, schedule and set of options.
+//
+// Instead of emitting Verilog and running it under a Verilog simulator, each
+// pipeline stage is extracted into its own function (see ExtractStage()) and
+// compiled with the LLVM JIT. All pipeline registers live in a single flat
+// buffer in the JIT's native layout, which the stage functions read their
+// operands from directly, so a cycle costs one call per stage plus a copy of
+// each loaded register.
+//
+// The simulated module differs from the generated one only in that registers
+// which have never been loaded (or reset) hold zero rather than X.
+class PipelineSimulator {
+ public:
+  // The values of the module's input ports during one cycle.
+  struct CycleInputs {
+    // The function arguments, in parameter order.
+    std::vector<Value> args;
+
+    // The valid input; only used with valid pipeline control.
+    bool valid = true;
+
+    // The register load enables, bit i controlling the i-th set of pipeline
+    // registers; only used with manual pipeline control.
+    Bits load_enable;
+
+    // Whether reset is asserted (regardless of the polarity of the signal).
+    bool reset = false;
+  };
+
+  // The values of the module's output ports during one cycle.
+  struct CycleOutputs {
+    Value out;
+
+    // The valid output; always true without valid pipeline control.
+    bool valid;
+  };
+
+  // Creates a simulator for the given function and schedule.
+  static xabsl::StatusOr<std::unique_ptr<PipelineSimulator>> Create(
+      Function* function, const PipelineSchedule& schedule,
+      const PipelineOptions& options = PipelineOptions());
+
+  // The number of cycles between inputs being applied and the corresponding
+  // output appearing, as in the signature of the generated module.
+  int64 latency() const { return register_loads_.size(); }
+
+  // Simulates one clock cycle: applies the given inputs, returns the outputs
+  // as sampled just before the rising edge of the clock, and then clocks the
+  // registers.
+  xabsl::StatusOr<CycleOutputs> Cycle(const CycleInputs& inputs);
+
+  // Simulates one cycle with reset asserted and all inputs zero. Returns an
+  // error if the module has no reset.
+  absl::Status Reset();
+
+  // Applies one set of arguments per cycle (asserting valid or all load
+  // enables, as appropriate) and runs until the last result emerges. Returns
+  // the results in order. As ModuleSimulator::RunBatched(), resets the module
+  // first if it has a reset.
+  xabsl::StatusOr<std::vector<Value>> RunBatched(
+      absl::Span<const std::vector<Value>> arg_sets);
+
+ private:
+  // A copy of "size" bytes between two offsets in buffer_.
+  struct Copy {
+    int64 destination;
+    int64 source;
+    int64 size;
+  };
+
+  struct Stage {
+    std::unique_ptr<LlvmIrJit> jit;
+
+    // The arguments and result of the stage function, pointing into buffer_.
+    std::vector<const uint8*> args;
+    absl::Span<uint8> result;
+  };
+
+  PipelineSimulator(std::unique_ptr<Package> package, Function* function,
+                    const PipelineOptions& options);
+
+  // Implementation of Cycle(), taking the fields of CycleInputs separately
+  // so callers need not copy the arguments.
+  xabsl::StatusOr<CycleOutputs> RunCycle(absl::Span<const Value> args,
+                                         bool valid, const Bits& load_enable,
+                                         bool reset);
+
+  // A copy of the package of the simulated function, which also holds the
+  // functions of the individual stages.
+  std::unique_ptr<Package> package_;
+  Function* function_;
+  bool valid_control_;
+  bool manual_control_;
+  absl::optional<ResetProto> reset_;
+
+  // Holds the input ports, the results of the stage functions and the pipeline
+  // registers.
+  std::vector<uint8> buffer_;
+
+  // All-zero arguments, applied while flushing the pipeline.
+  std::vector<Value> zero_args_;
+
+  std::vector<LlvmTypeLayout> input_layouts_;
+  std::vector<int64> input_offsets_;
+  absl::optional<LlvmTypeLayout> output_layout_;
+  int64 output_offset_;
+
+  std::vector<Stage> stages_;
+
+  // The copies performed when each set of pipeline registers is loaded, in
+  // pipeline order.
+  std::vector<std::vector<Copy>> register_loads_;
+
+  // The valid registers accompanying each set of pipeline registers; only used
+  // with valid pipeline control.
+  std::vector<bool> valid_;
+};
+
+}  // namespace verilog
+}  // namespace xls
+
+#endif  // XLS_SIMULATION_PIPELINE_SIMULATOR_H_
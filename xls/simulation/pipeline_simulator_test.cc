@@ -0,0 +1,294 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/simulation/pipeline_simulator.h"
+
+#include <random>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "xls/common/status/matchers.h"
+#include "xls/delay_model/delay_estimator.h"
+#include "xls/ir/function_builder.h"
+#include "xls/ir/ir_interpreter.h"
+#include "xls/ir/ir_test_base.h"
+#include "xls/ir/package.h"
+#include "xls/ir/value_helpers.h"
+
+namespace xls {
+namespace verilog {
+namespace {
+
+using status_testing::StatusIs;
+
+class TestDelayEstimator : public DelayEstimator {
+ public:
+  xabsl::StatusOr<int64> GetOperationDelayInPs(Node* node) const override {
+    switch (node->op()) {
+      case Op::kParam:
+      case Op::kLiteral:
+      case Op::kBitSlice:
+      case Op::kConcat:
+        return 0;
+      default:
+        return 1;
+    }
+  }
+};
+
+class PipelineSimulatorTest : public IrTestBase {
+ protected:
+  // Builds a function computing (x * y + z) ^ (x - z), in which x and z are
+  // needed across several stages.
+  xabsl::StatusOr<Function*> BuildFunction(Package* package) {
+    FunctionBuilder fb(TestName(), package);
+    Type* u32 = package->GetBitsType(32);
+    BValue x = fb.Param("x", u32);
+    BValue y = fb.Param("y", u32);
+    BValue z = fb.Param("z", u32);
+    BValue sum = fb.Add(fb.UMul(x, y), z);
+    fb.Xor(sum, fb.Subtract(x, z));
+    return fb.Build();
+  }
+
+  Value U32(int64 value) { return Value(UBits(value, 32)); }
+
+  // Returns the result of the function built by BuildFunction().
+  Value Expected(uint32 x, uint32 y, uint32 z) {
+    return U32((x * y + z) ^ (x - z));
+  }
+};
+
+TEST_F(PipelineSimulatorTest, TrivialFunction) {
+  auto package = CreatePackage();
+  FunctionBuilder fb(TestName(), package.get());
+  fb.Param("x", package->GetBitsType(8));
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, fb.Build());
+  XLS_ASSERT_OK_AND_ASSIGN(
+      PipelineSchedule schedule,
+      PipelineSchedule::Run(func, TestDelayEstimator(),
+                            SchedulingOptions().clock_period_ps(1)));
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto simulator,
+                           PipelineSimulator::Create(func, schedule));
+  EXPECT_EQ(simulator->latency(), 2);
+  std::vector<std::vector<Value>> args = {{Value(UBits(1, 8))},
+                                          {Value(UBits(42, 8))},
+                                          {Value(UBits(255, 8))}};
+  EXPECT_THAT(simulator->RunBatched(args),
+              status_testing::IsOkAndHolds(
+                  std::vector<Value>{args[0][0], args[1][0], args[2][0]}));
+}
+
+TEST_F(PipelineSimulatorTest, MatchesInterpreter) {
+  auto package = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, BuildFunction(package.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      PipelineSchedule schedule,
+      PipelineSchedule::Run(func, TestDelayEstimator(),
+                            SchedulingOptions().pipeline_stages(3)));
+
+  std::minstd_rand rng_engine;
+  std::vector<std::vector<Value>> arg_sets;
+  std::vector<Value> expected;
+  for (int64 i = 0; i < 100; ++i) {
+    arg_sets.push_back(RandomFunctionArguments(func, &rng_engine));
+    XLS_ASSERT_OK_AND_ASSIGN(Value result,
+                             ir_interpreter::Run(func, arg_sets.back()));
+    expected.push_back(result);
+  }
+
+  for (bool flop_inputs : {false, true}) {
+    for (bool flop_outputs : {false, true}) {
+      XLS_ASSERT_OK_AND_ASSIGN(
+          auto simulator,
+          PipelineSimulator::Create(func, schedule,
+                                    PipelineOptions()
+                                        .flop_inputs(flop_inputs)
+                                        .flop_outputs(flop_outputs)));
+      EXPECT_EQ(simulator->latency(),
+                schedule.length() - 1 + flop_inputs + flop_outputs);
+      EXPECT_THAT(simulator->RunBatched(arg_sets),
+                  status_testing::IsOkAndHolds(expected));
+    }
+  }
+}
+
+TEST_F(PipelineSimulatorTest, ValuePassedThroughStages) {
+  auto package = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, ParseFunction(R"(
+fn f(x: bits[8], y: bits[8]) -> (bits[8], bits[8]) {
+  add.1: bits[8] = add(x, y)
+  neg.2: bits[8] = neg(add.1)
+  not.3: bits[8] = not(neg.2)
+  sub.4: bits[8] = sub(not.3, x)
+  ret tuple.5: (bits[8], bits[8]) = tuple(sub.4, y)
+}
+)",
+                                                          package.get()));
+  ScheduleCycleMap cycle_map;
+  for (Node* node : func->nodes()) {
+    cycle_map[node] = 0;
+  }
+  cycle_map[FindNode("neg.2", func)] = 1;
+  cycle_map[FindNode("not.3", func)] = 2;
+  cycle_map[FindNode("sub.4", func)] = 3;
+  cycle_map[FindNode("tuple.5", func)] = 3;
+  PipelineSchedule schedule(func, cycle_map, 4);
+
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto simulator,
+      PipelineSimulator::Create(func, schedule,
+                                PipelineOptions().flop_inputs(false)));
+  EXPECT_EQ(simulator->latency(), 4);
+
+  // Each result appears exactly "latency" cycles after its inputs.
+  for (int64 cycle = 0; cycle < 10; ++cycle) {
+    PipelineSimulator::CycleInputs inputs;
+    inputs.args = {Value(UBits(cycle, 8)), Value(UBits(2 * cycle + 1, 8))};
+    XLS_ASSERT_OK_AND_ASSIGN(PipelineSimulator::CycleOutputs outputs,
+                             simulator->Cycle(inputs));
+    if (cycle >= 4) {
+      int64 x = cycle - 4;
+      int64 y = 2 * x + 1;
+      uint8 expected_sub = static_cast<uint8>(~(-(x + y)) - x);
+      EXPECT_EQ(outputs.out, Value::Tuple({Value(UBits(expected_sub, 8)),
+                                           Value(UBits(y, 8))}));
+    }
+    EXPECT_TRUE(outputs.valid);
+  }
+}
+
+TEST_F(PipelineSimulatorTest, ValidControlWithReset) {
+  auto package = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, BuildFunction(package.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      PipelineSchedule schedule,
+      PipelineSchedule::Run(func, TestDelayEstimator(),
+                            SchedulingOptions().pipeline_stages(3)));
+  ResetProto reset;
+  reset.set_name("rst");
+  reset.set_asynchronous(false);
+  reset.set_active_low(false);
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto simulator,
+      PipelineSimulator::Create(func, schedule,
+                                PipelineOptions()
+                                    .valid_control("in_valid", "out_valid")
+                                    .reset(reset)));
+  ASSERT_EQ(simulator->latency(), 4);
+  XLS_ASSERT_OK(simulator->Reset());
+
+  // Inject inputs in cycles 0, 1 and 3 only.
+  std::vector<bool> valid_in = {true, true, false, true, false, false,
+                                false, false, false};
+  std::vector<bool> valid_out;
+  std::vector<Value> results;
+  for (int64 cycle = 0; cycle < valid_in.size(); ++cycle) {
+    PipelineSimulator::CycleInputs inputs;
+    inputs.args = {U32(cycle), U32(3), U32(1)};
+    inputs.valid = valid_in[cycle];
+    XLS_ASSERT_OK_AND_ASSIGN(PipelineSimulator::CycleOutputs outputs,
+                             simulator->Cycle(inputs));
+    valid_out.push_back(outputs.valid);
+    if (outputs.valid) {
+      results.push_back(outputs.out);
+    }
+  }
+  EXPECT_THAT(valid_out, ::testing::ElementsAre(false, false, false, false,
+                                                true, true, false, true,
+                                                false));
+  EXPECT_THAT(results,
+              ::testing::ElementsAre(Expected(0, 3, 1), Expected(1, 3, 1),
+                                     Expected(3, 3, 1)));
+
+  // Resetting clears the valid bits of values in flight.
+  PipelineSimulator::CycleInputs inputs;
+  inputs.args = {U32(0), U32(0), U32(0)};
+  XLS_ASSERT_OK(simulator->Cycle(inputs).status());
+  XLS_ASSERT_OK(simulator->Reset());
+  inputs.valid = false;
+  for (int64 cycle = 0; cycle < 4; ++cycle) {
+    XLS_ASSERT_OK_AND_ASSIGN(PipelineSimulator::CycleOutputs outputs,
+                             simulator->Cycle(inputs));
+    EXPECT_FALSE(outputs.valid);
+  }
+}
+
+TEST_F(PipelineSimulatorTest, ManualControl) {
+  auto package = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, BuildFunction(package.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      PipelineSchedule schedule,
+      PipelineSchedule::Run(func, TestDelayEstimator(),
+                            SchedulingOptions().pipeline_stages(2)));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      auto simulator,
+      PipelineSimulator::Create(func, schedule,
+                                PipelineOptions().manual_control("load_en")));
+  ASSERT_EQ(simulator->latency(), 3);
+
+  // Load the first two register sets only; the output registers keep their
+  // (initially zero) contents.
+  PipelineSimulator::CycleInputs inputs;
+  inputs.args = {U32(2), U32(5), U32(7)};
+  inputs.load_enable = UBits(0b011, 3);
+  for (int64 cycle = 0; cycle < 4; ++cycle) {
+    XLS_ASSERT_OK_AND_ASSIGN(PipelineSimulator::CycleOutputs outputs,
+                             simulator->Cycle(inputs));
+    EXPECT_EQ(outputs.out, U32(0));
+  }
+  inputs.load_enable = UBits(0b100, 3);
+  XLS_ASSERT_OK(simulator->Cycle(inputs).status());
+  XLS_ASSERT_OK_AND_ASSIGN(PipelineSimulator::CycleOutputs outputs,
+                           simulator->Cycle(inputs));
+  EXPECT_EQ(outputs.out, Expected(2, 5, 7));
+
+  inputs.load_enable = UBits(0, 2);
+  EXPECT_THAT(simulator->Cycle(inputs),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(PipelineSimulatorTest, Errors) {
+  auto package = CreatePackage();
+  XLS_ASSERT_OK_AND_ASSIGN(Function * func, BuildFunction(package.get()));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      PipelineSchedule schedule,
+      PipelineSchedule::Run(func, TestDelayEstimator(),
+                            SchedulingOptions().pipeline_stages(2)));
+
+  ResetProto reset;
+  reset.set_name("rst");
+  reset.set_reset_data_path(true);
+  EXPECT_THAT(
+      PipelineSimulator::Create(func, schedule, PipelineOptions().reset(reset))
+          .status(),
+      StatusIs(absl::StatusCode::kUnimplemented));
+
+  XLS_ASSERT_OK_AND_ASSIGN(auto simulator,
+                           PipelineSimulator::Create(func, schedule));
+  EXPECT_THAT(simulator->Reset(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  PipelineSimulator::CycleInputs inputs;
+  inputs.args = {U32(1), U32(2)};
+  EXPECT_THAT(simulator->Cycle(inputs),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  inputs.args = {U32(1), U32(2), Value(UBits(3, 8))};
+  EXPECT_THAT(simulator->Cycle(inputs),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace verilog
+}  // namespace xls
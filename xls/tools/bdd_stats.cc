@@ -103,9 +103,19 @@ absl::Status RealMain(absl::string_view input_path) {
     absl::Duration bdd_time = absl::Now() - start;
     total_time += bdd_time;
     std::cout << "BDD construction time: " << bdd_time << "\n";
-    std::cout << "BDD node count: " << bdd_function->bdd().size() << "\n";
-    std::cout << "BDD variable count: " << bdd_function->bdd().variable_count()
+    int64 node_count = 0;
+    int64 variable_count = 0;
+    int64 memory_usage = 0;
+    for (int64 i = 0; i < bdd_function->partition_count(); ++i) {
+      node_count += bdd_function->bdd(i).size();
+      variable_count += bdd_function->bdd(i).variable_count();
+      memory_usage += bdd_function->bdd(i).memory_usage();
+    }
+    std::cout << "BDD partition count: " << bdd_function->partition_count()
               << "\n";
+    std::cout << "BDD node count: " << node_count << "\n";
+    std::cout << "BDD variable count: " << variable_count << "\n";
+    std::cout << "BDD memory usage: " << memory_usage << " bytes\n";
 
     int64 number_bits = 0;
     for (Node* node : entry->nodes()) {
@@ -114,9 +124,16 @@ absl::Status RealMain(absl::string_view input_path) {
     std::cout << "Bits in graph: " << number_bits << "\n";
 
     int64 max_minterms = 0;
-    for (int64 i = 0; i < bdd_function->bdd().size(); ++i) {
-      max_minterms = std::max(
-          max_minterms, bdd_function->bdd().minterm_count(BddNodeIndex(i)));
+    for (Node* node : entry->nodes()) {
+      if (!node->GetType()->IsBits()) {
+        continue;
+      }
+      const BinaryDecisionDiagram& bdd =
+          bdd_function->bdd(bdd_function->GetPartition(node));
+      for (int64 i = 0; i < node->BitCountOrDie(); ++i) {
+        max_minterms = std::max(
+            max_minterms, bdd.minterm_count(bdd_function->GetBddNode(node, i)));
+      }
     }
     if (max_minterms == std::numeric_limits<int32>::max()) {
       std::cout << "Maximum minterms of any expression: INT32_MAX\n";
@@ -32,6 +32,7 @@
 #include "xls/ir/ir_parser.h"
 #include "xls/ir/node_iterator.h"
 #include "xls/passes/bdd_query_engine.h"
+#include "xls/passes/pass_profile.h"
 #include "xls/passes/passes.h"
 #include "xls/passes/standard_pipeline.h"
 #include "xls/scheduling/pipeline_schedule.h"
@@ -62,6 +63,14 @@ ABSL_FLAG(std::string, entry, "",
           "Entry function to use in lieu of the default.");
 ABSL_FLAG(std::string, delay_model, "",
           "Delay model name to use from registry.");
+ABSL_FLAG(int64, opt_level, xls::kMaxOptLevel,
+          "Optimization level from 0 to 3 at which to run the pipeline.");
+ABSL_FLAG(std::string, pass_trace_path, "",
+          "If specified, profile the passes and write the profile to this "
+          "path in the Chrome trace event format (see chrome://tracing).");
+ABSL_FLAG(std::string, pass_folded_stacks_path, "",
+          "If specified, profile the passes and write their run times to "
+          "this path as folded stacks for flame graph tools.");
 
 namespace xls {
 namespace {
@@ -97,12 +106,19 @@ void PrintNodeBreakdown(Function* f) {
 // Run the standard pipeline on the given package and prints stats about the
 // passes and execution time.
 absl::Status RunOptimizationAndPrintStats(Package* package) {
-  std::unique_ptr<CompoundPass> pipeline = CreateStandardPassPipeline();
+  int64 opt_level = absl::GetFlag(FLAGS_opt_level);
+  std::unique_ptr<CompoundPass> pipeline =
+      CreateStandardPassPipeline(opt_level);
+
+  std::string trace_path = absl::GetFlag(FLAGS_pass_trace_path);
+  std::string folded_stacks_path = absl::GetFlag(FLAGS_pass_folded_stacks_path);
+  PassOptions options;
+  options.opt_level = opt_level;
+  options.profile_passes = !trace_path.empty() || !folded_stacks_path.empty();
 
   absl::Time start = absl::Now();
   PassResults pass_results;
-  XLS_RETURN_IF_ERROR(
-      pipeline->Run(package, PassOptions(), &pass_results).status());
+  XLS_RETURN_IF_ERROR(pipeline->Run(package, options, &pass_results).status());
   absl::Duration total_time = absl::Now() - start;
   auto to_ms = [](absl::Duration d) { return d / absl::Milliseconds(1); };
   std::cout << absl::StreamFormat("Optimization time: %dms\n",
@@ -115,10 +131,16 @@ absl::Status RunOptimizationAndPrintStats(Package* package) {
   absl::flat_hash_map<std::string, absl::Duration> pass_times;
   absl::flat_hash_map<std::string, int64> pass_counts;
   absl::flat_hash_map<std::string, int64> changed_counts;
+  absl::flat_hash_map<std::string, absl::Duration> query_engine_times;
+  absl::flat_hash_map<std::string, int64> node_deltas;
   for (const PassInvocation& invocation : pass_results.invocations) {
     pass_times[invocation.pass_name] += invocation.run_duration;
     ++pass_counts[invocation.pass_name];
     changed_counts[invocation.pass_name] += invocation.ir_changed ? 1 : 0;
+    query_engine_times[invocation.pass_name] +=
+        invocation.query_engine_duration;
+    node_deltas[invocation.pass_name] +=
+        invocation.node_count_after - invocation.node_count_before;
   }
   std::vector<std::string> pass_names;
   for (const auto& pair : pass_times) {
@@ -133,8 +155,24 @@ absl::Status RunOptimizationAndPrintStats(Package* package) {
             << std::endl;
   for (const std::string& name : pass_names) {
     std::cout << absl::StreamFormat(
-        "  %-20s : %-5dms (%3d / %3d)\n", name, to_ms(pass_times.at(name)),
+        "  %-20s : %-5dms (%3d / %3d)", name, to_ms(pass_times.at(name)),
         changed_counts.at(name), pass_counts.at(name));
+    if (options.profile_passes) {
+      std::cout << absl::StreamFormat(
+          "  query engines: %-5dms  nodes: %+d",
+          to_ms(query_engine_times.at(name)), node_deltas.at(name));
+    }
+    std::cout << std::endl;
+  }
+
+  if (!trace_path.empty()) {
+    XLS_RETURN_IF_ERROR(SetFileContents(
+        trace_path, PassInvocationsToChromeTrace(pass_results.invocations)));
+  }
+  if (!folded_stacks_path.empty()) {
+    XLS_RETURN_IF_ERROR(SetFileContents(
+        folded_stacks_path,
+        PassInvocationsToFoldedStacks(pass_results.invocations)));
   }
   return absl::OkStatus();
 }
@@ -267,22 +305,25 @@ absl::Status PrintCodegenInfo(Function* f, const PipelineSchedule& schedule,
   std::vector<int64> flops_per_stage(schedule.length() + 1);
   std::vector<int64> duplicates_per_stage(schedule.length() + 1);
   std::vector<int64> constants_per_stage(schedule.length() + 1);
+  const BddFunction& bdd_function = bdd_query_engine.bdd_function();
   for (int64 i = 0; i <= schedule.length(); ++i) {
-    absl::flat_hash_map<BddNodeIndex, std::pair<Node*, int64>> bdd_nodes;
+    // BDD nodes are identified by their partition and their index in it.
+    absl::flat_hash_map<std::pair<int64, BddNodeIndex>, std::pair<Node*, int64>>
+        bdd_nodes;
     for (Node* node : schedule.GetLiveOutOfCycle(i)) {
       flops_per_stage[i] += node->GetType()->GetFlatBitCount();
       if (node->GetType()->IsBits()) {
+        const BinaryDecisionDiagram& bdd =
+            bdd_function.bdd(bdd_function.GetPartition(node));
         for (int64 bit_index = 0; bit_index < node->BitCountOrDie();
              ++bit_index) {
-          BddNodeIndex bdd_node =
-              bdd_query_engine.bdd_function().GetBddNode(node, bit_index);
-          if (bdd_node == bdd_query_engine.bdd_function().bdd().zero() ||
-              bdd_node == bdd_query_engine.bdd_function().bdd().one()) {
+          std::pair<int64, BddNodeIndex> bdd_node = {
+              bdd_function.GetPartition(node),
+              bdd_function.GetBddNode(node, bit_index)};
+          if (bdd_node.second == bdd.zero() || bdd_node.second == bdd.one()) {
             XLS_VLOG(1) << absl::StreamFormat(
                 "%s:%d in stage %d is known %s", node->GetName(), bit_index, i,
-                bdd_node == bdd_query_engine.bdd_function().bdd().zero()
-                    ? "zero"
-                    : "one");
+                bdd_node.second == bdd.zero() ? "zero" : "one");
             constants_per_stage[i]++;
             total_constants++;
           } else if (bdd_nodes.contains(bdd_node)) {
@@ -32,6 +32,8 @@
 #include "xls/ir/value_helpers.h"
 #include "xls/passes/passes.h"
 #include "xls/passes/standard_pipeline.h"
+#include "xls/passes/value_profile.h"
+#include "xls/passes/value_profile.pb.h"
 
 const char kUsage[] = R"(
 Evaluates an IR file with user-specified or random inputs using the IR
@@ -65,6 +67,10 @@ Evaluate IR after every optimization pass:
 
 Evaluate IR using the JIT and with the interpreter and compare the results:
   eval_ir_main --test_llvm_jit --random_inputs=100  IR_FILE
+
+Record a value profile of a trace of inputs for profile-guided optimization
+(see opt_main --value_profile):
+  eval_ir_main --input_file=INPUT_FILE --value_profile_output=PROFILE IR_FILE
 )";
 
 ABSL_FLAG(std::string, entry, "", "Entry function name to evaluate.");
@@ -101,6 +107,15 @@ ABSL_FLAG(bool, test_llvm_jit, false,
 ABSL_FLAG(int64, llvm_opt_level, 3,
           "The optimization level of the LLVM JIT. Valid values are from 0 (no "
           "optimizations) to 3 (maximum optimizations).");
+ABSL_FLAG(bool, llvm_jit_profile, false,
+          "If true, instrument the LLVM JIT-compiled code with node-level "
+          "counters and print a profile report to stderr after evaluation.");
+
+ABSL_FLAG(std::string, value_profile_output, "",
+          "If specified, evaluate the inputs with the interpreter, recording "
+          "the most frequent values of each parameter and the bits of each "
+          "node which are the same for every input, and write the profile to "
+          "this path as a ValueProfileProto text proto.");
 
 ABSL_FLAG(
     std::string, test_only_inject_jit_result, "",
@@ -133,17 +148,34 @@ xabsl::StatusOr<std::vector<Value>> Eval(
     absl::string_view actual_src = "actual",
     absl::string_view expected_src = "expected") {
   std::unique_ptr<LlvmIrJit> jit;
+  // When using the JIT, all results are computed up front in a single batch.
+  std::vector<Value> jit_results;
   if (use_jit) {
     XLS_ASSIGN_OR_RETURN(
-        jit, LlvmIrJit::Create(f, absl::GetFlag(FLAGS_llvm_opt_level)));
+        jit, LlvmIrJit::Create(f, absl::GetFlag(FLAGS_llvm_opt_level),
+                               absl::GetFlag(FLAGS_llvm_jit_profile)));
+    if (absl::GetFlag(FLAGS_test_only_inject_jit_result).empty()) {
+      std::vector<std::vector<Value>> args;
+      args.reserve(arg_sets.size());
+      for (const ArgSet& arg_set : arg_sets) {
+        args.push_back(arg_set.args);
+      }
+      XLS_ASSIGN_OR_RETURN(jit_results, jit->RunBatched(args));
+      // The profile is only meaningful if the JIT actually produced the
+      // results.
+      if (jit->profile() != nullptr) {
+        std::cerr << jit->profile()->ToReport();
+      }
+    }
   }
 
   std::vector<Value> results;
-  for (const ArgSet& arg_set : arg_sets) {
+  for (int64 i = 0; i < arg_sets.size(); ++i) {
+    const ArgSet& arg_set = arg_sets[i];
     Value result;
     if (use_jit) {
       if (absl::GetFlag(FLAGS_test_only_inject_jit_result).empty()) {
-        XLS_ASSIGN_OR_RETURN(result, jit->Run(arg_set.args));
+        result = jit_results[i];
       } else {
         XLS_ASSIGN_OR_RETURN(result, Parser::ParseTypedValue(absl::GetFlag(
                                          FLAGS_test_only_inject_jit_result)));
@@ -226,6 +258,17 @@ absl::Status Run(Package* package, absl::Span<const ArgSet> arg_sets_in) {
     }
   }
 
+  if (!absl::GetFlag(FLAGS_value_profile_output).empty()) {
+    ValueProfiler profiler(f);
+    for (const ArgSet& arg_set : arg_sets) {
+      XLS_RETURN_IF_ERROR(profiler.Run(arg_set.args).status());
+    }
+    ValueProfileProto profile;
+    *profile.add_functions() = profiler.ToProto();
+    XLS_RETURN_IF_ERROR(
+        SetTextProtoFile(absl::GetFlag(FLAGS_value_profile_output), profile));
+  }
+
   // Run optimizations (optionally) and check the results against expectations
   // (either expected result passed in on the command line or the result
   // produced without optimizations).
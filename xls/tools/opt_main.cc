@@ -16,13 +16,20 @@
 // standard optimization pipeline.
 
 #include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "absl/strings/str_format.h"
 #include "xls/common/file/filesystem.h"
+#include "xls/common/fingerprint.h"
 #include "xls/common/init_xls.h"
 #include "xls/common/logging/logging.h"
 #include "xls/common/status/status_macros.h"
 #include "xls/ir/ir_parser.h"
 #include "xls/ir/package.h"
+#include "xls/passes/opt_cache_pass.h"
+#include "xls/passes/pass_profile.h"
+#include "xls/passes/profile_guided_specialization_pass.h"
 #include "xls/passes/standard_pipeline.h"
+#include "xls/passes/value_profile.pb.h"
 
 ABSL_FLAG(std::string, entry, "", "Entry function name to optimize.");
 ABSL_FLAG(std::string, ir_dump_path, "",
@@ -35,10 +42,51 @@ ABSL_FLAG(std::vector<std::string>, skip_passes, {},
           "pass names are skipped. If both --run_only_passes and --skip_passes "
           "are specified only passes which are present in --run_only_passes "
           "and not present in --skip_passes will be run.");
+ABSL_FLAG(int64, num_threads, 0,
+          "Number of threads to use for optimizing functions concurrently. "
+          "Set to 0 to use one per CPU. The output does not depend on this.");
+ABSL_FLAG(int64, opt_level, xls::kMaxOptLevel,
+          "Optimization level from 0 (only lower the IR for code generation) "
+          "to 3 (the most expensive optimizations).");
+ABSL_FLAG(absl::Duration, opt_time_budget, absl::InfiniteDuration(),
+          "Wall-clock budget for optimization, e.g. \"30s\". When it runs out "
+          "the remaining optimizations are cut short; the output is correct "
+          "but less optimized.");
+ABSL_FLAG(int64, node_budget, 0,
+          "If non-zero, fail rather than unroll loops into functions with more "
+          "than this many nodes.");
+ABSL_FLAG(int64, unroll_node_limit, 0,
+          "If non-zero, loops whose unrolling would add more than this many "
+          "nodes are only partially unrolled, or left rolled if no more than "
+          "one iteration fits.");
+ABSL_FLAG(std::vector<std::string>, rolled_loop_bodies, {},
+          "Comma-separated list of the body functions of loops which are not "
+          "unrolled, e.g. because they are generated as sequential modules.");
+ABSL_FLAG(std::string, opt_cache_dir, "",
+          "If specified, cache optimized functions in this directory and "
+          "restore the functions which are unchanged since a previous run of "
+          "the same build of this tool with the same options.");
+ABSL_FLAG(std::string, pass_trace_path, "",
+          "If specified, profile the passes and write the profile to this "
+          "path in the Chrome trace event format (see chrome://tracing).");
+ABSL_FLAG(std::string, pass_folded_stacks_path, "",
+          "If specified, profile the passes and write their run times to "
+          "this path as folded stacks for flame graph tools.");
+ABSL_FLAG(std::string, value_profile, "",
+          "If specified, specialize the functions for the values they usually "
+          "compute according to this value profile (see eval_ir_main "
+          "--value_profile_output) before optimizing them.");
 
 namespace xls {
 namespace {
 
+// Returns a string identifying the build of this binary, so that cached
+// results from other builds are not used.
+xabsl::StatusOr<std::string> GetToolVersion() {
+  XLS_ASSIGN_OR_RETURN(std::string binary, GetFileContents("/proc/self/exe"));
+  return absl::StrFormat("%016x", FingerprintString(binary));
+}
+
 absl::Status RealMain(absl::string_view input_path) {
   if (input_path == "-") {
     input_path = "/dev/stdin";
@@ -52,8 +100,25 @@ absl::Status RealMain(absl::string_view input_path) {
                          Parser::ParsePackageWithEntry(
                              contents, absl::GetFlag(FLAGS_entry), input_path));
   }
-  std::unique_ptr<CompoundPass> pipeline = CreateStandardPassPipeline();
+  int64 opt_level = absl::GetFlag(FLAGS_opt_level);
+  std::unique_ptr<Pass> pipeline = CreateStandardPassPipeline(opt_level);
+  if (!absl::GetFlag(FLAGS_opt_cache_dir).empty()) {
+    XLS_ASSIGN_OR_RETURN(std::string tool_version, GetToolVersion());
+    pipeline = absl::make_unique<OptCachePass>(
+        std::move(pipeline), absl::GetFlag(FLAGS_opt_cache_dir), tool_version);
+  }
   PassOptions options;
+  options.opt_level = opt_level;
+  if (absl::GetFlag(FLAGS_opt_time_budget) != absl::InfiniteDuration()) {
+    options.deadline = absl::Now() + absl::GetFlag(FLAGS_opt_time_budget);
+  }
+  if (absl::GetFlag(FLAGS_node_budget) != 0) {
+    options.node_budget = absl::GetFlag(FLAGS_node_budget);
+  }
+  if (absl::GetFlag(FLAGS_unroll_node_limit) != 0) {
+    options.unroll_node_limit = absl::GetFlag(FLAGS_unroll_node_limit);
+  }
+  options.rolled_loop_bodies = absl::GetFlag(FLAGS_rolled_loop_bodies);
   options.ir_dump_path = absl::GetFlag(FLAGS_ir_dump_path);
   if (!absl::GetFlag(FLAGS_run_only_passes).empty()) {
     options.run_only_passes = absl::GetFlag(FLAGS_run_only_passes);
@@ -61,8 +126,55 @@ absl::Status RealMain(absl::string_view input_path) {
   if (!absl::GetFlag(FLAGS_skip_passes).empty()) {
     options.skip_passes = absl::GetFlag(FLAGS_skip_passes);
   }
+  options.num_threads = absl::GetFlag(FLAGS_num_threads);
+  std::string trace_path = absl::GetFlag(FLAGS_pass_trace_path);
+  std::string folded_stacks_path = absl::GetFlag(FLAGS_pass_folded_stacks_path);
+  options.profile_passes = !trace_path.empty() || !folded_stacks_path.empty();
   PassResults results;
+  if (!absl::GetFlag(FLAGS_value_profile).empty()) {
+    XLS_ASSIGN_OR_RETURN(ValueProfileProto profile,
+                         ParseTextProtoFile<ValueProfileProto>(
+                             absl::GetFlag(FLAGS_value_profile)));
+    ProfileGuidedSpecializationPass specialization_pass(std::move(profile));
+    XLS_RETURN_IF_ERROR(
+        specialization_pass.Run(package.get(), options, &results).status());
+    for (const ProfileSpecialization& specialization :
+         results.profile_specializations) {
+      XLS_LOG(INFO) << absl::StreamFormat(
+          "Specialized function %s for %s == %s (%.1f%% of samples): %d of %d "
+          "bits need no logic, expected gate savings %.1f",
+          specialization.function, specialization.node, specialization.value,
+          specialization.hit_fraction * 100, specialization.known_bit_count,
+          specialization.cone_bit_count,
+          specialization.expected_gate_savings());
+    }
+  }
   XLS_RETURN_IF_ERROR(pipeline->Run(package.get(), options, &results).status());
+  for (const UnrollDecision& decision : results.unroll_decisions) {
+    if (decision.kind != UnrollDecision::Kind::kFull) {
+      XLS_LOG(INFO) << absl::StreamFormat(
+          "Loop %s in function %s with %d iterations %s", decision.loop,
+          decision.function, decision.trip_count,
+          decision.kind == UnrollDecision::Kind::kRolled
+              ? "left rolled"
+              : absl::StrFormat("unrolled by %d", decision.factor));
+    }
+  }
+  if (!absl::GetFlag(FLAGS_opt_cache_dir).empty()) {
+    XLS_LOG(INFO) << absl::StreamFormat(
+        "Optimization cache: %d functions restored, %d optimized, %d stored",
+        results.opt_cache_stats.hits, results.opt_cache_stats.misses,
+        results.opt_cache_stats.stores);
+  }
+  if (!trace_path.empty()) {
+    XLS_RETURN_IF_ERROR(SetFileContents(
+        trace_path, PassInvocationsToChromeTrace(results.invocations)));
+  }
+  if (!folded_stacks_path.empty()) {
+    XLS_RETURN_IF_ERROR(SetFileContents(
+        folded_stacks_path,
+        PassInvocationsToFoldedStacks(results.invocations)));
+  }
   std::cout << package->DumpIr();
   return absl::OkStatus();
 }
@@ -79,6 +191,10 @@ int main(int argc, char **argv) {
                                           argv[0]);
   }
 
+  XLS_QCHECK(absl::GetFlag(FLAGS_opt_level) >= 0 &&
+             absl::GetFlag(FLAGS_opt_level) <= xls::kMaxOptLevel)
+      << "--opt_level must be between 0 and " << xls::kMaxOptLevel;
+
   XLS_QCHECK_OK(xls::RealMain(positional_arguments[0]));
   return EXIT_SUCCESS;
 }
@@ -15,49 +15,88 @@
 #ifndef XLS_TOOLS_TESTBENCH_H_
 #define XLS_TOOLS_TESTBENCH_H_
 
+#include <algorithm>
+#include <filesystem>
 #include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "absl/base/internal/sysinfo.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "xls/common/file/filesystem.h"
 #include "xls/common/integral_types.h"
+#include "xls/common/status/status_macros.h"
+#include "xls/common/status/statusor.h"
+#include "xls/tools/testbench.pb.h"
+#include "xls/tools/testbench_chunk_queue.h"
 #include "xls/tools/testbench_thread.h"
 
 namespace xls {
 
 // Testbench is a helper class to test an XLS module (or...anything, really)
-// across a range of inputs. This class creates a set of worker threads and
-// divides the input across them, and sets them to go until complete.
-// Execution status (percent complete, number of result mismatches) will be
-// periodically printed to the terminal, as this class' primary use is for
-// exploring large test spaces.
+// across a range of inputs. This class creates a set of worker threads which
+// evaluate the input space chunk by chunk until it's exhausted. Execution
+// status (percent complete, per-thread throughput, number of result
+// mismatches) will be periodically printed to the terminal, as this class'
+// primary use is for exploring large test spaces.
 //
-// Presently, work is parititioned uniformly across threads at startup. This can
-// lead to work imbalance if certain areas of the input space execute faster
-// than others. More advanced strategies can be explored in the future if this
-// becomes a problem.
+// Work is handed out in fixed-size chunks of the index space on demand (see
+// TestbenchChunkQueue), so threads which happen to get faster-executing areas
+// of the input space simply process more chunks. All callbacks operate on a
+// whole chunk at a time, to amortize their dispatch cost.
+//
+// If a checkpoint path is set, progress is periodically saved there, and a
+// subsequent run with the same path resumes from the last checkpoint. Since a
+// chunk's inputs are generated from its first index, generators which are
+// deterministic in that index reproduce exactly the same sweep on resume.
 template <typename JitWrapperT, typename InputT, typename ResultT>
 class Testbench {
  public:
+  // Batched callbacks; see TestbenchSharedState for their contracts.
+  using IndexToInputsFn =
+      std::function<void(uint64 first_index, absl::Span<InputT> inputs)>;
+  using ComputeExpectedFn = std::function<void(absl::Span<const InputT> inputs,
+                                               absl::Span<ResultT> results)>;
+  using ComputeActualFn =
+      std::function<void(JitWrapperT* jit_wrapper,
+                         absl::Span<const InputT> inputs,
+                         absl::Span<ResultT> results)>;
+  using CompareResultsFn =
+      std::function<void(absl::Span<const ResultT> expected,
+                         absl::Span<const ResultT> actual,
+                         std::vector<int64>* mismatches)>;
+
   // Args:
   //   start, end: The bounds of the space to evaluate, as [start, end).
-  //   max_failures: The maximum number of result mismatches to allow (per
-  //                  worker thread) before cancelling execution.
-  //   compute_actual: The function to call to calculate the XLS result.
-  //     "result_buffer" is a convenience buffer provided as temporary storage
-  //     to hold result data if using view types in the calculation. This buffer
-  //     isn't directly used internally all - it's just a convenience to avoid
-  //     the need to heap allocate on every iteration.
-  //   compare_results: Should return true if both ResultTs (expected & actual)
-  //                     are considered equivalent.
-  // These lambdas return pure InputTs and ResultTs instead of wrapping them in
-  // StatusOrs so we don't pay that tax on every iteration. If our algorithms
-  // die, we should fix that before evaluating for correctness (since any
-  // changes might affect results).
-  // All lambdas must be thread-safe.
-  // TODO(rspringer): Update Testbench & TestbenchThread to use the JIT
-  // wrappers once they're fully implemented.
+  //   max_failures: The maximum number of result mismatches to allow (across
+  //                 all worker threads) before cancelling execution. If 0,
+  //                 then there will be no limit.
+  //   index_to_inputs: Generates the inputs for a chunk of indices.
+  //   compute_expected: Calculates the reference results for a chunk.
+  //   compute_actual: Calculates the XLS results for a chunk, using the
+  //                   calling thread's JitWrapperT instance.
+  //   compare_results: Records which elements of a chunk's expected and
+  //                    actual results are not considered equivalent.
+  // These callbacks return pure InputTs and ResultTs instead of wrapping them
+  // in StatusOrs so we don't pay that tax on every iteration. If our
+  // algorithms die, we should fix that before evaluating for correctness
+  // (since any changes might affect results).
+  // All callbacks must be thread-safe.
+  Testbench(uint64 start, uint64 end, uint64 max_failures,
+            IndexToInputsFn index_to_inputs, ComputeExpectedFn compute_expected,
+            ComputeActualFn compute_actual, CompareResultsFn compare_results);
+
+  // As above, but with per-element callbacks, which are adapted to batched
+  // ones. "result_buffer" is a convenience buffer provided as temporary
+  // storage to hold result data if using view types in the calculation. This
+  // buffer isn't directly used internally at all - it's just a convenience to
+  // avoid the need to heap allocate on every iteration.
   Testbench(uint64 start, uint64 end, uint64 max_failures,
             std::function<InputT(uint64)> index_to_input,
             std::function<ResultT(InputT)> compute_expected,
@@ -67,15 +106,46 @@ class Testbench {
 
   // Sets the number of threads to use. Must be called before Run().
   absl::Status SetNumThreads(int num_threads) {
-    absl::MutexLock lock(&mutex_);
-    if (started_) {
-      return absl::FailedPreconditionError(
-          "Can't change the number of threads after starting execution.");
-    }
+    XLS_RETURN_IF_ERROR(CheckNotStarted());
     num_threads_ = num_threads;
     return absl::OkStatus();
   }
 
+  // Sets the number of indices handed to a thread at a time. Larger chunks
+  // reduce scheduling overhead; smaller ones improve load balance and lose
+  // less work when a run is interrupted. Must be called before Run().
+  absl::Status SetChunkSize(uint64 chunk_size) {
+    XLS_RETURN_IF_ERROR(CheckNotStarted());
+    if (chunk_size == 0) {
+      return absl::InvalidArgumentError("Chunk size must be positive.");
+    }
+    chunk_size_ = chunk_size;
+    return absl::OkStatus();
+  }
+
+  // Sets the file to save progress to, and to resume from if it already
+  // exists. Must be called before Run().
+  absl::Status SetCheckpointPath(const std::filesystem::path& path) {
+    XLS_RETURN_IF_ERROR(CheckNotStarted());
+    checkpoint_path_ = path;
+    return absl::OkStatus();
+  }
+
+  // Sets how inputs and results are printed when reporting mismatches; by
+  // default, see TestbenchDefaultFormat(). Must be called before Run().
+  absl::Status SetInputFormatter(
+      std::function<std::string(const InputT&)> format_input) {
+    XLS_RETURN_IF_ERROR(CheckNotStarted());
+    shared_.format_input = std::move(format_input);
+    return absl::OkStatus();
+  }
+  absl::Status SetResultFormatter(
+      std::function<std::string(const ResultT&)> format_result) {
+    XLS_RETURN_IF_ERROR(CheckNotStarted());
+    shared_.format_result = std::move(format_result);
+    return absl::OkStatus();
+  }
+
   // Executes the test.
   absl::Status Run();
 
@@ -83,36 +153,71 @@ class Testbench {
   // How many seconds to wait before printing status (at most).
   static constexpr absl::Duration kPrintInterval = absl::Seconds(5);
 
-  // Requests that all running threads terminate (but doesn't Join() them).
-  void Cancel();
+  static constexpr uint64 kDefaultChunkSize = 4096;
+
+  absl::Status CheckNotStarted() {
+    absl::MutexLock lock(&shared_.mutex);
+    if (started_) {
+      return absl::FailedPreconditionError(
+          "Can't change the configuration after starting execution.");
+    }
+    return absl::OkStatus();
+  }
+
+  // Reads the checkpoint at checkpoint_path_, if any, and returns the index
+  // to start from and the number of failures before it.
+  absl::Status ReadCheckpoint(uint64* first_index, uint64* num_failures);
+
+  // Saves the current progress to checkpoint_path_, if set.
+  absl::Status WriteCheckpoint();
 
   // Prints the current execution status across all threads.
   void PrintStatus();
 
-  // The main thread sleeps while tests are running. As worker threads finish,
-  // they'll wake us up via this condvar.
-  absl::Mutex mutex_;
-  absl::CondVar wake_me_;
-
+  TestbenchSharedState<JitWrapperT, InputT, ResultT> shared_;
+  std::unique_ptr<TestbenchChunkQueue> queue_;
   std::vector<std::unique_ptr<TestbenchThread<JitWrapperT, InputT, ResultT>>>
       threads_;
 
   bool started_;
   int num_threads_;
-  absl::Time start_time_;
+  uint64 chunk_size_;
+  std::filesystem::path checkpoint_path_;
   uint64 start_;
   uint64 end_;
-  uint64 max_failures_;
-  uint64 num_samples_processed_;
-  std::function<InputT(uint64)> index_to_input_;
-  std::function<ResultT(InputT)> compute_expected_;
-  std::function<ResultT(JitWrapperT*, absl::Span<uint8>, InputT)>
-      compute_actual_;
-  std::function<bool(ResultT, ResultT)> compare_results_;
+
+  // For computing throughput: the time of and per-thread evaluation counts at
+  // the last status print, and the index execution started from.
+  absl::Time start_time_;
+  absl::Time last_print_time_;
+  std::vector<uint64> last_print_counts_;
+  uint64 first_index_;
 };
 
 // INTERNAL IMPL ---------------------------------
 
+template <typename JitWrapperT, typename InputT, typename ResultT>
+Testbench<JitWrapperT, InputT, ResultT>::Testbench(
+    uint64 start, uint64 end, uint64 max_failures,
+    IndexToInputsFn index_to_inputs, ComputeExpectedFn compute_expected,
+    ComputeActualFn compute_actual, CompareResultsFn compare_results)
+    : started_(false),
+      num_threads_(absl::base_internal::NumCPUs()),
+      chunk_size_(kDefaultChunkSize),
+      start_(start),
+      end_(end) {
+  shared_.index_to_inputs = std::move(index_to_inputs);
+  shared_.compute_expected = std::move(compute_expected);
+  shared_.compute_actual = std::move(compute_actual);
+  shared_.compare_results = std::move(compare_results);
+  shared_.format_input = TestbenchDefaultFormat<InputT>;
+  shared_.format_result = TestbenchDefaultFormat<ResultT>;
+  shared_.max_failures = max_failures;
+  shared_.queue = nullptr;
+  shared_.num_failures.store(0);
+  shared_.cancelled.store(false);
+}
+
 template <typename JitWrapperT, typename InputT, typename ResultT>
 Testbench<JitWrapperT, InputT, ResultT>::Testbench(
     uint64 start, uint64 end, uint64 max_failures,
@@ -121,140 +226,215 @@ Testbench<JitWrapperT, InputT, ResultT>::Testbench(
     std::function<ResultT(JitWrapperT*, absl::Span<uint8>, InputT)>
         compute_actual,
     std::function<bool(ResultT, ResultT)> compare_results)
-    : started_(false),
-      num_threads_(absl::base_internal::NumCPUs()),
-      start_(start),
-      end_(end),
-      max_failures_(max_failures),
-      num_samples_processed_(0),
-      index_to_input_(index_to_input),
-      compute_expected_(compute_expected),
-      compute_actual_(compute_actual),
-      compare_results_(compare_results) {}
+    : Testbench(
+          start, end, max_failures,
+          [index_to_input](uint64 first_index, absl::Span<InputT> inputs) {
+            for (int64 i = 0; i < inputs.size(); ++i) {
+              inputs[i] = index_to_input(first_index + i);
+            }
+          },
+          [compute_expected](absl::Span<const InputT> inputs,
+                             absl::Span<ResultT> results) {
+            for (int64 i = 0; i < inputs.size(); ++i) {
+              results[i] = compute_expected(inputs[i]);
+            }
+          },
+          [compute_actual](JitWrapperT* jit_wrapper,
+                           absl::Span<const InputT> inputs,
+                           absl::Span<ResultT> results) {
+            thread_local std::vector<uint8> result_buffer;
+            result_buffer.resize(jit_wrapper->jit()->GetReturnTypeSize());
+            for (int64 i = 0; i < inputs.size(); ++i) {
+              results[i] = compute_actual(
+                  jit_wrapper, absl::MakeSpan(result_buffer), inputs[i]);
+            }
+          },
+          [compare_results](absl::Span<const ResultT> expected,
+                            absl::Span<const ResultT> actual,
+                            std::vector<int64>* mismatches) {
+            for (int64 i = 0; i < expected.size(); ++i) {
+              if (!compare_results(expected[i], actual[i])) {
+                mismatches->push_back(i);
+              }
+            }
+          }) {}
+
+template <typename JitWrapperT, typename InputT, typename ResultT>
+absl::Status Testbench<JitWrapperT, InputT, ResultT>::ReadCheckpoint(
+    uint64* first_index, uint64* num_failures) {
+  *first_index = start_;
+  *num_failures = 0;
+  if (checkpoint_path_.empty() || !FileExists(checkpoint_path_).ok()) {
+    return absl::OkStatus();
+  }
+  XLS_ASSIGN_OR_RETURN(
+      TestbenchCheckpointProto checkpoint,
+      ParseTextProtoFile<TestbenchCheckpointProto>(checkpoint_path_));
+  if (checkpoint.start() != start_ || checkpoint.end() != end_ ||
+      checkpoint.chunk_size() != chunk_size_) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Checkpoint %s is for the range [%d, %d) with chunk size %d, not "
+        "[%d, %d) with chunk size %d.",
+        checkpoint_path_.string(), checkpoint.start(), checkpoint.end(),
+        checkpoint.chunk_size(), start_, end_, chunk_size_));
+  }
+  if (checkpoint.next_index() < start_ || checkpoint.next_index() > end_ ||
+      (checkpoint.next_index() != end_ &&
+       (checkpoint.next_index() - start_) % chunk_size_ != 0)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Checkpoint %s has invalid next index %d.",
+                        checkpoint_path_.string(), checkpoint.next_index()));
+  }
+  *first_index = checkpoint.next_index();
+  *num_failures = checkpoint.num_failures();
+  std::cout << absl::StreamFormat(
+                   "Resuming from checkpoint %s at index %d (%d failures so "
+                   "far)",
+                   checkpoint_path_.string(), *first_index, *num_failures)
+            << std::endl;
+  return absl::OkStatus();
+}
+
+template <typename JitWrapperT, typename InputT, typename ResultT>
+absl::Status Testbench<JitWrapperT, InputT, ResultT>::WriteCheckpoint() {
+  if (checkpoint_path_.empty()) {
+    return absl::OkStatus();
+  }
+  TestbenchCheckpointProto checkpoint;
+  checkpoint.set_start(start_);
+  checkpoint.set_end(end_);
+  checkpoint.set_chunk_size(chunk_size_);
+  checkpoint.set_next_index(queue_->completed_end());
+  checkpoint.set_num_failures(queue_->completed_failures());
+
+  // Write to a temporary file and rename it so an interruption never leaves a
+  // truncated checkpoint behind.
+  std::filesystem::path temp_path = checkpoint_path_;
+  temp_path += ".tmp";
+  XLS_RETURN_IF_ERROR(SetTextProtoFile(temp_path, checkpoint));
+  std::error_code error;
+  std::filesystem::rename(temp_path, checkpoint_path_, error);
+  if (error) {
+    return absl::InternalError(
+        absl::StrFormat("Unable to write checkpoint %s: %s",
+                        checkpoint_path_.string(), error.message()));
+  }
+  return absl::OkStatus();
+}
 
 template <typename JitWrapperT, typename InputT, typename ResultT>
 absl::Status Testbench<JitWrapperT, InputT, ResultT>::Run() {
+  {
+    absl::MutexLock lock(&shared_.mutex);
+    if (started_) {
+      return absl::FailedPreconditionError("Testbench has already been run.");
+    }
+    started_ = true;
+  }
+  if (start_ > end_) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Invalid range [%d, %d).", start_, end_));
+  }
+
+  uint64 prior_failures;
+  XLS_RETURN_IF_ERROR(ReadCheckpoint(&first_index_, &prior_failures));
+  queue_ = std::make_unique<TestbenchChunkQueue>(
+      start_, end_, chunk_size_, first_index_, prior_failures);
+  shared_.queue = queue_.get();
+  shared_.num_failures.store(prior_failures);
+  if (shared_.max_failures != 0 && prior_failures >= shared_.max_failures) {
+    return absl::InternalError(absl::StrFormat(
+        "Checkpoint %s already records %d mismatches.",
+        checkpoint_path_.string(), prior_failures));
+  }
+
   // Lock before spawning threads to prevent missing any early wakeup signals
   // here.
-  mutex_.Lock();
-  started_ = true;
+  shared_.mutex.Lock();
   start_time_ = absl::Now();
-
-  // Set up all the workers.
-  uint64 chunk_size = (end_ - start_) / num_threads_;
-  uint64 chunk_remainder = (end_ - start_) % chunk_size;
-  uint64 first = 0;
-  uint64 last;
+  last_print_time_ = start_time_;
+  last_print_counts_.assign(num_threads_, 0);
   for (int i = 0; i < num_threads_; i++) {
-    last = first + chunk_size;
-    // Distribute any remainder evenly amongst the threads.
-    if (chunk_remainder > 0) {
-      last++;
-      chunk_remainder--;
-    }
-
     threads_.push_back(
         std::make_unique<TestbenchThread<JitWrapperT, InputT, ResultT>>(
-            &mutex_, &wake_me_, first, last, max_failures_, index_to_input_,
-            compute_expected_, compute_actual_, compare_results_));
+            &shared_));
     threads_.back()->Run();
-
-    first = last + 1;
   }
 
-  // Now monitor them.
-  bool done = false;
-  while (!done) {
-    int num_done = 0;
-    wake_me_.WaitWithTimeout(&mutex_, kPrintInterval);
-
-    PrintStatus();
-
-    // See if everyone's done or if someone blew up.
-    for (int i = 0; i < threads_.size(); i++) {
-      if (!threads_[i]->running()) {
-        num_done++;
-        absl::Status status = threads_[i]->status();
-        if (!status.ok()) {
-          Cancel();
-          num_done = threads_.size();
-          break;
-        }
-      }
+  // Now monitor them. Workers cancel each other on errors, so we only need to
+  // wait for all of them to finish.
+  absl::Status checkpoint_status;
+  while (true) {
+    shared_.wake.WaitWithTimeout(&shared_.mutex, kPrintInterval);
+    bool done = true;
+    for (const auto& thread : threads_) {
+      done &= thread->done();
     }
-
-    done = num_done == threads_.size();
+    if (done) {
+      break;
+    }
+    PrintStatus();
+    checkpoint_status.Update(WriteCheckpoint());
   }
 
   // When exiting the loop, we'll be holding the lock (due to WaitWithTimeout).
-  mutex_.Unlock();
+  shared_.mutex.Unlock();
 
   // Join threads at the end because we are polite.
   for (int i = 0; i < threads_.size(); i++) {
     threads_[i]->Join();
   }
+  PrintStatus();
+  checkpoint_status.Update(WriteCheckpoint());
 
   for (int i = 0; i < threads_.size(); i++) {
-    if (threads_[i]->num_failures() != 0) {
-      return absl::InternalError(
-          "There was at least one mismatch during execution.");
-    }
+    XLS_RETURN_IF_ERROR(threads_[i]->status());
+  }
+  XLS_RETURN_IF_ERROR(checkpoint_status);
+  if (shared_.num_failures.load() != 0) {
+    return absl::InternalError(
+        "There was at least one mismatch during execution.");
   }
-
   return absl::OkStatus();
 }
 
 template <typename JitWrapperT, typename InputT, typename ResultT>
 void Testbench<JitWrapperT, InputT, ResultT>::PrintStatus() {
-  // Get the remainder-adjusted chunk size for this thread.
-  auto thread_chunk_size = [this](int thread_index) {
-    uint64 total_size = end_ - start_;
-    uint64 chunk_size = total_size / threads_.size();
-    uint64 remainder = total_size % chunk_size;
-    if (thread_index < remainder) {
-      chunk_size++;
-    }
-    return chunk_size;
-  };
-
-  // Ignore remainder issues here. It shouldn't matter much at all.
   absl::Time now = absl::Now();
-  auto delta = now - start_time_;
+  double interval_seconds = std::max(
+      absl::ToDoubleSeconds(now - last_print_time_), 1e-6);
   uint64 total_done = 0;
+  uint64 done_this_print = 0;
   for (int64 i = 0; i < threads_.size(); ++i) {
-    uint64 num_passes = threads_[i]->num_passes();
     uint64 num_failures = threads_[i]->num_failures();
-    uint64 thread_done = num_passes + num_failures;
-    uint64 chunk_size = thread_chunk_size(i);
+    uint64 thread_done = threads_[i]->num_passes() + num_failures;
     total_done += thread_done;
+    done_this_print += thread_done - last_print_counts_[i];
     std::cout << absl::StreamFormat(
-                     "thread %02d: %f%% @ %.1f us/sample :: failures %d", i,
-                     static_cast<double>(thread_done) / chunk_size * 100.0,
-                     absl::ToDoubleMicroseconds(delta) / thread_done,
-                     num_failures)
+                     "thread %02d: %.2f Mevals/s :: %d chunks :: failures %d",
+                     i,
+                     (thread_done - last_print_counts_[i]) / interval_seconds /
+                         1e6,
+                     threads_[i]->num_chunks(), num_failures)
               << "\n";
+    last_print_counts_[i] = thread_done;
   }
-  double done_per_second = total_done / absl::ToDoubleSeconds(delta);
-  int64 remaining = end_ - start_ - total_done;
-  auto estimate = absl::Seconds(remaining / done_per_second);
-  double throughput_this_print =
-      static_cast<double>(total_done - num_samples_processed_) /
-      ToInt64Seconds(kPrintInterval);
+
+  double space_size = end_ - start_;
+  double done = static_cast<double>(first_index_ - start_) + total_done;
+  absl::Duration elapsed = now - start_time_;
+  double done_per_second = total_done / absl::ToDoubleSeconds(elapsed);
+  absl::Duration estimate =
+      absl::Seconds((space_size - done) / done_per_second);
   std::cout << absl::StreamFormat(
-                   "--- ^ after %s elapsed; %.2f Misamples/s; estimate %s "
-                   "remaining ...",
-                   absl::FormatDuration(delta),
-                   throughput_this_print / std::pow(2, 20),
+                   "--- ^ after %s elapsed; %.2f%% complete; %.2f Mevals/s; "
+                   "estimate %s remaining ...",
+                   absl::FormatDuration(elapsed),
+                   space_size == 0 ? 100.0 : done / space_size * 100.0,
+                   done_this_print / interval_seconds / 1e6,
                    absl::FormatDuration(estimate))
             << std::endl;
-  num_samples_processed_ = total_done;
-}
-
-template <typename JitWrapperT, typename InputT, typename ResultT>
-void Testbench<JitWrapperT, InputT, ResultT>::Cancel() {
-  for (int i = 0; i < threads_.size(); i++) {
-    threads_[i]->Cancel();
-  }
+  last_print_time_ = now;
 }
 
 }  // namespace xls
@@ -0,0 +1,91 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/tools/testbench_chunk_queue.h"
+
+#include <algorithm>
+
+#include "xls/common/logging/logging.h"
+
+namespace xls {
+
+TestbenchChunkQueue::TestbenchChunkQueue(uint64 start, uint64 end,
+                                         uint64 chunk_size, uint64 first_index,
+                                         uint64 num_failures)
+    : start_(start),
+      end_(end),
+      chunk_size_(chunk_size),
+      // Written to avoid overflow when the space spans all 64-bit values.
+      num_chunks_((end - start) / chunk_size +
+                  ((end - start) % chunk_size == 0 ? 0 : 1)),
+      completed_chunks_(0),
+      completed_failures_(num_failures) {
+  XLS_CHECK_LE(start, end);
+  XLS_CHECK_GT(chunk_size, 0);
+  XLS_CHECK(first_index >= start && first_index <= end);
+  XLS_CHECK(first_index == end || (first_index - start) % chunk_size == 0)
+      << "Index " << first_index << " is not on a chunk boundary.";
+  completed_chunks_ = first_index == end ? num_chunks_
+                                         : (first_index - start) / chunk_size;
+  next_chunk_.store(completed_chunks_);
+}
+
+uint64 TestbenchChunkQueue::ChunkStart(uint64 chunk) const {
+  if (chunk >= num_chunks_) {
+    return end_;
+  }
+  return start_ + chunk * chunk_size_;
+}
+
+bool TestbenchChunkQueue::Claim(uint64* first, uint64* last) {
+  // Threads which find the queue empty each bump the counter once more before
+  // returning, which is harmless for any realistic number of threads.
+  uint64 chunk = next_chunk_.fetch_add(1);
+  if (chunk >= num_chunks_) {
+    return false;
+  }
+  *first = ChunkStart(chunk);
+  *last = *first + std::min(chunk_size_, end_ - *first);
+  return true;
+}
+
+void TestbenchChunkQueue::Complete(uint64 first, uint64 num_failures) {
+  uint64 chunk = (first - start_) / chunk_size_;
+  absl::MutexLock lock(&mutex_);
+  if (chunk != completed_chunks_) {
+    completed_out_of_order_[chunk] = num_failures;
+    return;
+  }
+  completed_chunks_++;
+  completed_failures_ += num_failures;
+  auto it = completed_out_of_order_.find(completed_chunks_);
+  while (it != completed_out_of_order_.end()) {
+    completed_chunks_++;
+    completed_failures_ += it->second;
+    completed_out_of_order_.erase(it);
+    it = completed_out_of_order_.find(completed_chunks_);
+  }
+}
+
+uint64 TestbenchChunkQueue::completed_end() const {
+  absl::MutexLock lock(&mutex_);
+  return ChunkStart(completed_chunks_);
+}
+
+uint64 TestbenchChunkQueue::completed_failures() const {
+  absl::MutexLock lock(&mutex_);
+  return completed_failures_;
+}
+
+}  // namespace xls
@@ -0,0 +1,90 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef XLS_TOOLS_TESTBENCH_CHUNK_QUEUE_H_
+#define XLS_TOOLS_TESTBENCH_CHUNK_QUEUE_H_
+
+#include <atomic>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "xls/common/integral_types.h"
+
+namespace xls {
+
+// Divides the index space [start, end) into fixed-size chunks and hands them
+// out to worker threads on demand. Since a thread only claims its next chunk
+// once it has finished its last one, faster threads naturally take over work
+// slower ones would otherwise have been assigned.
+//
+// Chunks may complete out of order; the queue tracks the longest completed
+// prefix of the index space (and the number of failures within it), which is
+// what a checkpoint can safely record.
+class TestbenchChunkQueue {
+ public:
+  // Creates a queue over [start, end) whose indices below "first_index" have
+  // already been evaluated, with "num_failures" failures among them.
+  // "first_index" must lie on a chunk boundary.
+  TestbenchChunkQueue(uint64 start, uint64 end, uint64 chunk_size,
+                      uint64 first_index, uint64 num_failures);
+
+  // Claims the next unclaimed chunk, [*first, *last). Returns false if none
+  // remain. Thread-safe and lock-free.
+  bool Claim(uint64* first, uint64* last);
+
+  // Records that the claimed chunk starting at "first" has been evaluated,
+  // with "num_failures" failures. Thread-safe.
+  void Complete(uint64 first, uint64 num_failures);
+
+  // Returns the end of the completed prefix of the index space, i.e., all
+  // indices in [start, completed_end()) have been evaluated.
+  uint64 completed_end() const;
+
+  // Returns the number of failures in [start, completed_end()).
+  uint64 completed_failures() const;
+
+  uint64 start() const { return start_; }
+  uint64 end() const { return end_; }
+  uint64 chunk_size() const { return chunk_size_; }
+
+ private:
+  // Returns the index of the first element of the given chunk, saturating at
+  // end_.
+  uint64 ChunkStart(uint64 chunk) const;
+
+  const uint64 start_;
+  const uint64 end_;
+  const uint64 chunk_size_;
+  const uint64 num_chunks_;
+
+  // The number of the next chunk to hand out.
+  std::atomic<uint64> next_chunk_;
+
+  mutable absl::Mutex mutex_;
+
+  // The number of leading chunks which have all completed, and their total
+  // failure count.
+  uint64 completed_chunks_ ABSL_GUARDED_BY(mutex_);
+  uint64 completed_failures_ ABSL_GUARDED_BY(mutex_);
+
+  // Chunks past the completed prefix which have completed, mapped to their
+  // failure counts. Its size is bounded by the number of worker threads times
+  // how far the fastest runs ahead of the slowest.
+  absl::flat_hash_map<uint64, uint64> completed_out_of_order_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace xls
+
+#endif  // XLS_TOOLS_TESTBENCH_CHUNK_QUEUE_H_
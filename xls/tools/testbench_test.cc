@@ -0,0 +1,295 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "xls/tools/testbench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "xls/common/file/filesystem.h"
+#include "xls/common/file/temp_directory.h"
+#include "xls/common/integral_types.h"
+#include "xls/common/status/matchers.h"
+#include "xls/common/status/statusor.h"
+#include "xls/tools/testbench.pb.h"
+
+namespace xls {
+namespace {
+
+using status_testing::StatusIs;
+using ::testing::HasSubstr;
+
+// Stands in for a generated JIT wrapper; "computes" the square of its input.
+class FakeJitWrapper {
+ public:
+  // Only used to size the result buffer for per-element callbacks.
+  struct FakeJit {
+    int64 GetReturnTypeSize() { return 8; }
+  };
+
+  static xabsl::StatusOr<std::unique_ptr<FakeJitWrapper>> Create() {
+    return std::make_unique<FakeJitWrapper>();
+  }
+
+  FakeJit* jit() { return &jit_; }
+
+  uint64 Run(uint64 x) { return x * x; }
+
+ private:
+  FakeJit jit_;
+};
+
+using FakeTestbench = Testbench<FakeJitWrapper, uint64, uint64>;
+
+// Records how many times each index in [0, size) is evaluated, and computes
+// results which mismatch at the given indices.
+class TestbenchTest : public ::testing::Test {
+ protected:
+  void SetUpSpace(uint64 size, std::vector<uint64> bad_indices = {}) {
+    evaluations_ = std::vector<std::atomic<int64>>(size);
+    bad_indices_ = std::move(bad_indices);
+  }
+
+  std::unique_ptr<FakeTestbench> MakeTestbench(uint64 start, uint64 end,
+                                               uint64 max_failures) {
+    return std::make_unique<FakeTestbench>(
+        start, end, max_failures,
+        [](uint64 first_index, absl::Span<uint64> inputs) {
+          for (int64 i = 0; i < inputs.size(); ++i) {
+            inputs[i] = first_index + i;
+          }
+        },
+        [this](absl::Span<const uint64> inputs, absl::Span<uint64> results) {
+          for (int64 i = 0; i < inputs.size(); ++i) {
+            evaluations_[inputs[i]].fetch_add(1);
+            results[i] = inputs[i] * inputs[i];
+          }
+        },
+        [this](FakeJitWrapper* jit_wrapper, absl::Span<const uint64> inputs,
+               absl::Span<uint64> results) {
+          for (int64 i = 0; i < inputs.size(); ++i) {
+            results[i] = jit_wrapper->Run(inputs[i]);
+            if (std::count(bad_indices_.begin(), bad_indices_.end(),
+                           inputs[i])) {
+              results[i]++;
+            }
+          }
+        },
+        [](absl::Span<const uint64> expected, absl::Span<const uint64> actual,
+           std::vector<int64>* mismatches) {
+          for (int64 i = 0; i < expected.size(); ++i) {
+            if (expected[i] != actual[i]) {
+              mismatches->push_back(i);
+            }
+          }
+        });
+  }
+
+  // Returns the number of indices evaluated exactly once, and expects no
+  // index to have been evaluated more often.
+  int64 CountEvaluatedOnce(uint64 start, uint64 end) {
+    int64 count = 0;
+    for (uint64 i = start; i < end; ++i) {
+      EXPECT_LE(evaluations_[i].load(), 1) << "index " << i;
+      count += evaluations_[i].load() == 1;
+    }
+    return count;
+  }
+
+  std::vector<std::atomic<int64>> evaluations_;
+  std::vector<uint64> bad_indices_;
+};
+
+TEST_F(TestbenchTest, EvaluatesEachIndexOnce) {
+  SetUpSpace(100000);
+  auto testbench = MakeTestbench(10, 99999, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->SetNumThreads(4));
+  XLS_ASSERT_OK(testbench->SetChunkSize(1000));
+  XLS_ASSERT_OK(testbench->Run());
+  EXPECT_EQ(CountEvaluatedOnce(0, 10), 0);
+  EXPECT_EQ(CountEvaluatedOnce(10, 99999), 99989);
+  EXPECT_EQ(CountEvaluatedOnce(99999, 100000), 0);
+}
+
+TEST_F(TestbenchTest, EmptyRange) {
+  SetUpSpace(10);
+  auto testbench = MakeTestbench(5, 5, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->Run());
+  EXPECT_EQ(CountEvaluatedOnce(0, 10), 0);
+}
+
+TEST_F(TestbenchTest, ReportsMismatches) {
+  SetUpSpace(10000, {1234, 5678});
+  auto testbench = MakeTestbench(0, 10000, /*max_failures=*/0);
+  XLS_ASSERT_OK(testbench->SetNumThreads(3));
+  XLS_ASSERT_OK(testbench->SetChunkSize(100));
+  EXPECT_THAT(testbench->Run(), StatusIs(absl::StatusCode::kInternal,
+                                         HasSubstr("at least one mismatch")));
+  // Without a failure limit, the whole space is still evaluated.
+  EXPECT_EQ(CountEvaluatedOnce(0, 10000), 10000);
+}
+
+TEST_F(TestbenchTest, MaxFailuresCancelsExecution) {
+  SetUpSpace(100000, {4321});
+  auto testbench = MakeTestbench(0, 100000, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->SetNumThreads(1));
+  XLS_ASSERT_OK(testbench->SetChunkSize(100));
+  EXPECT_THAT(testbench->Run(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("Value mismatch at index 4321")));
+  EXPECT_EQ(CountEvaluatedOnce(0, 100000), 4400);
+}
+
+TEST_F(TestbenchTest, PerElementCallbacks) {
+  std::atomic<int64> count(0);
+  FakeTestbench testbench(
+      0, 5000, /*max_failures=*/1, [](uint64 index) { return index; },
+      [&](uint64 x) {
+        count.fetch_add(1);
+        return x * x;
+      },
+      [](FakeJitWrapper* jit_wrapper, absl::Span<uint8> result_buffer,
+         uint64 x) {
+        EXPECT_EQ(result_buffer.size(), 8);
+        return jit_wrapper->Run(x);
+      },
+      [](uint64 a, uint64 b) { return a == b; });
+  XLS_ASSERT_OK(testbench.SetChunkSize(64));
+  XLS_ASSERT_OK(testbench.Run());
+  EXPECT_EQ(count.load(), 5000);
+}
+
+TEST_F(TestbenchTest, ResumesFromCheckpoint) {
+  XLS_ASSERT_OK_AND_ASSIGN(TempDirectory temp_dir, TempDirectory::Create());
+  std::filesystem::path checkpoint_path = temp_dir.path() / "checkpoint";
+  TestbenchCheckpointProto checkpoint;
+  checkpoint.set_start(0);
+  checkpoint.set_end(10000);
+  checkpoint.set_chunk_size(100);
+  checkpoint.set_next_index(6000);
+  checkpoint.set_num_failures(0);
+  XLS_ASSERT_OK(SetTextProtoFile(checkpoint_path, checkpoint));
+
+  SetUpSpace(10000);
+  auto testbench = MakeTestbench(0, 10000, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->SetChunkSize(100));
+  XLS_ASSERT_OK(testbench->SetCheckpointPath(checkpoint_path));
+  XLS_ASSERT_OK(testbench->Run());
+  EXPECT_EQ(CountEvaluatedOnce(0, 6000), 0);
+  EXPECT_EQ(CountEvaluatedOnce(6000, 10000), 4000);
+
+  XLS_ASSERT_OK_AND_ASSIGN(checkpoint,
+                           ParseTextProtoFile<TestbenchCheckpointProto>(
+                               checkpoint_path));
+  EXPECT_EQ(checkpoint.next_index(), 10000);
+  EXPECT_EQ(checkpoint.num_failures(), 0);
+}
+
+TEST_F(TestbenchTest, CheckpointRecordsFailures) {
+  XLS_ASSERT_OK_AND_ASSIGN(TempDirectory temp_dir, TempDirectory::Create());
+  std::filesystem::path checkpoint_path = temp_dir.path() / "checkpoint";
+
+  SetUpSpace(1000, {10, 20, 990});
+  auto testbench = MakeTestbench(0, 1000, /*max_failures=*/0);
+  XLS_ASSERT_OK(testbench->SetChunkSize(7));
+  XLS_ASSERT_OK(testbench->SetCheckpointPath(checkpoint_path));
+  EXPECT_THAT(testbench->Run(), StatusIs(absl::StatusCode::kInternal));
+  XLS_ASSERT_OK_AND_ASSIGN(
+      TestbenchCheckpointProto checkpoint,
+      ParseTextProtoFile<TestbenchCheckpointProto>(checkpoint_path));
+  EXPECT_EQ(checkpoint.next_index(), 1000);
+  EXPECT_EQ(checkpoint.num_failures(), 3);
+
+  // Resuming the finished run evaluates nothing, but still fails.
+  SetUpSpace(1000);
+  testbench = MakeTestbench(0, 1000, /*max_failures=*/0);
+  XLS_ASSERT_OK(testbench->SetChunkSize(7));
+  XLS_ASSERT_OK(testbench->SetCheckpointPath(checkpoint_path));
+  EXPECT_THAT(testbench->Run(), StatusIs(absl::StatusCode::kInternal));
+  EXPECT_EQ(CountEvaluatedOnce(0, 1000), 0);
+}
+
+TEST_F(TestbenchTest, MismatchedCheckpointIsAnError) {
+  XLS_ASSERT_OK_AND_ASSIGN(TempDirectory temp_dir, TempDirectory::Create());
+  std::filesystem::path checkpoint_path = temp_dir.path() / "checkpoint";
+  TestbenchCheckpointProto checkpoint;
+  checkpoint.set_start(0);
+  checkpoint.set_end(10000);
+  checkpoint.set_chunk_size(100);
+  checkpoint.set_next_index(6000);
+  XLS_ASSERT_OK(SetTextProtoFile(checkpoint_path, checkpoint));
+
+  SetUpSpace(10000);
+  auto testbench = MakeTestbench(0, 10000, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->SetChunkSize(1000));
+  XLS_ASSERT_OK(testbench->SetCheckpointPath(checkpoint_path));
+  EXPECT_THAT(testbench->Run(), StatusIs(absl::StatusCode::kInvalidArgument,
+                                         HasSubstr("chunk size 100")));
+}
+
+TEST_F(TestbenchTest, ConfigurationIsFixedAfterRun) {
+  SetUpSpace(10);
+  auto testbench = MakeTestbench(0, 10, /*max_failures=*/1);
+  XLS_ASSERT_OK(testbench->Run());
+  EXPECT_THAT(testbench->SetNumThreads(2),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(testbench->Run(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(TestbenchChunkQueueTest, TracksCompletedPrefix) {
+  TestbenchChunkQueue queue(100, 350, 100, 100, 0);
+  uint64 first, last;
+  ASSERT_TRUE(queue.Claim(&first, &last));
+  EXPECT_EQ(first, 100);
+  EXPECT_EQ(last, 200);
+  ASSERT_TRUE(queue.Claim(&first, &last));
+  ASSERT_TRUE(queue.Claim(&first, &last));
+  EXPECT_EQ(first, 300);
+  EXPECT_EQ(last, 350);
+  EXPECT_FALSE(queue.Claim(&first, &last));
+
+  queue.Complete(300, 1);
+  EXPECT_EQ(queue.completed_end(), 100);
+  queue.Complete(100, 2);
+  EXPECT_EQ(queue.completed_end(), 200);
+  EXPECT_EQ(queue.completed_failures(), 2);
+  queue.Complete(200, 0);
+  EXPECT_EQ(queue.completed_end(), 350);
+  EXPECT_EQ(queue.completed_failures(), 3);
+}
+
+TEST(TestbenchChunkQueueTest, FullIndexSpace) {
+  constexpr uint64 kMax = std::numeric_limits<uint64>::max();
+  TestbenchChunkQueue queue(0, kMax, uint64{1} << 62, uint64{3} << 62, 5);
+  EXPECT_EQ(queue.completed_end(), uint64{3} << 62);
+  EXPECT_EQ(queue.completed_failures(), 5);
+  uint64 first, last;
+  ASSERT_TRUE(queue.Claim(&first, &last));
+  EXPECT_EQ(first, uint64{3} << 62);
+  EXPECT_EQ(last, kMax);
+  EXPECT_FALSE(queue.Claim(&first, &last));
+  queue.Complete(first, 0);
+  EXPECT_EQ(queue.completed_end(), kMax);
+}
+
+}  // namespace
+}  // namespace xls
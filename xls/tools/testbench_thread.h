@@ -15,66 +15,109 @@
 #ifndef XLS_TOOLS_TESTBENCH_THREAD_H_
 #define XLS_TOOLS_TESTBENCH_THREAD_H_
 
+#include <atomic>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
-#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xls/common/integral_types.h"
 #include "xls/common/logging/logging.h"
-#include "xls/ir/ir_parser.h"
-#include "xls/ir/llvm_ir_jit.h"
-#include "xls/ir/package.h"
+#include "xls/common/status/statusor.h"
+#include "xls/tools/testbench_chunk_queue.h"
 
 namespace xls {
 
-// TestbenchThread handles the work of _actually_ running tests.
-// It simply iterates over its given range of the index space and calls the
-// expected/actual calculators.
+// Returns a printable representation of a testbench input or result: its
+// value (for arithmetic types) and its raw bytes (for trivially copyable
+// types).
+template <typename T>
+std::string TestbenchDefaultFormat(const T& value) {
+  std::string bytes;
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    uint8 buffer[sizeof(T)];
+    std::memcpy(buffer, &value, sizeof(T));
+    // Most significant byte first, assuming a little-endian host.
+    bytes = "0x";
+    for (int64 i = sizeof(T) - 1; i >= 0; --i) {
+      absl::StrAppendFormat(&bytes, "%02x", buffer[i]);
+    }
+  } else {
+    bytes = "<unprintable>";
+  }
+  if constexpr (std::is_arithmetic_v<T>) {
+    return absl::StrCat(value, " (", bytes, ")");
+  }
+  return bytes;
+}
+
+// The state shared between a Testbench and its worker threads.
+template <typename JitWrapperT, typename InputT, typename ResultT>
+struct TestbenchSharedState {
+  // Fills "inputs" with the inputs for indices [first_index, first_index +
+  // inputs.size()).
+  std::function<void(uint64 first_index, absl::Span<InputT> inputs)>
+      index_to_inputs;
+  // Compute the expected and actual results for a batch of inputs.
+  std::function<void(absl::Span<const InputT> inputs,
+                     absl::Span<ResultT> results)>
+      compute_expected;
+  std::function<void(JitWrapperT* jit_wrapper, absl::Span<const InputT> inputs,
+                     absl::Span<ResultT> results)>
+      compute_actual;
+  // Appends the positions at which "expected" and "actual" differ to
+  // "mismatches".
+  std::function<void(absl::Span<const ResultT> expected,
+                     absl::Span<const ResultT> actual,
+                     std::vector<int64>* mismatches)>
+      compare_results;
+  std::function<std::string(const InputT&)> format_input;
+  std::function<std::string(const ResultT&)> format_result;
+
+  // The total number of failures allowed before cancelling execution; zero
+  // for no limit.
+  uint64 max_failures;
+
+  TestbenchChunkQueue* queue;
+
+  // The failures found by all threads, including any in a resumed checkpoint.
+  std::atomic<uint64> num_failures;
+  std::atomic<bool> cancelled;
+
+  // Signalled by worker threads as they finish.
+  absl::Mutex mutex;
+  absl::CondVar wake;
+};
+
+// TestbenchThread handles the work of _actually_ running tests. It
+// repeatedly claims a chunk of the index space from the shared queue and
+// calls the batched input/expected/actual/compare callbacks on it, until the
+// queue is empty or execution is cancelled.
 template <typename JitWrapperT, typename InputT, typename ResultT>
 class TestbenchThread {
  public:
-  // All specified functions must be thread-safe.
-  //  - wake_parent_mutex: A mutex that protects:
-  //  - wake_parent: A condvar to kick the parent when this thread has finished.
-  //  - max_failures: The number of failures that will cause us to bail out.
-  //                  If 0, then there will be no limit.
-  //  - index_to_input: A function that can convert an index to an input to the
-  //                    calculation routines.
-  //  - generate_expected: Given an input, generates the "expected" value.
-  //  - generate_actual: Given an input, generates a value from the module
-  //                     under test.
-  TestbenchThread(
-      absl::Mutex* wake_parent_mutex, absl::CondVar* wake_parent,
-      uint64 start_index, uint64 end_index, uint64 max_failures,
-      std::function<InputT(uint64)> index_to_input,
-      std::function<ResultT(InputT)> generate_expected,
-      std::function<ResultT(JitWrapperT*, absl::Span<uint8>, InputT)>
-          generate_actual,
-      std::function<bool(ResultT, ResultT)> compare_results)
-      : wake_parent_mutex_(wake_parent_mutex),
-        wake_parent_(wake_parent),
-        cancelled_(false),
-        running_(false),
-        start_index_(start_index),
-        end_index_(end_index),
-        max_failures_(max_failures),
+  explicit TestbenchThread(
+      TestbenchSharedState<JitWrapperT, InputT, ResultT>* shared)
+      : shared_(shared),
+        done_(false),
         num_passes_(0),
         num_failures_(0),
-        index_to_input_(index_to_input),
-        generate_expected_(generate_expected),
-        generate_actual_(generate_actual),
-        compare_results_(compare_results) {}
+        num_chunks_(0) {}
 
   // Starts the thread. Silently returns if it's already running.
-  // If the tax of calling index_to_input_ every iter is too high, we can
-  // specialize this for simple cases, like uint64 -> uint64.
   void Run() {
     if (thread_) {
       return;
     }
-    thread_ = absl::make_unique<std::thread>([this]() { RunInternal(); });
+    thread_ = std::make_unique<std::thread>([this]() { RunInternal(); });
   }
 
   void Join() {
@@ -84,65 +127,13 @@ class TestbenchThread {
     thread_.reset();
   }
 
-  void RunInternal() {
-    absl::Status return_status;
-    if (cancelled_.load()) {
-      return;
-    }
-
-    xabsl::StatusOr<std::unique_ptr<JitWrapperT>> status_or_wrapper =
-        JitWrapperT::Create();
-    XLS_CHECK_OK(status_or_wrapper.status());
-    jit_wrapper_ = std::move(status_or_wrapper.value());
-    auto result_buffer =
-        std::make_unique<uint8[]>(jit_wrapper_->jit()->GetReturnTypeSize());
-    absl::Span<uint8> result_span(result_buffer.get(),
-                                  jit_wrapper_->jit()->GetReturnTypeSize());
-
-    running_.store(true);
-    for (uint64 i = start_index_; i < end_index_; i++) {
-      // Don't check for cancelled on every iteration; it's a touch slow.
-      if (i % 128 == 0 && cancelled_.load()) {
-        return_status = absl::CancelledError("This thread was cancelled.");
-        break;
-      }
-
-      InputT input = index_to_input_(i);
-      ResultT expected = generate_expected_(input);
-      ResultT actual = generate_actual_(jit_wrapper_.get(), result_span, input);
-      if (!compare_results_(expected, actual)) {
-        num_failures_.store(num_failures_.load() + 1);
-        std::string error = absl::StrFormat(
-            "Value mismatch at index %d:\n"
-            "  Expected: 0x%x\n"
-            "  Actual  : 0x%x",
-            i, absl::bit_cast<uint32>(expected),
-            absl::bit_cast<uint32>(actual));
-        XLS_LOG(ERROR) << error;
-        if (max_failures_ <= num_failures_.load()) {
-          return_status = absl::InternalError(error);
-          break;
-        }
-      } else {
-        num_passes_.store(num_passes_.load() + 1);
-      }
-    }
-
-    running_.store(false);
-    {
-      absl::MutexLock lock(&mutex_);
-      status_ = return_status;
-    }
-    WakeParent();
-  }
-
-  void Cancel() { cancelled_.store(true); }
-
-  bool running() { return running_.load(); }
+  // Returns whether the thread has finished (successfully or otherwise).
+  bool done() { return done_.load(); }
 
+  // The number of evaluations this thread has performed.
   uint64 num_failures() { return num_failures_.load(); }
-
   uint64 num_passes() { return num_passes_.load(); }
+  uint64 num_chunks() { return num_chunks_.load(); }
 
   absl::Status status() {
     absl::MutexLock lock(&mutex_);
@@ -150,43 +141,87 @@ class TestbenchThread {
   }
 
  private:
-  // Kicks the parent threads's condvar to indicate that this thread has
-  // finished its work (successfully or otherwise).
-  void WakeParent() {
-    absl::MutexLock lock(wake_parent_mutex_);
-    wake_parent_->Signal();
+  void RunInternal() {
+    absl::Status status = Evaluate();
+    {
+      absl::MutexLock lock(&mutex_);
+      status_ = status;
+    }
+    done_.store(true);
+    absl::MutexLock lock(&shared_->mutex);
+    shared_->wake.Signal();
+  }
+
+  absl::Status Evaluate() {
+    xabsl::StatusOr<std::unique_ptr<JitWrapperT>> jit_wrapper_or =
+        JitWrapperT::Create();
+    if (!jit_wrapper_or.ok()) {
+      shared_->cancelled.store(true);
+      return jit_wrapper_or.status();
+    }
+    std::unique_ptr<JitWrapperT> jit_wrapper =
+        std::move(jit_wrapper_or.value());
+
+    uint64 chunk_size = shared_->queue->chunk_size();
+    std::vector<InputT> inputs(chunk_size);
+    std::vector<ResultT> expected(chunk_size);
+    std::vector<ResultT> actual(chunk_size);
+    std::vector<int64> mismatches;
+    uint64 first;
+    uint64 last;
+    while (!shared_->cancelled.load() && shared_->queue->Claim(&first, &last)) {
+      int64 size = last - first;
+      absl::Span<InputT> input_span = absl::MakeSpan(inputs).subspan(0, size);
+      absl::Span<ResultT> expected_span =
+          absl::MakeSpan(expected).subspan(0, size);
+      absl::Span<ResultT> actual_span = absl::MakeSpan(actual).subspan(0, size);
+      shared_->index_to_inputs(first, input_span);
+      shared_->compute_expected(input_span, expected_span);
+      shared_->compute_actual(jit_wrapper.get(), input_span, actual_span);
+      mismatches.clear();
+      shared_->compare_results(expected_span, actual_span, &mismatches);
+
+      // The whole chunk has been evaluated even if we stop below, so it can be
+      // recorded as complete.
+      shared_->queue->Complete(first, mismatches.size());
+      num_passes_.fetch_add(size - mismatches.size());
+      num_failures_.fetch_add(mismatches.size());
+      num_chunks_.fetch_add(1);
+
+      for (int64 i : mismatches) {
+        std::string error = absl::StrFormat(
+            "Value mismatch at index %d:\n"
+            "  Input   : %s\n"
+            "  Expected: %s\n"
+            "  Actual  : %s",
+            first + i, shared_->format_input(inputs[i]),
+            shared_->format_result(expected[i]),
+            shared_->format_result(actual[i]));
+        XLS_LOG(ERROR) << error;
+        uint64 total_failures = shared_->num_failures.fetch_add(1) + 1;
+        if (shared_->max_failures != 0 &&
+            total_failures >= shared_->max_failures) {
+          shared_->cancelled.store(true);
+          return absl::InternalError(error);
+        }
+      }
+    }
+    return absl::OkStatus();
   }
 
-  // Parent-owned.
-  absl::Mutex* wake_parent_mutex_;
-  absl::CondVar* wake_parent_;
+  TestbenchSharedState<JitWrapperT, InputT, ResultT>* shared_;
 
   // Protects TestbenchThread-owned data.
   absl::Mutex mutex_;
 
-  // The current (and eventually final) status of this worker.
+  // The final status of this worker.
   absl::Status status_ ABSL_GUARDED_BY(mutex_);
-  std::atomic<bool> cancelled_;
-  std::atomic<bool> running_;
-
-  uint64 start_index_;
-  uint64 end_index_;
+  std::atomic<bool> done_;
 
   // Bookkeeping data.
-  uint64 max_failures_;
   std::atomic<uint64> num_passes_;
   std::atomic<uint64> num_failures_;
-
-  std::function<InputT(uint64)> index_to_input_;
-  std::function<ResultT(InputT)> generate_expected_;
-  std::function<ResultT(JitWrapperT*, absl::Span<uint8>, InputT)>
-      generate_actual_;
-  std::function<bool(ResultT, ResultT)> compare_results_;
-
-  std::string ir_text_;
-  std::string entry_fn_;
-  std::unique_ptr<Package> package_;
-  std::unique_ptr<JitWrapperT> jit_wrapper_;
+  std::atomic<uint64> num_chunks_;
 
   std::unique_ptr<std::thread> thread_;
 };